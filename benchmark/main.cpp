@@ -0,0 +1,368 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/box2d.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs testbed style scenes without graphics and prints the time per step, so solver and
+// broad-phase options can be compared on the same scene. Run it with the name of a group
+// and optionally the number of steps, for example "benchmark solver 600". Bodies never
+// sleep, so every step does the full work. Build with optimizations.
+
+typedef void SceneFcn(b2World* world);
+
+static void CreateHeavy1(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position.Set(0.0f, 0.5f);
+	b2Body* body = world->CreateBody(&bd);
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+	body->CreateFixture(&circle, 10.0f);
+
+	bd.position.Set(0.0f, 6.0f);
+	body = world->CreateBody(&bd);
+	circle.m_radius = 5.0f;
+	body->CreateFixture(&circle, 10.0f);
+}
+
+// Heavy 2 with the heavy circle dropped on the two light ones.
+static void CreateHeavy2(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+
+	bd.position.Set(0.0f, 2.5f);
+	world->CreateBody(&bd)->CreateFixture(&circle, 10.0f);
+	bd.position.Set(0.0f, 3.5f);
+	world->CreateBody(&bd)->CreateFixture(&circle, 10.0f);
+
+	bd.position.Set(0.0f, 9.0f);
+	circle.m_radius = 5.0f;
+	world->CreateBody(&bd)->CreateFixture(&circle, 10.0f);
+}
+
+static void CreatePyramid(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	const int32 count = 20;
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2Vec2 x(-7.0f, 0.75f);
+	b2Vec2 deltaX(0.5625f, 1.25f);
+	b2Vec2 deltaY(1.125f, 0.0f);
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Vec2 y = x;
+		for (int32 j = i; j < count; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position = y;
+			world->CreateBody(&bd)->CreateFixture(&box, 5.0f);
+			y += deltaY;
+		}
+		x += deltaX;
+	}
+}
+
+// The tile floor of the tiles test with a 60 by 50 block of boxes dropped on it.
+static void CreateTiles(b2World* world)
+{
+	float a = 0.5f;
+	b2BodyDef groundDef;
+	groundDef.position.y = -a;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	int32 N = 200;
+	int32 M = 10;
+	b2Vec2 position;
+	position.y = 0.0f;
+	for (int32 j = 0; j < M; ++j)
+	{
+		position.x = -N * a;
+		for (int32 i = 0; i < N; ++i)
+		{
+			b2PolygonShape shape;
+			shape.SetAsBox(a, a, position, 0.0f);
+			ground->CreateFixture(&shape, 0.0f);
+			position.x += 2.0f * a;
+		}
+		position.y -= 2.0f * a;
+	}
+
+	b2PolygonShape box;
+	box.SetAsBox(0.4f, 0.4f);
+	for (int32 i = 0; i < 3000; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-30.0f + 1.0f * (i % 60), 1.0f + 1.0f * (i / 60));
+		world->CreateBody(&bd)->CreateFixture(&box, 5.0f);
+	}
+}
+
+// Circles piled in a bin, like a large circle stack.
+static void CreateCircleBin(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(-20.0f, 80.0f));
+	ground->CreateFixture(&edge, 0.0f);
+	edge.SetTwoSided(b2Vec2(20.0f, 0.0f), b2Vec2(20.0f, 80.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.25f;
+	for (int32 i = 0; i < 4000; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-18.5f + 0.75f * (i % 50), 1.0f + 0.75f * (i / 50));
+		world->CreateBody(&bd)->CreateFixture(&circle, 1.0f);
+	}
+}
+
+// Boxes bouncing in a closed room without gravity, so every proxy keeps moving.
+static void CreateBouncing(b2World* world)
+{
+	world->SetGravity(b2Vec2_zero);
+
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	// Clockwise, so the one-sided walls face into the room.
+	b2Vec2 corners[4] = { b2Vec2(-50.0f, -50.0f), b2Vec2(-50.0f, 50.0f), b2Vec2(50.0f, 50.0f), b2Vec2(50.0f, -50.0f) };
+	b2ChainShape chain;
+	chain.CreateLoop(corners, 4);
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.25f, 0.25f);
+	b2FixtureDef fd;
+	fd.shape = &box;
+	fd.density = 1.0f;
+	fd.friction = 0.0f;
+	fd.restitution = 1.0f;
+
+	uint32 seed = 12345;
+	for (int32 i = 0; i < 4000; ++i)
+	{
+		seed = 1664525 * seed + 1013904223;
+		float angle = (seed >> 8) * (2.0f * b2_pi / 16777216.0f);
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-48.0f + 1.5f * (i % 64), -48.0f + 1.5f * (i / 64));
+		bd.linearVelocity.Set(8.0f * cosf(angle), 8.0f * sinf(angle));
+		world->CreateBody(&bd)->CreateFixture(&fd);
+	}
+}
+
+struct Result
+{
+	float step;
+	float solve;
+	float broadphase;
+	float pairs;
+
+	// The deepest contact overlap at the end, a measure of solver quality.
+	float overlap;
+};
+
+static float ComputeOverlap(b2World* world)
+{
+	float overlap = 0.0f;
+	for (b2Contact* c = world->GetContactList(); c; c = c->GetNext())
+	{
+		if (c->IsTouching() == false)
+		{
+			continue;
+		}
+
+		const b2Fixture* fixtureA = c->GetFixtureA();
+		const b2Fixture* fixtureB = c->GetFixtureB();
+		b2WorldManifold worldManifold;
+		worldManifold.Initialize(c->GetManifold(), fixtureA->GetBody()->GetTransform(), fixtureA->GetShape()->m_radius,
+								 fixtureB->GetBody()->GetTransform(), fixtureB->GetShape()->m_radius);
+		for (int32 i = 0; i < c->GetManifold()->pointCount; ++i)
+		{
+			overlap = b2Max(overlap, -worldManifold.separations[i]);
+		}
+	}
+	return overlap;
+}
+
+static Result Run(b2World* world, int32 stepCount, int32 velocityIterations, int32 positionIterations)
+{
+	Result result;
+	memset(&result, 0, sizeof(Result));
+
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		world->Step(1.0f / 60.0f, velocityIterations, positionIterations);
+		const b2Profile& profile = world->GetProfile();
+		result.step += profile.step;
+		result.solve += profile.solve;
+		result.broadphase += profile.broadphase;
+		result.pairs += profile.pairs;
+	}
+
+	result.step /= stepCount;
+	result.solve /= stepCount;
+	result.broadphase /= stepCount;
+	result.pairs /= stepCount;
+	result.overlap = ComputeOverlap(world);
+	return result;
+}
+
+// The default solver at 8 velocity and 3 position iterations against the soft step at
+// 4 sub-steps.
+static void BenchmarkSolver(int32 stepCount)
+{
+	struct Scene
+	{
+		const char* name;
+		SceneFcn* fcn;
+	};
+
+	Scene scenes[] =
+	{
+		{ "heavy 1", CreateHeavy1 },
+		{ "heavy 2", CreateHeavy2 },
+		{ "pyramid", CreatePyramid },
+	};
+
+	printf("solver, %d steps\n", stepCount);
+	printf("%-12s %-10s %10s %10s %10s\n", "scene", "solver", "step ms", "solve ms", "overlap");
+	for (int32 i = 0; i < int32(sizeof(scenes) / sizeof(scenes[0])); ++i)
+	{
+		for (int32 mode = 0; mode < 2; ++mode)
+		{
+			b2World world(b2Vec2(0.0f, -10.0f));
+			world.SetAllowSleeping(false);
+			world.SetSoftStep(mode == 1);
+			scenes[i].fcn(&world);
+
+			Result result = mode == 1 ? Run(&world, stepCount, 4, 3) : Run(&world, stepCount, 8, 3);
+			printf("%-12s %-10s %10.4f %10.4f %10.4f\n", scenes[i].name, mode == 1 ? "soft" : "default",
+				result.step, result.solve, result.overlap);
+		}
+	}
+}
+
+// The tree, the grid and sort and sweep on scenes with many moving proxies.
+static void BenchmarkBroadPhase(int32 stepCount)
+{
+	struct Scene
+	{
+		const char* name;
+		SceneFcn* fcn;
+	};
+
+	Scene scenes[] =
+	{
+		{ "tiles", CreateTiles },
+		{ "circle bin", CreateCircleBin },
+		{ "bouncing", CreateBouncing },
+	};
+
+	const char* typeNames[] = { "tree", "grid", "sweep" };
+	b2BroadPhaseType types[] = { b2_treeBroadPhase, b2_gridBroadPhase, b2_sweepBroadPhase };
+
+	printf("broadphase, %d steps\n", stepCount);
+	printf("%-12s %-10s %10s %10s %10s\n", "scene", "type", "step ms", "broad ms", "pairs");
+	for (int32 i = 0; i < int32(sizeof(scenes) / sizeof(scenes[0])); ++i)
+	{
+		for (int32 j = 0; j < 3; ++j)
+		{
+			b2BroadPhaseDef def;
+			def.type = types[j];
+			b2World world(b2Vec2(0.0f, -10.0f), nullptr, def);
+			world.SetAllowSleeping(false);
+			scenes[i].fcn(&world);
+
+			Result result = Run(&world, stepCount, 8, 3);
+			printf("%-12s %-10s %10.4f %10.4f %10.0f\n", scenes[i].name, typeNames[j],
+				result.step, result.broadphase, result.pairs);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* group = argc > 1 ? argv[1] : "all";
+	int32 stepCount = argc > 2 ? atoi(argv[2]) : 300;
+	if (stepCount <= 0)
+	{
+		printf("usage: benchmark [all|solver|broadphase] [step count]\n");
+		return 1;
+	}
+
+	bool all = strcmp(group, "all") == 0;
+	bool found = false;
+	if (all || strcmp(group, "solver") == 0)
+	{
+		BenchmarkSolver(stepCount);
+		found = true;
+	}
+
+	if (all || strcmp(group, "broadphase") == 0)
+	{
+		BenchmarkBroadPhase(stepCount);
+		found = true;
+	}
+
+	if (found == false)
+	{
+		printf("usage: benchmark [all|solver|broadphase] [step count]\n");
+		return 1;
+	}
+
+	return 0;
+}
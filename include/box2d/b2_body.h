@@ -26,6 +26,7 @@
 #include "b2_api.h"
 #include "b2_math.h"
 #include "b2_shape.h"
+#include "b2_time_step.h"
 
 class b2Fixture;
 class b2Joint;
@@ -175,7 +176,9 @@ public:
 	float GetAngle() const;
 
 	/// Get the world position of the center of mass.
-	const b2Vec2& GetWorldCenter() const;
+	/// @note this returns a copy. The body state is stored in arrays of the world that
+	/// move when bodies are created, so a reference would not stay valid.
+	b2Vec2 GetWorldCenter() const;
 
 	/// Get the local position of the center of mass.
 	const b2Vec2& GetLocalCenter() const;
@@ -185,8 +188,8 @@ public:
 	void SetLinearVelocity(const b2Vec2& v);
 
 	/// Get the linear velocity of the center of mass.
-	/// @return the linear velocity of the center of mass.
-	const b2Vec2& GetLinearVelocity() const;
+	/// @return the linear velocity of the center of mass. This is a copy, see GetWorldCenter.
+	b2Vec2 GetLinearVelocity() const;
 
 	/// Set the angular velocity.
 	/// @param omega the new angular velocity in radians/second.
@@ -393,6 +396,7 @@ private:
 	friend class b2ContactManager;
 	friend class b2ContactSolver;
 	friend class b2Contact;
+	friend class b2ConstraintGraph;
 
 	friend class b2DistanceJoint;
 	friend class b2FrictionJoint;
@@ -423,23 +427,43 @@ private:
 	void SynchronizeFixtures();
 	void SynchronizeTransform();
 
+	// SynchronizeFixtures in two parts. Sweeping can run in parallel for different bodies.
+	void SweepFixtures();
+	void MoveFixtureProxies();
+
 	// This is used to prevent connected bodies from colliding.
 	// It may lie, depending on the collideConnected flag.
 	bool ShouldCollide(const b2Body* other) const;
 
 	void Advance(float t);
 
+	// The center, angle, and velocity are kept by the world in the solver arrays.
+	b2Position& GetSolverPosition();
+	const b2Position& GetSolverPosition() const;
+	b2Position& GetSolverPosition0();
+	const b2Position& GetSolverPosition0() const;
+	b2Velocity& GetSolverVelocity();
+	const b2Velocity& GetSolverVelocity() const;
+
+	// The swept motion for CCD.
+	b2Sweep GetSweep() const;
+	void SetSweep(const b2Sweep& sweep);
+
 	b2BodyType m_type;
 
 	uint16 m_flags;
 
+	// The index used by the constraints to access the solver arrays of an island.
 	int32 m_islandIndex;
 
+	// The index of the body state in the solver arrays of the world.
+	int32 m_solverIndex;
+	b2SolverBodies* m_solverBodies;
+
 	b2Transform m_xf;		// the body origin transform
-	b2Sweep m_sweep;		// the swept motion for CCD
 
-	b2Vec2 m_linearVelocity;
-	float m_angularVelocity;
+	b2Vec2 m_localCenter;	// local center of mass position
+	float m_alpha0;			// fraction of the current time step in the range [0,1]
 
 	b2Vec2 m_force;
 	float m_torque;
@@ -485,17 +509,17 @@ inline const b2Vec2& b2Body::GetPosition() const
 
 inline float b2Body::GetAngle() const
 {
-	return m_sweep.a;
+	return GetSolverPosition().a;
 }
 
-inline const b2Vec2& b2Body::GetWorldCenter() const
+inline b2Vec2 b2Body::GetWorldCenter() const
 {
-	return m_sweep.c;
+	return GetSolverPosition().c;
 }
 
 inline const b2Vec2& b2Body::GetLocalCenter() const
 {
-	return m_sweep.localCenter;
+	return m_localCenter;
 }
 
 inline void b2Body::SetLinearVelocity(const b2Vec2& v)
@@ -510,12 +534,12 @@ inline void b2Body::SetLinearVelocity(const b2Vec2& v)
 		SetAwake(true);
 	}
 
-	m_linearVelocity = v;
+	GetSolverVelocity().v = v;
 }
 
-inline const b2Vec2& b2Body::GetLinearVelocity() const
+inline b2Vec2 b2Body::GetLinearVelocity() const
 {
-	return m_linearVelocity;
+	return GetSolverVelocity().v;
 }
 
 inline void b2Body::SetAngularVelocity(float w)
@@ -530,12 +554,12 @@ inline void b2Body::SetAngularVelocity(float w)
 		SetAwake(true);
 	}
 
-	m_angularVelocity = w;
+	GetSolverVelocity().w = w;
 }
 
 inline float b2Body::GetAngularVelocity() const
 {
-	return m_angularVelocity;
+	return GetSolverVelocity().w;
 }
 
 inline float b2Body::GetMass() const
@@ -545,15 +569,15 @@ inline float b2Body::GetMass() const
 
 inline float b2Body::GetInertia() const
 {
-	return m_I + m_mass * b2Dot(m_sweep.localCenter, m_sweep.localCenter);
+	return m_I + m_mass * b2Dot(m_localCenter, m_localCenter);
 }
 
 inline b2MassData b2Body::GetMassData() const
 {
 	b2MassData data;
 	data.mass = m_mass;
-	data.I = m_I + m_mass * b2Dot(m_sweep.localCenter, m_sweep.localCenter);
-	data.center = m_sweep.localCenter;
+	data.I = m_I + m_mass * b2Dot(m_localCenter, m_localCenter);
+	data.center = m_localCenter;
 	return data;
 }
 
@@ -579,7 +603,8 @@ inline b2Vec2 b2Body::GetLocalVector(const b2Vec2& worldVector) const
 
 inline b2Vec2 b2Body::GetLinearVelocityFromWorldPoint(const b2Vec2& worldPoint) const
 {
-	return m_linearVelocity + b2Cross(m_angularVelocity, worldPoint - m_sweep.c);
+	const b2Velocity& v = GetSolverVelocity();
+	return v.v + b2Cross(v.w, worldPoint - GetSolverPosition().c);
 }
 
 inline b2Vec2 b2Body::GetLinearVelocityFromLocalPoint(const b2Vec2& localPoint) const
@@ -650,8 +675,8 @@ inline void b2Body::SetAwake(bool flag)
 	{
 		m_flags &= ~e_awakeFlag;
 		m_sleepTime = 0.0f;
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
+		GetSolverVelocity().v.SetZero();
+		GetSolverVelocity().w = 0.0f;
 		m_force.SetZero();
 		m_torque = 0.0f;
 	}
@@ -756,7 +781,7 @@ inline void b2Body::ApplyForce(const b2Vec2& force, const b2Vec2& point, bool wa
 	if (m_flags & e_awakeFlag)
 	{
 		m_force += force;
-		m_torque += b2Cross(point - m_sweep.c, force);
+		m_torque += b2Cross(point - GetSolverPosition().c, force);
 	}
 }
 
@@ -813,8 +838,9 @@ inline void b2Body::ApplyLinearImpulse(const b2Vec2& impulse, const b2Vec2& poin
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_linearVelocity += m_invMass * impulse;
-		m_angularVelocity += m_invI * b2Cross(point - m_sweep.c, impulse);
+		b2Velocity& v = GetSolverVelocity();
+		v.v += m_invMass * impulse;
+		v.w += m_invI * b2Cross(point - GetSolverPosition().c, impulse);
 	}
 }
 
@@ -833,7 +859,7 @@ inline void b2Body::ApplyLinearImpulseToCenter(const b2Vec2& impulse, bool wake)
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_linearVelocity += m_invMass * impulse;
+		GetSolverVelocity().v += m_invMass * impulse;
 	}
 }
 
@@ -852,24 +878,88 @@ inline void b2Body::ApplyAngularImpulse(float impulse, bool wake)
 	// Don't accumulate velocity if the body is sleeping
 	if (m_flags & e_awakeFlag)
 	{
-		m_angularVelocity += m_invI * impulse;
+		GetSolverVelocity().w += m_invI * impulse;
 	}
 }
 
 inline void b2Body::SynchronizeTransform()
 {
-	m_xf.q.Set(m_sweep.a);
-	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
+	const b2Position& p = GetSolverPosition();
+	m_xf.q.Set(p.a);
+	m_xf.p = p.c - b2Mul(m_xf.q, m_localCenter);
 }
 
 inline void b2Body::Advance(float alpha)
 {
 	// Advance to the new safe time. This doesn't sync the broad-phase.
-	m_sweep.Advance(alpha);
-	m_sweep.c = m_sweep.c0;
-	m_sweep.a = m_sweep.a0;
-	m_xf.q.Set(m_sweep.a);
-	m_xf.p = m_sweep.c - b2Mul(m_xf.q, m_sweep.localCenter);
+	b2Sweep sweep = GetSweep();
+	sweep.Advance(alpha);
+	m_alpha0 = sweep.alpha0;
+
+	b2Position& p = GetSolverPosition();
+	b2Position& p0 = GetSolverPosition0();
+	p0.c = sweep.c0;
+	p0.a = sweep.a0;
+	p = p0;
+	m_xf.q.Set(p.a);
+	m_xf.p = p.c - b2Mul(m_xf.q, m_localCenter);
+}
+
+inline b2Position& b2Body::GetSolverPosition()
+{
+	return m_solverBodies->positions[m_solverIndex];
+}
+
+inline const b2Position& b2Body::GetSolverPosition() const
+{
+	return m_solverBodies->positions[m_solverIndex];
+}
+
+inline b2Position& b2Body::GetSolverPosition0()
+{
+	return m_solverBodies->positions0[m_solverIndex];
+}
+
+inline const b2Position& b2Body::GetSolverPosition0() const
+{
+	return m_solverBodies->positions0[m_solverIndex];
+}
+
+inline b2Velocity& b2Body::GetSolverVelocity()
+{
+	return m_solverBodies->velocities[m_solverIndex];
+}
+
+inline const b2Velocity& b2Body::GetSolverVelocity() const
+{
+	return m_solverBodies->velocities[m_solverIndex];
+}
+
+inline b2Sweep b2Body::GetSweep() const
+{
+	const b2Position& p = GetSolverPosition();
+	const b2Position& p0 = GetSolverPosition0();
+
+	b2Sweep sweep;
+	sweep.localCenter = m_localCenter;
+	sweep.c0 = p0.c;
+	sweep.c = p.c;
+	sweep.a0 = p0.a;
+	sweep.a = p.a;
+	sweep.alpha0 = m_alpha0;
+	return sweep;
+}
+
+inline void b2Body::SetSweep(const b2Sweep& sweep)
+{
+	b2Position& p = GetSolverPosition();
+	b2Position& p0 = GetSolverPosition0();
+	m_localCenter = sweep.localCenter;
+	p0.c = sweep.c0;
+	p.c = sweep.c;
+	p0.a = sweep.a0;
+	p.a = sweep.a;
+	m_alpha0 = sweep.alpha0;
 }
 
 inline b2World* b2Body::GetWorld()
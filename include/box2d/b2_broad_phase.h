@@ -27,6 +27,10 @@
 #include "b2_settings.h"
 #include "b2_collision.h"
 #include "b2_dynamic_tree.h"
+#include "b2_spatial_hash.h"
+#include "b2_sweep_and_prune.h"
+#include "b2_compact_tree.h"
+#include "b2_wide_tree.h"
 
 struct B2_API b2Pair
 {
@@ -34,9 +38,45 @@ struct B2_API b2Pair
 	int32 proxyIdB;
 };
 
+/// The structure that holds the proxies of moving bodies. Static proxies are always
+/// kept in a tree.
+enum b2BroadPhaseType
+{
+	b2_treeBroadPhase,	///< a dynamic AABB tree, see b2DynamicTree
+	b2_gridBroadPhase,	///< a uniform grid, see b2SpatialHash
+	b2_sweepBroadPhase	///< sort and sweep on the x-axis, see b2SweepAndPrune
+};
+
+/// Broad-phase settings that are chosen when the world is created.
+struct B2_API b2BroadPhaseDef
+{
+	b2BroadPhaseDef()
+	{
+		type = b2_treeBroadPhase;
+		cellSize = b2_hashCellSize;
+	}
+
+	/// The structure for the proxies of moving bodies.
+	b2BroadPhaseType type;
+
+	/// The cell size of the grid. This should be about the size of the moving shapes.
+	float cellSize;
+};
+
+class b2TaskScheduler;
+class b2TreeRebuildTask;
+struct b2BroadPhaseWorker;
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+/// Static proxies are kept in their own tree, so the tree that changes every step only
+/// holds the moving proxies. That tree is rebuilt in the background when its quality
+/// drops, see StartRebuild. The static tree is rebuilt when many static proxies changed
+/// and it lost quality. Queries of the static tree can go through a b2WideTree copy that
+/// is built when it changes, or a b2CompactTree copy for very large static worlds. The
+/// moving proxies can be kept in a uniform grid or sorted for sort and sweep instead of
+/// a tree, see b2BroadPhaseType.
 class B2_API b2BroadPhase
 {
 public:
@@ -46,19 +86,36 @@ public:
 		e_nullProxy = -1
 	};
 
+	enum
+	{
+		e_staticTree = 0,
+		e_dynamicTree = 1,
+		e_treeCount = 2
+	};
+
 	b2BroadPhase();
 	~b2BroadPhase();
 
+	/// Choose the structure for the moving proxies. There must be no proxies.
+	void SetType(const b2BroadPhaseDef& def);
+	b2BroadPhaseType GetType() const;
+
 	/// Create a proxy with an initial AABB. Pairs are not reported until
 	/// UpdatePairs is called.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// @param isStatic static proxies never form pairs with each other.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool isStatic = false);
+
+	/// Create many proxies at once. This rebuilds the tree, see b2DynamicTree::CreateProxies.
+	/// Pairs are not reported until UpdatePairs is called.
+	void CreateProxies(int32 count, const b2AABB* aabbs, void* const* userData, int32* proxyIds, bool isStatic = false);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
 
 	/// Call MoveProxy as many times as you like, then when you are done
 	/// call UpdatePairs to finalized the proxy pairs (for your time step).
-	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement);
+	/// @param margin the extension of the fat AABB on each side, see b2UpdateFatAABB.
+	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement, const b2Vec2& margin = b2Vec2(b2_aabbExtension, b2_aabbExtension));
 
 	/// Call to trigger a re-processing of it's pairs on the next call to UpdatePairs.
 	void TouchProxy(int32 proxyId);
@@ -75,9 +132,32 @@ public:
 	/// Get the number of proxies.
 	int32 GetProxyCount() const;
 
+	/// Get the number of times a proxy moved outside of its fat AABB. Sample this every
+	/// step to get the move rate.
+	int32 GetProxyMoveCount() const;
+
+	/// Get the number of proxies queried for new pairs and the number of potential pairs
+	/// they found, summed over all calls to UpdatePairs.
+	int32 GetPairQueryCount() const;
+	int32 GetFoundPairCount() const;
+
+	/// Enable/disable adaptive fat AABB margins. This is read by b2Fixture, which passes
+	/// the margins to MoveProxy.
+	void SetAdaptiveMargins(bool flag);
+	bool GetAdaptiveMargins() const;
+
+	/// Enable/disable refit mode for the tree of moving proxies. See b2DynamicTree::SetRefitMode.
+	/// The tree is refit before the pairs are updated.
+	void SetRefitMode(bool flag);
+
+	/// Is this a static proxy?
+	bool IsStaticProxy(int32 proxyId) const;
+
 	/// Update the pairs. This results in pair callbacks. This can only add pairs.
+	/// @param scheduler if this is not null the tree queries are run in parallel. The
+	/// pairs are reported in the same order either way.
 	template <typename T>
-	void UpdatePairs(T* callback);
+	void UpdatePairs(T* callback, b2TaskScheduler* scheduler = nullptr);
 
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
@@ -94,15 +174,53 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
-	/// Get the height of the embedded tree.
+	/// Ray-cast a packet of up to b2_maxRayPacket rays against the proxies. The callback
+	/// is called as callback->RayCastCallback(input, proxyId, rayIndex) and its return
+	/// value clips or terminates that ray only.
+	/// @param inputs the rays. On return each maxFraction holds the clipped fraction,
+	/// or zero if the ray was terminated.
+	template <typename T>
+	void RayCastPacket(T* callback, b2RayCastInput* inputs, int32 count) const;
+
+	/// Get the height of the taller embedded tree.
 	int32 GetTreeHeight() const;
 
-	/// Get the balance of the embedded tree.
+	/// Get the worst balance of the embedded trees.
 	int32 GetTreeBalance() const;
 
-	/// Get the quality metric of the embedded tree.
+	/// Get the worst quality metric of the embedded trees.
 	float GetTreeQuality() const;
 
+	/// Start rebuilding the tree of moving proxies if its quality has dropped far enough
+	/// since the last rebuild. The new tree is built from a snapshot, so the broad-phase
+	/// can be used as usual until FinishRebuild is called.
+	/// @param scheduler the rebuild runs as a background task on this. If this is null the
+	/// new tree is built inline, but it is still swapped in by FinishRebuild.
+	void StartRebuild(b2TaskScheduler* scheduler);
+
+	/// Wait for a rebuild started by StartRebuild and swap in the new tree. This does
+	/// nothing if no rebuild is running.
+	void FinishRebuild();
+
+	/// Wait for the background task of a rebuild without swapping in the new tree. Call
+	/// this before the scheduler passed to StartRebuild goes away.
+	void WaitForRebuild();
+
+	/// Enable/disable the b2WideTree copy of the static tree. The copy is built again
+	/// before the next pair update whenever a static proxy changes. This is disabled by
+	/// default.
+	void SetWideTree(bool flag);
+	bool GetWideTree() const;
+
+	/// Enable/disable the b2CompactTree copy of the static tree. It takes the place of
+	/// the wide copy and uses less memory per proxy. This is disabled by default.
+	void SetCompactTree(bool flag);
+	bool GetCompactTree() const;
+
+	/// Set the quality ratio that triggers a rebuild. Use zero to disable rebuilds.
+	/// The default is b2_treeRebuildRatio.
+	void SetRebuildThreshold(float threshold);
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -111,13 +229,146 @@ public:
 private:
 
 	friend class b2DynamicTree;
+	friend class b2WideTree;
+	friend class b2CompactTree;
+	friend class b2SpatialHash;
+	friend class b2SweepAndPrune;
+	friend class b2FindPairsTask;
+	friend struct b2BroadPhaseWorker;
+
+	// Forwards the leaves of one tree to the client with their proxy ids.
+	template <typename T>
+	struct QueryWrapper
+	{
+		bool QueryCallback(int32 nodeId)
+		{
+			proceed = callback->QueryCallback(MakeProxyId(nodeId, treeType));
+			return proceed;
+		}
+
+		T* callback;
+		int32 treeType;
+		bool proceed;
+	};
+
+	// Forwards the leaves of one tree to the client with their proxy ids and keeps the
+	// clipped ray for the next tree.
+	template <typename T>
+	struct RayCastWrapper
+	{
+		float RayCastCallback(const b2RayCastInput& input, int32 nodeId)
+		{
+			float value = callback->RayCastCallback(input, MakeProxyId(nodeId, treeType));
+			if (value == 0.0f)
+			{
+				terminated = true;
+			}
+			else if (value > 0.0f)
+			{
+				maxFraction = value;
+			}
+			return value;
+		}
+
+		T* callback;
+		int32 treeType;
+		float maxFraction;
+		bool terminated;
+	};
+
+	template <typename T>
+	struct RayCastPacketWrapper
+	{
+		float RayCastCallback(const b2RayCastInput& input, int32 nodeId, int32 rayIndex)
+		{
+			return callback->RayCastCallback(input, MakeProxyId(nodeId, treeType), rayIndex);
+		}
+
+		T* callback;
+		int32 treeType;
+	};
+
+	// Forwards one ray of a packet to a structure that casts a single ray.
+	template <typename T>
+	struct RayCastRayWrapper
+	{
+		float RayCastCallback(const b2RayCastInput& input, int32 nodeId)
+		{
+			float value = callback->RayCastCallback(input, nodeId, rayIndex);
+			if (value >= 0.0f)
+			{
+				*maxFraction = value;
+			}
+			return value;
+		}
+
+		T* callback;
+		int32 rayIndex;
+		float* maxFraction;
+	};
+
+	// The tree of a proxy is in the lowest bit of the proxy id.
+	static int32 MakeProxyId(int32 nodeId, int32 treeType) { return (nodeId << 1) | treeType; }
+	static int32 GetTreeType(int32 proxyId) { return proxyId & 1; }
+	static int32 GetNodeId(int32 proxyId) { return proxyId >> 1; }
 
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
 
-	bool QueryCallback(int32 proxyId);
+	bool QueryCallback(int32 nodeId);
+
+	// Is the proxy in a tree or in the structure for moving proxies?
+	bool IsTreeProxy(int32 proxyId) const;
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	// Count a static proxy that was created, destroyed, or moved in the static tree.
+	void StaticTreeChanged();
+
+	// Rebuild the static tree if it changed a lot and lost quality, and rebuild its copy
+	// if the static proxies changed.
+	void UpdateStaticTree();
+
+	// Build the enabled copy of the static tree.
+	void BuildStaticCopy();
 
-	b2DynamicTree m_tree;
+	// The copies are out of date while the static tree has changes they do not have. The
+	// compact copy wins if both are enabled.
+	bool UseCompactTree() const { return m_useCompactTree && m_staticCopyDirty == false; }
+	bool UseWideTree() const { return m_useWideTree && m_useCompactTree == false && m_staticCopyDirty == false; }
+
+	// Query one tree, using a copy for the static tree and the selected structure
+	// for the moving proxies.
+	template <typename T>
+	void QueryTree(T* callback, int32 treeType, const b2AABB& aabb) const;
+
+	template <typename T>
+	void RayCastTree(T* callback, int32 treeType, const b2RayCastInput& input) const;
+
+	// Fill the pair buffer using the task scheduler.
+	void FindPairs(b2TaskScheduler* scheduler);
+
+	b2DynamicTree m_trees[e_treeCount];
+
+	// The moving proxies are in one of these unless the type is b2_treeBroadPhase.
+	b2BroadPhaseType m_type;
+	b2SpatialHash m_grid;
+	b2SweepAndPrune m_sweep;
+
+	// Static proxies are inserted and removed in place. The copy of the static tree is
+	// rebuilt before the next pair update, and the tree itself only when it has lost
+	// quality, see UpdateStaticTree.
+	bool m_staticCopyDirty;
+	int32 m_staticProxyCount;
+	int32 m_staticChangeCount;
+	float m_staticBaseQuality;
+
+	b2WideTree m_wideTree;
+	bool m_useWideTree;
+
+	b2CompactTree m_compactTree;
+	bool m_useCompactTree;
 
 	int32 m_proxyCount;
 
@@ -129,24 +380,94 @@ private:
 	int32 m_pairCapacity;
 	int32 m_pairCount;
 
+	int32 m_pairQueryCount;
+	int32 m_foundPairCount;
+
+	bool m_adaptiveMargins;
+
 	int32 m_queryProxyId;
+	int32 m_queryTree;
+
+	b2TreeRebuildTask* m_rebuildTask;
+	b2TaskScheduler* m_rebuildScheduler;
+	void* m_rebuildHandle;
+	bool m_rebuilding;
+	float m_rebuildThreshold;
+
+	// The quality of the tree after the last rebuild and the move count when the
+	// quality was last checked.
+	float m_baseQuality;
+	int32 m_checkedMoveCount;
+
+	b2BroadPhaseWorker* m_workers;
+	int32 m_workerCount;
 };
 
+inline b2BroadPhaseType b2BroadPhase::GetType() const
+{
+	return m_type;
+}
+
+inline bool b2BroadPhase::IsTreeProxy(int32 proxyId) const
+{
+	return GetTreeType(proxyId) == e_staticTree || m_type == b2_treeBroadPhase;
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	int32 nodeId = GetNodeId(proxyId);
+	if (IsTreeProxy(proxyId))
+	{
+		return m_trees[GetTreeType(proxyId)].GetUserData(nodeId);
+	}
+
+	return m_type == b2_gridBroadPhase ? m_grid.GetUserData(nodeId) : m_sweep.GetUserData(nodeId);
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	int32 nodeId = GetNodeId(proxyId);
+	if (IsTreeProxy(proxyId))
+	{
+		return m_trees[GetTreeType(proxyId)].GetFatAABB(nodeId);
+	}
+
+	return m_type == b2_gridBroadPhase ? m_grid.GetFatAABB(nodeId) : m_sweep.GetFatAABB(nodeId);
+}
+
+inline bool b2BroadPhase::WasMoved(int32 proxyId) const
+{
+	int32 nodeId = GetNodeId(proxyId);
+	if (IsTreeProxy(proxyId))
+	{
+		return m_trees[GetTreeType(proxyId)].WasMoved(nodeId);
+	}
+
+	return m_type == b2_gridBroadPhase ? m_grid.WasMoved(nodeId) : m_sweep.WasMoved(nodeId);
+}
+
+inline void b2BroadPhase::ClearMoved(int32 proxyId)
+{
+	int32 nodeId = GetNodeId(proxyId);
+	if (IsTreeProxy(proxyId))
+	{
+		m_trees[GetTreeType(proxyId)].ClearMoved(nodeId);
+	}
+	else if (m_type == b2_gridBroadPhase)
+	{
+		m_grid.ClearMoved(nodeId);
+	}
+	else
+	{
+		m_sweep.ClearMoved(nodeId);
+	}
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -154,50 +475,108 @@ inline int32 b2BroadPhase::GetProxyCount() const
 	return m_proxyCount;
 }
 
+inline int32 b2BroadPhase::GetProxyMoveCount() const
+{
+	return m_trees[e_staticTree].GetMoveCount() + m_trees[e_dynamicTree].GetMoveCount() +
+		m_grid.GetMoveCount() + m_sweep.GetMoveCount();
+}
+
+inline int32 b2BroadPhase::GetPairQueryCount() const
+{
+	return m_pairQueryCount;
+}
+
+inline int32 b2BroadPhase::GetFoundPairCount() const
+{
+	return m_foundPairCount;
+}
+
+inline void b2BroadPhase::SetAdaptiveMargins(bool flag)
+{
+	m_adaptiveMargins = flag;
+}
+
+inline bool b2BroadPhase::GetAdaptiveMargins() const
+{
+	return m_adaptiveMargins;
+}
+
+inline void b2BroadPhase::SetRefitMode(bool flag)
+{
+	m_trees[e_dynamicTree].SetRefitMode(flag);
+}
+
+inline bool b2BroadPhase::IsStaticProxy(int32 proxyId) const
+{
+	return GetTreeType(proxyId) == e_staticTree;
+}
+
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
-	return m_tree.GetHeight();
+	return b2Max(m_trees[e_staticTree].GetHeight(), m_trees[e_dynamicTree].GetHeight());
 }
 
 inline int32 b2BroadPhase::GetTreeBalance() const
 {
-	return m_tree.GetMaxBalance();
+	return b2Max(m_trees[e_staticTree].GetMaxBalance(), m_trees[e_dynamicTree].GetMaxBalance());
 }
 
 inline float b2BroadPhase::GetTreeQuality() const
 {
-	return m_tree.GetAreaRatio();
+	return b2Max(m_trees[e_staticTree].GetAreaRatio(), m_trees[e_dynamicTree].GetAreaRatio());
 }
 
 template <typename T>
-void b2BroadPhase::UpdatePairs(T* callback)
+void b2BroadPhase::UpdatePairs(T* callback, b2TaskScheduler* scheduler)
 {
-	// Reset pair buffer
-	m_pairCount = 0;
+	UpdateStaticTree();
+	m_trees[e_dynamicTree].Refit();
 
-	// Perform tree queries for all moving proxies.
-	for (int32 i = 0; i < m_moveCount; ++i)
+	if (scheduler != nullptr)
 	{
-		m_queryProxyId = m_moveBuffer[i];
-		if (m_queryProxyId == e_nullProxy)
+		FindPairs(scheduler);
+	}
+	else
+	{
+		// Reset pair buffer
+		m_pairCount = 0;
+
+		// Perform tree queries for all moving proxies.
+		for (int32 i = 0; i < m_moveCount; ++i)
 		{
-			continue;
+			m_queryProxyId = m_moveBuffer[i];
+			if (m_queryProxyId == e_nullProxy)
+			{
+				continue;
+			}
+
+			++m_pairQueryCount;
+
+			// We have to query the tree with the fat AABB so that
+			// we don't fail to create a pair that may touch later.
+			const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
+
+			// Query tree, create pairs and add them pair buffer. Static proxies
+			// do not pair with each other.
+			m_queryTree = e_dynamicTree;
+			QueryTree(this, e_dynamicTree, fatAABB);
+
+			if (GetTreeType(m_queryProxyId) == e_dynamicTree)
+			{
+				m_queryTree = e_staticTree;
+				QueryTree(this, e_staticTree, fatAABB);
+			}
 		}
-
-		// We have to query the tree with the fat AABB so that
-		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
-
-		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
 	}
 
+	m_foundPairCount += m_pairCount;
+
 	// Send pairs to caller
 	for (int32 i = 0; i < m_pairCount; ++i)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 	}
@@ -211,7 +590,7 @@ void b2BroadPhase::UpdatePairs(T* callback)
 			continue;
 		}
 
-		m_tree.ClearMoved(proxyId);
+		ClearMoved(proxyId);
 	}
 
 	// Reset move buffer
@@ -221,18 +600,162 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	QueryWrapper<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.proceed = true;
+
+	for (int32 treeType = e_treeCount - 1; treeType >= 0 && wrapper.proceed; --treeType)
+	{
+		wrapper.treeType = treeType;
+		QueryTree(&wrapper, treeType, aabb);
+	}
+}
+
+template <typename T>
+inline void b2BroadPhase::QueryTree(T* callback, int32 treeType, const b2AABB& aabb) const
+{
+	if (treeType == e_staticTree && UseCompactTree())
+	{
+		m_compactTree.Query(callback, aabb);
+	}
+	else if (treeType == e_staticTree && UseWideTree())
+	{
+		m_wideTree.Query(callback, aabb);
+	}
+	else if (treeType == e_staticTree || m_type == b2_treeBroadPhase)
+	{
+		m_trees[treeType].Query(callback, aabb);
+	}
+	else if (m_type == b2_gridBroadPhase)
+	{
+		m_grid.Query(callback, aabb);
+	}
+	else
+	{
+		m_sweep.Query(callback, aabb);
+	}
+}
+
+template <typename T>
+inline void b2BroadPhase::RayCastTree(T* callback, int32 treeType, const b2RayCastInput& input) const
+{
+	if (treeType == e_staticTree && UseCompactTree())
+	{
+		m_compactTree.RayCast(callback, input);
+	}
+	else if (treeType == e_staticTree && UseWideTree())
+	{
+		m_wideTree.RayCast(callback, input);
+	}
+	else if (treeType == e_staticTree || m_type == b2_treeBroadPhase)
+	{
+		m_trees[treeType].RayCast(callback, input);
+	}
+	else if (m_type == b2_gridBroadPhase)
+	{
+		m_grid.RayCast(callback, input);
+	}
+	else
+	{
+		m_sweep.RayCast(callback, input);
+	}
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	RayCastWrapper<T> wrapper;
+	wrapper.callback = callback;
+	wrapper.maxFraction = input.maxFraction;
+	wrapper.terminated = false;
+
+	// The second tree only looks as far as the closest hit the client kept.
+	b2RayCastInput treeInput = input;
+	for (int32 treeType = e_treeCount - 1; treeType >= 0 && wrapper.terminated == false; --treeType)
+	{
+		treeInput.maxFraction = wrapper.maxFraction;
+		wrapper.treeType = treeType;
+		RayCastTree(&wrapper, treeType, treeInput);
+	}
+}
+
+template <typename T>
+inline void b2BroadPhase::RayCastPacket(T* callback, b2RayCastInput* inputs, int32 count) const
+{
+	RayCastPacketWrapper<T> wrapper;
+	wrapper.callback = callback;
+
+	// The inputs carry each ray's clipped fraction into the second tree.
+	for (int32 treeType = e_treeCount - 1; treeType >= 0; --treeType)
+	{
+		wrapper.treeType = treeType;
+		if (treeType == e_staticTree && UseWideTree())
+		{
+			m_wideTree.RayCastPacket(&wrapper, inputs, count);
+		}
+		else if ((treeType == e_staticTree && UseCompactTree() == false) || (treeType == e_dynamicTree && m_type == b2_treeBroadPhase))
+		{
+			m_trees[treeType].RayCastPacket(&wrapper, inputs, count);
+		}
+		else
+		{
+			// The compact copy, the grid, and sort and sweep cast the rays one at a time.
+			RayCastRayWrapper<RayCastPacketWrapper<T> > rayWrapper;
+			rayWrapper.callback = &wrapper;
+			for (int32 i = 0; i < count; ++i)
+			{
+				if (inputs[i].maxFraction > 0.0f)
+				{
+					b2RayCastInput input = inputs[i];
+					rayWrapper.rayIndex = i;
+					rayWrapper.maxFraction = &inputs[i].maxFraction;
+					RayCastTree(&rayWrapper, treeType, input);
+				}
+			}
+		}
+	}
+}
+
+inline void b2BroadPhase::SetWideTree(bool flag)
+{
+	m_useWideTree = flag;
+
+	// Build the wide copy before it is used.
+	m_staticCopyDirty = m_staticCopyDirty || flag;
+}
+
+inline bool b2BroadPhase::GetWideTree() const
+{
+	return m_useWideTree;
+}
+
+inline void b2BroadPhase::SetCompactTree(bool flag)
+{
+	m_useCompactTree = flag;
+
+	// Build the copy that is used now.
+	m_staticCopyDirty = true;
+}
+
+inline bool b2BroadPhase::GetCompactTree() const
+{
+	return m_useCompactTree;
+}
+
+inline void b2BroadPhase::SetRebuildThreshold(float threshold)
+{
+	m_rebuildThreshold = threshold;
 }
 
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
-	m_tree.ShiftOrigin(newOrigin);
+	m_trees[e_staticTree].ShiftOrigin(newOrigin);
+	m_trees[e_dynamicTree].ShiftOrigin(newOrigin);
+	m_grid.ShiftOrigin(newOrigin);
+	m_sweep.ShiftOrigin(newOrigin);
+
+	// The copy is built again.
+	m_staticCopyDirty = true;
 }
 
 #endif
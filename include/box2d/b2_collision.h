@@ -33,6 +33,7 @@
 /// queries, and TOI queries.
 
 class b2Shape;
+class b2CapsuleShape;
 class b2CircleShape;
 class b2EdgeShape;
 class b2PolygonShape;
@@ -246,6 +247,26 @@ B2_API void b2CollideEdgeAndPolygon(b2Manifold* manifold,
 							   const b2EdgeShape* edgeA, const b2Transform& xfA,
 							   const b2PolygonShape* circleB, const b2Transform& xfB);
 
+/// Compute the collision manifold between a capsule and a circle.
+B2_API void b2CollideCapsuleAndCircle(b2Manifold* manifold,
+							   const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+							   const b2CircleShape* circleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between two capsules.
+B2_API void b2CollideCapsules(b2Manifold* manifold,
+					   const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+					   const b2CapsuleShape* capsuleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between a polygon and a capsule.
+B2_API void b2CollidePolygonAndCapsule(b2Manifold* manifold,
+							   const b2PolygonShape* polygonA, const b2Transform& xfA,
+							   const b2CapsuleShape* capsuleB, const b2Transform& xfB);
+
+/// Compute the collision manifold between an edge and a capsule.
+B2_API void b2CollideEdgeAndCapsule(b2Manifold* manifold,
+							   const b2EdgeShape* edgeA, const b2Transform& xfA,
+							   const b2CapsuleShape* capsuleB, const b2Transform& xfB);
+
 /// Clipping for contact manifolds.
 B2_API int32 b2ClipSegmentToLine(b2ClipVertex vOut[2], const b2ClipVertex vIn[2],
 							const b2Vec2& normal, float offset, int32 vertexIndexA);
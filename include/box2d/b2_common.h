@@ -28,6 +28,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <float.h>
+#include <atomic>
 
 #if !defined(NDEBUG)
 	#define b2DEBUG
@@ -60,6 +61,36 @@
 /// This is a dimensionless multiplier.
 #define b2_aabbMultiplier		4.0f
 
+/// With adaptive margins the fat AABB extension of a proxy is this minimum plus a
+/// multiple of its largest recent displacement, up to the maximum.
+/// See b2World::SetAdaptiveMargins. These are in meters.
+#define b2_aabbMinExtension		(0.02f * b2_lengthUnitsPerMeter)
+#define b2_aabbMaxExtension		(0.5f * b2_lengthUnitsPerMeter)
+
+/// The adaptive margin multiplier of the largest recent displacement.
+/// This is a dimensionless multiplier.
+#define b2_aabbMotionMultiplier	2.0f
+
+/// The largest recent displacement decays by this factor every step.
+/// This is a dimensionless multiplier.
+#define b2_aabbMotionDecay		0.9f
+
+/// The broad-phase rebuilds the tree of moving proxies when its area ratio grows past
+/// this multiple of the area ratio right after the last rebuild. See b2DynamicTree::GetAreaRatio.
+/// This is a dimensionless multiplier.
+#define b2_treeRebuildRatio		1.2f
+
+/// A proxy of a b2SpatialHash that covers more cells than this is kept in a list
+/// that every query checks instead.
+#define b2_maxHashProxyCells	16
+
+/// The default cell size of a b2SpatialHash. This is in meters.
+#define b2_hashCellSize			(1.0f * b2_lengthUnitsPerMeter)
+
+/// The maximum number of rays traced together through the broad-phase trees. See
+/// b2World::RayCastBatch.
+#define b2_maxRayPacket			8
+
 /// A small length used as a collision and constraint tolerance. Usually it is
 /// chosen to be numerically significant, but visually insignificant. In meters.
 #define b2_linearSlop			(0.005f * b2_lengthUnitsPerMeter)
@@ -76,6 +107,14 @@
 /// Maximum number of sub-steps per contact in continuous physics simulation.
 #define b2_maxSubSteps			8
 
+/// A contact keeps its manifold while the bodies have moved less than this relative to
+/// each other since it was computed. See b2World::SetManifoldReuse. In meters.
+#define b2_manifoldReuseLinearSlop		(0.25f * b2_linearSlop)
+
+/// A contact keeps its manifold while the bodies have rotated less than this relative to
+/// each other since it was computed. In radians.
+#define b2_manifoldReuseAngularSlop		(0.01f * b2_angularSlop)
+
 
 // Dynamics
 
@@ -106,6 +145,18 @@
 #define b2_baumgarte				0.2f
 #define b2_toiBaumgarte				0.75f
 
+/// The stiffness of the soft contact constraints used by the soft step solver, in Hertz.
+/// This is capped at a quarter of the sub-step rate.
+#define b2_contactHertz				30.0f
+
+/// The damping ratio of the soft contact constraints. Contacts are over-damped so that
+/// resolving overlap does not make bodies bounce.
+#define b2_contactDampingRatio		10.0f
+
+/// The maximum speed used by the soft step solver to push overlapping shapes apart. Meters
+/// per second.
+#define b2_contactPushVelocity		(3.0f * b2_lengthUnitsPerMeter)
+
 
 // Sleep
 
@@ -118,6 +169,39 @@
 /// A body cannot sleep if its angular velocity is above this tolerance.
 #define b2_angularSleepTolerance	(2.0f / 180.0f * b2_pi)
 
+
+// Threading
+
+/// The minimum number of bodies or contacts handled by one range of a parallel task.
+/// Smaller ranges cost more to schedule than they save.
+#define b2_minTaskRange				64
+
+/// The number of graph colors used to solve a large island in parallel. Constraints that
+/// do not fit in a color are solved serially. This must be at most 32.
+#define b2_graphColorCount			12
+
+/// Islands with fewer contacts and joints are not split into graph colors.
+#define b2_minColoredConstraints	256
+
+/// Raise an atomic statistic to value if value is larger.
+template <typename T>
+inline void b2AtomicMax(std::atomic<T>& a, T value)
+{
+	T current = a.load(std::memory_order_relaxed);
+	while (value > current && a.compare_exchange_weak(current, value, std::memory_order_relaxed) == false)
+	{
+	}
+}
+
+/// Add to an atomic float statistic. std::atomic<float> has no fetch_add before C++20.
+inline void b2AtomicAdd(std::atomic<float>& a, float value)
+{
+	float current = a.load(std::memory_order_relaxed);
+	while (a.compare_exchange_weak(current, current + value, std::memory_order_relaxed) == false)
+	{
+	}
+}
+
 /// Dump to a file. Only one dump file allowed at a time.
 void b2OpenDump(const char* fileName);
 void b2Dump(const char* string, ...);
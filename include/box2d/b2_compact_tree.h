@@ -0,0 +1,138 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_COMPACT_TREE_H
+#define B2_COMPACT_TREE_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+
+class b2DynamicTree;
+
+/// A node of a b2CompactTree. It has the layout of a b2WideNode, but the bounds of the
+/// children are quantized to 16 bits within the bounds of the node. Lower bounds are
+/// stored as steps up from the node's lower bound and upper bounds as steps down from its
+/// upper bound, rounded outward, so a decoded child always contains the original child.
+/// This is 52 bytes against the 84 of a b2WideNode.
+struct B2_API b2CompactNode
+{
+	uint16 lowerX[4];
+	uint16 lowerY[4];
+	uint16 upperX[4];
+	uint16 upperY[4];
+
+	// A compact node index or a proxy id of the source tree, see leafMask.
+	int32 children[4];
+
+	// Bit i is set if child i is a proxy.
+	uint16 leafMask;
+
+	// The number of children, from two to four. A leaf root has one.
+	uint16 childCount;
+};
+
+/// A read only copy of a b2DynamicTree with four children per node and quantized bounds.
+/// It is built like a b2WideTree and takes about 60 percent of its memory. User data and
+/// the exact fat AABBs stay in the source tree, which is only read for proxies that pass
+/// the quantized test. Queries and ray casts report the proxy ids of the source tree.
+/// The copy must be built again after the source tree changes and the source tree must
+/// outlive it.
+class B2_API b2CompactTree
+{
+public:
+
+	b2CompactTree();
+	~b2CompactTree();
+
+	/// Build from a dynamic tree. This is O(n).
+	void Build(const b2DynamicTree* tree);
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	/// @see b2DynamicTree::Query
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies in the tree.
+	/// @see b2DynamicTree::RayCast
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Get the number of compact nodes.
+	int32 GetNodeCount() const;
+
+	/// Get the number of bytes used by the nodes.
+	int32 GetByteCount() const;
+
+private:
+
+	typedef bool QueryFcn(void* context, int32 proxyId);
+	typedef float RayCastFcn(void* context, const b2RayCastInput& input, int32 proxyId);
+
+	template <typename T>
+	static bool QueryThunk(void* context, int32 proxyId)
+	{
+		return ((T*)context)->QueryCallback(proxyId);
+	}
+
+	template <typename T>
+	static float RayCastThunk(void* context, const b2RayCastInput& input, int32 proxyId)
+	{
+		return ((T*)context)->RayCastCallback(input, proxyId);
+	}
+
+	void Query(QueryFcn* fcn, void* context, const b2AABB& aabb) const;
+	void RayCast(RayCastFcn* fcn, void* context, const b2RayCastInput& input) const;
+
+	const b2DynamicTree* m_tree;
+
+	// The bounds of the root node. Node 0 is the root.
+	b2AABB m_rootAABB;
+
+	b2CompactNode* m_nodes;
+	int32 m_nodeCount;
+	int32 m_nodeCapacity;
+};
+
+template <typename T>
+inline void b2CompactTree::Query(T* callback, const b2AABB& aabb) const
+{
+	Query(QueryThunk<T>, callback, aabb);
+}
+
+template <typename T>
+inline void b2CompactTree::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	RayCast(RayCastThunk<T>, callback, input);
+}
+
+inline int32 b2CompactTree::GetNodeCount() const
+{
+	return m_nodeCount;
+}
+
+inline int32 b2CompactTree::GetByteCount() const
+{
+	return m_nodeCount * int32(sizeof(b2CompactNode));
+}
+
+#endif
@@ -25,6 +25,7 @@
 
 #include "b2_api.h"
 #include "b2_collision.h"
+#include "b2_contact_manager.h"
 #include "b2_fixture.h"
 #include "b2_math.h"
 #include "b2_shape.h"
@@ -108,7 +109,8 @@ public:
 	/// Has this contact been disabled?
 	bool IsEnabled() const;
 
-	/// Get the next contact in the world's contact list.
+	/// Get the next contact in the world's contact list. The list must not be modified
+	/// while it is being iterated.
 	b2Contact* GetNext();
 	const b2Contact* GetNext() const;
 
@@ -191,7 +193,10 @@ protected:
 		e_bulletHitFlag		= 0x0010,
 
 		// This contact has a valid TOI in m_toi
-		e_toiFlag			= 0x0020
+		e_toiFlag			= 0x0020,
+
+		// m_relativeXf holds the relative transform m_manifold was computed at
+		e_reusableFlag		= 0x0040
 	};
 
 	/// Flag this contact for filtering. Filtering will occur the next time step.
@@ -210,14 +215,28 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	// Update in two parts. Computing the manifold does not modify the contact, so
+	// contacts can be computed in parallel. Returns true if the shapes are touching.
+	bool ComputeManifold(b2Manifold* manifold);
+	void FinishUpdate(const b2Manifold& manifold, bool touching, b2ContactListener* listener);
+
+	// Returns true if the bodies moved so little relative to each other since the manifold
+	// was computed that it still holds. The manifold is in body coordinates, so the solver
+	// re-projects it with the current transforms.
+	bool CanReuseManifold() const;
+
+	// Update without computing the manifold. The contact is still re-enabled and PreSolve
+	// is still called.
+	void ReuseManifold(b2ContactListener* listener);
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
 	uint32 m_flags;
 
-	// World pool and list pointers.
-	b2Contact* m_prev;
-	b2Contact* m_next;
+	// The contact manager that owns this contact and the index in its contact array.
+	b2ContactManager* m_manager;
+	int32 m_managerIndex;
 
 	// Nodes for connecting bodies.
 	b2ContactEdge m_nodeA;
@@ -231,6 +250,9 @@ protected:
 
 	b2Manifold m_manifold;
 
+	// The transform of body B in the frame of body A when the manifold was computed.
+	b2Transform m_relativeXf;
+
 	int32 m_toiCount;
 	float m_toi;
 
@@ -283,14 +305,15 @@ inline bool b2Contact::IsTouching() const
 	return (m_flags & e_touchingFlag) == e_touchingFlag;
 }
 
+// The world's contact list runs from the end of the contact array to the start.
 inline b2Contact* b2Contact::GetNext()
 {
-	return m_next;
+	return m_managerIndex > 0 ? m_manager->m_contacts[m_managerIndex - 1] : nullptr;
 }
 
 inline const b2Contact* b2Contact::GetNext() const
 {
-	return m_next;
+	return m_managerIndex > 0 ? m_manager->m_contacts[m_managerIndex - 1] : nullptr;
 }
 
 inline b2Fixture* b2Contact::GetFixtureA()
@@ -28,14 +28,19 @@
 
 class b2Contact;
 class b2ContactFilter;
+class b2Fixture;
 class b2ContactListener;
 class b2BlockAllocator;
+class b2TaskScheduler;
+struct b2ContactUpdate;
+struct b2Manifold;
 
 // Delegate of b2World.
 class B2_API b2ContactManager
 {
 public:
 	b2ContactManager();
+	~b2ContactManager();
 
 	// Broad-phase callback.
 	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
@@ -46,12 +51,56 @@ public:
 
 	void Collide();
 
+	// Filter and update a contact, or destroy it if the proxies stopped overlapping.
+	// The manifold is computed here if it is null.
+	void UpdateContact(b2Contact* c, const b2Manifold* manifold, bool touching);
+
+	// Range task function for Collide.
+	void ComputeManifolds(int32 begin, int32 end);
+
+	// Get the contact at the end of the array, or null if there are no contacts.
+	b2Contact* GetLastContact() const;
+
+	// Find the contact between two fixture children in either order, or null.
+	b2Contact* FindContact(const b2Fixture* fixtureA, int32 indexA, const b2Fixture* fixtureB, int32 indexB) const;
+
+	// Manage the contact table.
+	int32 GetTableSlot(const b2Fixture* fixtureA, int32 indexA, const b2Fixture* fixtureB, int32 indexB) const;
+	void InsertIntoTable(b2Contact* c);
+	void RemoveFromTable(b2Contact* c);
+
 	b2BroadPhase m_broadPhase;
-	b2Contact* m_contactList;
+
+	// The contacts are stored densely and indexed by b2Contact::m_managerIndex. Destroying
+	// a contact moves the last contact into its slot.
+	b2Contact** m_contacts;
 	int32 m_contactCount;
+	int32 m_contactCapacity;
+
+	// The contacts hashed by their fixture children with linear probing, so AddPair finds
+	// an existing contact in constant time no matter how many contacts a body has. The
+	// capacity is a power of two and at least twice the contact count.
+	b2Contact** m_contactTable;
+	int32 m_contactTableCapacity;
+
+	// Skip the manifold of contacts whose bodies barely moved relative to each other.
+	// See b2Contact::CanReuseManifold.
+	bool m_reuseManifolds;
+	int32 m_reusedManifoldCount;
+
+	// The parallel path of Collide computes the manifolds into this first.
+	b2ContactUpdate* m_updates;
+	int32 m_updateCapacity;
+
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+	b2TaskScheduler* m_taskScheduler;
 };
 
+inline b2Contact* b2ContactManager::GetLastContact() const
+{
+	return m_contactCount > 0 ? m_contacts[m_contactCount - 1] : nullptr;
+}
+
 #endif
@@ -26,6 +26,8 @@
 #include "b2_api.h"
 #include "b2_math.h"
 
+#include <atomic>
+
 class b2Shape;
 
 /// A distance proxy is used by the GJK algorithm.
@@ -98,6 +100,10 @@ B2_API void b2Distance(b2DistanceOutput* output,
 				b2SimplexCache* cache,
 				const b2DistanceInput* input);
 
+/// GJK statistics for profiling, updated by every call to b2Distance. These are atomic
+/// because queries may run on several threads at once.
+extern B2_API std::atomic<int32> b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
+
 /// Input parameters for b2ShapeCast
 struct B2_API b2ShapeCastInput
 {
@@ -29,6 +29,114 @@
 
 #define b2_nullNode (-1)
 
+/// Enlarge the fat AABB of a moving proxy so it contains the AABB and its predicted
+/// movement. The fat AABB is kept if it still contains the AABB and has not grown too
+/// large, which is what lets a proxy move a little without any update.
+/// @param margin the extension on each side, b2_aabbExtension unless margins are adaptive.
+/// @return true if the fat AABB changed.
+inline bool b2UpdateFatAABB(b2AABB* fatAABB, const b2AABB& aabb, const b2Vec2& displacement, const b2Vec2& margin = b2Vec2(b2_aabbExtension, b2_aabbExtension))
+{
+	// Extend AABB
+	b2AABB newAABB;
+	b2Vec2 r = margin;
+	newAABB.lowerBound = aabb.lowerBound - r;
+	newAABB.upperBound = aabb.upperBound + r;
+
+	// Predict AABB movement
+	b2Vec2 d = b2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		newAABB.lowerBound.x += d.x;
+	}
+	else
+	{
+		newAABB.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		newAABB.lowerBound.y += d.y;
+	}
+	else
+	{
+		newAABB.upperBound.y += d.y;
+	}
+
+	if (fatAABB->Contains(aabb))
+	{
+		// The fat AABB still contains the object, but it might be too large.
+		// Perhaps the object was moving fast but has since gone to sleep.
+		// The huge AABB is larger than the new fat AABB.
+		b2AABB hugeAABB;
+		hugeAABB.lowerBound = newAABB.lowerBound - 4.0f * r;
+		hugeAABB.upperBound = newAABB.upperBound + 4.0f * r;
+
+		if (hugeAABB.Contains(*fatAABB))
+		{
+			// The fat AABB contains the object AABB and is not too large.
+			return false;
+		}
+
+		// Otherwise the fat AABB is huge and needs to be shrunk
+	}
+
+	*fatAABB = newAABB;
+	return true;
+}
+
+/// A node waiting to be visited by a packet ray cast and the rays that reach it.
+struct B2_API b2RayPacketItem
+{
+	int32 nodeId;
+	int32 rayMask;
+};
+
+/// The segment of a ray of a packet ray cast. This is an internal structure.
+struct B2_API b2RayPacketSegment
+{
+	/// Set up the segment of a ray input.
+	void Set(const b2RayCastInput& input)
+	{
+		p1 = input.p1;
+		d = input.p2 - input.p1;
+		b2Vec2 r = d;
+		r.Normalize();
+
+		// v is perpendicular to the segment.
+		v = b2Cross(1.0f, r);
+		absV = b2Abs(v);
+		Clip(input.maxFraction);
+	}
+
+	/// Update the bounding box for a new max fraction.
+	void Clip(float maxFraction)
+	{
+		b2Vec2 t = p1 + maxFraction * d;
+		aabb.lowerBound = b2Min(p1, t);
+		aabb.upperBound = b2Max(p1, t);
+	}
+
+	/// Test an AABB against the segment. See b2DynamicTree::RayCast.
+	bool Test(const b2AABB& box) const
+	{
+		if (b2TestOverlap(box, aabb) == false)
+		{
+			return false;
+		}
+
+		b2Vec2 c = box.GetCenter();
+		b2Vec2 h = box.GetExtents();
+		return b2Abs(b2Dot(v, p1 - c)) <= b2Dot(absV, h);
+	}
+
+	b2Vec2 p1;
+	b2Vec2 d;
+	b2Vec2 v;
+	b2Vec2 absV;
+	b2AABB aabb;
+};
+
 /// A node in the dynamic tree. The client does not interact with this directly.
 struct B2_API b2TreeNode
 {
@@ -55,6 +163,53 @@ struct B2_API b2TreeNode
 	int32 height;
 
 	bool moved;
+
+	// The AABB was grown in place by a refit move and needs to be refit.
+	bool enlarged;
+};
+
+class b2DynamicTree;
+
+/// Rebuilds a b2DynamicTree top-down from a snapshot of its leaves. Build only reads the
+/// snapshot, so it can run on another thread while the tree keeps changing. Apply then
+/// gives the tree the new structure. Leaves destroyed since the snapshot are skipped and
+/// leaves created since then are inserted one at a time.
+class B2_API b2TreeRebuild
+{
+public:
+	b2TreeRebuild();
+	~b2TreeRebuild();
+
+	/// Copy the leaves of a tree. Call this on the thread that owns the tree.
+	void Snapshot(const b2DynamicTree* tree);
+
+	/// Build the new structure using a binned surface area heuristic. This is O(n log n)
+	/// and does not touch the tree.
+	void Build();
+
+	/// Give the tree the new structure. Call this on the thread that owns the tree.
+	void Apply(b2DynamicTree* tree);
+
+private:
+
+	// An internal node of the new structure. A negative child is the leaf at -child - 1
+	// in the snapshot, otherwise it is another internal node.
+	struct Node
+	{
+		int32 child1;
+		int32 child2;
+	};
+
+	int32* m_leaves;
+	b2AABB* m_aabbs;
+	b2Vec2* m_centers;
+	int32 m_leafCount;
+	int32 m_leafCapacity;
+
+	// Parents come before their children.
+	Node* m_nodes;
+	int32* m_subtrees;
+	int32 m_nodeCount;
 };
 
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
@@ -77,14 +232,33 @@ public:
 	/// Create a proxy. Provide a tight fitting AABB and a userData pointer.
 	int32 CreateProxy(const b2AABB& aabb, void* userData);
 
+	/// Create many proxies at once. The tree is rebuilt top-down from all of its proxies,
+	/// which is faster than creating the proxies one at a time and gives a better tree.
+	/// @param count the number of proxies
+	/// @param aabbs tight fitting AABBs of the proxies
+	/// @param userData user data of the proxies
+	/// @param proxyIds receives the proxy ids
+	void CreateProxies(int32 count, const b2AABB* aabbs, void* const* userData, int32* proxyIds);
+
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int32 proxyId);
 
 	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
-	/// then the proxy is removed from the tree and re-inserted. Otherwise
-	/// the function returns immediately.
-	/// @return true if the proxy was re-inserted.
-	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement);
+	/// then the proxy is removed from the tree and re-inserted, or in refit mode its AABB
+	/// is updated in place. Otherwise the function returns immediately.
+	/// @return true if the proxy was re-inserted or refit.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement, const b2Vec2& margin = b2Vec2(b2_aabbExtension, b2_aabbExtension));
+
+	/// Enable/disable refit mode. In refit mode MoveProxy updates the AABB of a proxy in
+	/// place and grows its ancestors as needed instead of re-inserting it. Call Refit
+	/// once all proxies are moved to shrink the ancestors again. This is much cheaper
+	/// when many proxies move every step, but the tree gets worse over time.
+	void SetRefitMode(bool flag);
+	bool GetRefitMode() const;
+
+	/// Refit the nodes grown by MoveProxy in refit mode. A proxy that drifted far from
+	/// its sibling is re-inserted. This costs nothing if no proxy was refit.
+	void Refit();
 
 	/// Get proxy user data.
 	/// @return the proxy user data or 0 if the id is invalid.
@@ -111,6 +285,17 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
+	/// Ray-cast a packet of rays together. Each node is fetched once for all the rays
+	/// that reach it, which is faster than separate ray casts when the rays are close
+	/// together. The callback is called with the input and the index of the ray:
+	/// float RayCastCallback(const b2RayCastInput& input, int32 proxyId, int32 rayIndex).
+	/// The return value clips or terminates that ray as in RayCast.
+	/// @param inputs the rays. The max fraction of each ray is updated as it is clipped and
+	/// a terminated ray is clipped to zero. Rays with a zero max fraction are skipped.
+	/// @param count the number of rays, at most b2_maxRayPacket.
+	template <typename T>
+	void RayCastPacket(T* callback, b2RayCastInput* inputs, int32 count) const;
+
 	/// Validate this tree. For testing.
 	void Validate() const;
 
@@ -128,6 +313,14 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Rebuild the tree top-down using a binned surface area heuristic. This is O(n log n)
+	/// and gives a better tree than inserting the proxies one at a time.
+	void Rebuild();
+
+	/// Get the number of times MoveProxy found a proxy outside of its fat AABB. Sample this
+	/// every step to get the move rate.
+	int32 GetMoveCount() const;
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -135,6 +328,10 @@ public:
 
 private:
 
+	friend class b2TreeRebuild;
+	friend class b2WideTree;
+	friend class b2CompactTree;
+
 	int32 AllocateNode();
 	void FreeNode(int32 node);
 
@@ -158,6 +355,9 @@ private:
 	int32 m_freeList;
 
 	int32 m_insertionCount;
+	int32 m_moveCount;
+
+	bool m_refitMode;
 };
 
 inline void* b2DynamicTree::GetUserData(int32 proxyId) const
@@ -166,6 +366,21 @@ inline void* b2DynamicTree::GetUserData(int32 proxyId) const
 	return m_nodes[proxyId].userData;
 }
 
+inline void b2DynamicTree::SetRefitMode(bool flag)
+{
+	m_refitMode = flag;
+}
+
+inline bool b2DynamicTree::GetRefitMode() const
+{
+	return m_refitMode;
+}
+
+inline int32 b2DynamicTree::GetMoveCount() const
+{
+	return m_moveCount;
+}
+
 inline bool b2DynamicTree::WasMoved(int32 proxyId) const
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -305,4 +520,93 @@ inline void b2DynamicTree::RayCast(T* callback, const b2RayCastInput& input) con
 	}
 }
 
+template <typename T>
+void b2DynamicTree::RayCastPacket(T* callback, b2RayCastInput* inputs, int32 count) const
+{
+	b2Assert(0 < count && count <= b2_maxRayPacket);
+
+	b2RayPacketSegment segments[b2_maxRayPacket];
+	int32 rayMask = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		if (inputs[i].maxFraction > 0.0f)
+		{
+			b2Assert((inputs[i].p2 - inputs[i].p1).LengthSquared() > 0.0f);
+			segments[i].Set(inputs[i]);
+			rayMask |= 1 << i;
+		}
+	}
+
+	if (rayMask == 0 || m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	b2GrowableStack<b2RayPacketItem, 256> stack;
+	b2RayPacketItem root;
+	root.nodeId = m_root;
+	root.rayMask = rayMask;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2RayPacketItem item = stack.Pop();
+
+		const b2TreeNode* node = m_nodes + item.nodeId;
+
+		// Rays terminated since the node was pushed are dropped.
+		int32 hitMask = 0;
+		for (int32 i = 0; i < count; ++i)
+		{
+			if ((item.rayMask & rayMask & (1 << i)) && segments[i].Test(node->aabb))
+			{
+				hitMask |= 1 << i;
+			}
+		}
+
+		if (hitMask == 0)
+		{
+			continue;
+		}
+
+		if (node->IsLeaf() == false)
+		{
+			b2RayPacketItem child;
+			child.rayMask = hitMask;
+			child.nodeId = node->child1;
+			stack.Push(child);
+			child.nodeId = node->child2;
+			stack.Push(child);
+			continue;
+		}
+
+		for (int32 i = 0; i < count; ++i)
+		{
+			if ((hitMask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			float value = callback->RayCastCallback(inputs[i], item.nodeId, i);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated this ray.
+				inputs[i].maxFraction = 0.0f;
+				rayMask &= ~(1 << i);
+			}
+			else if (value > 0.0f)
+			{
+				inputs[i].maxFraction = value;
+				segments[i].Clip(value);
+			}
+		}
+
+		if (rayMask == 0)
+		{
+			return;
+		}
+	}
+}
+
 #endif
@@ -103,6 +103,12 @@ struct B2_API b2FixtureDef
 struct B2_API b2FixtureProxy
 {
 	b2AABB aabb;
+	b2Vec2 displacement;
+
+	// The largest recent displacement on each axis, which decays every step. Adaptive
+	// margins follow this.
+	b2Vec2 motion;
+
 	b2Fixture* fixture;
 	int32 childIndex;
 	int32 proxyId;
@@ -230,6 +236,11 @@ protected:
 
 	void Synchronize(b2BroadPhase* broadPhase, const b2Transform& xf1, const b2Transform& xf2);
 
+	// Synchronize in two parts. Sweeping the proxies does not touch the broad-phase,
+	// so fixtures on different bodies can be swept in parallel.
+	void SweepProxies(const b2Transform& xf1, const b2Transform& xf2);
+	void MoveProxies(b2BroadPhase* broadPhase);
+
 	float m_density;
 
 	b2Fixture* m_next;
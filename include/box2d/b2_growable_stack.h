@@ -80,6 +80,12 @@ public:
 		return m_count;
 	}
 
+	const T& Get(int32 index) const
+	{
+		b2Assert(0 <= index && index < m_count);
+		return m_stack[index];
+	}
+
 private:
 	T* m_stack;
 	T m_array[N];
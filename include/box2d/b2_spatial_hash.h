@@ -0,0 +1,435 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_SPATIAL_HASH_H
+#define B2_SPATIAL_HASH_H
+
+#include "b2_api.h"
+#include "b2_dynamic_tree.h"
+
+/// A proxy in a b2SpatialHash.
+struct B2_API b2HashProxy
+{
+	/// Enlarged AABB
+	b2AABB aabb;
+
+	void* userData;
+
+	/// The next free proxy.
+	int32 next;
+
+	/// Index in the list of proxies that cover too many cells, or b2_nullNode.
+	int32 oversizeIndex;
+
+	bool used;
+	bool moved;
+};
+
+/// The entry of a proxy in one grid cell.
+struct B2_API b2HashEntry
+{
+	int32 proxyId;
+	int32 x, y;
+
+	/// The next entry in the bucket, or the next free entry.
+	int32 next;
+};
+
+/// A uniform grid stored in a hash table of cells. Each proxy is entered in every cell
+/// its fat AABB touches. This suits many proxies of about the cell size: moving a proxy
+/// only touches its own cells and a query only visits the cells under the query box.
+/// Proxies that cover more than b2_maxHashProxyCells cells are kept in a list that
+/// every query checks.
+/// The interface follows b2DynamicTree, so b2BroadPhase can use either.
+class B2_API b2SpatialHash
+{
+public:
+	b2SpatialHash();
+	~b2SpatialHash();
+
+	/// Set the cell size. There must be no proxies.
+	void SetCellSize(float cellSize);
+
+	/// Create a proxy. The AABB is fattened as in b2DynamicTree::CreateProxy.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Move a proxy. If the proxy has moved outside of its fattened AABB, then the
+	/// proxy is removed from its cells and entered in the new ones.
+	/// @return true if the proxy was re-entered.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement, const b2Vec2& margin = b2Vec2(b2_aabbExtension, b2_aabbExtension));
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Get the number of times a proxy moved outside of its fat AABB.
+	int32 GetMoveCount() const;
+
+	/// Query an AABB for overlapping proxies. The callback class is called once for
+	/// each proxy that overlaps the supplied AABB.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies by walking the cells along the ray.
+	/// @see b2DynamicTree::RayCast
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Shift the world origin. Every proxy is entered in its cells again.
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+private:
+
+	int32 GetCellX(float x) const;
+	int32 GetCellY(float y) const;
+	int32 GetBucket(int32 x, int32 y) const;
+
+	// Does the AABB cover too many cells to be entered in them?
+	bool IsOversize(const b2AABB& aabb) const;
+
+	void InsertProxy(int32 proxyId);
+	void RemoveProxy(int32 proxyId);
+
+	int32 AllocateEntry();
+	void GrowBuckets();
+
+	b2HashProxy* m_proxies;
+	int32 m_proxyCount;
+	int32 m_proxyCapacity;
+	int32 m_freeProxy;
+
+	b2HashEntry* m_entries;
+	int32 m_entryCount;
+	int32 m_entryCapacity;
+	int32 m_freeEntry;
+
+	// The head entry of each bucket. The bucket count is a power of two.
+	int32* m_buckets;
+	int32 m_bucketCount;
+
+	int32* m_oversize;
+	int32 m_oversizeCount;
+	int32 m_oversizeCapacity;
+
+	float m_cellSize;
+	float m_invCellSize;
+
+	int32 m_moveCount;
+};
+
+inline void* b2SpatialHash::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline bool b2SpatialHash::WasMoved(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].moved;
+}
+
+inline void b2SpatialHash::ClearMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].moved = false;
+}
+
+inline const b2AABB& b2SpatialHash::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].aabb;
+}
+
+inline int32 b2SpatialHash::GetMoveCount() const
+{
+	return m_moveCount;
+}
+
+inline int32 b2SpatialHash::GetCellX(float x) const
+{
+	// Clamp so far away proxies do not overflow the cell coordinates.
+	return int32(floorf(b2Clamp(x * m_invCellSize, -1.0e9f, 1.0e9f)));
+}
+
+inline int32 b2SpatialHash::GetCellY(float y) const
+{
+	return int32(floorf(b2Clamp(y * m_invCellSize, -1.0e9f, 1.0e9f)));
+}
+
+inline int32 b2SpatialHash::GetBucket(int32 x, int32 y) const
+{
+	uint32 hash = (uint32(x) * 73856093u) ^ (uint32(y) * 19349663u);
+	return int32(hash & uint32(m_bucketCount - 1));
+}
+
+template <typename T>
+inline void b2SpatialHash::Query(T* callback, const b2AABB& aabb) const
+{
+	for (int32 i = 0; i < m_oversizeCount; ++i)
+	{
+		int32 proxyId = m_oversize[i];
+		if (b2TestOverlap(m_proxies[proxyId].aabb, aabb))
+		{
+			bool proceed = callback->QueryCallback(proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+
+	int32 x0 = GetCellX(aabb.lowerBound.x);
+	int32 y0 = GetCellY(aabb.lowerBound.y);
+	int32 x1 = GetCellX(aabb.upperBound.x);
+	int32 y1 = GetCellY(aabb.upperBound.y);
+
+	// A query over more cells than there are entries is cheaper as a scan of the proxies.
+	if (float(x1 - x0 + 1) * float(y1 - y0 + 1) > float(m_entryCount))
+	{
+		for (int32 i = 0; i < m_proxyCapacity; ++i)
+		{
+			const b2HashProxy* proxy = m_proxies + i;
+			if (proxy->used == false || proxy->oversizeIndex != b2_nullNode)
+			{
+				continue;
+			}
+
+			if (b2TestOverlap(proxy->aabb, aabb))
+			{
+				bool proceed = callback->QueryCallback(i);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+		}
+
+		return;
+	}
+
+	for (int32 y = y0; y <= y1; ++y)
+	{
+		for (int32 x = x0; x <= x1; ++x)
+		{
+			int32 entryId = m_buckets[GetBucket(x, y)];
+			while (entryId != b2_nullNode)
+			{
+				const b2HashEntry* entry = m_entries + entryId;
+				entryId = entry->next;
+
+				if (entry->x != x || entry->y != y)
+				{
+					continue;
+				}
+
+				const b2AABB& proxyAABB = m_proxies[entry->proxyId].aabb;
+				if (b2TestOverlap(proxyAABB, aabb) == false)
+				{
+					continue;
+				}
+
+				// A proxy in several cells is only reported by the cell that holds the
+				// lower corner of the overlap.
+				float lowerX = b2Max(proxyAABB.lowerBound.x, aabb.lowerBound.x);
+				float lowerY = b2Max(proxyAABB.lowerBound.y, aabb.lowerBound.y);
+				if (GetCellX(lowerX) != x || GetCellY(lowerY) != y)
+				{
+					continue;
+				}
+
+				bool proceed = callback->QueryCallback(entry->proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void b2SpatialHash::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2Vec2 p1 = input.p1;
+	b2Vec2 d = input.p2 - input.p1;
+	b2Assert(d.LengthSquared() > 0.0f);
+
+	b2RayPacketSegment segment;
+	segment.Set(input);
+
+	b2RayCastInput subInput = input;
+
+	for (int32 i = 0; i < m_oversizeCount; ++i)
+	{
+		int32 proxyId = m_oversize[i];
+		if (segment.Test(m_proxies[proxyId].aabb) == false)
+		{
+			continue;
+		}
+
+		float value = callback->RayCastCallback(subInput, proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			subInput.maxFraction = value;
+			segment.Clip(value);
+		}
+	}
+
+	int32 x = GetCellX(p1.x);
+	int32 y = GetCellY(p1.y);
+
+	// A ray through more cells than there are entries is cheaper as a scan of the proxies.
+	b2Vec2 end = p1 + subInput.maxFraction * d;
+	float cellCount = b2Abs(float(GetCellX(end.x) - x)) + b2Abs(float(GetCellY(end.y) - y)) + 1.0f;
+	if (cellCount > float(m_entryCount))
+	{
+		for (int32 i = 0; i < m_proxyCapacity; ++i)
+		{
+			const b2HashProxy* proxy = m_proxies + i;
+			if (proxy->used == false || proxy->oversizeIndex != b2_nullNode || segment.Test(proxy->aabb) == false)
+			{
+				continue;
+			}
+
+			float value = callback->RayCastCallback(subInput, i);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				subInput.maxFraction = value;
+				segment.Clip(value);
+			}
+		}
+
+		return;
+	}
+
+	// Walk the cells along the ray. The fractions are along the whole ray.
+	int32 stepX = d.x > 0.0f ? 1 : -1;
+	int32 stepY = d.y > 0.0f ? 1 : -1;
+
+	float nextX = d.x != 0.0f ? ((x + (stepX > 0 ? 1 : 0)) * m_cellSize - p1.x) / d.x : b2_maxFloat;
+	float nextY = d.y != 0.0f ? ((y + (stepY > 0 ? 1 : 0)) * m_cellSize - p1.y) / d.y : b2_maxFloat;
+	float deltaX = d.x != 0.0f ? m_cellSize / b2Abs(d.x) : b2_maxFloat;
+	float deltaY = d.y != 0.0f ? m_cellSize / b2Abs(d.y) : b2_maxFloat;
+
+	// Proxies in several cells are reported once.
+	b2GrowableStack<int32, 64> reported;
+
+	for (;;)
+	{
+		int32 entryId = m_buckets[GetBucket(x, y)];
+		while (entryId != b2_nullNode)
+		{
+			const b2HashEntry* entry = m_entries + entryId;
+			entryId = entry->next;
+
+			if (entry->x != x || entry->y != y)
+			{
+				continue;
+			}
+
+			int32 proxyId = entry->proxyId;
+			const b2AABB& proxyAABB = m_proxies[proxyId].aabb;
+			if (segment.Test(proxyAABB) == false)
+			{
+				continue;
+			}
+
+			bool spansCells = GetCellX(proxyAABB.lowerBound.x) != GetCellX(proxyAABB.upperBound.x) ||
+				GetCellY(proxyAABB.lowerBound.y) != GetCellY(proxyAABB.upperBound.y);
+			if (spansCells)
+			{
+				bool found = false;
+				for (int32 i = 0; i < reported.GetCount() && found == false; ++i)
+				{
+					found = reported.Get(i) == proxyId;
+				}
+
+				if (found)
+				{
+					continue;
+				}
+
+				reported.Push(proxyId);
+			}
+
+			float value = callback->RayCastCallback(subInput, proxyId);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				subInput.maxFraction = value;
+				segment.Clip(value);
+			}
+		}
+
+		if (nextX < nextY)
+		{
+			if (nextX > subInput.maxFraction)
+			{
+				break;
+			}
+
+			x += stepX;
+			nextX += deltaX;
+		}
+		else
+		{
+			if (nextY > subInput.maxFraction)
+			{
+				break;
+			}
+
+			y += stepY;
+			nextY += deltaY;
+		}
+	}
+}
+
+#endif
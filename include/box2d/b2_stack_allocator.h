@@ -28,6 +28,7 @@
 
 const int32 b2_stackSize = 100 * 1024;	// 100k
 const int32 b2_maxStackEntries = 32;
+const int32 b2_stackAlignment = 8;
 
 struct B2_API b2StackEntry
 {
@@ -52,7 +53,7 @@ public:
 
 private:
 
-	char m_data[b2_stackSize];
+	alignas(b2_stackAlignment) char m_data[b2_stackSize];
 	int32 m_index;
 
 	int32 m_allocation;
@@ -0,0 +1,236 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef B2_SWEEP_AND_PRUNE_H
+#define B2_SWEEP_AND_PRUNE_H
+
+#include "b2_api.h"
+#include "b2_dynamic_tree.h"
+
+/// A proxy in a b2SweepAndPrune.
+struct B2_API b2SweepProxy
+{
+	void* userData;
+
+	/// Index in the sorted entries, or the next free proxy.
+	union
+	{
+		int32 index;
+		int32 next;
+	};
+
+	bool used;
+	bool moved;
+};
+
+/// The fat AABB of a proxy in the sorted entries.
+struct B2_API b2SweepEntry
+{
+	b2AABB aabb;
+	int32 proxyId;
+};
+
+/// Sort and sweep on the x-axis. The fat AABBs are kept sorted by their lower x bound
+/// with insertion sort, which is cheap when the proxies move a little each step. A query
+/// is a binary search followed by a sweep over the proxies that start in the query range,
+/// widened by the widest proxy. This suits many proxies of about the same size.
+/// The interface follows b2DynamicTree, so b2BroadPhase can use either.
+class B2_API b2SweepAndPrune
+{
+public:
+	b2SweepAndPrune();
+	~b2SweepAndPrune();
+
+	/// Create a proxy. The AABB is fattened as in b2DynamicTree::CreateProxy.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+
+	/// Destroy a proxy. This asserts if the id is invalid.
+	void DestroyProxy(int32 proxyId);
+
+	/// Move a proxy. If the proxy has moved outside of its fattened AABB, then the
+	/// proxy is moved to its new place in the sorted order.
+	/// @return true if the fat AABB changed.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb1, const b2Vec2& displacement, const b2Vec2& margin = b2Vec2(b2_aabbExtension, b2_aabbExtension));
+
+	/// Get proxy user data.
+	void* GetUserData(int32 proxyId) const;
+
+	bool WasMoved(int32 proxyId) const;
+	void ClearMoved(int32 proxyId);
+
+	/// Get the fat AABB for a proxy.
+	const b2AABB& GetFatAABB(int32 proxyId) const;
+
+	/// Get the number of times a proxy moved outside of its fat AABB.
+	int32 GetMoveCount() const;
+
+	/// Query an AABB for overlapping proxies. The callback class is called for each
+	/// proxy that overlaps the supplied AABB, in order of the lower x bounds.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies under the bounding box of the ray.
+	/// @see b2DynamicTree::RayCast
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Shift the world origin.
+	void ShiftOrigin(const b2Vec2& newOrigin);
+
+private:
+
+	// Move an entry to its place in the sorted order.
+	void SortEntry(int32 index);
+
+	// The index of the first entry with a lower x bound at or past x.
+	int32 FindFirst(float x) const;
+
+	void ComputeMaxWidth();
+
+	b2SweepProxy* m_proxies;
+	int32 m_proxyCapacity;
+	int32 m_freeProxy;
+
+	b2SweepEntry* m_entries;
+	int32 m_entryCount;
+	int32 m_entryCapacity;
+
+	// No proxy is wider than this. It only grows between recomputes.
+	float m_maxWidth;
+	int32 m_widthMoveCount;
+
+	int32 m_moveCount;
+};
+
+inline void* b2SweepAndPrune::GetUserData(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].userData;
+}
+
+inline bool b2SweepAndPrune::WasMoved(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	return m_proxies[proxyId].moved;
+}
+
+inline void b2SweepAndPrune::ClearMoved(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	m_proxies[proxyId].moved = false;
+}
+
+inline const b2AABB& b2SweepAndPrune::GetFatAABB(int32 proxyId) const
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].used);
+	return m_entries[m_proxies[proxyId].index].aabb;
+}
+
+inline int32 b2SweepAndPrune::GetMoveCount() const
+{
+	return m_moveCount;
+}
+
+inline int32 b2SweepAndPrune::FindFirst(float x) const
+{
+	int32 low = 0;
+	int32 high = m_entryCount;
+	while (low < high)
+	{
+		int32 mid = (low + high) >> 1;
+		if (m_entries[mid].aabb.lowerBound.x < x)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+template <typename T>
+inline void b2SweepAndPrune::Query(T* callback, const b2AABB& aabb) const
+{
+	// A proxy that overlaps the query starts at most the widest proxy width before it.
+	for (int32 i = FindFirst(aabb.lowerBound.x - m_maxWidth); i < m_entryCount; ++i)
+	{
+		const b2SweepEntry* entry = m_entries + i;
+		if (entry->aabb.lowerBound.x > aabb.upperBound.x)
+		{
+			break;
+		}
+
+		if (b2TestOverlap(entry->aabb, aabb))
+		{
+			bool proceed = callback->QueryCallback(entry->proxyId);
+			if (proceed == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void b2SweepAndPrune::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	b2RayPacketSegment segment;
+	segment.Set(input);
+
+	b2RayCastInput subInput = input;
+
+	// The bounding box of the ray shrinks as the ray is clipped.
+	for (int32 i = FindFirst(segment.aabb.lowerBound.x - m_maxWidth); i < m_entryCount; ++i)
+	{
+		const b2SweepEntry* entry = m_entries + i;
+		if (entry->aabb.lowerBound.x > segment.aabb.upperBound.x)
+		{
+			break;
+		}
+
+		if (segment.Test(entry->aabb) == false)
+		{
+			continue;
+		}
+
+		float value = callback->RayCastCallback(subInput, entry->proxyId);
+
+		if (value == 0.0f)
+		{
+			// The client has terminated the ray cast.
+			return;
+		}
+
+		if (value > 0.0f)
+		{
+			subInput.maxFraction = value;
+			segment.Clip(value);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,99 @@
+// MIT License
+
+// Copyright (c) 2020 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_TASK_SCHEDULER_H
+#define B2_TASK_SCHEDULER_H
+
+#include "b2_api.h"
+#include "b2_settings.h"
+
+/// A task that processes a range of items. Box2D implements this for each
+/// part of the time step that can run in parallel.
+class B2_API b2RangeTask
+{
+public:
+	virtual ~b2RangeTask() {}
+
+	/// Process the items in [begin, end).
+	/// @param workerIndex the worker running this range. This is in the range
+	/// [0, b2TaskScheduler::GetWorkerCount()) and must not be shared by ranges
+	/// that run at the same time.
+	virtual void Execute(int32 begin, int32 end, int32 workerIndex) = 0;
+};
+
+/// Implement this class to run parts of the time step on your own job system.
+/// Box2D enqueues a task from inside b2World::Step and waits for it before
+/// moving on, so these tasks never outlive the step. Background tasks are the
+/// exception: they may run across steps and are waited on in a later step.
+class B2_API b2TaskScheduler
+{
+public:
+	virtual ~b2TaskScheduler() {}
+
+	/// Get the number of workers, including the thread calling b2World::Step.
+	/// Box2D allocates per worker storage for this many workers. A count
+	/// of one runs the time step serially.
+	virtual int32 GetWorkerCount() const = 0;
+
+	/// Split [0, itemCount) into ranges of at least minRange items (except for the
+	/// last one) and call b2RangeTask::Execute for each range, possibly in parallel.
+	/// The ranges may be executed in any order.
+	/// @return a handle that is passed to Wait. This may be nullptr if the
+	/// task was finished inline.
+	virtual void* Enqueue(b2RangeTask* task, int32 itemCount, int32 minRange) = 0;
+
+	/// Run a single item task that may take longer than a step, such as a broad-phase
+	/// tree rebuild. Call b2RangeTask::Execute(0, 1, workerIndex) for it once. It should
+	/// not hold up the thread calling b2World::Step, which will Wait on it later.
+	/// The default implementation runs the task inline.
+	/// @return a handle that is passed to Wait. This may be nullptr if the
+	/// task was finished inline.
+	virtual void* EnqueueBackground(b2RangeTask* task)
+	{
+		task->Execute(0, 1, 0);
+		return nullptr;
+	}
+
+	/// Block until all the ranges of an enqueued task are finished.
+	virtual void Wait(void* handle) = 0;
+};
+
+/// Execute a task over [0, itemCount) and wait for it to finish. The task runs
+/// inline as worker zero if there is no scheduler or it only has one worker.
+inline void b2ExecuteTask(b2TaskScheduler* scheduler, b2RangeTask* task, int32 itemCount, int32 minRange)
+{
+	if (itemCount <= 0)
+	{
+		return;
+	}
+
+	if (scheduler == nullptr || scheduler->GetWorkerCount() <= 1)
+	{
+		task->Execute(0, itemCount, 0);
+		return;
+	}
+
+	void* handle = scheduler->Enqueue(task, itemCount, minRange);
+	scheduler->Wait(handle);
+}
+
+#endif
@@ -0,0 +1,72 @@
+// MIT License
+
+// Copyright (c) 2020 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_THREAD_POOL_H
+#define B2_THREAD_POOL_H
+
+#include "b2_api.h"
+#include "b2_settings.h"
+#include "b2_task_scheduler.h"
+
+struct b2ThreadPoolData;
+struct b2ThreadPoolJob;
+
+/// A work stealing thread pool for users who don't bring their own job system.
+/// The thread calling b2World::Step is worker zero and helps out while it waits,
+/// so a pool with N workers starts N - 1 threads. Each worker has its own queue
+/// of ranges and steals from the other queues when it runs out of work. Background
+/// tasks go in a separate queue that only the pool threads take from.
+/// @warning a pool must only be used by one world step at a time.
+class B2_API b2ThreadPool : public b2TaskScheduler
+{
+public:
+	/// Start the pool.
+	/// @param workerCount the number of workers including the calling thread. Use zero
+	/// for the number of hardware threads. A single worker starts no threads.
+	explicit b2ThreadPool(int32 workerCount = 0);
+
+	/// Stop and join all threads.
+	~b2ThreadPool();
+
+	/// @see b2TaskScheduler::GetWorkerCount
+	int32 GetWorkerCount() const override;
+
+	/// @see b2TaskScheduler::Enqueue
+	void* Enqueue(b2RangeTask* task, int32 itemCount, int32 minRange) override;
+
+	/// @see b2TaskScheduler::EnqueueBackground
+	void* EnqueueBackground(b2RangeTask* task) override;
+
+	/// @see b2TaskScheduler::Wait
+	void Wait(void* handle) override;
+
+private:
+
+	void WorkerMain(int32 workerIndex);
+	bool RunOne(int32 workerIndex);
+	bool RunBackground(int32 workerIndex, b2ThreadPoolJob* job);
+
+	b2ThreadPoolData* m_data;
+	int32 m_workerCount;
+};
+
+#endif
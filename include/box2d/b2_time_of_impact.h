@@ -60,4 +60,10 @@ struct B2_API b2TOIOutput
 /// Note: use b2Distance to compute the contact point and normal at the time of impact.
 B2_API void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input);
 
+/// TOI statistics for profiling, updated by every call to b2TimeOfImpact. These are atomic
+/// because the world may compute several times of impact at once.
+extern B2_API std::atomic<float> b2_toiTime, b2_toiMaxTime;
+extern B2_API std::atomic<int32> b2_toiCalls, b2_toiIters, b2_toiMaxIters;
+extern B2_API std::atomic<int32> b2_toiRootIters, b2_toiMaxRootIters;
+
 #endif
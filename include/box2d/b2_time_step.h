@@ -25,7 +25,9 @@
 #include "b2_api.h"
 #include "b2_math.h"
 
-/// Profiling data. Times are in milliseconds.
+class b2Body;
+
+/// Profiling data. Times are in milliseconds. Counts are for the whole step.
 struct B2_API b2Profile
 {
 	float step;
@@ -36,6 +38,19 @@ struct B2_API b2Profile
 	float solvePosition;
 	float broadphase;
 	float solveTOI;
+
+	/// Broad-phase proxies that moved outside of their fat AABB.
+	int32 proxyMoves;
+
+	/// Proxies queried for new pairs.
+	int32 pairQueries;
+
+	/// Potential pairs found by the queries, including pairs that already have a contact.
+	int32 pairs;
+
+	/// Contacts that kept their manifold because their bodies barely moved relative to
+	/// each other. See b2World::SetManifoldReuse.
+	int32 reusedManifolds;
 };
 
 /// This is an internal structure.
@@ -47,6 +62,9 @@ struct B2_API b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool wideSolver;	// solve the contact velocity constraints in SIMD batches
+	bool graphColoring;	// split large islands into graph colors
+	bool softStep;		// sub-step with soft contacts, velocityIterations is the sub-step count
 };
 
 /// This is an internal structure.
@@ -63,6 +81,22 @@ struct B2_API b2Velocity
 	float w;
 };
 
+/// The position and velocity of every body in a world. The arrays are indexed by the
+/// solver index of a body and persist between time steps, so the island solver can work
+/// on them in place instead of copying the state out of the bodies and back each step.
+/// The start positions are the center and angle at the start of the sweep, used for
+/// continuous collision.
+/// This is an internal structure.
+struct B2_API b2SolverBodies
+{
+	b2Position* positions;
+	b2Position* positions0;
+	b2Velocity* velocities;
+	b2Body** bodies;
+	int32 count;
+	int32 capacity;
+};
+
 /// Solver Data
 struct B2_API b2SolverData
 {
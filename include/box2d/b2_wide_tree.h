@@ -0,0 +1,137 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_WIDE_TREE_H
+#define B2_WIDE_TREE_H
+
+#include "b2_api.h"
+#include "b2_collision.h"
+
+class b2DynamicTree;
+
+/// A node of a b2WideTree with the bounds of its four children stored as structure of
+/// arrays so they can be tested together. Unused children have empty bounds.
+struct B2_API b2WideNode
+{
+	float lowerX[4];
+	float lowerY[4];
+	float upperX[4];
+	float upperY[4];
+
+	// A wide node index or a proxy id of the source tree, see leafMask.
+	int32 children[4];
+
+	// Bit i is set if child i is a proxy.
+	int32 leafMask;
+};
+
+/// A read only copy of a b2DynamicTree with four children per node. Build collapses
+/// every other level of the binary tree, so a query visits half as many nodes and
+/// tests four AABBs at once with SSE2. Queries and ray casts report the proxy ids of
+/// the source tree. The copy must be built again after the source tree changes.
+class B2_API b2WideTree
+{
+public:
+
+	b2WideTree();
+	~b2WideTree();
+
+	/// Build from a dynamic tree. This is O(n).
+	void Build(const b2DynamicTree* tree);
+
+	/// Query an AABB for overlapping proxies. The callback class
+	/// is called for each proxy that overlaps the supplied AABB.
+	/// @see b2DynamicTree::Query
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	/// Ray-cast against the proxies in the tree.
+	/// @see b2DynamicTree::RayCast
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	/// Ray-cast a packet of rays together.
+	/// @see b2DynamicTree::RayCastPacket
+	template <typename T>
+	void RayCastPacket(T* callback, b2RayCastInput* inputs, int32 count) const;
+
+	/// Get the number of wide nodes.
+	int32 GetNodeCount() const;
+
+private:
+
+	typedef bool QueryFcn(void* context, int32 proxyId);
+	typedef float RayCastFcn(void* context, const b2RayCastInput& input, int32 proxyId);
+
+	template <typename T>
+	static bool QueryThunk(void* context, int32 proxyId)
+	{
+		return ((T*)context)->QueryCallback(proxyId);
+	}
+
+	template <typename T>
+	static float RayCastThunk(void* context, const b2RayCastInput& input, int32 proxyId)
+	{
+		return ((T*)context)->RayCastCallback(input, proxyId);
+	}
+
+	typedef float RayCastPacketFcn(void* context, const b2RayCastInput& input, int32 proxyId, int32 rayIndex);
+
+	template <typename T>
+	static float RayCastPacketThunk(void* context, const b2RayCastInput& input, int32 proxyId, int32 rayIndex)
+	{
+		return ((T*)context)->RayCastCallback(input, proxyId, rayIndex);
+	}
+
+	void Query(QueryFcn* fcn, void* context, const b2AABB& aabb) const;
+	void RayCast(RayCastFcn* fcn, void* context, const b2RayCastInput& input) const;
+	void RayCastPacket(RayCastPacketFcn* fcn, void* context, b2RayCastInput* inputs, int32 count) const;
+
+	b2WideNode* m_nodes;
+	int32 m_nodeCount;
+	int32 m_nodeCapacity;
+};
+
+template <typename T>
+inline void b2WideTree::Query(T* callback, const b2AABB& aabb) const
+{
+	Query(QueryThunk<T>, callback, aabb);
+}
+
+template <typename T>
+inline void b2WideTree::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	RayCast(RayCastThunk<T>, callback, input);
+}
+
+template <typename T>
+inline void b2WideTree::RayCastPacket(T* callback, b2RayCastInput* inputs, int32 count) const
+{
+	RayCastPacket(RayCastPacketThunk<T>, callback, inputs, count);
+}
+
+inline int32 b2WideTree::GetNodeCount() const
+{
+	return m_nodeCount;
+}
+
+#endif
@@ -39,10 +39,54 @@ class b2Body;
 class b2Draw;
 class b2Fixture;
 class b2Joint;
+class b2Island;
+class b2Shape;
+class b2TaskScheduler;
+struct b2IslandWorker;
+
+/// A ray for b2World::RayCastBatch.
+struct B2_API b2BatchRay
+{
+	/// The ray starting point.
+	b2Vec2 p1;
+
+	/// The ray ending point.
+	b2Vec2 p2;
+
+	/// The ray only hits fixtures whose category bits overlap these bits.
+	uint16 maskBits;
+};
+
+/// The closest hit of a ray cast by b2World::RayCastBatch.
+struct B2_API b2BatchRayHit
+{
+	/// The fixture hit by the ray, or nullptr if the ray hit nothing.
+	b2Fixture* fixture;
+	b2Vec2 point;
+	b2Vec2 normal;
+	float fraction;
+};
+
+/// A shape for b2World::OverlapShapeBatch.
+struct B2_API b2BatchShapeQuery
+{
+	/// The query shape. All of its children are tested.
+	const b2Shape* shape;
+
+	/// The world transform of the query shape.
+	b2Transform transform;
+
+	/// The query only finds fixtures whose category bits overlap these bits.
+	uint16 maskBits;
+};
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
 /// management facilities.
+///
+/// The const queries (QueryAABB, RayCast, and the batch queries) do not change the
+/// world, so they may be called from several threads at once while the world is
+/// not locked and no thread is changing it. Each thread needs its own callback.
 class B2_API b2World
 {
 public:
@@ -50,6 +94,18 @@ public:
 	/// @param gravity the world gravity vector.
 	b2World(const b2Vec2& gravity);
 
+	/// Construct a world object that runs on a task scheduler.
+	/// @param gravity the world gravity vector.
+	/// @param scheduler runs the parallel parts of the time step. This is owned by you and must
+	/// remain in scope. Use nullptr or a scheduler with one worker to run on the calling thread only.
+	b2World(const b2Vec2& gravity, b2TaskScheduler* scheduler);
+
+	/// Construct a world object with a choice of broad-phase structure for moving bodies.
+	/// @param gravity the world gravity vector.
+	/// @param scheduler runs the parallel parts of the time step. This may be nullptr.
+	/// @param broadPhaseDef picks a tree, a uniform grid, or sort and sweep.
+	b2World(const b2Vec2& gravity, b2TaskScheduler* scheduler, const b2BroadPhaseDef& broadPhaseDef);
+
 	/// Destruct the world. All physics entities are destroyed and all heap memory is released.
 	~b2World();
 
@@ -71,6 +127,17 @@ public:
 	/// by you and must remain in scope.
 	void SetDebugDraw(b2Draw* debugDraw);
 
+	/// Register a task scheduler to run the parallel parts of the time step. The scheduler
+	/// is owned by you and must remain in scope. Pass nullptr to step on the calling thread only.
+	/// The results do not depend on the scheduler or its number of workers. A broad-phase
+	/// tree rebuild may run on the scheduler between steps, so destroy the world or set a
+	/// different scheduler before destroying it.
+	/// @warning This function is locked during callbacks.
+	void SetTaskScheduler(b2TaskScheduler* scheduler);
+
+	/// Get the registered task scheduler. This may be nullptr.
+	b2TaskScheduler* GetTaskScheduler() const;
+
 	/// Create a rigid body given a definition. No reference to the definition
 	/// is retained.
 	/// @warning This function is locked during callbacks.
@@ -91,6 +158,18 @@ public:
 	/// @warning This function is locked during callbacks.
 	void DestroyJoint(b2Joint* joint);
 
+	/// Begin loading many fixtures at once, for example the static geometry of a level.
+	/// The broad-phase proxies of fixtures created until EndBulkLoad are added in one
+	/// top-down tree build, which is faster than adding them one at a time and gives a
+	/// better tree. These fixtures are not found by queries and ray casts until EndBulkLoad.
+	/// @warning This function is locked during callbacks.
+	void BeginBulkLoad();
+
+	/// Add the broad-phase proxies of the fixtures created since BeginBulkLoad. Call this
+	/// before the next time step.
+	/// @warning This function is locked during callbacks.
+	void EndBulkLoad();
+
 	/// Take a time step. This performs collision detection, integration,
 	/// and constraint solution.
 	/// @param timeStep the amount of time to simulate, this should not vary.
@@ -126,6 +205,35 @@ public:
 	/// @param point2 the ray ending point
 	void RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
 
+	/// Ray-cast many rays for their closest hits. Consecutive rays are traced through the
+	/// broad-phase together, so rays that start near each other and point the same way
+	/// should be next to each other in the array. Sensors are ignored. This gives the same
+	/// hits as RayCast with a callback that clips to the closest fixture.
+	/// @param rays the rays to cast.
+	/// @param count the number of rays.
+	/// @param hits receives the closest hit of each ray.
+	/// @param parallel spread the rays over the workers of the task scheduler. Do not use
+	/// this from inside a task run by the scheduler.
+	void RayCastBatch(const b2BatchRay* rays, int32 count, b2BatchRayHit* hits, bool parallel = true) const;
+
+	/// Query many AABBs. Query i stores the fixtures it finds in
+	/// fixtures[i * capacity, (i + 1) * capacity) in the order QueryAABB reports them.
+	/// @param aabbs the query boxes.
+	/// @param count the number of queries.
+	/// @param fixtures receives capacity fixtures per query.
+	/// @param capacity the number of fixtures stored per query.
+	/// @param counts receives the number of fixtures found by each query. This may be
+	/// more than the capacity, in which case only the first fixtures are stored.
+	/// @param parallel spread the queries over the workers of the task scheduler. Do not
+	/// use this from inside a task run by the scheduler.
+	void QueryAABBBatch(const b2AABB* aabbs, int32 count, b2Fixture** fixtures, int32 capacity, int32* counts, bool parallel = true) const;
+
+	/// Find the fixtures that overlap each of many shapes. A fixture is found once per
+	/// child that overlaps any child of the query shape. The results are stored as in
+	/// QueryAABBBatch.
+	/// @see QueryAABBBatch
+	void OverlapShapeBatch(const b2BatchShapeQuery* queries, int32 count, b2Fixture** fixtures, int32 capacity, int32* counts, bool parallel = true) const;
+
 	/// Get the world body list. With the returned body, use b2Body::GetNext to get
 	/// the next body in the world list. A nullptr body indicates the end of the list.
 	/// @return the head of the world body list.
@@ -162,9 +270,86 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Set when the broad-phase tree of moving proxies is rebuilt. The tree is rebuilt once
+	/// its quality is worse than this multiple of its quality after the last rebuild. The
+	/// rebuild runs as a background task on the task scheduler and the new tree is swapped
+	/// in at the start of the next step. Use zero to disable rebuilds. The default is
+	/// b2_treeRebuildRatio.
+	void SetTreeRebuildThreshold(float threshold);
+
+	/// Enable/disable refit mode for the broad-phase tree of moving proxies. A proxy that
+	/// leaves its fat AABB is updated in place instead of being re-inserted, and the tree
+	/// is refit once per step. This is faster for swarms of small fast bodies. The tree
+	/// loses quality faster, which the automatic tree rebuild makes up for.
+	void SetTreeRefit(bool flag);
+
+	/// Enable/disable adaptive fat AABB margins. The margin of each broad-phase proxy then
+	/// follows its recent movement, between b2_aabbMinExtension and b2_aabbMaxExtension,
+	/// instead of the fixed b2_aabbExtension. Fast proxies leave their fat AABB less often
+	/// and resting proxies form fewer pairs. See b2Profile::proxyMoves and b2Profile::pairs.
+	/// This is disabled by default.
+	void SetAdaptiveMargins(bool flag);
+	bool GetAdaptiveMargins() const;
+
+	/// Enable/disable manifold reuse. A contact whose bodies moved less than
+	/// b2_manifoldReuseLinearSlop and rotated less than b2_manifoldReuseAngularSlop
+	/// relative to each other since its manifold was computed keeps the manifold instead
+	/// of computing it again. This helps piles that are not asleep yet and bodies riding a
+	/// moving platform. The results then differ slightly from recomputing every manifold.
+	/// See b2Profile::reusedManifolds. This is disabled by default.
+	void SetManifoldReuse(bool flag);
+	bool GetManifoldReuse() const;
+
+	/// Enable/disable the 4-wide copy of the broad-phase tree of static proxies. QueryAABB,
+	/// RayCast, and the pair update use it to test four AABBs at once. It is built again
+	/// whenever a static fixture is created, destroyed, or moved, so use it for static
+	/// geometry that rarely changes. This is disabled by default.
+	void SetWideTree(bool flag);
+
+	/// Enable/disable the compact copy of the broad-phase tree of static proxies. It
+	/// stores child bounds in 16 bits and takes the place of the wide copy. This helps
+	/// worlds with hundreds of thousands of static fixtures, where the tree does not fit
+	/// in the cache. This is disabled by default.
+	void SetCompactTree(bool flag);
+
+	/// Enable/disable the wide contact solver. This solves the contact velocity constraints
+	/// of an island in SIMD batches (SSE2 or AVX when the compiler targets them). The
+	/// results are deterministic for a given build but differ from the default solver
+	/// because the constraints are solved in a different order. Continuous collision always uses the
+	/// default solver.
+	void SetWideSolver(bool flag) { m_wideSolver = flag; }
+	bool GetWideSolver() const { return m_wideSolver; }
+
+	/// Enable/disable graph coloring of large islands. The contacts and joints of an island
+	/// with at least b2_minColoredConstraints constraints are split into colors that do not
+	/// share a body, and each color is solved in parallel by the task scheduler. This lets
+	/// a single large pile use several workers. The results do not depend on the number of
+	/// workers, but they differ from the default solver because the constraints are solved
+	/// in a different order. Colored islands do not use the wide solver.
+	void SetGraphColoring(bool flag) { m_graphColoring = flag; }
+	bool GetGraphColoring() const { return m_graphColoring; }
+
+	/// Enable/disable the soft step solver. This splits each time step into sub-steps and
+	/// solves the contacts as soft constraints, with a relax pass in each sub-step instead of
+	/// position iterations. The velocityIterations passed to Step become the number of
+	/// sub-steps; 4 is a good choice. The positionIterations are only used to correct the
+	/// joints. Tall stacks are stable with fewer sub-steps than the default solver needs
+	/// iterations. The soft step solver does not use the wide solver or graph coloring.
+	void SetSoftStep(bool flag) { m_softStep = flag; }
+	bool GetSoftStep() const { return m_softStep; }
+
+	/// Compute a hash of the world state: the transform and velocity of every body and the
+	/// impulses of every contact. Two worlds that were given the same inputs have the same
+	/// hash. This is cheap enough to compare across processes every step.
+	uint64 ComputeStateHash() const;
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
+	/// Get the number of times a broad-phase proxy moved outside of its fat AABB. Sample
+	/// this every step to get the move rate.
+	int32 GetProxyMoveCount() const;
+
 	/// Get the number of bodies.
 	int32 GetBodyCount() const;
 
@@ -222,7 +407,19 @@ private:
 	friend class b2Controller;
 
 	void Solve(const b2TimeStep& step);
+	void SolveParallel(const b2TimeStep& step);
+	void BuildIsland(b2Island* island, b2Body* seed, b2Body** stack, int32 stackSize, b2Body** statics, int32* staticCount);
 	void SolveTOI(const b2TimeStep& step);
+	bool ComputeTOI(b2Contact* contact);
+
+	// Manage the slots of the bodies in the solver arrays.
+	int32 AddSolverBody(b2Body* body);
+	void RemoveSolverBody(b2Body* body);
+
+	// Range task functions.
+	void SolveIslands(void* context, int32 begin, int32 end, int32 workerIndex);
+	void SweepFixtures(void* context, int32 begin, int32 end, int32 workerIndex);
+	void ComputeTOIs(void* context, int32 begin, int32 end, int32 workerIndex);
 
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
 
@@ -234,6 +431,8 @@ private:
 	b2Body* m_bodyList;
 	b2Joint* m_jointList;
 
+	b2SolverBodies m_solverBodies;
+
 	int32 m_bodyCount;
 	int32 m_jointCount;
 
@@ -243,6 +442,10 @@ private:
 	b2DestructionListener* m_destructionListener;
 	b2Draw* m_debugDraw;
 
+	b2TaskScheduler* m_taskScheduler;
+	b2IslandWorker* m_islandWorkers;
+	int32 m_islandWorkerCount;
+
 	// This is used to compute the time step ratio to
 	// support a variable time step.
 	float m_inv_dt0;
@@ -255,12 +458,21 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_wideSolver;
+	bool m_graphColoring;
+	bool m_softStep;
+	bool m_bulkLoad;
 
 	bool m_stepComplete;
 
 	b2Profile m_profile;
 };
 
+inline b2TaskScheduler* b2World::GetTaskScheduler() const
+{
+	return m_taskScheduler;
+}
+
 inline b2Body* b2World::GetBodyList()
 {
 	return m_bodyList;
@@ -283,12 +495,12 @@ inline const b2Joint* b2World::GetJointList() const
 
 inline b2Contact* b2World::GetContactList()
 {
-	return m_contactManager.m_contactList;
+	return m_contactManager.GetLastContact();
 }
 
 inline const b2Contact* b2World::GetContactList() const
 {
-	return m_contactManager.m_contactList;
+	return m_contactManager.GetLastContact();
 }
 
 inline int32 b2World::GetBodyCount() const
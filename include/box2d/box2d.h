@@ -29,17 +29,24 @@
 #include "b2_draw.h"
 #include "b2_timer.h"
 
+#include "b2_capsule_shape.h"
 #include "b2_chain_shape.h"
 #include "b2_circle_shape.h"
 #include "b2_edge_shape.h"
 #include "b2_polygon_shape.h"
 
 #include "b2_broad_phase.h"
+#include "b2_compact_tree.h"
 #include "b2_dynamic_tree.h"
+#include "b2_spatial_hash.h"
+#include "b2_sweep_and_prune.h"
+#include "b2_wide_tree.h"
 
 #include "b2_body.h"
 #include "b2_contact.h"
 #include "b2_fixture.h"
+#include "b2_task_scheduler.h"
+#include "b2_thread_pool.h"
 #include "b2_time_step.h"
 #include "b2_world.h"
 #include "b2_world_callbacks.h"
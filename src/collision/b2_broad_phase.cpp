@@ -21,47 +21,301 @@
 // SOFTWARE.
 
 #include "box2d/b2_broad_phase.h"
+#include "box2d/b2_task_scheduler.h"
+
+#include <new>
 #include <string.h>
 
+// A pair tagged with the index of the move buffer entry that found it.
+struct b2MovePair
+{
+	int32 proxyIdA;
+	int32 proxyIdB;
+	int32 moveIndex;
+};
+
+// Pairs found by one worker in b2BroadPhase::FindPairs.
+struct b2BroadPhaseWorker
+{
+	// This is called from b2DynamicTree::Query when we are gathering pairs.
+	// This follows b2BroadPhase::QueryCallback.
+	bool QueryCallback(int32 nodeId)
+	{
+		int32 proxyId = b2BroadPhase::MakeProxyId(nodeId, queryTree);
+
+		// A proxy cannot form a pair with itself.
+		if (proxyId == queryProxyId)
+		{
+			return true;
+		}
+
+		const bool moved = broadPhase->WasMoved(proxyId);
+		if (moved && proxyId > queryProxyId)
+		{
+			// Both proxies are moving. Avoid duplicate pairs.
+			return true;
+		}
+
+		// Grow the pair buffer as needed.
+		if (pairCount == pairCapacity)
+		{
+			b2MovePair* oldBuffer = pairs;
+			pairCapacity = pairCapacity + (pairCapacity >> 1);
+			pairs = (b2MovePair*)b2Alloc(pairCapacity * sizeof(b2MovePair));
+			memcpy(pairs, oldBuffer, pairCount * sizeof(b2MovePair));
+			b2Free(oldBuffer);
+		}
+
+		pairs[pairCount].proxyIdA = b2Min(proxyId, queryProxyId);
+		pairs[pairCount].proxyIdB = b2Max(proxyId, queryProxyId);
+		pairs[pairCount].moveIndex = moveIndex;
+		++pairCount;
+
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	int32 queryTree;
+	int32 queryProxyId;
+	int32 moveIndex;
+
+	b2MovePair* pairs;
+	int32 pairCount;
+	int32 pairCapacity;
+
+	// The number of move entries queried, skipping the null ones.
+	int32 queryCount;
+};
+
+// Queries the tree for a range of the move buffer.
+class b2FindPairsTask : public b2RangeTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 workerIndex) override
+	{
+		b2BroadPhaseWorker* worker = m_workers + workerIndex;
+		for (int32 i = begin; i < end; ++i)
+		{
+			int32 proxyId = m_moveBuffer[i];
+			if (proxyId == b2BroadPhase::e_nullProxy)
+			{
+				continue;
+			}
+
+			worker->queryProxyId = proxyId;
+			worker->moveIndex = i;
+			++worker->queryCount;
+
+			const b2AABB& fatAABB = m_broadPhase->GetFatAABB(proxyId);
+
+			worker->queryTree = b2BroadPhase::e_dynamicTree;
+			m_broadPhase->QueryTree(worker, b2BroadPhase::e_dynamicTree, fatAABB);
+
+			if (b2BroadPhase::GetTreeType(proxyId) == b2BroadPhase::e_dynamicTree)
+			{
+				worker->queryTree = b2BroadPhase::e_staticTree;
+				m_broadPhase->QueryTree(worker, b2BroadPhase::e_staticTree, fatAABB);
+			}
+		}
+	}
+
+	const b2BroadPhase* m_broadPhase;
+	const int32* m_moveBuffer;
+	b2BroadPhaseWorker* m_workers;
+};
+
+// Builds the new structure of the tree of moving proxies away from the step.
+class b2TreeRebuildTask : public b2RangeTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 workerIndex) override
+	{
+		B2_NOT_USED(begin);
+		B2_NOT_USED(end);
+		B2_NOT_USED(workerIndex);
+		m_rebuild.Build();
+	}
+
+	b2TreeRebuild m_rebuild;
+};
+
 b2BroadPhase::b2BroadPhase()
 {
 	m_proxyCount = 0;
+	m_type = b2_treeBroadPhase;
+	m_staticCopyDirty = false;
+	m_staticProxyCount = 0;
+	m_staticChangeCount = 0;
+	m_staticBaseQuality = 0.0f;
+	m_useWideTree = false;
+	m_useCompactTree = false;
+	m_adaptiveMargins = false;
 
 	m_pairCapacity = 16;
 	m_pairCount = 0;
 	m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	m_pairQueryCount = 0;
+	m_foundPairCount = 0;
 
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_workers = nullptr;
+	m_workerCount = 0;
+
+	m_rebuildTask = nullptr;
+	m_rebuildScheduler = nullptr;
+	m_rebuildHandle = nullptr;
+	m_rebuilding = false;
+	m_rebuildThreshold = b2_treeRebuildRatio;
+	m_baseQuality = 0.0f;
+	m_checkedMoveCount = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
+	WaitForRebuild();
+
+	if (m_rebuildTask != nullptr)
+	{
+		m_rebuildTask->~b2TreeRebuildTask();
+		b2Free(m_rebuildTask);
+	}
+
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		b2Free(m_workers[i].pairs);
+	}
+	b2Free(m_workers);
+
 	b2Free(m_moveBuffer);
 	b2Free(m_pairBuffer);
 }
 
-int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+void b2BroadPhase::SetType(const b2BroadPhaseDef& def)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	b2Assert(m_proxyCount == 0);
+	m_type = def.type;
+	m_grid.SetCellSize(def.cellSize);
+}
+
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData, bool isStatic)
+{
+	int32 treeType = isStatic ? e_staticTree : e_dynamicTree;
+	int32 nodeId;
+	if (isStatic || m_type == b2_treeBroadPhase)
+	{
+		nodeId = m_trees[treeType].CreateProxy(aabb, userData);
+	}
+	else if (m_type == b2_gridBroadPhase)
+	{
+		nodeId = m_grid.CreateProxy(aabb, userData);
+	}
+	else
+	{
+		nodeId = m_sweep.CreateProxy(aabb, userData);
+	}
+
+	int32 proxyId = MakeProxyId(nodeId, treeType);
+	if (isStatic)
+	{
+		StaticTreeChanged();
+		++m_staticProxyCount;
+	}
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
 }
 
+void b2BroadPhase::CreateProxies(int32 count, const b2AABB* aabbs, void* const* userData, int32* proxyIds, bool isStatic)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (isStatic == false && m_type != b2_treeBroadPhase)
+	{
+		// Only a tree has a bulk build.
+		for (int32 i = 0; i < count; ++i)
+		{
+			proxyIds[i] = CreateProxy(aabbs[i], userData[i], false);
+		}
+		return;
+	}
+
+	int32 treeType = isStatic ? e_staticTree : e_dynamicTree;
+	m_trees[treeType].CreateProxies(count, aabbs, userData, proxyIds);
+	m_proxyCount += count;
+
+	if (isStatic)
+	{
+		// The whole static tree was just rebuilt.
+		m_staticProxyCount += count;
+		m_staticChangeCount = 0;
+		m_staticBaseQuality = m_trees[e_staticTree].GetAreaRatio();
+		m_staticCopyDirty = false;
+		BuildStaticCopy();
+	}
+	for (int32 i = 0; i < count; ++i)
+	{
+		proxyIds[i] = MakeProxyId(proxyIds[i], treeType);
+		BufferMove(proxyIds[i]);
+	}
+}
+
 void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+
+	int32 treeType = GetTreeType(proxyId);
+	int32 nodeId = GetNodeId(proxyId);
+	if (IsTreeProxy(proxyId))
+	{
+		m_trees[treeType].DestroyProxy(nodeId);
+	}
+	else if (m_type == b2_gridBroadPhase)
+	{
+		m_grid.DestroyProxy(nodeId);
+	}
+	else
+	{
+		m_sweep.DestroyProxy(nodeId);
+	}
+
+	if (treeType == e_staticTree)
+	{
+		StaticTreeChanged();
+		--m_staticProxyCount;
+	}
 }
 
-void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement, const b2Vec2& margin)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	int32 treeType = GetTreeType(proxyId);
+	int32 nodeId = GetNodeId(proxyId);
+	bool buffer;
+	if (IsTreeProxy(proxyId))
+	{
+		buffer = m_trees[treeType].MoveProxy(nodeId, aabb, displacement, margin);
+	}
+	else if (m_type == b2_gridBroadPhase)
+	{
+		buffer = m_grid.MoveProxy(nodeId, aabb, displacement, margin);
+	}
+	else
+	{
+		buffer = m_sweep.MoveProxy(nodeId, aabb, displacement, margin);
+	}
+
 	if (buffer)
 	{
+		if (treeType == e_staticTree)
+		{
+			StaticTreeChanged();
+		}
 		BufferMove(proxyId);
 	}
 }
@@ -98,15 +352,18 @@ void b2BroadPhase::UnBufferMove(int32 proxyId)
 }
 
 // This is called from b2DynamicTree::Query when we are gathering pairs.
-bool b2BroadPhase::QueryCallback(int32 proxyId)
+bool b2BroadPhase::QueryCallback(int32 nodeId)
 {
+	int32 proxyId = MakeProxyId(nodeId, m_queryTree);
+
 	// A proxy cannot form a pair with itself.
 	if (proxyId == m_queryProxyId)
 	{
 		return true;
 	}
 
-	const bool moved = m_tree.WasMoved(proxyId);
+	// A pair of moved proxies is found by both queries. Keep one.
+	const bool moved = WasMoved(proxyId);
 	if (moved && proxyId > m_queryProxyId)
 	{
 		// Both proxies are moving. Avoid duplicate pairs.
@@ -129,3 +386,198 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 
 	return true;
 }
+
+void b2BroadPhase::FindPairs(b2TaskScheduler* scheduler)
+{
+	int32 workerCount = scheduler->GetWorkerCount();
+	if (workerCount != m_workerCount)
+	{
+		for (int32 i = 0; i < m_workerCount; ++i)
+		{
+			b2Free(m_workers[i].pairs);
+		}
+		b2Free(m_workers);
+
+		m_workerCount = workerCount;
+		m_workers = (b2BroadPhaseWorker*)b2Alloc(m_workerCount * sizeof(b2BroadPhaseWorker));
+		for (int32 i = 0; i < m_workerCount; ++i)
+		{
+			b2BroadPhaseWorker* worker = m_workers + i;
+			worker->pairCapacity = 16;
+			worker->pairs = (b2MovePair*)b2Alloc(worker->pairCapacity * sizeof(b2MovePair));
+		}
+	}
+
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		m_workers[i].broadPhase = this;
+		m_workers[i].pairCount = 0;
+		m_workers[i].queryCount = 0;
+	}
+
+	b2FindPairsTask task;
+	task.m_broadPhase = this;
+	task.m_moveBuffer = m_moveBuffer;
+	task.m_workers = m_workers;
+	b2ExecuteTask(scheduler, &task, m_moveCount, b2_minTaskRange);
+
+	// Put the pairs in move buffer order, which is the order of the serial queries.
+	// Each move entry is queried by a single worker, so a counting sort on the move
+	// index keeps the query order of its pairs.
+	int32* offsets = (int32*)b2Alloc((m_moveCount + 1) * sizeof(int32));
+	memset(offsets, 0, (m_moveCount + 1) * sizeof(int32));
+
+	int32 pairCount = 0;
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		const b2BroadPhaseWorker* worker = m_workers + i;
+		for (int32 j = 0; j < worker->pairCount; ++j)
+		{
+			offsets[worker->pairs[j].moveIndex + 1] += 1;
+		}
+		pairCount += worker->pairCount;
+		m_pairQueryCount += worker->queryCount;
+	}
+
+	for (int32 i = 0; i < m_moveCount; ++i)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	if (pairCount > m_pairCapacity)
+	{
+		b2Free(m_pairBuffer);
+		m_pairCapacity = b2Max(pairCount, m_pairCapacity + (m_pairCapacity >> 1));
+		m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	}
+
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		const b2BroadPhaseWorker* worker = m_workers + i;
+		for (int32 j = 0; j < worker->pairCount; ++j)
+		{
+			const b2MovePair* pair = worker->pairs + j;
+			b2Pair* sortedPair = m_pairBuffer + offsets[pair->moveIndex]++;
+			sortedPair->proxyIdA = pair->proxyIdA;
+			sortedPair->proxyIdB = pair->proxyIdB;
+		}
+	}
+
+	m_pairCount = pairCount;
+
+	b2Free(offsets);
+}
+
+void b2BroadPhase::StaticTreeChanged()
+{
+	++m_staticChangeCount;
+	m_staticCopyDirty = true;
+}
+
+void b2BroadPhase::UpdateStaticTree()
+{
+	// Computing the quality visits every node, so only check it once a good share of the
+	// static proxies have changed. Then rebuild if the quality dropped far enough since
+	// the last rebuild, as StartRebuild does for the tree of moving proxies.
+	b2DynamicTree* tree = m_trees + e_staticTree;
+	if (m_rebuildThreshold > 0.0f && m_staticChangeCount >= b2Max(m_staticProxyCount / 4, 64))
+	{
+		m_staticChangeCount = 0;
+		if (m_staticBaseQuality == 0.0f || tree->GetAreaRatio() >= m_rebuildThreshold * m_staticBaseQuality)
+		{
+			tree->Rebuild();
+			m_staticBaseQuality = tree->GetAreaRatio();
+		}
+	}
+
+	if (m_staticCopyDirty)
+	{
+		m_staticCopyDirty = false;
+		BuildStaticCopy();
+	}
+}
+
+void b2BroadPhase::BuildStaticCopy()
+{
+	if (m_useCompactTree)
+	{
+		m_compactTree.Build(m_trees + e_staticTree);
+	}
+	else if (m_useWideTree)
+	{
+		m_wideTree.Build(m_trees + e_staticTree);
+	}
+}
+
+void b2BroadPhase::StartRebuild(b2TaskScheduler* scheduler)
+{
+	if (m_rebuilding || m_rebuildThreshold <= 0.0f || m_type != b2_treeBroadPhase)
+	{
+		return;
+	}
+
+	b2DynamicTree* tree = m_trees + e_dynamicTree;
+
+	// Computing the quality visits every node, so only check it once a good share of the
+	// proxies have moved.
+	int32 moveCount = tree->GetMoveCount() - m_checkedMoveCount;
+	if (moveCount < b2Max(m_proxyCount / 4, 64))
+	{
+		return;
+	}
+
+	m_checkedMoveCount = tree->GetMoveCount();
+
+	// The first rebuild gives the quality to compare against.
+	if (m_baseQuality > 0.0f && tree->GetAreaRatio() < m_rebuildThreshold * m_baseQuality)
+	{
+		return;
+	}
+
+	if (m_rebuildTask == nullptr)
+	{
+		m_rebuildTask = new (b2Alloc(sizeof(b2TreeRebuildTask))) b2TreeRebuildTask();
+	}
+
+	m_rebuildTask->m_rebuild.Snapshot(tree);
+	m_rebuilding = true;
+
+	if (scheduler != nullptr)
+	{
+		m_rebuildScheduler = scheduler;
+		m_rebuildHandle = scheduler->EnqueueBackground(m_rebuildTask);
+	}
+	else
+	{
+		// The new tree is still swapped in by FinishRebuild so the pairs come out the
+		// same with or without a scheduler.
+		m_rebuildTask->m_rebuild.Build();
+	}
+}
+
+void b2BroadPhase::FinishRebuild()
+{
+	if (m_rebuilding == false)
+	{
+		return;
+	}
+
+	WaitForRebuild();
+
+	b2DynamicTree* tree = m_trees + e_dynamicTree;
+	m_rebuildTask->m_rebuild.Apply(tree);
+	m_rebuilding = false;
+
+	m_baseQuality = tree->GetAreaRatio();
+	m_checkedMoveCount = tree->GetMoveCount();
+}
+
+void b2BroadPhase::WaitForRebuild()
+{
+	if (m_rebuildScheduler != nullptr)
+	{
+		m_rebuildScheduler->Wait(m_rebuildHandle);
+		m_rebuildScheduler = nullptr;
+		m_rebuildHandle = nullptr;
+	}
+}
@@ -0,0 +1,199 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_capsule_shape.h"
+#include "box2d/b2_block_allocator.h"
+
+#include <new>
+
+void b2CapsuleShape::Set(const b2Vec2& v1, const b2Vec2& v2, float radius)
+{
+	b2Assert(b2DistanceSquared(v1, v2) > b2_linearSlop * b2_linearSlop);
+	b2Assert(radius > 0.0f);
+	m_vertex1 = v1;
+	m_vertex2 = v2;
+	m_radius = radius;
+}
+
+b2Shape* b2CapsuleShape::Clone(b2BlockAllocator* allocator) const
+{
+	void* mem = allocator->Allocate(sizeof(b2CapsuleShape));
+	b2CapsuleShape* clone = new (mem) b2CapsuleShape;
+	*clone = *this;
+	return clone;
+}
+
+int32 b2CapsuleShape::GetChildCount() const
+{
+	return 1;
+}
+
+bool b2CapsuleShape::TestPoint(const b2Transform& transform, const b2Vec2& p) const
+{
+	b2Vec2 pLocal = b2MulT(transform, p);
+
+	// Find the closest point on the segment.
+	b2Vec2 e = m_vertex2 - m_vertex1;
+	float t = b2Clamp(b2Dot(pLocal - m_vertex1, e) / b2Dot(e, e), 0.0f, 1.0f);
+	b2Vec2 closest = m_vertex1 + t * e;
+
+	return b2DistanceSquared(pLocal, closest) <= m_radius * m_radius;
+}
+
+// Ray cast against a cap. See b2CircleShape::RayCast.
+static bool b2RayCastCap(float* fraction, const b2Vec2& p1, const b2Vec2& d, const b2Vec2& center, float radius, float maxFraction)
+{
+	b2Vec2 s = p1 - center;
+	float b = b2Dot(s, s) - radius * radius;
+
+	float c = b2Dot(s, d);
+	float rr = b2Dot(d, d);
+	float sigma = c * c - rr * b;
+	if (sigma < 0.0f || rr < b2_epsilon)
+	{
+		return false;
+	}
+
+	float a = -(c + b2Sqrt(sigma));
+	if (0.0f <= a && a <= maxFraction * rr)
+	{
+		*fraction = a / rr;
+		return true;
+	}
+
+	return false;
+}
+
+bool b2CapsuleShape::RayCast(b2RayCastOutput* output, const b2RayCastInput& input,
+							const b2Transform& transform, int32 childIndex) const
+{
+	B2_NOT_USED(childIndex);
+
+	// Put the ray into the capsule's frame of reference.
+	b2Vec2 p1 = b2MulT(transform.q, input.p1 - transform.p);
+	b2Vec2 p2 = b2MulT(transform.q, input.p2 - transform.p);
+	b2Vec2 d = p2 - p1;
+
+	b2Vec2 v1 = m_vertex1;
+	b2Vec2 v2 = m_vertex2;
+	b2Vec2 e = v2 - v1;
+	float length = e.Normalize();
+
+	// Rays that start inside do not hit.
+	float u = b2Clamp(b2Dot(p1 - v1, e), 0.0f, length);
+	if (b2DistanceSquared(p1, v1 + u * e) <= m_radius * m_radius)
+	{
+		return false;
+	}
+
+	// Does the ray enter through the side that faces its start?
+	b2Vec2 normal(e.y, -e.x);
+	float offset = b2Dot(normal, p1 - v1);
+	if (offset < 0.0f)
+	{
+		normal = -normal;
+		offset = -offset;
+	}
+
+	float denominator = b2Dot(normal, d);
+	if (offset > m_radius && denominator < 0.0f)
+	{
+		// dot(normal, p1 + t * d - v1) = radius
+		float t = (m_radius - offset) / denominator;
+		float s = b2Dot(p1 + t * d - v1, e);
+		if (0.0f <= s && s <= length)
+		{
+			if (t > input.maxFraction)
+			{
+				return false;
+			}
+
+			output->fraction = t;
+			output->normal = b2Mul(transform.q, normal);
+			return true;
+		}
+	}
+
+	// Otherwise the ray can only enter through a cap.
+	float fraction = input.maxFraction;
+	b2Vec2 center;
+	bool hit = false;
+	float t;
+	if (b2RayCastCap(&t, p1, d, v1, m_radius, fraction))
+	{
+		fraction = t;
+		center = v1;
+		hit = true;
+	}
+
+	if (b2RayCastCap(&t, p1, d, v2, m_radius, fraction))
+	{
+		fraction = t;
+		center = v2;
+		hit = true;
+	}
+
+	if (hit == false)
+	{
+		return false;
+	}
+
+	b2Vec2 n = p1 + fraction * d - center;
+	n.Normalize();
+	output->fraction = fraction;
+	output->normal = b2Mul(transform.q, n);
+	return true;
+}
+
+void b2CapsuleShape::ComputeAABB(b2AABB* aabb, const b2Transform& transform, int32 childIndex) const
+{
+	B2_NOT_USED(childIndex);
+
+	b2Vec2 v1 = b2Mul(transform, m_vertex1);
+	b2Vec2 v2 = b2Mul(transform, m_vertex2);
+
+	b2Vec2 r(m_radius, m_radius);
+	aabb->lowerBound = b2Min(v1, v2) - r;
+	aabb->upperBound = b2Max(v1, v2) + r;
+}
+
+void b2CapsuleShape::ComputeMass(b2MassData* massData, float density) const
+{
+	float rr = m_radius * m_radius;
+	float length = b2Distance(m_vertex1, m_vertex2);
+
+	// A box with a half circle on each end. Together the caps make a full circle.
+	float circleMass = density * b2_pi * rr;
+	float boxMass = density * 2.0f * m_radius * length;
+	massData->mass = circleMass + boxMass;
+	massData->center = 0.5f * (m_vertex1 + m_vertex2);
+
+	// Each half circle has its centroid lc from the end of the box. The parallel axis
+	// theorem moves it to the center of the box: m * ((h + lc)^2 - lc^2) = m * (h^2 + 2 * h * lc)
+	float lc = 4.0f * m_radius / (3.0f * b2_pi);
+	float h = 0.5f * length;
+	float circleInertia = circleMass * (0.5f * rr + h * h + 2.0f * h * lc);
+	float boxInertia = boxMass * (4.0f * rr + length * length) / 12.0f;
+
+	// Inertia about the local origin
+	massData->I = circleInertia + boxInertia + massData->mass * b2Dot(massData->center, massData->center);
+}
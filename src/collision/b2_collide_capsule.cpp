@@ -0,0 +1,544 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_collision.h"
+#include "box2d/b2_capsule_shape.h"
+#include "box2d/b2_circle_shape.h"
+#include "box2d/b2_edge_shape.h"
+#include "box2d/b2_polygon_shape.h"
+
+void b2CollideCapsuleAndCircle(b2Manifold* manifold,
+							const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+							const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+
+	// Compute circle in frame of capsule
+	b2Vec2 Q = b2MulT(xfA, b2Mul(xfB, circleB->m_p));
+
+	b2Vec2 A = capsuleA->m_vertex1, B = capsuleA->m_vertex2;
+	b2Vec2 e = B - A;
+
+	// Barycentric coordinates
+	float u = b2Dot(e, B - Q);
+	float v = b2Dot(e, Q - A);
+
+	float radius = capsuleA->m_radius + circleB->m_radius;
+
+	b2ContactFeature cf;
+	cf.indexB = 0;
+	cf.typeB = b2ContactFeature::e_vertex;
+
+	// Cap regions
+	if (v <= 0.0f || u <= 0.0f)
+	{
+		b2Vec2 P = v <= 0.0f ? A : B;
+		if (b2DistanceSquared(Q, P) > radius * radius)
+		{
+			return;
+		}
+
+		cf.indexA = v <= 0.0f ? 0 : 1;
+		cf.typeA = b2ContactFeature::e_vertex;
+		manifold->pointCount = 1;
+		manifold->type = b2Manifold::e_circles;
+		manifold->localNormal.SetZero();
+		manifold->localPoint = P;
+		manifold->points[0].id.key = 0;
+		manifold->points[0].id.cf = cf;
+		manifold->points[0].localPoint = circleB->m_p;
+		return;
+	}
+
+	// Side region
+	float den = b2Dot(e, e);
+	b2Assert(den > 0.0f);
+	b2Vec2 P = (1.0f / den) * (u * A + v * B);
+	if (b2DistanceSquared(Q, P) > radius * radius)
+	{
+		return;
+	}
+
+	b2Vec2 n(e.y, -e.x);
+	if (b2Dot(n, Q - A) < 0.0f)
+	{
+		n.Set(-n.x, -n.y);
+	}
+	n.Normalize();
+
+	cf.indexA = 0;
+	cf.typeA = b2ContactFeature::e_face;
+	manifold->pointCount = 1;
+	manifold->type = b2Manifold::e_faceA;
+	manifold->localNormal = n;
+	manifold->localPoint = A;
+	manifold->points[0].id.key = 0;
+	manifold->points[0].id.cf = cf;
+	manifold->points[0].localPoint = circleB->m_p;
+}
+
+// Find the closest points of the segments p1-q1 and p2-q2 at p1 + s * (q1 - p1) and p2 + t * (q2 - p2).
+// From Real-Time Collision Detection by Christer Ericson, section 5.1.9.
+static float b2SegmentDistanceSquared(float* s, float* t, b2Vec2* c1, b2Vec2* c2,
+									const b2Vec2& p1, const b2Vec2& q1, const b2Vec2& p2, const b2Vec2& q2)
+{
+	b2Vec2 d1 = q1 - p1;
+	b2Vec2 d2 = q2 - p2;
+	b2Vec2 r = p1 - p2;
+	float a = b2Dot(d1, d1);
+	float e = b2Dot(d2, d2);
+	float f = b2Dot(d2, r);
+
+	if (a <= b2_epsilon && e <= b2_epsilon)
+	{
+		*s = 0.0f;
+		*t = 0.0f;
+	}
+	else if (a <= b2_epsilon)
+	{
+		*s = 0.0f;
+		*t = b2Clamp(f / e, 0.0f, 1.0f);
+	}
+	else
+	{
+		float c = b2Dot(d1, r);
+		if (e <= b2_epsilon)
+		{
+			*t = 0.0f;
+			*s = b2Clamp(-c / a, 0.0f, 1.0f);
+		}
+		else
+		{
+			// Parallel segments use s = 0.
+			float b = b2Dot(d1, d2);
+			float denom = a * e - b * b;
+			*s = denom != 0.0f ? b2Clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+			*t = (b * *s + f) / e;
+
+			if (*t < 0.0f)
+			{
+				*t = 0.0f;
+				*s = b2Clamp(-c / a, 0.0f, 1.0f);
+			}
+			else if (*t > 1.0f)
+			{
+				*t = 1.0f;
+				*s = b2Clamp((b - c) / a, 0.0f, 1.0f);
+			}
+		}
+	}
+
+	*c1 = p1 + *s * d1;
+	*c2 = p2 + *t * d2;
+	return b2DistanceSquared(*c1, *c2);
+}
+
+// Clip the incident segment q1-q2 to the sides of the reference segment v1-v2 and add the
+// points within the radius to the manifold. Everything is in the frame of the reference
+// segment and xf takes the incident frame to this frame. The vertex indices are used for
+// the feature ids, which are flipped if the reference is shape B.
+static int32 b2ClipCapsuleSegment(b2Manifold* manifold, const b2Vec2& v1, const b2Vec2& v2, const b2Vec2& normal,
+								int32 i1, int32 i2, const b2Vec2& q1, const b2Vec2& q2, int32 j1, int32 j2,
+								const b2Transform& xf, float radius, bool flip)
+{
+	b2Vec2 tangent = v2 - v1;
+	tangent.Normalize();
+
+	b2ClipVertex incidentEdge[2];
+	incidentEdge[0].v = q1;
+	incidentEdge[0].id.cf.indexA = static_cast<uint8>(i1);
+	incidentEdge[0].id.cf.indexB = static_cast<uint8>(j1);
+	incidentEdge[0].id.cf.typeA = b2ContactFeature::e_face;
+	incidentEdge[0].id.cf.typeB = b2ContactFeature::e_vertex;
+	incidentEdge[1].v = q2;
+	incidentEdge[1].id.cf.indexA = static_cast<uint8>(i1);
+	incidentEdge[1].id.cf.indexB = static_cast<uint8>(j2);
+	incidentEdge[1].id.cf.typeA = b2ContactFeature::e_face;
+	incidentEdge[1].id.cf.typeB = b2ContactFeature::e_vertex;
+
+	b2ClipVertex clipPoints1[2];
+	b2ClipVertex clipPoints2[2];
+	int32 np = b2ClipSegmentToLine(clipPoints1, incidentEdge, -tangent, -b2Dot(tangent, v1), i1);
+	if (np < 2)
+	{
+		return 0;
+	}
+
+	np = b2ClipSegmentToLine(clipPoints2, clipPoints1, tangent, b2Dot(tangent, v2), i2);
+	if (np < 2)
+	{
+		return 0;
+	}
+
+	int32 pointCount = 0;
+	for (int32 i = 0; i < b2_maxManifoldPoints; ++i)
+	{
+		float separation = b2Dot(normal, clipPoints2[i].v - v1);
+		if (separation <= radius)
+		{
+			b2ManifoldPoint* cp = manifold->points + pointCount;
+			cp->localPoint = b2MulT(xf, clipPoints2[i].v);
+			cp->id = clipPoints2[i].id;
+			if (flip)
+			{
+				b2ContactFeature cf = cp->id.cf;
+				cp->id.cf.indexA = cf.indexB;
+				cp->id.cf.indexB = cf.indexA;
+				cp->id.cf.typeA = cf.typeB;
+				cp->id.cf.typeB = cf.typeA;
+			}
+			++pointCount;
+		}
+	}
+
+	return pointCount;
+}
+
+// Collide the segment v1-v2 of shape A with capsule B. Shape A is a capsule or an edge. If the
+// edge is one-sided it is passed for its adjacent vertices.
+static void b2CollideSegmentAndCapsule(b2Manifold* manifold, const b2Vec2& v1, const b2Vec2& v2, float radiusA,
+									const b2EdgeShape* oneSidedEdge, const b2CapsuleShape* capsuleB,
+									const b2Transform& xfA, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+
+	// Compute capsule B in frame A
+	b2Transform xf = b2MulT(xfA, xfB);
+	b2Vec2 q1 = b2Mul(xf, capsuleB->m_vertex1);
+	b2Vec2 q2 = b2Mul(xf, capsuleB->m_vertex2);
+
+	b2Vec2 edge1 = v2 - v1;
+	edge1.Normalize();
+
+	// Normal points to the right for a CCW winding
+	b2Vec2 normal1(edge1.y, -edge1.x);
+	b2Vec2 centerB = 0.5f * (q1 + q2);
+	if (oneSidedEdge != nullptr && b2Dot(normal1, centerB - v1) < 0.0f)
+	{
+		return;
+	}
+
+	float s, t;
+	b2Vec2 c1, c2;
+	float distanceSquared = b2SegmentDistanceSquared(&s, &t, &c1, &c2, v1, v2, q1, q2);
+	float radius = radiusA + capsuleB->m_radius;
+	if (distanceSquared > radius * radius)
+	{
+		return;
+	}
+
+	// The closest points pick the reference: a side of A, a side of B, or the caps. Nearly
+	// parallel segments that overlap always use side A. Otherwise the reference would flip
+	// between the sides as the bodies rock, which loses the warm starting.
+	enum
+	{
+		e_sideA,
+		e_sideB,
+		e_caps
+	} reference;
+
+	b2Vec2 edge2 = q2 - q1;
+	edge2.Normalize();
+
+	const float sinTol = 0.1f;
+	float length1 = b2Dot(v2 - v1, edge1);
+	float u1 = b2Dot(q1 - v1, edge1);
+	float u2 = b2Dot(q2 - v1, edge1);
+	bool parallel = b2Abs(b2Cross(edge1, edge2)) < sinTol && b2Max(u1, u2) > 0.0f && b2Min(u1, u2) < length1;
+
+	// Contact normal from A to B
+	b2Vec2 normal;
+	if (parallel || (0.0f < s && s < 1.0f))
+	{
+		reference = e_sideA;
+		b2Vec2 d = distanceSquared > b2_epsilon * b2_epsilon ? c2 - c1 : centerB - v1;
+		normal = b2Dot(normal1, d) < 0.0f && oneSidedEdge == nullptr ? -normal1 : normal1;
+	}
+	else if (0.0f < t && t < 1.0f)
+	{
+		reference = e_sideB;
+		normal.Set(edge2.y, -edge2.x);
+		b2Vec2 d = distanceSquared > b2_epsilon * b2_epsilon ? c2 - c1 : centerB - 0.5f * (v1 + v2);
+		if (b2Dot(normal, d) < 0.0f)
+		{
+			normal = -normal;
+		}
+	}
+	else
+	{
+		reference = e_caps;
+		if (distanceSquared > b2_epsilon * b2_epsilon)
+		{
+			normal = c2 - c1;
+			normal.Normalize();
+		}
+		else
+		{
+			normal = b2Dot(normal1, centerB - v1) < 0.0f ? -normal1 : normal1;
+		}
+	}
+
+	if (oneSidedEdge != nullptr)
+	{
+		// Smooth collision, as in b2CollideEdgeAndPolygon.
+		b2Vec2 edge0 = v1 - oneSidedEdge->m_vertex0;
+		edge0.Normalize();
+		b2Vec2 normal0(edge0.y, -edge0.x);
+		bool convex1 = b2Cross(edge0, edge1) >= 0.0f;
+
+		b2Vec2 edge3 = oneSidedEdge->m_vertex3 - v2;
+		edge3.Normalize();
+		b2Vec2 normal2(edge3.y, -edge3.x);
+		bool convex2 = b2Cross(edge1, edge3) >= 0.0f;
+
+		bool side1 = b2Dot(normal, edge1) <= 0.0f;
+		bool convex = side1 ? convex1 : convex2;
+		if (convex)
+		{
+			if ((side1 && b2Cross(normal, normal0) > sinTol) || (side1 == false && b2Cross(normal2, normal) > sinTol))
+			{
+				// Skip region
+				return;
+			}
+		}
+		else
+		{
+			// Snap region
+			reference = e_sideA;
+			normal = normal1;
+		}
+	}
+
+	if (reference == e_sideA)
+	{
+		int32 pointCount = b2ClipCapsuleSegment(manifold, v1, v2, normal, 0, 1, q1, q2, 0, 1, xf, radius, false);
+		if (pointCount > 0)
+		{
+			manifold->type = b2Manifold::e_faceA;
+			manifold->localNormal = normal;
+			manifold->localPoint = v1;
+			manifold->pointCount = pointCount;
+			return;
+		}
+	}
+	else if (reference == e_sideB)
+	{
+		// Clip in frame B. The reference normal points from B to A.
+		b2Transform xfBA = b2MulT(xfB, xfA);
+		b2Vec2 normalB = -b2MulT(xf.q, normal);
+		int32 pointCount = b2ClipCapsuleSegment(manifold, capsuleB->m_vertex1, capsuleB->m_vertex2, normalB, 0, 1,
+												b2Mul(xfBA, v1), b2Mul(xfBA, v2), 0, 1, xfBA, radius, true);
+		if (pointCount > 0)
+		{
+			manifold->type = b2Manifold::e_faceB;
+			manifold->localNormal = normalB;
+			manifold->localPoint = capsuleB->m_vertex1;
+			manifold->pointCount = pointCount;
+			return;
+		}
+	}
+
+	// A single point between the closest points.
+	b2ContactFeature cf;
+	cf.indexA = s < 0.5f ? 0 : 1;
+	cf.indexB = t < 0.5f ? 0 : 1;
+	cf.typeA = b2ContactFeature::e_vertex;
+	cf.typeB = b2ContactFeature::e_vertex;
+	manifold->type = b2Manifold::e_faceA;
+	manifold->localNormal = normal;
+	manifold->localPoint = c1;
+	manifold->pointCount = 1;
+	manifold->points[0].localPoint = b2MulT(xf, c2);
+	manifold->points[0].id.key = 0;
+	manifold->points[0].id.cf = cf;
+}
+
+void b2CollideCapsules(b2Manifold* manifold,
+					const b2CapsuleShape* capsuleA, const b2Transform& xfA,
+					const b2CapsuleShape* capsuleB, const b2Transform& xfB)
+{
+	b2CollideSegmentAndCapsule(manifold, capsuleA->m_vertex1, capsuleA->m_vertex2, capsuleA->m_radius,
+							nullptr, capsuleB, xfA, xfB);
+}
+
+void b2CollideEdgeAndCapsule(b2Manifold* manifold,
+							const b2EdgeShape* edgeA, const b2Transform& xfA,
+							const b2CapsuleShape* capsuleB, const b2Transform& xfB)
+{
+	b2CollideSegmentAndCapsule(manifold, edgeA->m_vertex1, edgeA->m_vertex2, edgeA->m_radius,
+							edgeA->m_oneSided ? edgeA : nullptr, capsuleB, xfA, xfB);
+}
+
+void b2CollidePolygonAndCapsule(b2Manifold* manifold,
+							const b2PolygonShape* polygonA, const b2Transform& xfA,
+							const b2CapsuleShape* capsuleB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+
+	// Compute the capsule segment in frame A
+	b2Transform xf = b2MulT(xfA, xfB);
+	b2Vec2 q1 = b2Mul(xf, capsuleB->m_vertex1);
+	b2Vec2 q2 = b2Mul(xf, capsuleB->m_vertex2);
+
+	float radius = polygonA->m_radius + capsuleB->m_radius;
+	int32 count = polygonA->m_count;
+	const b2Vec2* vertices = polygonA->m_vertices;
+	const b2Vec2* normals = polygonA->m_normals;
+
+	// Find the polygon face with the largest separation from the segment.
+	int32 edgeA = 0;
+	float separationA = -b2_maxFloat;
+	for (int32 i = 0; i < count; ++i)
+	{
+		float si = b2Min(b2Dot(normals[i], q1 - vertices[i]), b2Dot(normals[i], q2 - vertices[i]));
+		if (si > separationA)
+		{
+			separationA = si;
+			edgeA = i;
+		}
+	}
+
+	if (separationA > radius)
+	{
+		return;
+	}
+
+	// Find the capsule side with the largest separation from the polygon.
+	b2Vec2 edgeB = q2 - q1;
+	edgeB.Normalize();
+	b2Vec2 normalB(edgeB.y, -edgeB.x);
+	float lower = b2_maxFloat;
+	float upper = -b2_maxFloat;
+	for (int32 i = 0; i < count; ++i)
+	{
+		float d = b2Dot(normalB, vertices[i] - q1);
+		lower = b2Min(lower, d);
+		upper = b2Max(upper, d);
+	}
+
+	// The side normal points from the capsule to the polygon.
+	float separationB = lower;
+	if (-upper > lower)
+	{
+		separationB = -upper;
+		normalB = -normalB;
+	}
+
+	if (separationB > radius)
+	{
+		return;
+	}
+
+	// Prefer the polygon face, as in b2CollidePolygons.
+	const float k_tol = 0.1f * b2_linearSlop;
+	bool flip = separationB > separationA + k_tol;
+
+	// The reference and incident segments in frame A. The incident edge of the polygon is
+	// the most anti-parallel to the capsule side.
+	b2Vec2 v1, v2, w1, w2;
+	int32 i1, i2;
+	if (flip)
+	{
+		i1 = 0;
+		float minDot = b2_maxFloat;
+		for (int32 i = 0; i < count; ++i)
+		{
+			float d = b2Dot(normalB, normals[i]);
+			if (d < minDot)
+			{
+				minDot = d;
+				i1 = i;
+			}
+		}
+
+		i2 = i1 + 1 < count ? i1 + 1 : 0;
+		v1 = q1;
+		v2 = q2;
+		w1 = vertices[i1];
+		w2 = vertices[i2];
+	}
+	else
+	{
+		i1 = edgeA;
+		i2 = i1 + 1 < count ? i1 + 1 : 0;
+		v1 = vertices[i1];
+		v2 = vertices[i2];
+		w1 = q1;
+		w2 = q2;
+	}
+
+	// When the cores are apart, a polygon vertex against a cap is not on any of the axes
+	// above. The closest points of the segments give its normal.
+	float separation = b2Max(separationA, separationB);
+	if (separation > k_tol)
+	{
+		float s, t;
+		b2Vec2 c1, c2;
+		float distanceSquared = b2SegmentDistanceSquared(&s, &t, &c1, &c2, v1, v2, w1, w2);
+		if ((s == 0.0f || s == 1.0f) && (t == 0.0f || t == 1.0f))
+		{
+			if (distanceSquared > radius * radius)
+			{
+				return;
+			}
+
+			b2Vec2 pointA = flip ? c2 : c1;
+			b2Vec2 pointB = flip ? c1 : c2;
+			b2Vec2 normal = pointB - pointA;
+			normal.Normalize();
+
+			b2ContactFeature cf;
+			cf.indexA = static_cast<uint8>(flip ? (t == 0.0f ? i1 : i2) : (s == 0.0f ? i1 : i2));
+			cf.indexB = static_cast<uint8>(flip ? (s == 0.0f ? 0 : 1) : (t == 0.0f ? 0 : 1));
+			cf.typeA = b2ContactFeature::e_vertex;
+			cf.typeB = b2ContactFeature::e_vertex;
+			manifold->type = b2Manifold::e_faceA;
+			manifold->localNormal = normal;
+			manifold->localPoint = pointA;
+			manifold->pointCount = 1;
+			manifold->points[0].localPoint = b2MulT(xf, pointB);
+			manifold->points[0].id.key = 0;
+			manifold->points[0].id.cf = cf;
+			return;
+		}
+	}
+
+	if (flip)
+	{
+		// Clip the polygon edge to the capsule side in frame A, then move the side to frame B.
+		b2Transform identity;
+		identity.SetIdentity();
+		int32 pointCount = b2ClipCapsuleSegment(manifold, v1, v2, normalB, 0, 1, w1, w2, i1, i2, identity, radius, true);
+		manifold->type = b2Manifold::e_faceB;
+		manifold->localNormal = b2MulT(xf.q, normalB);
+		manifold->localPoint = capsuleB->m_vertex1;
+		manifold->pointCount = pointCount;
+	}
+	else
+	{
+		int32 pointCount = b2ClipCapsuleSegment(manifold, v1, v2, normals[i1], i1, i2, w1, w2, 0, 1, xf, radius, false);
+		manifold->type = b2Manifold::e_faceA;
+		manifold->localNormal = normals[i1];
+		manifold->localPoint = v1;
+		manifold->pointCount = pointCount;
+	}
+}
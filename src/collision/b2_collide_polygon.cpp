@@ -23,6 +23,104 @@
 #include "box2d/b2_collision.h"
 #include "box2d/b2_polygon_shape.h"
 
+#if !defined(B2_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+
+#include <emmintrin.h>
+
+// The number of lanes needed for the edges of any polygon.
+#define b2_polygonLanes ((b2_maxPolygonVertices + 3) & ~3)
+
+// Find the max separation between poly1 and poly2 using edge normals from poly1.
+// Each lane holds one edge of poly1, so four edges are tested against every vertex of
+// poly2 at once. The lanes do the same float operations in the same order as the scalar
+// version, so the separation and the edge index are bit-identical.
+static float b2FindMaxSeparation(int32* edgeIndex,
+								 const b2PolygonShape* poly1, const b2Transform& xf1,
+								 const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+	int32 count1 = poly1->m_count;
+	int32 count2 = poly2->m_count;
+	const b2Vec2* n1s = poly1->m_normals;
+	const b2Vec2* v1s = poly1->m_vertices;
+	const b2Vec2* v2s = poly2->m_vertices;
+	b2Transform xf = b2MulT(xf2, xf1);
+
+	__m128 c = _mm_set1_ps(xf.q.c);
+	__m128 s = _mm_set1_ps(xf.q.s);
+	__m128 px = _mm_set1_ps(xf.p.x);
+	__m128 py = _mm_set1_ps(xf.p.y);
+
+	float separations[b2_polygonLanes];
+	for (int32 i = 0; i < count1; i += 4)
+	{
+		// Transpose four edges of poly1 into lanes. A partial block repeats the last
+		// edge, so no lane reads past the polygon's count.
+		__m128 n1x, n1y, v1x, v1y;
+		if (i + 4 <= count1)
+		{
+			__m128 n01 = _mm_loadu_ps(&n1s[i].x);
+			__m128 n23 = _mm_loadu_ps(&n1s[i + 2].x);
+			__m128 v01 = _mm_loadu_ps(&v1s[i].x);
+			__m128 v23 = _mm_loadu_ps(&v1s[i + 2].x);
+			n1x = _mm_shuffle_ps(n01, n23, _MM_SHUFFLE(2, 0, 2, 0));
+			n1y = _mm_shuffle_ps(n01, n23, _MM_SHUFFLE(3, 1, 3, 1));
+			v1x = _mm_shuffle_ps(v01, v23, _MM_SHUFFLE(2, 0, 2, 0));
+			v1y = _mm_shuffle_ps(v01, v23, _MM_SHUFFLE(3, 1, 3, 1));
+		}
+		else
+		{
+			float nx[4], ny[4], vx[4], vy[4];
+			for (int32 k = 0; k < 4; ++k)
+			{
+				int32 index = b2Min(i + k, count1 - 1);
+				nx[k] = n1s[index].x;
+				ny[k] = n1s[index].y;
+				vx[k] = v1s[index].x;
+				vy[k] = v1s[index].y;
+			}
+			n1x = _mm_loadu_ps(nx);
+			n1y = _mm_loadu_ps(ny);
+			v1x = _mm_loadu_ps(vx);
+			v1y = _mm_loadu_ps(vy);
+		}
+
+		// Get poly1 normals and vertices in frame2, see b2Mul.
+		__m128 nX = _mm_sub_ps(_mm_mul_ps(c, n1x), _mm_mul_ps(s, n1y));
+		__m128 nY = _mm_add_ps(_mm_mul_ps(s, n1x), _mm_mul_ps(c, n1y));
+		__m128 v1X = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, v1x), _mm_mul_ps(s, v1y)), px);
+		__m128 v1Y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, v1x), _mm_mul_ps(c, v1y)), py);
+
+		// Find the deepest point for each normal. min(a, b) returns b unless a < b,
+		// which keeps the first of equal separations like the scalar loop.
+		__m128 si = _mm_set1_ps(b2_maxFloat);
+		for (int32 j = 0; j < count2; ++j)
+		{
+			__m128 dx = _mm_sub_ps(_mm_set1_ps(v2s[j].x), v1X);
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(v2s[j].y), v1Y);
+			__m128 sij = _mm_add_ps(_mm_mul_ps(nX, dx), _mm_mul_ps(nY, dy));
+			si = _mm_min_ps(sij, si);
+		}
+
+		_mm_storeu_ps(separations + i, si);
+	}
+
+	int32 bestIndex = 0;
+	float maxSeparation = -b2_maxFloat;
+	for (int32 i = 0; i < count1; ++i)
+	{
+		if (separations[i] > maxSeparation)
+		{
+			maxSeparation = separations[i];
+			bestIndex = i;
+		}
+	}
+
+	*edgeIndex = bestIndex;
+	return maxSeparation;
+}
+
+#else
+
 // Find the max separation between poly1 and poly2 using edge normals from poly1.
 static float b2FindMaxSeparation(int32* edgeIndex,
 								 const b2PolygonShape* poly1, const b2Transform& xf1,
@@ -65,6 +163,8 @@ static float b2FindMaxSeparation(int32* edgeIndex,
 	return maxSeparation;
 }
 
+#endif
+
 static void b2FindIncidentEdge(b2ClipVertex c[2],
 							 const b2PolygonShape* poly1, const b2Transform& xf1, int32 edge1,
 							 const b2PolygonShape* poly2, const b2Transform& xf2)
@@ -0,0 +1,410 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_compact_tree.h"
+#include "box2d/b2_dynamic_tree.h"
+#include "b2_wide_node.h"
+
+// The decoded bounds of the children of a compact node.
+struct b2CompactBounds
+{
+	float lowerX[4];
+	float lowerY[4];
+	float upperX[4];
+	float upperY[4];
+};
+
+static inline b2Vec2 b2QuantizeScale(const b2AABB& box)
+{
+	return (1.0f / 65535.0f) * (box.upperBound - box.lowerBound);
+}
+
+#if !defined(B2_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+
+#include <emmintrin.h>
+
+static inline __m128 b2LoadSteps(const uint16* steps)
+{
+	__m128i q = _mm_loadl_epi64((const __m128i*)steps);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, _mm_setzero_si128()));
+}
+
+// The build checks its rounding with this function, so the queries must decode with it
+// as well.
+static inline void b2DecodeBounds(const b2CompactNode* node, const b2AABB& box, b2CompactBounds* bounds)
+{
+	b2Vec2 scale = b2QuantizeScale(box);
+	__m128 scaleX = _mm_set1_ps(scale.x);
+	__m128 scaleY = _mm_set1_ps(scale.y);
+
+	_mm_storeu_ps(bounds->lowerX, _mm_add_ps(_mm_set1_ps(box.lowerBound.x), _mm_mul_ps(scaleX, b2LoadSteps(node->lowerX))));
+	_mm_storeu_ps(bounds->lowerY, _mm_add_ps(_mm_set1_ps(box.lowerBound.y), _mm_mul_ps(scaleY, b2LoadSteps(node->lowerY))));
+	_mm_storeu_ps(bounds->upperX, _mm_sub_ps(_mm_set1_ps(box.upperBound.x), _mm_mul_ps(scaleX, b2LoadSteps(node->upperX))));
+	_mm_storeu_ps(bounds->upperY, _mm_sub_ps(_mm_set1_ps(box.upperBound.y), _mm_mul_ps(scaleY, b2LoadSteps(node->upperY))));
+}
+
+#else
+
+static inline void b2DecodeBounds(const b2CompactNode* node, const b2AABB& box, b2CompactBounds* bounds)
+{
+	b2Vec2 scale = b2QuantizeScale(box);
+	for (int32 i = 0; i < 4; ++i)
+	{
+		bounds->lowerX[i] = box.lowerBound.x + scale.x * float(node->lowerX[i]);
+		bounds->lowerY[i] = box.lowerBound.y + scale.y * float(node->lowerY[i]);
+		bounds->upperX[i] = box.upperBound.x - scale.x * float(node->upperX[i]);
+		bounds->upperY[i] = box.upperBound.y - scale.y * float(node->upperY[i]);
+	}
+}
+
+#endif
+
+// Steps up from lower that stay at or below value, rounded toward zero. The build steps
+// down further if decoding rounds the other way. Zero steps decode to lower exactly.
+static inline uint16 b2QuantizeLower(float lower, float scale, float value)
+{
+	if (scale <= 0.0f)
+	{
+		return 0;
+	}
+
+	return uint16(b2Clamp((value - lower) / scale, 0.0f, 65535.0f));
+}
+
+// Steps down from upper that stay at or above value.
+static inline uint16 b2QuantizeUpper(float upper, float scale, float value)
+{
+	if (scale <= 0.0f)
+	{
+		return 0;
+	}
+
+	return uint16(b2Clamp((upper - value) / scale, 0.0f, 65535.0f));
+}
+
+static inline void b2GetChildBounds(const b2CompactBounds* bounds, int32 index, b2AABB* aabb)
+{
+	aabb->lowerBound.Set(bounds->lowerX[index], bounds->lowerY[index]);
+	aabb->upperBound.Set(bounds->upperX[index], bounds->upperY[index]);
+}
+
+// The exact test of a proxy against a segment. See b2DynamicTree::RayCast.
+static inline bool b2TestSegment(const b2AABB& aabb, const b2AABB& segmentAABB, const b2Vec2& p1, const b2Vec2& v, const b2Vec2& absV)
+{
+	if (b2TestOverlap(aabb, segmentAABB) == false)
+	{
+		return false;
+	}
+
+	// |dot(v, p1 - c)| <= dot(|v|, h)
+	b2Vec2 c = aabb.GetCenter();
+	b2Vec2 h = aabb.GetExtents();
+	return b2Abs(b2Dot(v, p1 - c)) <= b2Dot(absV, h);
+}
+
+// A binary node waiting to become a compact node with the decoded bounds of that node.
+struct b2CompactBuildItem
+{
+	int32 treeNode;
+	int32 compactNode;
+	b2AABB box;
+};
+
+// A compact node to visit with its decoded bounds.
+struct b2CompactStackItem
+{
+	int32 node;
+	b2AABB box;
+};
+
+b2CompactTree::b2CompactTree()
+{
+	m_tree = nullptr;
+	m_nodes = nullptr;
+	m_nodeCount = 0;
+	m_nodeCapacity = 0;
+}
+
+b2CompactTree::~b2CompactTree()
+{
+	b2Free(m_nodes);
+}
+
+void b2CompactTree::Build(const b2DynamicTree* tree)
+{
+	m_tree = tree;
+	m_nodeCount = 0;
+	if (tree->m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	// Each compact node replaces at least one binary internal node, except for a leaf root.
+	int32 capacity = b2Max(tree->m_nodeCount / 2 + 1, 1);
+	if (capacity > m_nodeCapacity)
+	{
+		b2Free(m_nodes);
+		m_nodeCapacity = capacity;
+		m_nodes = (b2CompactNode*)b2Alloc(m_nodeCapacity * sizeof(b2CompactNode));
+	}
+
+	const b2TreeNode* nodes = tree->m_nodes;
+	m_rootAABB = nodes[tree->m_root].aabb;
+
+	b2GrowableStack<b2CompactBuildItem, 64> stack;
+	b2CompactBuildItem root;
+	root.treeNode = tree->m_root;
+	root.compactNode = m_nodeCount++;
+	root.box = m_rootAABB;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2CompactBuildItem item = stack.Pop();
+
+		int32 children[4];
+		int32 childCount = b2CollapseWideNode(nodes, item.treeNode, children);
+
+		b2CompactNode* compact = m_nodes + item.compactNode;
+		compact->leafMask = 0;
+		compact->childCount = uint16(childCount);
+
+		b2Vec2 scale = b2QuantizeScale(item.box);
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if (i >= childCount)
+			{
+				compact->lowerX[i] = 0;
+				compact->lowerY[i] = 0;
+				compact->upperX[i] = 0;
+				compact->upperY[i] = 0;
+				compact->children[i] = b2_nullNode;
+				continue;
+			}
+
+			const b2AABB& aabb = nodes[children[i]].aabb;
+			compact->lowerX[i] = b2QuantizeLower(item.box.lowerBound.x, scale.x, aabb.lowerBound.x);
+			compact->lowerY[i] = b2QuantizeLower(item.box.lowerBound.y, scale.y, aabb.lowerBound.y);
+			compact->upperX[i] = b2QuantizeUpper(item.box.upperBound.x, scale.x, aabb.upperBound.x);
+			compact->upperY[i] = b2QuantizeUpper(item.box.upperBound.y, scale.y, aabb.upperBound.y);
+		}
+
+		// Step outward until every decoded child contains its source node. This ends,
+		// because zero steps decode to the bounds of this node.
+		b2CompactBounds bounds;
+		bool contained = false;
+		while (contained == false)
+		{
+			b2DecodeBounds(compact, item.box, &bounds);
+			contained = true;
+			for (int32 i = 0; i < childCount; ++i)
+			{
+				const b2AABB& aabb = nodes[children[i]].aabb;
+				if (bounds.lowerX[i] > aabb.lowerBound.x)
+				{
+					--compact->lowerX[i];
+					contained = false;
+				}
+				if (bounds.lowerY[i] > aabb.lowerBound.y)
+				{
+					--compact->lowerY[i];
+					contained = false;
+				}
+				if (bounds.upperX[i] < aabb.upperBound.x)
+				{
+					--compact->upperX[i];
+					contained = false;
+				}
+				if (bounds.upperY[i] < aabb.upperBound.y)
+				{
+					--compact->upperY[i];
+					contained = false;
+				}
+			}
+		}
+
+		for (int32 i = 0; i < childCount; ++i)
+		{
+			const b2TreeNode* child = nodes + children[i];
+			if (child->IsLeaf())
+			{
+				compact->children[i] = children[i];
+				compact->leafMask |= 1 << i;
+			}
+			else
+			{
+				b2Assert(m_nodeCount < m_nodeCapacity);
+				b2CompactBuildItem childItem;
+				childItem.treeNode = children[i];
+				childItem.compactNode = m_nodeCount++;
+				b2GetChildBounds(&bounds, i, &childItem.box);
+				compact->children[i] = childItem.compactNode;
+				stack.Push(childItem);
+			}
+		}
+	}
+}
+
+void b2CompactTree::Query(QueryFcn* fcn, void* context, const b2AABB& aabb) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	const b2TreeNode* sourceNodes = m_tree->m_nodes;
+
+	b2GrowableStack<b2CompactStackItem, 256> stack;
+	b2CompactStackItem root;
+	root.node = 0;
+	root.box = m_rootAABB;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2CompactStackItem item = stack.Pop();
+		const b2CompactNode* node = m_nodes + item.node;
+
+		b2CompactBounds bounds;
+		b2DecodeBounds(node, item.box, &bounds);
+		int32 mask = b2OverlapMask(&bounds, aabb) & ((1 << node->childCount) - 1);
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if ((mask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			if ((node->leafMask & (1 << i)) == 0)
+			{
+				b2CompactStackItem child;
+				child.node = node->children[i];
+				b2GetChildBounds(&bounds, i, &child.box);
+				stack.Push(child);
+				continue;
+			}
+
+			// The exact test. The callback most likely reads the user data from the same
+			// source node.
+			int32 proxyId = node->children[i];
+			if (b2TestOverlap(sourceNodes[proxyId].aabb, aabb))
+			{
+				bool proceed = fcn(context, proxyId);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+		}
+	}
+}
+
+void b2CompactTree::RayCast(RayCastFcn* fcn, void* context, const b2RayCastInput& input) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 absV = b2Abs(v);
+
+	float maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	const b2TreeNode* sourceNodes = m_tree->m_nodes;
+
+	b2GrowableStack<b2CompactStackItem, 256> stack;
+	b2CompactStackItem root;
+	root.node = 0;
+	root.box = m_rootAABB;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2CompactStackItem item = stack.Pop();
+		const b2CompactNode* node = m_nodes + item.node;
+
+		b2CompactBounds bounds;
+		b2DecodeBounds(node, item.box, &bounds);
+		int32 mask = b2OverlapMask(&bounds, segmentAABB) & b2SegmentMask(&bounds, p1, v, absV) & ((1 << node->childCount) - 1);
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if ((mask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			if ((node->leafMask & (1 << i)) == 0)
+			{
+				b2CompactStackItem child;
+				child.node = node->children[i];
+				b2GetChildBounds(&bounds, i, &child.box);
+				stack.Push(child);
+				continue;
+			}
+
+			// The exact test, which also catches a segment clipped by an earlier child.
+			int32 proxyId = node->children[i];
+			if (b2TestSegment(sourceNodes[proxyId].aabb, segmentAABB, p1, v, absV) == false)
+			{
+				continue;
+			}
+
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			float value = fcn(context, subInput, proxyId);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentAABB.lowerBound = b2Min(p1, t);
+				segmentAABB.upperBound = b2Max(p1, t);
+			}
+		}
+	}
+}
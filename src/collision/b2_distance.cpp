@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "box2d/b2_capsule_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_distance.h"
 #include "box2d/b2_edge_shape.h"
@@ -27,7 +28,9 @@
 #include "box2d/b2_polygon_shape.h"
 
 // GJK using Voronoi regions (Christer Ericson) and Barycentric coordinates.
-B2_API int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
+
+// Debugging statistics.
+B2_API std::atomic<int32> b2_gjkCalls(0), b2_gjkIters(0), b2_gjkMaxIters(0);
 
 void b2DistanceProxy::Set(const b2Shape* shape, int32 index)
 {
@@ -81,6 +84,15 @@ void b2DistanceProxy::Set(const b2Shape* shape, int32 index)
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			const b2CapsuleShape* capsule = static_cast<const b2CapsuleShape*>(shape);
+			m_vertices = &capsule->m_vertex1;
+			m_count = 2;
+			m_radius = capsule->m_radius;
+		}
+		break;
+
 	default:
 		b2Assert(false);
 	}
@@ -455,8 +467,6 @@ void b2Distance(b2DistanceOutput* output,
 				b2SimplexCache* cache,
 				const b2DistanceInput* input)
 {
-	++b2_gjkCalls;
-
 	const b2DistanceProxy* proxyA = &input->proxyA;
 	const b2DistanceProxy* proxyB = &input->proxyB;
 
@@ -536,7 +546,6 @@ void b2Distance(b2DistanceOutput* output,
 
 		// Iteration count is equated to the number of support point calls.
 		++iter;
-		++b2_gjkIters;
 
 		// Check for duplicate support points. This is the main termination criteria.
 		bool duplicate = false;
@@ -559,7 +568,10 @@ void b2Distance(b2DistanceOutput* output,
 		++simplex.m_count;
 	}
 
-	b2_gjkMaxIters = b2Max(b2_gjkMaxIters, iter);
+	// Queries may run b2Distance on several threads at once.
+	b2_gjkCalls.fetch_add(1, std::memory_order_relaxed);
+	b2_gjkIters.fetch_add(iter, std::memory_order_relaxed);
+	b2AtomicMax(b2_gjkMaxIters, iter);
 
 	// Prepare output.
 	simplex.GetWitnessPoints(&output->pointA, &output->pointB);
@@ -42,6 +42,8 @@ b2DynamicTree::b2DynamicTree()
 	m_freeList = 0;
 
 	m_insertionCount = 0;
+	m_moveCount = 0;
+	m_refitMode = false;
 }
 
 b2DynamicTree::~b2DynamicTree()
@@ -86,6 +88,7 @@ int32 b2DynamicTree::AllocateNode()
 	m_nodes[nodeId].height = 0;
 	m_nodes[nodeId].userData = nullptr;
 	m_nodes[nodeId].moved = false;
+	m_nodes[nodeId].enlarged = false;
 	++m_nodeCount;
 	return nodeId;
 }
@@ -106,6 +109,9 @@ void b2DynamicTree::FreeNode(int32 nodeId)
 // the node pool.
 int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 {
+	// Insertion rotates nodes, so finish any refit first.
+	Refit();
+
 	int32 proxyId = AllocateNode();
 
 	// Fatten the aabb.
@@ -126,72 +132,141 @@ void b2DynamicTree::DestroyProxy(int32 proxyId)
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 	b2Assert(m_nodes[proxyId].IsLeaf());
 
+	Refit();
+
 	RemoveLeaf(proxyId);
 	FreeNode(proxyId);
 }
 
-bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement, const b2Vec2& margin)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 
 	b2Assert(m_nodes[proxyId].IsLeaf());
 
-	// Extend AABB
-	b2AABB fatAABB;
-	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
-	fatAABB.lowerBound = aabb.lowerBound - r;
-	fatAABB.upperBound = aabb.upperBound + r;
-
-	// Predict AABB movement
-	b2Vec2 d = b2_aabbMultiplier * displacement;
-
-	if (d.x < 0.0f)
-	{
-		fatAABB.lowerBound.x += d.x;
-	}
-	else
+	b2AABB fatAABB = m_nodes[proxyId].aabb;
+	if (b2UpdateFatAABB(&fatAABB, aabb, displacement, margin) == false)
 	{
-		fatAABB.upperBound.x += d.x;
+		// No tree update needed.
+		return false;
 	}
 
-	if (d.y < 0.0f)
+	++m_moveCount;
+	m_nodes[proxyId].moved = true;
+
+	if (m_refitMode)
 	{
-		fatAABB.lowerBound.y += d.y;
+		// Update the leaf in place and grow the ancestors that no longer contain it. All
+		// ancestors are flagged so Refit can find the leaf from the root.
+		m_nodes[proxyId].aabb = fatAABB;
+		m_nodes[proxyId].enlarged = true;
+
+		int32 index = m_nodes[proxyId].parent;
+		while (index != b2_nullNode)
+		{
+			b2TreeNode* node = m_nodes + index;
+			bool grow = node->aabb.Contains(fatAABB) == false;
+			if (grow)
+			{
+				node->aabb.Combine(fatAABB);
+			}
+			else if (node->enlarged)
+			{
+				break;
+			}
+
+			node->enlarged = true;
+			index = node->parent;
+		}
+
+		return true;
 	}
-	else
+
+	RemoveLeaf(proxyId);
+
+	m_nodes[proxyId].aabb = fatAABB;
+
+	InsertLeaf(proxyId);
+
+	return true;
+}
+
+// A refit leaf is re-inserted when the AABB of it and its sibling has a perimeter this
+// many times the sum of theirs.
+#define b2_refitRatio 2.0f
+
+void b2DynamicTree::Refit()
+{
+	if (m_root == b2_nullNode || m_nodes[m_root].enlarged == false)
 	{
-		fatAABB.upperBound.y += d.y;
+		return;
 	}
 
-	const b2AABB& treeAABB = m_nodes[proxyId].aabb;
-	if (treeAABB.Contains(aabb))
+	// Gather the enlarged nodes top-down. Internal nodes go at the front with parents
+	// before their children and leaves go at the back.
+	int32 nodeCount = m_nodeCount;
+	int32* nodes = (int32*)b2Alloc(nodeCount * sizeof(int32));
+	int32 internalCount = 0;
+	int32 leafIndex = nodeCount;
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root);
+	while (stack.GetCount() > 0)
 	{
-		// The tree AABB still contains the object, but it might be too large.
-		// Perhaps the object was moving fast but has since gone to sleep.
-		// The huge AABB is larger than the new fat AABB.
-		b2AABB hugeAABB;
-		hugeAABB.lowerBound = fatAABB.lowerBound - 4.0f * r;
-		hugeAABB.upperBound = fatAABB.upperBound + 4.0f * r;
+		int32 nodeId = stack.Pop();
+		b2TreeNode* node = m_nodes + nodeId;
+		if (node->enlarged == false)
+		{
+			continue;
+		}
 
-		if (hugeAABB.Contains(treeAABB))
+		node->enlarged = false;
+
+		if (node->IsLeaf())
 		{
-			// The tree AABB contains the object AABB and the tree AABB is
-			// not too large. No tree update needed.
-			return false;
+			nodes[--leafIndex] = nodeId;
 		}
+		else
+		{
+			nodes[internalCount++] = nodeId;
+			stack.Push(node->child1);
+			stack.Push(node->child2);
+		}
+	}
 
-		// Otherwise the tree AABB is huge and needs to be shrunk
+	// Refit bottom-up.
+	for (int32 i = internalCount - 1; i >= 0; --i)
+	{
+		b2TreeNode* node = m_nodes + nodes[i];
+		node->aabb.Combine(m_nodes[node->child1].aabb, m_nodes[node->child2].aabb);
 	}
 
-	RemoveLeaf(proxyId);
+	// Re-insert the leaves that drifted away from their siblings.
+	for (int32 i = leafIndex; i < nodeCount; ++i)
+	{
+		int32 leaf = nodes[i];
+		int32 parent = m_nodes[leaf].parent;
+		if (parent == b2_nullNode)
+		{
+			continue;
+		}
 
-	m_nodes[proxyId].aabb = fatAABB;
+		int32 sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+		const b2AABB& leafAABB = m_nodes[leaf].aabb;
+		const b2AABB& siblingAABB = m_nodes[sibling].aabb;
 
-	InsertLeaf(proxyId);
+		b2AABB combined;
+		combined.Combine(leafAABB, siblingAABB);
+		if (combined.GetPerimeter() > b2_refitRatio * (leafAABB.GetPerimeter() + siblingAABB.GetPerimeter()))
+		{
+			RemoveLeaf(leaf);
+			InsertLeaf(leaf);
+		}
+	}
 
-	m_nodes[proxyId].moved = true;
+	b2Free(nodes);
 
-	return true;
+	Validate();
 }
 
 void b2DynamicTree::InsertLeaf(int32 leaf)
@@ -790,6 +865,379 @@ void b2DynamicTree::RebuildBottomUp()
 	Validate();
 }
 
+void b2DynamicTree::CreateProxies(int32 count, const b2AABB* aabbs, void* const* userData, int32* proxyIds)
+{
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 proxyId = AllocateNode();
+
+		// Fatten the aabb.
+		m_nodes[proxyId].aabb.lowerBound = aabbs[i].lowerBound - r;
+		m_nodes[proxyId].aabb.upperBound = aabbs[i].upperBound + r;
+		m_nodes[proxyId].userData = userData[i];
+		m_nodes[proxyId].height = 0;
+		m_nodes[proxyId].moved = true;
+
+		proxyIds[i] = proxyId;
+	}
+
+	// The new leaves are not in the tree yet. The rebuild picks them up from the pool.
+	Rebuild();
+}
+
+// The number of bins used to evaluate split planes. See Ingo Wald, "On fast Construction
+// of SAH-based Bounding Volume Hierarchies", 2007.
+#define b2_treeBinCount 16
+
+struct b2TreeBin
+{
+	b2AABB aabb;
+	int32 count;
+};
+
+static int32 b2BinIndex(float center, float lower, float binScale)
+{
+	int32 index = int32(binScale * (center - lower));
+	return b2Clamp(index, 0, b2_treeBinCount - 1);
+}
+
+// Split the leaves into two groups with the smallest surface area cost. The leaves, their
+// AABBs, and their centers are reordered so that the first group comes first. Returns the
+// size of the first group.
+static int32 b2PartitionLeaves(int32* leaves, b2AABB* aabbs, b2Vec2* centers, int32 count)
+{
+	b2Assert(count > 2);
+
+	b2Vec2 lowerBound = centers[0];
+	b2Vec2 upperBound = centers[0];
+	for (int32 i = 1; i < count; ++i)
+	{
+		lowerBound = b2Min(lowerBound, centers[i]);
+		upperBound = b2Max(upperBound, centers[i]);
+	}
+
+	// Split along the longest axis of the centers.
+	b2Vec2 d = upperBound - lowerBound;
+	int32 axis = d.x >= d.y ? 0 : 1;
+	float lower = lowerBound(axis);
+	float extent = d(axis);
+	if (extent <= 0.0f)
+	{
+		// All centers coincide.
+		return count / 2;
+	}
+
+	b2TreeBin bins[b2_treeBinCount];
+	for (int32 i = 0; i < b2_treeBinCount; ++i)
+	{
+		bins[i].aabb.lowerBound.Set(b2_maxFloat, b2_maxFloat);
+		bins[i].aabb.upperBound.Set(-b2_maxFloat, -b2_maxFloat);
+		bins[i].count = 0;
+	}
+
+	float binScale = b2_treeBinCount / extent;
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2TreeBin* bin = bins + b2BinIndex(centers[i](axis), lower, binScale);
+		bin->aabb.Combine(aabbs[i]);
+		bin->count += 1;
+	}
+
+	// Sweep from the right to get the cost of the right side of each plane. Plane i
+	// separates bin i from bin i + 1.
+	float rightCost[b2_treeBinCount - 1];
+	b2AABB rightAABB = bins[b2_treeBinCount - 1].aabb;
+	int32 rightCount = bins[b2_treeBinCount - 1].count;
+	for (int32 i = b2_treeBinCount - 2; i >= 0; --i)
+	{
+		rightCost[i] = rightCount > 0 ? rightCount * rightAABB.GetPerimeter() : -1.0f;
+		rightAABB.Combine(bins[i].aabb);
+		rightCount += bins[i].count;
+	}
+
+	// Sweep from the left to find the best plane.
+	int32 bestPlane = -1;
+	float bestCost = b2_maxFloat;
+	b2AABB leftAABB = bins[0].aabb;
+	int32 leftCount = bins[0].count;
+	for (int32 i = 0; i < b2_treeBinCount - 1; ++i)
+	{
+		if (leftCount > 0 && rightCost[i] >= 0.0f)
+		{
+			float cost = leftCount * leftAABB.GetPerimeter() + rightCost[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestPlane = i;
+			}
+		}
+
+		leftAABB.Combine(bins[i + 1].aabb);
+		leftCount += bins[i + 1].count;
+	}
+
+	if (bestPlane == -1)
+	{
+		// All centers fall in one bin.
+		return count / 2;
+	}
+
+	// Move the leaves left of the plane to the front.
+	int32 i1 = 0, i2 = count;
+	while (i1 < i2)
+	{
+		if (b2BinIndex(centers[i1](axis), lower, binScale) <= bestPlane)
+		{
+			++i1;
+		}
+		else
+		{
+			--i2;
+			b2Swap(leaves[i1], leaves[i2]);
+			b2Swap(aabbs[i1], aabbs[i2]);
+			b2Swap(centers[i1], centers[i2]);
+		}
+	}
+
+	b2Assert(0 < i1 && i1 < count);
+	return i1;
+}
+
+// An internal node waiting for its children during the build.
+struct b2RebuildItem
+{
+	int32 nodeIndex;
+	int32 childCount;
+	int32 startIndex;
+	int32 splitIndex;
+	int32 endIndex;
+};
+
+b2TreeRebuild::b2TreeRebuild()
+{
+	m_leaves = nullptr;
+	m_aabbs = nullptr;
+	m_centers = nullptr;
+	m_leafCount = 0;
+	m_leafCapacity = 0;
+	m_nodes = nullptr;
+	m_subtrees = nullptr;
+	m_nodeCount = 0;
+}
+
+b2TreeRebuild::~b2TreeRebuild()
+{
+	b2Free(m_subtrees);
+	b2Free(m_nodes);
+	b2Free(m_centers);
+	b2Free(m_aabbs);
+	b2Free(m_leaves);
+}
+
+void b2TreeRebuild::Snapshot(const b2DynamicTree* tree)
+{
+	if (tree->m_nodeCount > m_leafCapacity)
+	{
+		b2Free(m_subtrees);
+		b2Free(m_nodes);
+		b2Free(m_centers);
+		b2Free(m_aabbs);
+		b2Free(m_leaves);
+
+		m_leafCapacity = tree->m_nodeCount;
+		m_leaves = (int32*)b2Alloc(m_leafCapacity * sizeof(int32));
+		m_aabbs = (b2AABB*)b2Alloc(m_leafCapacity * sizeof(b2AABB));
+		m_centers = (b2Vec2*)b2Alloc(m_leafCapacity * sizeof(b2Vec2));
+		m_nodes = (Node*)b2Alloc(m_leafCapacity * sizeof(Node));
+		m_subtrees = (int32*)b2Alloc(m_leafCapacity * sizeof(int32));
+	}
+
+	m_leafCount = 0;
+	m_nodeCount = 0;
+	for (int32 i = 0; i < tree->m_nodeCapacity; ++i)
+	{
+		const b2TreeNode* node = tree->m_nodes + i;
+		if (node->height == 0)
+		{
+			m_leaves[m_leafCount] = i;
+			m_aabbs[m_leafCount] = node->aabb;
+			++m_leafCount;
+		}
+	}
+}
+
+void b2TreeRebuild::Build()
+{
+	m_nodeCount = 0;
+	if (m_leafCount < 2)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < m_leafCount; ++i)
+	{
+		m_centers[i] = m_aabbs[i].GetCenter();
+	}
+
+	// The depth of the tree is less than the leaf count.
+	b2RebuildItem* stack = (b2RebuildItem*)b2Alloc(m_leafCount * sizeof(b2RebuildItem));
+	int32 top = 0;
+
+	m_nodeCount = 1;
+	stack[0].nodeIndex = 0;
+	stack[0].childCount = 0;
+	stack[0].startIndex = 0;
+	stack[0].splitIndex = m_leafCount == 2 ? 1 : b2PartitionLeaves(m_leaves, m_aabbs, m_centers, m_leafCount);
+	stack[0].endIndex = m_leafCount;
+
+	while (top >= 0)
+	{
+		b2RebuildItem* item = stack + top;
+		if (item->childCount == 2)
+		{
+			--top;
+			continue;
+		}
+
+		int32 startIndex = item->childCount == 0 ? item->startIndex : item->splitIndex;
+		int32 endIndex = item->childCount == 0 ? item->splitIndex : item->endIndex;
+		int32 count = endIndex - startIndex;
+
+		int32 child;
+		if (count == 1)
+		{
+			child = -startIndex - 1;
+		}
+		else
+		{
+			child = m_nodeCount++;
+
+			int32 splitIndex = startIndex + 1;
+			if (count > 2)
+			{
+				splitIndex = startIndex + b2PartitionLeaves(m_leaves + startIndex, m_aabbs + startIndex, m_centers + startIndex, count);
+			}
+
+			b2Assert(top + 1 < m_leafCount);
+			b2RebuildItem* childItem = stack + top + 1;
+			childItem->nodeIndex = child;
+			childItem->childCount = 0;
+			childItem->startIndex = startIndex;
+			childItem->splitIndex = splitIndex;
+			childItem->endIndex = endIndex;
+		}
+
+		if (item->childCount == 0)
+		{
+			m_nodes[item->nodeIndex].child1 = child;
+		}
+		else
+		{
+			m_nodes[item->nodeIndex].child2 = child;
+		}
+
+		item->childCount += 1;
+
+		if (count > 1)
+		{
+			++top;
+		}
+	}
+
+	b2Assert(m_nodeCount == m_leafCount - 1);
+	b2Free(stack);
+}
+
+void b2TreeRebuild::Apply(b2DynamicTree* tree)
+{
+	// Drop the old structure.
+	for (int32 i = 0; i < tree->m_nodeCapacity; ++i)
+	{
+		b2TreeNode* node = tree->m_nodes + i;
+		if (node->height < 0)
+		{
+			// free node in pool
+			continue;
+		}
+
+		if (node->IsLeaf())
+		{
+			node->parent = b2_nullNode;
+			node->enlarged = false;
+		}
+		else
+		{
+			tree->FreeNode(i);
+		}
+	}
+
+	// Skip the leaves destroyed since the snapshot. A node reused by a new leaf is kept.
+	for (int32 i = 0; i < m_leafCount; ++i)
+	{
+		if (tree->m_nodes[m_leaves[i]].height != 0)
+		{
+			m_leaves[i] = b2_nullNode;
+		}
+	}
+
+	// Build the internal nodes bottom-up. An internal node with a single remaining child
+	// is replaced by that child.
+	for (int32 i = m_nodeCount - 1; i >= 0; --i)
+	{
+		const Node* node = m_nodes + i;
+		int32 child1 = node->child1 < 0 ? m_leaves[-node->child1 - 1] : m_subtrees[node->child1];
+		int32 child2 = node->child2 < 0 ? m_leaves[-node->child2 - 1] : m_subtrees[node->child2];
+
+		if (child1 == b2_nullNode || child2 == b2_nullNode)
+		{
+			m_subtrees[i] = child1 == b2_nullNode ? child2 : child1;
+			continue;
+		}
+
+		int32 parentIndex = tree->AllocateNode();
+		b2TreeNode* parent = tree->m_nodes + parentIndex;
+		b2TreeNode* node1 = tree->m_nodes + child1;
+		b2TreeNode* node2 = tree->m_nodes + child2;
+		parent->child1 = child1;
+		parent->child2 = child2;
+		parent->aabb.Combine(node1->aabb, node2->aabb);
+		parent->height = 1 + b2Max(node1->height, node2->height);
+		node1->parent = parentIndex;
+		node2->parent = parentIndex;
+		m_subtrees[i] = parentIndex;
+	}
+
+	if (m_nodeCount > 0)
+	{
+		tree->m_root = m_subtrees[0];
+	}
+	else
+	{
+		tree->m_root = m_leafCount == 1 ? m_leaves[0] : b2_nullNode;
+	}
+
+	// Insert the leaves created since the snapshot.
+	for (int32 i = 0; i < tree->m_nodeCapacity; ++i)
+	{
+		const b2TreeNode* node = tree->m_nodes + i;
+		if (node->height == 0 && node->parent == b2_nullNode && i != tree->m_root)
+		{
+			tree->InsertLeaf(i);
+		}
+	}
+
+	tree->Validate();
+}
+
+void b2DynamicTree::Rebuild()
+{
+	b2TreeRebuild rebuild;
+	rebuild.Snapshot(this);
+	rebuild.Build();
+	rebuild.Apply(this);
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	// Build array of leaves. Free the rest.
@@ -0,0 +1,365 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "box2d/b2_spatial_hash.h"
+
+#include <string.h>
+
+b2SpatialHash::b2SpatialHash()
+{
+	m_proxyCount = 0;
+	m_proxyCapacity = 16;
+	m_proxies = (b2HashProxy*)b2Alloc(m_proxyCapacity * sizeof(b2HashProxy));
+	memset(m_proxies, 0, m_proxyCapacity * sizeof(b2HashProxy));
+
+	// Build a linked list for the free list.
+	for (int32 i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+	}
+	m_proxies[m_proxyCapacity - 1].next = b2_nullNode;
+	m_freeProxy = 0;
+
+	m_entryCount = 0;
+	m_entryCapacity = 64;
+	m_entries = (b2HashEntry*)b2Alloc(m_entryCapacity * sizeof(b2HashEntry));
+	for (int32 i = 0; i < m_entryCapacity; ++i)
+	{
+		m_entries[i].proxyId = b2_nullNode;
+		m_entries[i].next = i + 1;
+	}
+	m_entries[m_entryCapacity - 1].next = b2_nullNode;
+	m_freeEntry = 0;
+
+	m_bucketCount = 64;
+	m_buckets = (int32*)b2Alloc(m_bucketCount * sizeof(int32));
+	for (int32 i = 0; i < m_bucketCount; ++i)
+	{
+		m_buckets[i] = b2_nullNode;
+	}
+
+	m_oversizeCount = 0;
+	m_oversizeCapacity = 16;
+	m_oversize = (int32*)b2Alloc(m_oversizeCapacity * sizeof(int32));
+
+	m_cellSize = b2_hashCellSize;
+	m_invCellSize = 1.0f / m_cellSize;
+
+	m_moveCount = 0;
+}
+
+b2SpatialHash::~b2SpatialHash()
+{
+	b2Free(m_proxies);
+	b2Free(m_entries);
+	b2Free(m_buckets);
+	b2Free(m_oversize);
+}
+
+void b2SpatialHash::SetCellSize(float cellSize)
+{
+	b2Assert(m_proxyCount == 0);
+	b2Assert(cellSize > 0.0f);
+	m_cellSize = cellSize;
+	m_invCellSize = 1.0f / cellSize;
+}
+
+int32 b2SpatialHash::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	// Expand the proxy pool if needed.
+	if (m_freeProxy == b2_nullNode)
+	{
+		b2HashProxy* oldProxies = m_proxies;
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity *= 2;
+		m_proxies = (b2HashProxy*)b2Alloc(m_proxyCapacity * sizeof(b2HashProxy));
+		memcpy(m_proxies, oldProxies, oldCapacity * sizeof(b2HashProxy));
+		memset(m_proxies + oldCapacity, 0, (m_proxyCapacity - oldCapacity) * sizeof(b2HashProxy));
+		b2Free(oldProxies);
+
+		for (int32 i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+		}
+		m_proxies[m_proxyCapacity - 1].next = b2_nullNode;
+		m_freeProxy = oldCapacity;
+	}
+
+	int32 proxyId = m_freeProxy;
+	b2HashProxy* proxy = m_proxies + proxyId;
+	m_freeProxy = proxy->next;
+	++m_proxyCount;
+
+	// Fatten the aabb.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	proxy->aabb.lowerBound = aabb.lowerBound - r;
+	proxy->aabb.upperBound = aabb.upperBound + r;
+	proxy->userData = userData;
+	proxy->next = b2_nullNode;
+	proxy->oversizeIndex = b2_nullNode;
+	proxy->used = true;
+	proxy->moved = true;
+
+	InsertProxy(proxyId);
+
+	return proxyId;
+}
+
+void b2SpatialHash::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].used);
+
+	RemoveProxy(proxyId);
+
+	b2HashProxy* proxy = m_proxies + proxyId;
+	proxy->used = false;
+	proxy->userData = nullptr;
+	proxy->next = m_freeProxy;
+	m_freeProxy = proxyId;
+	--m_proxyCount;
+}
+
+bool b2SpatialHash::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement, const b2Vec2& margin)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].used);
+
+	b2HashProxy* proxy = m_proxies + proxyId;
+	b2AABB fatAABB = proxy->aabb;
+	if (b2UpdateFatAABB(&fatAABB, aabb, displacement, margin) == false)
+	{
+		return false;
+	}
+
+	++m_moveCount;
+	proxy->moved = true;
+
+	// A proxy that stays in the same cells keeps its entries.
+	const b2AABB& oldAABB = proxy->aabb;
+	bool sameCells = proxy->oversizeIndex == b2_nullNode &&
+		GetCellX(oldAABB.lowerBound.x) == GetCellX(fatAABB.lowerBound.x) &&
+		GetCellY(oldAABB.lowerBound.y) == GetCellY(fatAABB.lowerBound.y) &&
+		GetCellX(oldAABB.upperBound.x) == GetCellX(fatAABB.upperBound.x) &&
+		GetCellY(oldAABB.upperBound.y) == GetCellY(fatAABB.upperBound.y);
+
+	if (sameCells)
+	{
+		proxy->aabb = fatAABB;
+		return true;
+	}
+
+	RemoveProxy(proxyId);
+	proxy->aabb = fatAABB;
+	InsertProxy(proxyId);
+
+	return true;
+}
+
+bool b2SpatialHash::IsOversize(const b2AABB& aabb) const
+{
+	int32 width = GetCellX(aabb.upperBound.x) - GetCellX(aabb.lowerBound.x) + 1;
+	int32 height = GetCellY(aabb.upperBound.y) - GetCellY(aabb.lowerBound.y) + 1;
+	return width > b2_maxHashProxyCells || height > b2_maxHashProxyCells || width * height > b2_maxHashProxyCells;
+}
+
+int32 b2SpatialHash::AllocateEntry()
+{
+	if (m_freeEntry == b2_nullNode)
+	{
+		b2HashEntry* oldEntries = m_entries;
+		int32 oldCapacity = m_entryCapacity;
+		m_entryCapacity *= 2;
+		m_entries = (b2HashEntry*)b2Alloc(m_entryCapacity * sizeof(b2HashEntry));
+		memcpy(m_entries, oldEntries, oldCapacity * sizeof(b2HashEntry));
+		b2Free(oldEntries);
+
+		for (int32 i = oldCapacity; i < m_entryCapacity; ++i)
+		{
+			m_entries[i].proxyId = b2_nullNode;
+			m_entries[i].next = i + 1;
+		}
+		m_entries[m_entryCapacity - 1].next = b2_nullNode;
+		m_freeEntry = oldCapacity;
+	}
+
+	int32 entryId = m_freeEntry;
+	m_freeEntry = m_entries[entryId].next;
+	++m_entryCount;
+	return entryId;
+}
+
+void b2SpatialHash::GrowBuckets()
+{
+	b2Free(m_buckets);
+	while (m_bucketCount < m_entryCount)
+	{
+		m_bucketCount *= 2;
+	}
+
+	m_buckets = (int32*)b2Alloc(m_bucketCount * sizeof(int32));
+	for (int32 i = 0; i < m_bucketCount; ++i)
+	{
+		m_buckets[i] = b2_nullNode;
+	}
+
+	for (int32 i = 0; i < m_entryCapacity; ++i)
+	{
+		b2HashEntry* entry = m_entries + i;
+		if (entry->proxyId == b2_nullNode)
+		{
+			continue;
+		}
+
+		int32 bucket = GetBucket(entry->x, entry->y);
+		entry->next = m_buckets[bucket];
+		m_buckets[bucket] = i;
+	}
+}
+
+void b2SpatialHash::InsertProxy(int32 proxyId)
+{
+	b2HashProxy* proxy = m_proxies + proxyId;
+	const b2AABB& aabb = proxy->aabb;
+
+	if (IsOversize(aabb))
+	{
+		if (m_oversizeCount == m_oversizeCapacity)
+		{
+			int32* oldOversize = m_oversize;
+			m_oversizeCapacity *= 2;
+			m_oversize = (int32*)b2Alloc(m_oversizeCapacity * sizeof(int32));
+			memcpy(m_oversize, oldOversize, m_oversizeCount * sizeof(int32));
+			b2Free(oldOversize);
+		}
+
+		proxy->oversizeIndex = m_oversizeCount;
+		m_oversize[m_oversizeCount++] = proxyId;
+		return;
+	}
+
+	int32 x0 = GetCellX(aabb.lowerBound.x);
+	int32 y0 = GetCellY(aabb.lowerBound.y);
+	int32 x1 = GetCellX(aabb.upperBound.x);
+	int32 y1 = GetCellY(aabb.upperBound.y);
+
+	for (int32 y = y0; y <= y1; ++y)
+	{
+		for (int32 x = x0; x <= x1; ++x)
+		{
+			int32 entryId = AllocateEntry();
+			b2HashEntry* entry = m_entries + entryId;
+			entry->proxyId = proxyId;
+			entry->x = x;
+			entry->y = y;
+
+			int32 bucket = GetBucket(x, y);
+			entry->next = m_buckets[bucket];
+			m_buckets[bucket] = entryId;
+		}
+	}
+
+	if (m_entryCount > m_bucketCount)
+	{
+		GrowBuckets();
+	}
+}
+
+void b2SpatialHash::RemoveProxy(int32 proxyId)
+{
+	b2HashProxy* proxy = m_proxies + proxyId;
+
+	if (proxy->oversizeIndex != b2_nullNode)
+	{
+		// Swap the last oversize proxy into the hole.
+		int32 lastId = m_oversize[--m_oversizeCount];
+		m_oversize[proxy->oversizeIndex] = lastId;
+		m_proxies[lastId].oversizeIndex = proxy->oversizeIndex;
+		proxy->oversizeIndex = b2_nullNode;
+		return;
+	}
+
+	const b2AABB& aabb = proxy->aabb;
+	int32 x0 = GetCellX(aabb.lowerBound.x);
+	int32 y0 = GetCellY(aabb.lowerBound.y);
+	int32 x1 = GetCellX(aabb.upperBound.x);
+	int32 y1 = GetCellY(aabb.upperBound.y);
+
+	for (int32 y = y0; y <= y1; ++y)
+	{
+		for (int32 x = x0; x <= x1; ++x)
+		{
+			int32* link = m_buckets + GetBucket(x, y);
+			while (*link != b2_nullNode)
+			{
+				b2HashEntry* entry = m_entries + *link;
+				if (entry->proxyId == proxyId && entry->x == x && entry->y == y)
+				{
+					int32 entryId = *link;
+					*link = entry->next;
+
+					entry->proxyId = b2_nullNode;
+					entry->next = m_freeEntry;
+					m_freeEntry = entryId;
+					--m_entryCount;
+					break;
+				}
+
+				link = &entry->next;
+			}
+		}
+	}
+}
+
+void b2SpatialHash::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// Clear the cells and enter every proxy again.
+	for (int32 i = 0; i < m_bucketCount; ++i)
+	{
+		m_buckets[i] = b2_nullNode;
+	}
+
+	for (int32 i = 0; i < m_entryCapacity; ++i)
+	{
+		m_entries[i].proxyId = b2_nullNode;
+		m_entries[i].next = i + 1;
+	}
+	m_entries[m_entryCapacity - 1].next = b2_nullNode;
+	m_freeEntry = 0;
+	m_entryCount = 0;
+	m_oversizeCount = 0;
+
+	for (int32 i = 0; i < m_proxyCapacity; ++i)
+	{
+		b2HashProxy* proxy = m_proxies + i;
+		if (proxy->used == false)
+		{
+			continue;
+		}
+
+		proxy->aabb.lowerBound -= newOrigin;
+		proxy->aabb.upperBound -= newOrigin;
+		proxy->oversizeIndex = b2_nullNode;
+		InsertProxy(i);
+	}
+}
@@ -0,0 +1,202 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "box2d/b2_sweep_and_prune.h"
+
+#include <string.h>
+
+b2SweepAndPrune::b2SweepAndPrune()
+{
+	m_proxyCapacity = 16;
+	m_proxies = (b2SweepProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SweepProxy));
+	memset(m_proxies, 0, m_proxyCapacity * sizeof(b2SweepProxy));
+
+	// Build a linked list for the free list.
+	for (int32 i = 0; i < m_proxyCapacity - 1; ++i)
+	{
+		m_proxies[i].next = i + 1;
+	}
+	m_proxies[m_proxyCapacity - 1].next = b2_nullNode;
+	m_freeProxy = 0;
+
+	m_entryCount = 0;
+	m_entryCapacity = 16;
+	m_entries = (b2SweepEntry*)b2Alloc(m_entryCapacity * sizeof(b2SweepEntry));
+
+	m_maxWidth = 0.0f;
+	m_widthMoveCount = 0;
+	m_moveCount = 0;
+}
+
+b2SweepAndPrune::~b2SweepAndPrune()
+{
+	b2Free(m_proxies);
+	b2Free(m_entries);
+}
+
+int32 b2SweepAndPrune::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	// Expand the proxy pool if needed.
+	if (m_freeProxy == b2_nullNode)
+	{
+		b2SweepProxy* oldProxies = m_proxies;
+		int32 oldCapacity = m_proxyCapacity;
+		m_proxyCapacity *= 2;
+		m_proxies = (b2SweepProxy*)b2Alloc(m_proxyCapacity * sizeof(b2SweepProxy));
+		memcpy(m_proxies, oldProxies, oldCapacity * sizeof(b2SweepProxy));
+		memset(m_proxies + oldCapacity, 0, (m_proxyCapacity - oldCapacity) * sizeof(b2SweepProxy));
+		b2Free(oldProxies);
+
+		for (int32 i = oldCapacity; i < m_proxyCapacity - 1; ++i)
+		{
+			m_proxies[i].next = i + 1;
+		}
+		m_proxies[m_proxyCapacity - 1].next = b2_nullNode;
+		m_freeProxy = oldCapacity;
+	}
+
+	if (m_entryCount == m_entryCapacity)
+	{
+		b2SweepEntry* oldEntries = m_entries;
+		m_entryCapacity *= 2;
+		m_entries = (b2SweepEntry*)b2Alloc(m_entryCapacity * sizeof(b2SweepEntry));
+		memcpy(m_entries, oldEntries, m_entryCount * sizeof(b2SweepEntry));
+		b2Free(oldEntries);
+	}
+
+	int32 proxyId = m_freeProxy;
+	b2SweepProxy* proxy = m_proxies + proxyId;
+	m_freeProxy = proxy->next;
+
+	// Fatten the aabb.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2SweepEntry* entry = m_entries + m_entryCount;
+	entry->aabb.lowerBound = aabb.lowerBound - r;
+	entry->aabb.upperBound = aabb.upperBound + r;
+	entry->proxyId = proxyId;
+	m_maxWidth = b2Max(m_maxWidth, entry->aabb.upperBound.x - entry->aabb.lowerBound.x);
+
+	proxy->userData = userData;
+	proxy->index = m_entryCount;
+	proxy->used = true;
+	proxy->moved = true;
+
+	++m_entryCount;
+	SortEntry(proxy->index);
+
+	return proxyId;
+}
+
+void b2SweepAndPrune::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].used);
+
+	// Close the gap in the sorted entries.
+	int32 index = m_proxies[proxyId].index;
+	--m_entryCount;
+	memmove(m_entries + index, m_entries + index + 1, (m_entryCount - index) * sizeof(b2SweepEntry));
+	for (int32 i = index; i < m_entryCount; ++i)
+	{
+		m_proxies[m_entries[i].proxyId].index = i;
+	}
+
+	b2SweepProxy* proxy = m_proxies + proxyId;
+	proxy->used = false;
+	proxy->userData = nullptr;
+	proxy->next = m_freeProxy;
+	m_freeProxy = proxyId;
+}
+
+bool b2SweepAndPrune::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement, const b2Vec2& margin)
+{
+	b2Assert(0 <= proxyId && proxyId < m_proxyCapacity);
+	b2Assert(m_proxies[proxyId].used);
+
+	b2SweepProxy* proxy = m_proxies + proxyId;
+	b2SweepEntry* entry = m_entries + proxy->index;
+	if (b2UpdateFatAABB(&entry->aabb, aabb, displacement, margin) == false)
+	{
+		return false;
+	}
+
+	++m_moveCount;
+	proxy->moved = true;
+	m_maxWidth = b2Max(m_maxWidth, entry->aabb.upperBound.x - entry->aabb.lowerBound.x);
+
+	SortEntry(proxy->index);
+
+	// Shrink the widest width once about every proxy has moved.
+	if (m_moveCount - m_widthMoveCount > m_entryCount)
+	{
+		ComputeMaxWidth();
+	}
+
+	return true;
+}
+
+void b2SweepAndPrune::SortEntry(int32 index)
+{
+	b2SweepEntry entry = m_entries[index];
+	float x = entry.aabb.lowerBound.x;
+
+	// Insertion sort in whichever direction the entry moved.
+	while (index > 0 && m_entries[index - 1].aabb.lowerBound.x > x)
+	{
+		m_entries[index] = m_entries[index - 1];
+		m_proxies[m_entries[index].proxyId].index = index;
+		--index;
+	}
+
+	while (index < m_entryCount - 1 && m_entries[index + 1].aabb.lowerBound.x < x)
+	{
+		m_entries[index] = m_entries[index + 1];
+		m_proxies[m_entries[index].proxyId].index = index;
+		++index;
+	}
+
+	m_entries[index] = entry;
+	m_proxies[entry.proxyId].index = index;
+}
+
+void b2SweepAndPrune::ComputeMaxWidth()
+{
+	m_maxWidth = 0.0f;
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		const b2AABB& aabb = m_entries[i].aabb;
+		m_maxWidth = b2Max(m_maxWidth, aabb.upperBound.x - aabb.lowerBound.x);
+	}
+
+	m_widthMoveCount = m_moveCount;
+}
+
+void b2SweepAndPrune::ShiftOrigin(const b2Vec2& newOrigin)
+{
+	// The order of the entries does not change.
+	for (int32 i = 0; i < m_entryCount; ++i)
+	{
+		m_entries[i].aabb.lowerBound -= newOrigin;
+		m_entries[i].aabb.upperBound -= newOrigin;
+	}
+}
@@ -29,9 +29,9 @@
 
 #include <stdio.h>
 
-B2_API float b2_toiTime, b2_toiMaxTime;
-B2_API int32 b2_toiCalls, b2_toiIters, b2_toiMaxIters;
-B2_API int32 b2_toiRootIters, b2_toiMaxRootIters;
+B2_API std::atomic<float> b2_toiTime(0.0f), b2_toiMaxTime(0.0f);
+B2_API std::atomic<int32> b2_toiCalls(0), b2_toiIters(0), b2_toiMaxIters(0);
+B2_API std::atomic<int32> b2_toiRootIters(0), b2_toiMaxRootIters(0);
 
 //
 struct b2SeparationFunction
@@ -259,7 +259,10 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 {
 	b2Timer timer;
 
-	++b2_toiCalls;
+	// The statistics are accumulated locally and published once at the end, because the
+	// world may compute several times of impact in parallel.
+	int32 rootIters = 0;
+	int32 maxRootIters = 0;
 
 	output->state = b2TOIOutput::e_unknown;
 	output->t = input->tMax;
@@ -426,7 +429,7 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 				}
 
 				++rootIterCount;
-				++b2_toiRootIters;
+				++rootIters;
 
 				float s = fcn.Evaluate(indexA, indexB, t);
 
@@ -455,7 +458,7 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 				}
 			}
 
-			b2_toiMaxRootIters = b2Max(b2_toiMaxRootIters, rootIterCount);
+			maxRootIters = b2Max(maxRootIters, rootIterCount);
 
 			++pushBackIter;
 
@@ -466,7 +469,6 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 		}
 
 		++iter;
-		++b2_toiIters;
 
 		if (done)
 		{
@@ -482,9 +484,13 @@ void b2TimeOfImpact(b2TOIOutput* output, const b2TOIInput* input)
 		}
 	}
 
-	b2_toiMaxIters = b2Max(b2_toiMaxIters, iter);
+	b2_toiCalls.fetch_add(1, std::memory_order_relaxed);
+	b2_toiIters.fetch_add(iter, std::memory_order_relaxed);
+	b2AtomicMax(b2_toiMaxIters, iter);
+	b2_toiRootIters.fetch_add(rootIters, std::memory_order_relaxed);
+	b2AtomicMax(b2_toiMaxRootIters, maxRootIters);
 
 	float time = timer.GetMilliseconds();
-	b2_toiMaxTime = b2Max(b2_toiMaxTime, time);
-	b2_toiTime += time;
+	b2AtomicMax(b2_toiMaxTime, time);
+	b2AtomicAdd(b2_toiTime, time);
 }
@@ -0,0 +1,147 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_WIDE_NODE_H
+#define B2_WIDE_NODE_H
+
+#include "box2d/b2_collision.h"
+#include "box2d/b2_dynamic_tree.h"
+#include "box2d/b2_math.h"
+
+// Helpers shared by b2WideTree and b2CompactTree. The masks work on any type that stores
+// the bounds of four children in lowerX, lowerY, upperX and upperY arrays.
+
+#if !defined(B2_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+
+#include <emmintrin.h>
+
+// Bit i is set if child i overlaps the AABB.
+template <typename T>
+inline int32 b2OverlapMask(const T* bounds, const b2AABB& aabb)
+{
+	__m128 lowerX = _mm_loadu_ps(bounds->lowerX);
+	__m128 lowerY = _mm_loadu_ps(bounds->lowerY);
+	__m128 upperX = _mm_loadu_ps(bounds->upperX);
+	__m128 upperY = _mm_loadu_ps(bounds->upperY);
+
+	__m128 mask = _mm_and_ps(
+		_mm_and_ps(_mm_cmple_ps(lowerX, _mm_set1_ps(aabb.upperBound.x)), _mm_cmple_ps(lowerY, _mm_set1_ps(aabb.upperBound.y))),
+		_mm_and_ps(_mm_cmpge_ps(upperX, _mm_set1_ps(aabb.lowerBound.x)), _mm_cmpge_ps(upperY, _mm_set1_ps(aabb.lowerBound.y))));
+
+	return _mm_movemask_ps(mask);
+}
+
+// Bit i is set if child i is not separated from the segment through p1 along the segment
+// normal v. See b2DynamicTree::RayCast.
+template <typename T>
+inline int32 b2SegmentMask(const T* bounds, const b2Vec2& p1, const b2Vec2& v, const b2Vec2& absV)
+{
+	__m128 lowerX = _mm_loadu_ps(bounds->lowerX);
+	__m128 lowerY = _mm_loadu_ps(bounds->lowerY);
+	__m128 upperX = _mm_loadu_ps(bounds->upperX);
+	__m128 upperY = _mm_loadu_ps(bounds->upperY);
+
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 cx = _mm_mul_ps(half, _mm_add_ps(lowerX, upperX));
+	__m128 cy = _mm_mul_ps(half, _mm_add_ps(lowerY, upperY));
+	__m128 hx = _mm_mul_ps(half, _mm_sub_ps(upperX, lowerX));
+	__m128 hy = _mm_mul_ps(half, _mm_sub_ps(upperY, lowerY));
+
+	// |dot(v, p1 - c)| <= dot(|v|, h)
+	__m128 dot = _mm_add_ps(
+		_mm_mul_ps(_mm_set1_ps(v.x), _mm_sub_ps(_mm_set1_ps(p1.x), cx)),
+		_mm_mul_ps(_mm_set1_ps(v.y), _mm_sub_ps(_mm_set1_ps(p1.y), cy)));
+	__m128 absDot = _mm_max_ps(dot, _mm_sub_ps(_mm_setzero_ps(), dot));
+	__m128 radius = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(absV.x), hx), _mm_mul_ps(_mm_set1_ps(absV.y), hy));
+
+	return _mm_movemask_ps(_mm_cmple_ps(absDot, radius));
+}
+
+#else
+
+template <typename T>
+inline int32 b2OverlapMask(const T* bounds, const b2AABB& aabb)
+{
+	int32 mask = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if (bounds->lowerX[i] <= aabb.upperBound.x && bounds->lowerY[i] <= aabb.upperBound.y &&
+			bounds->upperX[i] >= aabb.lowerBound.x && bounds->upperY[i] >= aabb.lowerBound.y)
+		{
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+}
+
+template <typename T>
+inline int32 b2SegmentMask(const T* bounds, const b2Vec2& p1, const b2Vec2& v, const b2Vec2& absV)
+{
+	int32 mask = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		b2Vec2 c(0.5f * (bounds->lowerX[i] + bounds->upperX[i]), 0.5f * (bounds->lowerY[i] + bounds->upperY[i]));
+		b2Vec2 h(0.5f * (bounds->upperX[i] - bounds->lowerX[i]), 0.5f * (bounds->upperY[i] - bounds->lowerY[i]));
+		if (b2Abs(b2Dot(v, p1 - c)) <= b2Dot(absV, h))
+		{
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+}
+
+#endif
+
+// Collapse a binary subtree into up to four children by opening up the largest internal
+// node until there are four. A leaf stays the only child. Returns the child count.
+inline int32 b2CollapseWideNode(const b2TreeNode* nodes, int32 treeNode, int32* children)
+{
+	int32 childCount = 1;
+	children[0] = treeNode;
+	while (childCount < 4)
+	{
+		int32 best = -1;
+		float bestPerimeter = -1.0f;
+		for (int32 i = 0; i < childCount; ++i)
+		{
+			const b2TreeNode* child = nodes + children[i];
+			if (child->IsLeaf() == false && child->aabb.GetPerimeter() > bestPerimeter)
+			{
+				best = i;
+				bestPerimeter = child->aabb.GetPerimeter();
+			}
+		}
+
+		if (best == -1)
+		{
+			break;
+		}
+
+		const b2TreeNode* node = nodes + children[best];
+		children[best] = node->child1;
+		children[childCount++] = node->child2;
+	}
+
+	return childCount;
+}
+
+#endif
@@ -0,0 +1,338 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_wide_tree.h"
+#include "box2d/b2_dynamic_tree.h"
+#include "b2_wide_node.h"
+
+#include <string.h>
+
+// A binary node waiting to become a wide node.
+struct b2WideBuildItem
+{
+	int32 treeNode;
+	int32 wideNode;
+};
+
+b2WideTree::b2WideTree()
+{
+	m_nodes = nullptr;
+	m_nodeCount = 0;
+	m_nodeCapacity = 0;
+}
+
+b2WideTree::~b2WideTree()
+{
+	b2Free(m_nodes);
+}
+
+void b2WideTree::Build(const b2DynamicTree* tree)
+{
+	m_nodeCount = 0;
+	if (tree->m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	// Each wide node replaces at least one binary internal node, except for a leaf root.
+	int32 capacity = b2Max(tree->m_nodeCount / 2 + 1, 1);
+	if (capacity > m_nodeCapacity)
+	{
+		b2Free(m_nodes);
+		m_nodeCapacity = capacity;
+		m_nodes = (b2WideNode*)b2Alloc(m_nodeCapacity * sizeof(b2WideNode));
+	}
+
+	const b2TreeNode* nodes = tree->m_nodes;
+
+	b2GrowableStack<b2WideBuildItem, 64> stack;
+	b2WideBuildItem root;
+	root.treeNode = tree->m_root;
+	root.wideNode = m_nodeCount++;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2WideBuildItem item = stack.Pop();
+
+		int32 children[4];
+		int32 childCount = b2CollapseWideNode(nodes, item.treeNode, children);
+
+		b2WideNode* wide = m_nodes + item.wideNode;
+		wide->leafMask = 0;
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if (i >= childCount)
+			{
+				// Empty bounds never overlap.
+				wide->lowerX[i] = b2_maxFloat;
+				wide->lowerY[i] = b2_maxFloat;
+				wide->upperX[i] = -b2_maxFloat;
+				wide->upperY[i] = -b2_maxFloat;
+				wide->children[i] = b2_nullNode;
+				continue;
+			}
+
+			const b2TreeNode* child = nodes + children[i];
+			wide->lowerX[i] = child->aabb.lowerBound.x;
+			wide->lowerY[i] = child->aabb.lowerBound.y;
+			wide->upperX[i] = child->aabb.upperBound.x;
+			wide->upperY[i] = child->aabb.upperBound.y;
+
+			if (child->IsLeaf())
+			{
+				wide->children[i] = children[i];
+				wide->leafMask |= 1 << i;
+			}
+			else
+			{
+				b2Assert(m_nodeCount < m_nodeCapacity);
+				b2WideBuildItem childItem;
+				childItem.treeNode = children[i];
+				childItem.wideNode = m_nodeCount++;
+				wide->children[i] = childItem.wideNode;
+				stack.Push(childItem);
+			}
+		}
+	}
+}
+
+void b2WideTree::Query(QueryFcn* fcn, void* context, const b2AABB& aabb) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(0);
+
+	while (stack.GetCount() > 0)
+	{
+		const b2WideNode* node = m_nodes + stack.Pop();
+		int32 mask = b2OverlapMask(node, aabb);
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if ((mask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			if (node->leafMask & (1 << i))
+			{
+				bool proceed = fcn(context, node->children[i]);
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+			else
+			{
+				stack.Push(node->children[i]);
+			}
+		}
+	}
+}
+
+void b2WideTree::RayCast(RayCastFcn* fcn, void* context, const b2RayCastInput& input) const
+{
+	if (m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 absV = b2Abs(v);
+
+	float maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(0);
+
+	while (stack.GetCount() > 0)
+	{
+		const b2WideNode* node = m_nodes + stack.Pop();
+		int32 mask = b2OverlapMask(node, segmentAABB) & b2SegmentMask(node, p1, v, absV);
+		for (int32 i = 0; i < 4; ++i)
+		{
+			if ((mask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			if ((node->leafMask & (1 << i)) == 0)
+			{
+				stack.Push(node->children[i]);
+				continue;
+			}
+
+			// An earlier child may have clipped the segment.
+			if (node->lowerX[i] > segmentAABB.upperBound.x || node->lowerY[i] > segmentAABB.upperBound.y ||
+				node->upperX[i] < segmentAABB.lowerBound.x || node->upperY[i] < segmentAABB.lowerBound.y)
+			{
+				continue;
+			}
+
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			float value = fcn(context, subInput, node->children[i]);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentAABB.lowerBound = b2Min(p1, t);
+				segmentAABB.upperBound = b2Max(p1, t);
+			}
+		}
+	}
+}
+
+void b2WideTree::RayCastPacket(RayCastPacketFcn* fcn, void* context, b2RayCastInput* inputs, int32 count) const
+{
+	b2Assert(0 < count && count <= b2_maxRayPacket);
+
+	b2RayPacketSegment segments[b2_maxRayPacket];
+	int32 rayMask = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		if (inputs[i].maxFraction > 0.0f)
+		{
+			b2Assert((inputs[i].p2 - inputs[i].p1).LengthSquared() > 0.0f);
+			segments[i].Set(inputs[i]);
+			rayMask |= 1 << i;
+		}
+	}
+
+	if (rayMask == 0 || m_nodeCount == 0)
+	{
+		return;
+	}
+
+	b2GrowableStack<b2RayPacketItem, 256> stack;
+	b2RayPacketItem root;
+	root.nodeId = 0;
+	root.rayMask = rayMask;
+	stack.Push(root);
+
+	while (stack.GetCount() > 0)
+	{
+		b2RayPacketItem item = stack.Pop();
+		const b2WideNode* node = m_nodes + item.nodeId;
+
+		// The rays that reach each child. Rays terminated since the node was pushed
+		// are dropped.
+		int32 childRays[4] = { 0, 0, 0, 0 };
+		int32 activeMask = item.rayMask & rayMask;
+		for (int32 i = 0; i < count; ++i)
+		{
+			if ((activeMask & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			const b2RayPacketSegment& segment = segments[i];
+			int32 mask = b2OverlapMask(node, segment.aabb) & b2SegmentMask(node, segment.p1, segment.v, segment.absV);
+			for (int32 j = 0; j < 4; ++j)
+			{
+				if (mask & (1 << j))
+				{
+					childRays[j] |= 1 << i;
+				}
+			}
+		}
+
+		for (int32 j = 0; j < 4; ++j)
+		{
+			if (childRays[j] == 0)
+			{
+				continue;
+			}
+
+			if ((node->leafMask & (1 << j)) == 0)
+			{
+				b2RayPacketItem child;
+				child.nodeId = node->children[j];
+				child.rayMask = childRays[j];
+				stack.Push(child);
+				continue;
+			}
+
+			b2AABB box;
+			box.lowerBound.Set(node->lowerX[j], node->lowerY[j]);
+			box.upperBound.Set(node->upperX[j], node->upperY[j]);
+
+			for (int32 i = 0; i < count; ++i)
+			{
+				// An earlier child may have clipped or terminated the ray.
+				if ((childRays[j] & rayMask & (1 << i)) == 0 || b2TestOverlap(box, segments[i].aabb) == false)
+				{
+					continue;
+				}
+
+				float value = fcn(context, inputs[i], node->children[j], i);
+
+				if (value == 0.0f)
+				{
+					// The client has terminated this ray.
+					inputs[i].maxFraction = 0.0f;
+					rayMask &= ~(1 << i);
+				}
+				else if (value > 0.0f)
+				{
+					inputs[i].maxFraction = value;
+					segments[i].Clip(value);
+				}
+			}
+
+			if (rayMask == 0)
+			{
+				return;
+			}
+		}
+	}
+}
@@ -41,6 +41,9 @@ void* b2StackAllocator::Allocate(int32 size)
 {
 	b2Assert(m_entryCount < b2_maxStackEntries);
 
+	// Round up so every block is aligned for pointers and the objects placed in it.
+	size = (size + b2_stackAlignment - 1) & ~(b2_stackAlignment - 1);
+
 	b2StackEntry* entry = m_entries + m_entryCount;
 	entry->size = size;
 	if (m_index + size > b2_stackSize)
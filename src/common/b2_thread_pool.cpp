@@ -0,0 +1,374 @@
+// MIT License
+
+// Copyright (c) 2020 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "box2d/b2_thread_pool.h"
+#include "box2d/b2_math.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string.h>
+#include <thread>
+
+// A task enqueued on the pool. Wait returns once all its ranges are done.
+struct b2ThreadPoolJob
+{
+	std::atomic<int32> remaining;
+	bool background;
+};
+
+struct b2ThreadPoolRange
+{
+	b2RangeTask* task;
+	b2ThreadPoolJob* job;
+	int32 begin;
+	int32 end;
+};
+
+// A double ended queue of ranges. The owner takes ranges from the back and
+// other workers steal from the front.
+struct b2ThreadPoolQueue
+{
+	std::mutex mutex;
+	b2ThreadPoolRange* ranges;
+	int32 head;
+	int32 tail;
+	int32 capacity;
+};
+
+static void b2PushRange(b2ThreadPoolQueue* queue, const b2ThreadPoolRange& range)
+{
+	std::lock_guard<std::mutex> lock(queue->mutex);
+
+	if (queue->tail == queue->capacity)
+	{
+		// Compact or grow.
+		int32 count = queue->tail - queue->head;
+		b2ThreadPoolRange* old = queue->ranges;
+		if (2 * count > queue->capacity)
+		{
+			queue->capacity *= 2;
+			queue->ranges = (b2ThreadPoolRange*)b2Alloc(queue->capacity * sizeof(b2ThreadPoolRange));
+		}
+		memmove(queue->ranges, old + queue->head, count * sizeof(b2ThreadPoolRange));
+		if (old != queue->ranges)
+		{
+			b2Free(old);
+		}
+		queue->head = 0;
+		queue->tail = count;
+	}
+
+	queue->ranges[queue->tail++] = range;
+}
+
+struct b2ThreadPoolData
+{
+	b2ThreadPoolQueue* queues;
+	std::thread* threads;
+
+	// Background tasks. Worker zero never takes these while waiting on a step task.
+	b2ThreadPoolQueue background;
+
+	// The number of ranges in all queues. This only changes with the queue locks held.
+	std::atomic<int32> pendingCount;
+
+	// Idle threads sleep on this. The pending count is raised under this lock.
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stop;
+};
+
+b2ThreadPool::b2ThreadPool(int32 workerCount)
+{
+	if (workerCount <= 0)
+	{
+		workerCount = b2Max(int32(std::thread::hardware_concurrency()), 1);
+	}
+
+	m_workerCount = workerCount;
+
+	m_data = new (b2Alloc(sizeof(b2ThreadPoolData))) b2ThreadPoolData();
+	m_data->pendingCount = 0;
+	m_data->stop = false;
+
+	m_data->queues = (b2ThreadPoolQueue*)b2Alloc(m_workerCount * sizeof(b2ThreadPoolQueue));
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		b2ThreadPoolQueue* queue = new (m_data->queues + i) b2ThreadPoolQueue();
+		queue->capacity = 16;
+		queue->ranges = (b2ThreadPoolRange*)b2Alloc(queue->capacity * sizeof(b2ThreadPoolRange));
+		queue->head = 0;
+		queue->tail = 0;
+	}
+
+	m_data->background.capacity = 4;
+	m_data->background.ranges = (b2ThreadPoolRange*)b2Alloc(m_data->background.capacity * sizeof(b2ThreadPoolRange));
+	m_data->background.head = 0;
+	m_data->background.tail = 0;
+
+	// Worker zero is the thread that waits on the tasks.
+	m_data->threads = (std::thread*)b2Alloc(m_workerCount * sizeof(std::thread));
+	for (int32 i = 1; i < m_workerCount; ++i)
+	{
+		new (m_data->threads + i) std::thread(&b2ThreadPool::WorkerMain, this, i);
+	}
+}
+
+b2ThreadPool::~b2ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_data->mutex);
+		m_data->stop = true;
+	}
+	m_data->condition.notify_all();
+
+	for (int32 i = 1; i < m_workerCount; ++i)
+	{
+		m_data->threads[i].join();
+		m_data->threads[i].~thread();
+	}
+	b2Free(m_data->threads);
+
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		b2ThreadPoolQueue* queue = m_data->queues + i;
+		b2Free(queue->ranges);
+		queue->~b2ThreadPoolQueue();
+	}
+	b2Free(m_data->queues);
+	b2Free(m_data->background.ranges);
+
+	m_data->~b2ThreadPoolData();
+	b2Free(m_data);
+}
+
+int32 b2ThreadPool::GetWorkerCount() const
+{
+	return m_workerCount;
+}
+
+void* b2ThreadPool::Enqueue(b2RangeTask* task, int32 itemCount, int32 minRange)
+{
+	if (itemCount <= 0)
+	{
+		return nullptr;
+	}
+
+	// Make a few ranges per worker so there is something left to steal.
+	minRange = b2Max(minRange, 1);
+	int32 maxRangeCount = 4 * m_workerCount;
+	int32 rangeSize = b2Max(minRange, (itemCount + maxRangeCount - 1) / maxRangeCount);
+	int32 rangeCount = (itemCount + rangeSize - 1) / rangeSize;
+
+	if (rangeCount == 1 || m_workerCount == 1)
+	{
+		task->Execute(0, itemCount, 0);
+		return nullptr;
+	}
+
+	b2ThreadPoolJob* job = new (b2Alloc(sizeof(b2ThreadPoolJob))) b2ThreadPoolJob();
+	job->remaining = rangeCount;
+	job->background = false;
+
+	for (int32 i = 0; i < rangeCount; ++i)
+	{
+		b2ThreadPoolRange range;
+		range.task = task;
+		range.job = job;
+		range.begin = i * rangeSize;
+		range.end = b2Min(range.begin + rangeSize, itemCount);
+
+		b2PushRange(m_data->queues + (i % m_workerCount), range);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_data->mutex);
+		m_data->pendingCount += rangeCount;
+	}
+	m_data->condition.notify_all();
+
+	return job;
+}
+
+void* b2ThreadPool::EnqueueBackground(b2RangeTask* task)
+{
+	if (m_workerCount == 1)
+	{
+		task->Execute(0, 1, 0);
+		return nullptr;
+	}
+
+	b2ThreadPoolJob* job = new (b2Alloc(sizeof(b2ThreadPoolJob))) b2ThreadPoolJob();
+	job->remaining = 1;
+	job->background = true;
+
+	b2ThreadPoolRange range;
+	range.task = task;
+	range.job = job;
+	range.begin = 0;
+	range.end = 1;
+	b2PushRange(&m_data->background, range);
+
+	{
+		std::lock_guard<std::mutex> lock(m_data->mutex);
+		m_data->pendingCount += 1;
+	}
+	m_data->condition.notify_one();
+
+	return job;
+}
+
+void b2ThreadPool::Wait(void* handle)
+{
+	if (handle == nullptr)
+	{
+		return;
+	}
+
+	b2ThreadPoolJob* job = (b2ThreadPoolJob*)handle;
+	while (job->remaining.load(std::memory_order_acquire) > 0)
+	{
+		// Waiting on a background task that no thread has picked up yet, so run it here.
+		if (job->background && RunBackground(0, job))
+		{
+			continue;
+		}
+
+		if (RunOne(0) == false)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	job->~b2ThreadPoolJob();
+	b2Free(job);
+}
+
+// Run a range from our own queue or steal one from another worker.
+bool b2ThreadPool::RunOne(int32 workerIndex)
+{
+	b2ThreadPoolRange range;
+	bool found = false;
+
+	for (int32 i = 0; i < m_workerCount && found == false; ++i)
+	{
+		int32 index = (workerIndex + i) % m_workerCount;
+		b2ThreadPoolQueue* queue = m_data->queues + index;
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (queue->head == queue->tail)
+		{
+			continue;
+		}
+
+		if (index == workerIndex)
+		{
+			range = queue->ranges[--queue->tail];
+		}
+		else
+		{
+			range = queue->ranges[queue->head++];
+		}
+
+		if (queue->head == queue->tail)
+		{
+			queue->head = 0;
+			queue->tail = 0;
+		}
+
+		m_data->pendingCount.fetch_sub(1);
+		found = true;
+	}
+
+	if (found == false)
+	{
+		return false;
+	}
+
+	range.task->Execute(range.begin, range.end, workerIndex);
+	range.job->remaining.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+// Run a background task. If job is not null then only that task is taken.
+bool b2ThreadPool::RunBackground(int32 workerIndex, b2ThreadPoolJob* job)
+{
+	b2ThreadPoolRange range;
+
+	{
+		b2ThreadPoolQueue* queue = &m_data->background;
+		std::lock_guard<std::mutex> lock(queue->mutex);
+
+		int32 index = queue->head;
+		if (job != nullptr)
+		{
+			while (index < queue->tail && queue->ranges[index].job != job)
+			{
+				++index;
+			}
+		}
+
+		if (index == queue->tail)
+		{
+			return false;
+		}
+
+		range = queue->ranges[index];
+		memmove(queue->ranges + index, queue->ranges + index + 1, (queue->tail - index - 1) * sizeof(b2ThreadPoolRange));
+		queue->tail -= 1;
+
+		if (queue->head == queue->tail)
+		{
+			queue->head = 0;
+			queue->tail = 0;
+		}
+
+		m_data->pendingCount.fetch_sub(1);
+	}
+
+	range.task->Execute(range.begin, range.end, workerIndex);
+	range.job->remaining.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void b2ThreadPool::WorkerMain(int32 workerIndex)
+{
+	for (;;)
+	{
+		if (RunOne(workerIndex) || RunBackground(workerIndex, nullptr))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_data->mutex);
+		while (m_data->stop == false && m_data->pendingCount.load() <= 0)
+		{
+			m_data->condition.wait(lock);
+		}
+
+		if (m_data->stop)
+		{
+			return;
+		}
+	}
+}
@@ -62,23 +62,29 @@ b2Body::b2Body(const b2BodyDef* bd, b2World* world)
 
 	m_world = world;
 
+	m_islandIndex = 0;
+	m_solverBodies = &world->m_solverBodies;
+	m_solverIndex = world->AddSolverBody(this);
+
 	m_xf.p = bd->position;
 	m_xf.q.Set(bd->angle);
 
-	m_sweep.localCenter.SetZero();
-	m_sweep.c0 = m_xf.p;
-	m_sweep.c = m_xf.p;
-	m_sweep.a0 = bd->angle;
-	m_sweep.a = bd->angle;
-	m_sweep.alpha0 = 0.0f;
+	m_localCenter.SetZero();
+	m_alpha0 = 0.0f;
+
+	b2Position& p = GetSolverPosition();
+	p.c = m_xf.p;
+	p.a = bd->angle;
+	GetSolverPosition0() = p;
 
 	m_jointList = nullptr;
 	m_contactList = nullptr;
 	m_prev = nullptr;
 	m_next = nullptr;
 
-	m_linearVelocity = bd->linearVelocity;
-	m_angularVelocity = bd->angularVelocity;
+	b2Velocity& v = GetSolverVelocity();
+	v.v = bd->linearVelocity;
+	v.w = bd->angularVelocity;
 
 	m_linearDamping = bd->linearDamping;
 	m_angularDamping = bd->angularDamping;
@@ -121,16 +127,16 @@ void b2Body::SetType(b2BodyType type)
 		return;
 	}
 
+	bool wasStatic = m_type == b2_staticBody;
 	m_type = type;
 
 	ResetMassData();
 
 	if (m_type == b2_staticBody)
 	{
-		m_linearVelocity.SetZero();
-		m_angularVelocity = 0.0f;
-		m_sweep.a0 = m_sweep.a;
-		m_sweep.c0 = m_sweep.c;
+		GetSolverVelocity().v.SetZero();
+		GetSolverVelocity().w = 0.0f;
+		GetSolverPosition0() = GetSolverPosition();
 		m_flags &= ~e_awakeFlag;
 		SynchronizeFixtures();
 	}
@@ -152,8 +158,17 @@ void b2Body::SetType(b2BodyType type)
 
 	// Touch the proxies so that new contacts will be created (when appropriate)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+	bool isStatic = m_type == b2_staticBody;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
+		// Static proxies live in their own tree.
+		if (f->m_proxyCount > 0 && isStatic != wasStatic)
+		{
+			f->DestroyProxies(broadPhase);
+			f->CreateProxies(broadPhase, m_xf);
+			continue;
+		}
+
 		int32 proxyCount = f->m_proxyCount;
 		for (int32 i = 0; i < proxyCount; ++i)
 		{
@@ -176,7 +191,8 @@ b2Fixture* b2Body::CreateFixture(const b2FixtureDef* def)
 	b2Fixture* fixture = new (memory) b2Fixture;
 	fixture->Create(allocator, this, def);
 
-	if (m_flags & e_enabledFlag)
+	// During a bulk load the world adds the proxies later.
+	if ((m_flags & e_enabledFlag) && m_world->m_bulkLoad == false)
 	{
 		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 		fixture->CreateProxies(broadPhase, m_xf);
@@ -294,14 +310,16 @@ void b2Body::ResetMassData()
 	m_invMass = 0.0f;
 	m_I = 0.0f;
 	m_invI = 0.0f;
-	m_sweep.localCenter.SetZero();
+	m_localCenter.SetZero();
 
 	// Static and kinematic bodies have zero mass.
 	if (m_type == b2_staticBody || m_type == b2_kinematicBody)
 	{
-		m_sweep.c0 = m_xf.p;
-		m_sweep.c = m_xf.p;
-		m_sweep.a0 = m_sweep.a;
+		b2Position& p = GetSolverPosition();
+		b2Position& p0 = GetSolverPosition0();
+		p0.c = m_xf.p;
+		p.c = m_xf.p;
+		p0.a = p.a;
 		return;
 	}
 
@@ -345,12 +363,14 @@ void b2Body::ResetMassData()
 	}
 
 	// Move center of mass.
-	b2Vec2 oldCenter = m_sweep.c;
-	m_sweep.localCenter = localCenter;
-	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	b2Position& p = GetSolverPosition();
+	b2Vec2 oldCenter = p.c;
+	m_localCenter = localCenter;
+	GetSolverPosition0().c = p.c = b2Mul(m_xf, m_localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	b2Velocity& v = GetSolverVelocity();
+	v.v += b2Cross(v.w, p.c - oldCenter);
 }
 
 void b2Body::SetMassData(const b2MassData* massData)
@@ -386,12 +406,14 @@ void b2Body::SetMassData(const b2MassData* massData)
 	}
 
 	// Move center of mass.
-	b2Vec2 oldCenter = m_sweep.c;
-	m_sweep.localCenter =  massData->center;
-	m_sweep.c0 = m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
+	b2Position& p = GetSolverPosition();
+	b2Vec2 oldCenter = p.c;
+	m_localCenter =  massData->center;
+	GetSolverPosition0().c = p.c = b2Mul(m_xf, m_localCenter);
 
 	// Update center of mass velocity.
-	m_linearVelocity += b2Cross(m_angularVelocity, m_sweep.c - oldCenter);
+	b2Velocity& v = GetSolverVelocity();
+	v.v += b2Cross(v.w, p.c - oldCenter);
 }
 
 bool b2Body::ShouldCollide(const b2Body* other) const
@@ -428,11 +450,11 @@ void b2Body::SetTransform(const b2Vec2& position, float angle)
 	m_xf.q.Set(angle);
 	m_xf.p = position;
 
-	m_sweep.c = b2Mul(m_xf, m_sweep.localCenter);
-	m_sweep.a = angle;
+	b2Position& p = GetSolverPosition();
+	p.c = b2Mul(m_xf, m_localCenter);
+	p.a = angle;
 
-	m_sweep.c0 = m_sweep.c;
-	m_sweep.a0 = angle;
+	GetSolverPosition0() = p;
 
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
@@ -450,9 +472,10 @@ void b2Body::SynchronizeFixtures()
 
 	if (m_flags & b2Body::e_awakeFlag)
 	{
+		const b2Position& p0 = GetSolverPosition0();
 		b2Transform xf1;
-		xf1.q.Set(m_sweep.a0);
-		xf1.p = m_sweep.c0 - b2Mul(xf1.q, m_sweep.localCenter);
+		xf1.q.Set(p0.a);
+		xf1.p = p0.c - b2Mul(xf1.q, m_localCenter);
 
 		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 		{
@@ -468,6 +491,38 @@ void b2Body::SynchronizeFixtures()
 	}
 }
 
+void b2Body::SweepFixtures()
+{
+	if (m_flags & b2Body::e_awakeFlag)
+	{
+		const b2Position& p0 = GetSolverPosition0();
+		b2Transform xf1;
+		xf1.q.Set(p0.a);
+		xf1.p = p0.c - b2Mul(xf1.q, m_localCenter);
+
+		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		{
+			f->SweepProxies(xf1, m_xf);
+		}
+	}
+	else
+	{
+		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		{
+			f->SweepProxies(m_xf, m_xf);
+		}
+	}
+}
+
+void b2Body::MoveFixtureProxies()
+{
+	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		f->MoveProxies(broadPhase);
+	}
+}
+
 void b2Body::SetEnabled(bool flag)
 {
 	b2Assert(m_world->IsLocked() == false);
@@ -531,7 +586,7 @@ void b2Body::SetFixedRotation(bool flag)
 		m_flags &= ~e_fixedRotationFlag;
 	}
 
-	m_angularVelocity = 0.0f;
+	GetSolverVelocity().w = 0.0f;
 
 	ResetMassData();
 }
@@ -547,9 +602,10 @@ void b2Body::Dump()
 	b2Dump("  b2BodyDef bd;\n");
 	b2Dump("  bd.type = b2BodyType(%d);\n", m_type);
 	b2Dump("  bd.position.Set(%.9g, %.9g);\n", m_xf.p.x, m_xf.p.y);
-	b2Dump("  bd.angle = %.9g;\n", m_sweep.a);
-	b2Dump("  bd.linearVelocity.Set(%.9g, %.9g);\n", m_linearVelocity.x, m_linearVelocity.y);
-	b2Dump("  bd.angularVelocity = %.9g;\n", m_angularVelocity);
+	const b2Velocity& v = GetSolverVelocity();
+	b2Dump("  bd.angle = %.9g;\n", GetSolverPosition().a);
+	b2Dump("  bd.linearVelocity.Set(%.9g, %.9g);\n", v.v.x, v.v.y);
+	b2Dump("  bd.angularVelocity = %.9g;\n", v.w);
 	b2Dump("  bd.linearDamping = %.9g;\n", m_linearDamping);
 	b2Dump("  bd.angularDamping = %.9g;\n", m_angularDamping);
 	b2Dump("  bd.allowSleep = bool(%d);\n", m_flags & e_autoSleepFlag);
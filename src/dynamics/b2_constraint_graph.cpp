@@ -0,0 +1,302 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "b2_constraint_graph.h"
+#include "b2_contact_solver.h"
+#include "b2_island.h"
+
+#include "box2d/b2_body.h"
+#include "box2d/b2_joint.h"
+#include "box2d/b2_stack_allocator.h"
+
+// Constraints are more expensive than bodies, so a color is split into smaller ranges.
+#define b2_minColorRange (b2_minTaskRange / 4)
+
+static bool b2IsMovable(float invMass, float invI)
+{
+	return invMass != 0.0f || invI != 0.0f;
+}
+
+// Find the first color not used by the bodies, or the overflow color. Bodies without mass
+// are passed as -1 and do not restrict the color.
+static int32 b2AssignColor(uint32* bodyColors, int32 indexA, int32 indexB)
+{
+	uint32 used = 0;
+	if (indexA != -1)
+	{
+		used |= bodyColors[indexA];
+	}
+	if (indexB != -1)
+	{
+		used |= bodyColors[indexB];
+	}
+
+	for (int32 color = 0; color < b2_graphColorCount; ++color)
+	{
+		uint32 bit = 1u << color;
+		if ((used & bit) == 0)
+		{
+			if (indexA != -1)
+			{
+				bodyColors[indexA] |= bit;
+			}
+			if (indexB != -1)
+			{
+				bodyColors[indexB] |= bit;
+			}
+			return color;
+		}
+	}
+
+	return b2_graphColorCount;
+}
+
+// Sort the constraints by color, keeping the island order within a color.
+static void b2SortByColor(int32* sorted, int32* starts, const int32* colors, int32 count)
+{
+	for (int32 color = 0; color < b2_graphColorCount + 2; ++color)
+	{
+		starts[color] = 0;
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		++starts[colors[i] + 1];
+	}
+
+	for (int32 color = 0; color < b2_graphColorCount + 1; ++color)
+	{
+		starts[color + 1] += starts[color];
+	}
+
+	int32 offsets[b2_graphColorCount + 1];
+	for (int32 color = 0; color < b2_graphColorCount + 1; ++color)
+	{
+		offsets[color] = starts[color];
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		sorted[offsets[colors[i]]++] = i;
+	}
+}
+
+b2ConstraintGraph::b2ConstraintGraph(b2Island* island, b2ContactSolver* contactSolver, const b2SolverData* data, b2TaskScheduler* scheduler)
+{
+	m_island = island;
+	m_contactSolver = contactSolver;
+	m_data = data;
+	m_scheduler = scheduler;
+	m_workerCount = scheduler != nullptr ? b2Max(scheduler->GetWorkerCount(), 1) : 1;
+	m_stage = e_initialize;
+	m_color = 0;
+
+	b2StackAllocator* allocator = island->m_allocator;
+	int32 contactCount = contactSolver->m_count;
+	int32 jointCount = island->m_jointCount;
+
+	m_positionSolved = (bool*)allocator->Allocate(m_workerCount * sizeof(bool));
+	m_contacts = (int32*)allocator->Allocate(contactCount * sizeof(int32));
+	m_joints = (int32*)allocator->Allocate(jointCount * sizeof(int32));
+
+	// The used colors of each body, indexed by island index.
+	int32 indexCount = 0;
+	for (int32 i = 0; i < island->m_bodyCount; ++i)
+	{
+		indexCount = b2Max(indexCount, island->m_bodies[i]->m_islandIndex + 1);
+	}
+
+	uint32* bodyColors = (uint32*)allocator->Allocate(indexCount * sizeof(uint32));
+	for (int32 i = 0; i < island->m_bodyCount; ++i)
+	{
+		bodyColors[island->m_bodies[i]->m_islandIndex] = 0;
+	}
+
+	int32* colors = (int32*)allocator->Allocate(b2Max(contactCount, jointCount) * sizeof(int32));
+
+	// Joints always write both bodies, so joints attached to a body without mass are
+	// solved serially. Gear joints use four bodies and are solved serially too.
+	for (int32 i = 0; i < jointCount; ++i)
+	{
+		const b2Joint* joint = island->m_joints[i];
+		const b2Body* bodyA = joint->m_bodyA;
+		const b2Body* bodyB = joint->m_bodyB;
+
+		if (joint->m_type == e_gearJoint ||
+			b2IsMovable(bodyA->m_invMass, bodyA->m_invI) == false ||
+			b2IsMovable(bodyB->m_invMass, bodyB->m_invI) == false)
+		{
+			colors[i] = b2_graphColorCount;
+			continue;
+		}
+
+		colors[i] = b2AssignColor(bodyColors, bodyA->m_islandIndex, bodyB->m_islandIndex);
+	}
+
+	b2SortByColor(m_joints, m_jointStarts, colors, jointCount);
+
+	// Contacts never write bodies without mass when they are colored, so those bodies
+	// may be shared within a color.
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = contactSolver->m_velocityConstraints + i;
+		int32 indexA = b2IsMovable(vc->invMassA, vc->invIA) ? vc->indexA : -1;
+		int32 indexB = b2IsMovable(vc->invMassB, vc->invIB) ? vc->indexB : -1;
+		colors[i] = b2AssignColor(bodyColors, indexA, indexB);
+	}
+
+	b2SortByColor(m_contacts, m_contactStarts, colors, contactCount);
+
+	allocator->Free(colors);
+	allocator->Free(bodyColors);
+}
+
+b2ConstraintGraph::~b2ConstraintGraph()
+{
+	b2StackAllocator* allocator = m_island->m_allocator;
+	allocator->Free(m_joints);
+	allocator->Free(m_contacts);
+	allocator->Free(m_positionSolved);
+}
+
+void b2ConstraintGraph::InitializeVelocityConstraints()
+{
+	// The position dependent part of the contact constraints is independent per contact.
+	m_stage = e_initialize;
+	b2ExecuteTask(m_scheduler, this, m_contactSolver->m_count, b2_minColorRange);
+
+	SolveColors(e_warmStart);
+}
+
+void b2ConstraintGraph::SolveVelocityConstraints()
+{
+	SolveColors(e_solveVelocity);
+}
+
+bool b2ConstraintGraph::SolvePositionConstraints()
+{
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		m_positionSolved[i] = true;
+	}
+
+	SolveColors(e_solvePosition);
+
+	bool solved = true;
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		solved = solved && m_positionSolved[i];
+	}
+	return solved;
+}
+
+void b2ConstraintGraph::SolveColors(Stage stage)
+{
+	m_stage = stage;
+
+	for (int32 color = 0; color < b2_graphColorCount; ++color)
+	{
+		int32 jointCount = m_jointStarts[color + 1] - m_jointStarts[color];
+		int32 contactCount = m_contactStarts[color + 1] - m_contactStarts[color];
+
+		m_color = color;
+		b2ExecuteTask(m_scheduler, this, jointCount + contactCount, b2_minColorRange);
+	}
+
+	// The remaining constraints are solved on this thread.
+	m_color = b2_graphColorCount;
+	int32 jointCount = m_jointStarts[m_color + 1] - m_jointStarts[m_color];
+	int32 contactCount = m_contactStarts[m_color + 1] - m_contactStarts[m_color];
+	if (jointCount + contactCount > 0)
+	{
+		Execute(0, jointCount + contactCount, 0);
+	}
+}
+
+void b2ConstraintGraph::Execute(int32 begin, int32 end, int32 workerIndex)
+{
+	if (m_stage == e_initialize)
+	{
+		m_contactSolver->InitializeVelocityConstraints(begin, end);
+		return;
+	}
+
+	// The items of a color are its joints followed by its contacts.
+	const int32* joints = m_joints + m_jointStarts[m_color];
+	int32 jointCount = m_jointStarts[m_color + 1] - m_jointStarts[m_color];
+	const int32* contacts = m_contacts + m_contactStarts[m_color];
+
+	int32 jointEnd = b2Min(end, jointCount);
+	int32 contactBegin = b2Max(begin, jointCount) - jointCount;
+	int32 contactCount = end - jointCount - contactBegin;
+
+	b2Joint** islandJoints = m_island->m_joints;
+
+	switch (m_stage)
+	{
+	case e_warmStart:
+		for (int32 i = begin; i < jointEnd; ++i)
+		{
+			islandJoints[joints[i]]->InitVelocityConstraints(*m_data);
+		}
+
+		if (contactCount > 0 && m_data->step.warmStarting)
+		{
+			m_contactSolver->WarmStart(contacts + contactBegin, contactCount);
+		}
+		break;
+
+	case e_solveVelocity:
+		for (int32 i = begin; i < jointEnd; ++i)
+		{
+			islandJoints[joints[i]]->SolveVelocityConstraints(*m_data);
+		}
+
+		if (contactCount > 0)
+		{
+			m_contactSolver->SolveVelocityConstraints(contacts + contactBegin, contactCount);
+		}
+		break;
+
+	case e_solvePosition:
+		{
+			bool solved = true;
+			for (int32 i = begin; i < jointEnd; ++i)
+			{
+				bool jointOkay = islandJoints[joints[i]]->SolvePositionConstraints(*m_data);
+				solved = solved && jointOkay;
+			}
+
+			if (contactCount > 0)
+			{
+				bool contactsOkay = m_contactSolver->SolvePositionConstraints(contacts + contactBegin, contactCount);
+				solved = solved && contactsOkay;
+			}
+
+			m_positionSolved[workerIndex] = m_positionSolved[workerIndex] && solved;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
@@ -0,0 +1,92 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_CONSTRAINT_GRAPH_H
+#define B2_CONSTRAINT_GRAPH_H
+
+#include "box2d/b2_common.h"
+#include "box2d/b2_task_scheduler.h"
+#include "box2d/b2_time_step.h"
+
+class b2ContactSolver;
+class b2Island;
+
+/// Large islands are split into graph colors when graph coloring is enabled.
+inline bool b2IsColoredIsland(const b2TimeStep& step, int32 contactCount, int32 jointCount)
+{
+	return step.graphColoring && step.softStep == false && contactCount + jointCount >= b2_minColoredConstraints;
+}
+
+/// Splits the contacts and joints of an island into colors. No two constraints of a color
+/// share a body with mass, so the constraints of a color are solved in parallel. The colors
+/// are solved one after another and the constraints that did not fit in a color are solved
+/// serially after them. The results do not depend on the number of workers.
+/// This is an internal class.
+class b2ConstraintGraph : public b2RangeTask
+{
+public:
+	b2ConstraintGraph(b2Island* island, b2ContactSolver* contactSolver, const b2SolverData* data, b2TaskScheduler* scheduler);
+	~b2ConstraintGraph();
+
+	/// Initialize the contact and joint constraints and warm start them.
+	void InitializeVelocityConstraints();
+
+	void SolveVelocityConstraints();
+
+	/// @return true if the position errors are small.
+	bool SolvePositionConstraints();
+
+	void Execute(int32 begin, int32 end, int32 workerIndex) override;
+
+private:
+
+	enum Stage
+	{
+		e_initialize,
+		e_warmStart,
+		e_solveVelocity,
+		e_solvePosition
+	};
+
+	void SolveColors(Stage stage);
+
+	b2Island* m_island;
+	b2ContactSolver* m_contactSolver;
+	const b2SolverData* m_data;
+	b2TaskScheduler* m_scheduler;
+	int32 m_workerCount;
+
+	// Constraint indices sorted by color. The last color holds the constraints that are
+	// solved serially. The constraints of color c are [starts[c], starts[c + 1]).
+	int32* m_contacts;
+	int32* m_joints;
+	int32 m_contactStarts[b2_graphColorCount + 2];
+	int32 m_jointStarts[b2_graphColorCount + 2];
+
+	// Position solver results per worker.
+	bool* m_positionSolved;
+
+	Stage m_stage;
+	int32 m_color;
+};
+
+#endif
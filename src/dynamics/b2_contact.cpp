@@ -20,12 +20,17 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "b2_capsule_circle_contact.h"
+#include "b2_capsule_contact.h"
+#include "b2_chain_capsule_contact.h"
 #include "b2_chain_circle_contact.h"
 #include "b2_chain_polygon_contact.h"
 #include "b2_circle_contact.h"
 #include "b2_contact_solver.h"
+#include "b2_edge_capsule_contact.h"
 #include "b2_edge_circle_contact.h"
 #include "b2_edge_polygon_contact.h"
+#include "b2_polygon_capsule_contact.h"
 #include "b2_polygon_circle_contact.h"
 #include "b2_polygon_contact.h"
 
@@ -50,6 +55,11 @@ void b2Contact::InitializeRegisters()
 	AddType(b2EdgeAndPolygonContact::Create, b2EdgeAndPolygonContact::Destroy, b2Shape::e_edge, b2Shape::e_polygon);
 	AddType(b2ChainAndCircleContact::Create, b2ChainAndCircleContact::Destroy, b2Shape::e_chain, b2Shape::e_circle);
 	AddType(b2ChainAndPolygonContact::Create, b2ChainAndPolygonContact::Destroy, b2Shape::e_chain, b2Shape::e_polygon);
+	AddType(b2CapsuleAndCircleContact::Create, b2CapsuleAndCircleContact::Destroy, b2Shape::e_capsule, b2Shape::e_circle);
+	AddType(b2CapsuleContact::Create, b2CapsuleContact::Destroy, b2Shape::e_capsule, b2Shape::e_capsule);
+	AddType(b2PolygonAndCapsuleContact::Create, b2PolygonAndCapsuleContact::Destroy, b2Shape::e_polygon, b2Shape::e_capsule);
+	AddType(b2EdgeAndCapsuleContact::Create, b2EdgeAndCapsuleContact::Destroy, b2Shape::e_edge, b2Shape::e_capsule);
+	AddType(b2ChainAndCapsuleContact::Create, b2ChainAndCapsuleContact::Destroy, b2Shape::e_chain, b2Shape::e_capsule);
 }
 
 void b2Contact::AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* destoryFcn,
@@ -139,8 +149,8 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 
 	m_manifold.pointCount = 0;
 
-	m_prev = nullptr;
-	m_next = nullptr;
+	m_manager = nullptr;
+	m_managerIndex = -1;
 
 	m_nodeA.contact = nullptr;
 	m_nodeA.prev = nullptr;
@@ -165,13 +175,14 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 // Note: do not assume the fixture AABBs are overlapping or are valid.
 void b2Contact::Update(b2ContactListener* listener)
 {
-	b2Manifold oldManifold = m_manifold;
-
-	// Re-enable this contact.
-	m_flags |= e_enabledFlag;
+	b2Manifold manifold;
+	bool touching = ComputeManifold(&manifold);
+	FinishUpdate(manifold, touching, listener);
+}
 
-	bool touching = false;
-	bool wasTouching = (m_flags & e_touchingFlag) == e_touchingFlag;
+bool b2Contact::ComputeManifold(b2Manifold* manifold)
+{
+	const b2Manifold* oldManifold = &m_manifold;
 
 	bool sensorA = m_fixtureA->IsSensor();
 	bool sensorB = m_fixtureB->IsSensor();
@@ -182,48 +193,77 @@ void b2Contact::Update(b2ContactListener* listener)
 	const b2Transform& xfA = bodyA->GetTransform();
 	const b2Transform& xfB = bodyB->GetTransform();
 
+	// Start from the old manifold, as if it was updated in place.
+	*manifold = *oldManifold;
+
 	// Is this contact a sensor?
 	if (sensor)
 	{
 		const b2Shape* shapeA = m_fixtureA->GetShape();
 		const b2Shape* shapeB = m_fixtureB->GetShape();
-		touching = b2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB);
 
 		// Sensors don't generate manifolds.
-		m_manifold.pointCount = 0;
+		manifold->pointCount = 0;
+
+		return b2TestOverlap(shapeA, m_indexA, shapeB, m_indexB, xfA, xfB);
 	}
-	else
+
+	Evaluate(manifold, xfA, xfB);
+
+	// Match old contact ids to new contact ids and copy the
+	// stored impulses to warm start the solver.
+	for (int32 i = 0; i < manifold->pointCount; ++i)
 	{
-		Evaluate(&m_manifold, xfA, xfB);
-		touching = m_manifold.pointCount > 0;
+		b2ManifoldPoint* mp2 = manifold->points + i;
+		mp2->normalImpulse = 0.0f;
+		mp2->tangentImpulse = 0.0f;
+		b2ContactID id2 = mp2->id;
 
-		// Match old contact ids to new contact ids and copy the
-		// stored impulses to warm start the solver.
-		for (int32 i = 0; i < m_manifold.pointCount; ++i)
+		for (int32 j = 0; j < oldManifold->pointCount; ++j)
 		{
-			b2ManifoldPoint* mp2 = m_manifold.points + i;
-			mp2->normalImpulse = 0.0f;
-			mp2->tangentImpulse = 0.0f;
-			b2ContactID id2 = mp2->id;
+			const b2ManifoldPoint* mp1 = oldManifold->points + j;
 
-			for (int32 j = 0; j < oldManifold.pointCount; ++j)
+			if (mp1->id.key == id2.key)
 			{
-				b2ManifoldPoint* mp1 = oldManifold.points + j;
-
-				if (mp1->id.key == id2.key)
-				{
-					mp2->normalImpulse = mp1->normalImpulse;
-					mp2->tangentImpulse = mp1->tangentImpulse;
-					break;
-				}
+				mp2->normalImpulse = mp1->normalImpulse;
+				mp2->tangentImpulse = mp1->tangentImpulse;
+				break;
 			}
 		}
+	}
 
-		if (touching != wasTouching)
-		{
-			bodyA->SetAwake(true);
-			bodyB->SetAwake(true);
-		}
+	return manifold->pointCount > 0;
+}
+
+void b2Contact::FinishUpdate(const b2Manifold& manifold, bool touching, b2ContactListener* listener)
+{
+	b2Manifold oldManifold = m_manifold;
+	m_manifold = manifold;
+
+	// Re-enable this contact.
+	m_flags |= e_enabledFlag;
+
+	bool wasTouching = (m_flags & e_touchingFlag) == e_touchingFlag;
+
+	bool sensorA = m_fixtureA->IsSensor();
+	bool sensorB = m_fixtureB->IsSensor();
+	bool sensor = sensorA || sensorB;
+
+	// Remember where the manifold was computed. Sensors have no manifold to reuse.
+	if (sensor)
+	{
+		m_flags &= ~e_reusableFlag;
+	}
+	else
+	{
+		m_relativeXf = b2MulT(m_fixtureA->GetBody()->GetTransform(), m_fixtureB->GetBody()->GetTransform());
+		m_flags |= e_reusableFlag;
+	}
+
+	if (sensor == false && touching != wasTouching)
+	{
+		m_fixtureA->GetBody()->SetAwake(true);
+		m_fixtureB->GetBody()->SetAwake(true);
 	}
 
 	if (touching)
@@ -250,3 +290,35 @@ void b2Contact::Update(b2ContactListener* listener)
 		listener->PreSolve(this, &oldManifold);
 	}
 }
+
+bool b2Contact::CanReuseManifold() const
+{
+	if ((m_flags & e_reusableFlag) == 0 || m_fixtureA->IsSensor() || m_fixtureB->IsSensor())
+	{
+		return false;
+	}
+
+	b2Transform xf = b2MulT(m_fixtureA->GetBody()->GetTransform(), m_fixtureB->GetBody()->GetTransform());
+
+	b2Vec2 d = xf.p - m_relativeXf.p;
+	if (b2Dot(d, d) > b2_manifoldReuseLinearSlop * b2_manifoldReuseLinearSlop)
+	{
+		return false;
+	}
+
+	// The sine and cosine of the rotation since the manifold was computed.
+	b2Rot q = b2MulT(m_relativeXf.q, xf.q);
+	return q.c > 0.0f && b2Abs(q.s) <= b2_manifoldReuseAngularSlop;
+}
+
+void b2Contact::ReuseManifold(b2ContactListener* listener)
+{
+	// Re-enable this contact.
+	m_flags |= e_enabledFlag;
+
+	// The touching state is unchanged, so only PreSolve is reported.
+	if ((m_flags & e_touchingFlag) && listener)
+	{
+		listener->PreSolve(this, &m_manifold);
+	}
+}
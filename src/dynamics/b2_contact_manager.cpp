@@ -24,48 +24,137 @@
 #include "box2d/b2_contact.h"
 #include "box2d/b2_contact_manager.h"
 #include "box2d/b2_fixture.h"
+#include "box2d/b2_task_scheduler.h"
 #include "box2d/b2_world_callbacks.h"
 
+#include <string.h>
+
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
 
 b2ContactManager::b2ContactManager()
 {
-	m_contactList = nullptr;
+	m_contactCapacity = 256;
 	m_contactCount = 0;
+	m_contacts = (b2Contact**)b2Alloc(m_contactCapacity * sizeof(b2Contact*));
+	m_contactTableCapacity = 2 * m_contactCapacity;
+	m_contactTable = (b2Contact**)b2Alloc(m_contactTableCapacity * sizeof(b2Contact*));
+	memset(m_contactTable, 0, m_contactTableCapacity * sizeof(b2Contact*));
+	m_reuseManifolds = false;
+	m_reusedManifoldCount = 0;
+	m_updates = nullptr;
+	m_updateCapacity = 0;
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = nullptr;
+	m_taskScheduler = nullptr;
 }
 
-void b2ContactManager::Destroy(b2Contact* c)
+b2ContactManager::~b2ContactManager()
 {
-	b2Fixture* fixtureA = c->GetFixtureA();
-	b2Fixture* fixtureB = c->GetFixtureB();
-	b2Body* bodyA = fixtureA->GetBody();
-	b2Body* bodyB = fixtureB->GetBody();
+	b2Free(m_contacts);
+	b2Free(m_contactTable);
+	b2Free(m_updates);
+}
 
-	if (m_contactListener && c->IsTouching())
+// The hash does not depend on the order of the fixture children.
+int32 b2ContactManager::GetTableSlot(const b2Fixture* fixtureA, int32 indexA, const b2Fixture* fixtureB, int32 indexB) const
+{
+	uint64 keyA = uint64(uintptr_t(fixtureA)) + uint64(indexA);
+	uint64 keyB = uint64(uintptr_t(fixtureB)) + uint64(indexB);
+	uint64 hash = (keyA ^ keyB) * 0x9E3779B97F4A7C15ull + (keyA + keyB);
+	hash ^= hash >> 32;
+	return int32(hash & uint64(m_contactTableCapacity - 1));
+}
+
+static inline bool b2IsContactOf(const b2Contact* c, const b2Fixture* fixtureA, int32 indexA, const b2Fixture* fixtureB, int32 indexB)
+{
+	const b2Fixture* fA = c->GetFixtureA();
+	const b2Fixture* fB = c->GetFixtureB();
+	int32 iA = c->GetChildIndexA();
+	int32 iB = c->GetChildIndexB();
+
+	return (fA == fixtureA && fB == fixtureB && iA == indexA && iB == indexB) ||
+		(fA == fixtureB && fB == fixtureA && iA == indexB && iB == indexA);
+}
+
+b2Contact* b2ContactManager::FindContact(const b2Fixture* fixtureA, int32 indexA, const b2Fixture* fixtureB, int32 indexB) const
+{
+	int32 mask = m_contactTableCapacity - 1;
+	for (int32 slot = GetTableSlot(fixtureA, indexA, fixtureB, indexB); m_contactTable[slot] != nullptr; slot = (slot + 1) & mask)
 	{
-		m_contactListener->EndContact(c);
+		b2Contact* c = m_contactTable[slot];
+		if (b2IsContactOf(c, fixtureA, indexA, fixtureB, indexB))
+		{
+			return c;
+		}
 	}
 
-	// Remove from the world.
-	if (c->m_prev)
+	return nullptr;
+}
+
+void b2ContactManager::InsertIntoTable(b2Contact* c)
+{
+	int32 mask = m_contactTableCapacity - 1;
+	int32 slot = GetTableSlot(c->GetFixtureA(), c->GetChildIndexA(), c->GetFixtureB(), c->GetChildIndexB());
+	while (m_contactTable[slot] != nullptr)
 	{
-		c->m_prev->m_next = c->m_next;
+		slot = (slot + 1) & mask;
 	}
 
-	if (c->m_next)
+	m_contactTable[slot] = c;
+}
+
+void b2ContactManager::RemoveFromTable(b2Contact* c)
+{
+	int32 mask = m_contactTableCapacity - 1;
+	int32 slot = GetTableSlot(c->GetFixtureA(), c->GetChildIndexA(), c->GetFixtureB(), c->GetChildIndexB());
+	while (m_contactTable[slot] != c)
 	{
-		c->m_next->m_prev = c->m_prev;
+		b2Assert(m_contactTable[slot] != nullptr);
+		slot = (slot + 1) & mask;
 	}
 
-	if (c == m_contactList)
+	// Shift back the contacts that probed past the hole so every contact stays
+	// reachable from its home slot.
+	int32 hole = slot;
+	for (int32 next = (hole + 1) & mask; m_contactTable[next] != nullptr; next = (next + 1) & mask)
 	{
-		m_contactList = c->m_next;
+		b2Contact* other = m_contactTable[next];
+		int32 home = GetTableSlot(other->GetFixtureA(), other->GetChildIndexA(), other->GetFixtureB(), other->GetChildIndexB());
+
+		// Can the contact move to the hole? That is, is home cyclically outside (hole, next]?
+		if (((next - home) & mask) >= ((next - hole) & mask))
+		{
+			m_contactTable[hole] = other;
+			hole = next;
+		}
 	}
 
+	m_contactTable[hole] = nullptr;
+}
+
+void b2ContactManager::Destroy(b2Contact* c)
+{
+	b2Fixture* fixtureA = c->GetFixtureA();
+	b2Fixture* fixtureB = c->GetFixtureB();
+	b2Body* bodyA = fixtureA->GetBody();
+	b2Body* bodyB = fixtureB->GetBody();
+
+	if (m_contactListener && c->IsTouching())
+	{
+		m_contactListener->EndContact(c);
+	}
+
+	RemoveFromTable(c);
+
+	// Remove from the world. The last contact fills the hole.
+	int32 index = c->m_managerIndex;
+	b2Assert(0 <= index && index < m_contactCount && m_contacts[index] == c);
+	b2Contact* last = m_contacts[m_contactCount - 1];
+	m_contacts[index] = last;
+	last->m_managerIndex = index;
+
 	// Remove from body 1
 	if (c->m_nodeA.prev)
 	{
@@ -103,79 +192,177 @@ void b2ContactManager::Destroy(b2Contact* c)
 	--m_contactCount;
 }
 
+// A contact and its manifold computed in advance.
+struct b2ContactUpdate
+{
+	b2Contact* contact;
+	b2Manifold manifold;
+	bool computed;
+	bool touching;
+};
+
+// Computes the manifolds of the active contacts for b2ContactManager::Collide.
+class b2ComputeManifoldsTask : public b2RangeTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 workerIndex) override
+	{
+		B2_NOT_USED(workerIndex);
+		m_contactManager->ComputeManifolds(begin, end);
+	}
+
+	b2ContactManager* m_contactManager;
+};
+
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
 // contact list.
 void b2ContactManager::Collide()
 {
-	// Update awake contacts.
-	b2Contact* c = m_contactList;
-	while (c)
-	{
-		b2Fixture* fixtureA = c->GetFixtureA();
-		b2Fixture* fixtureB = c->GetFixtureB();
-		int32 indexA = c->GetChildIndexA();
-		int32 indexB = c->GetChildIndexB();
-		b2Body* bodyA = fixtureA->GetBody();
-		b2Body* bodyB = fixtureB->GetBody();
-		 
-		// Is this contact flagged for filtering?
-		if (c->m_flags & b2Contact::e_filterFlag)
+	// The contacts are visited from the end of the array so that a destroyed contact is
+	// only ever replaced by one that has already been updated.
+	if (m_taskScheduler == nullptr || m_taskScheduler->GetWorkerCount() <= 1)
+	{
+		// Update awake contacts.
+		for (int32 i = m_contactCount - 1; i >= 0; --i)
 		{
-			// Should these bodies collide?
-			if (bodyB->ShouldCollide(bodyA) == false)
-			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
-				continue;
-			}
-
-			// Check user filtering.
-			if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
-			{
-				b2Contact* cNuke = c;
-				c = cNuke->GetNext();
-				Destroy(cNuke);
-				continue;
-			}
-
-			// Clear the filtering flag.
-			c->m_flags &= ~b2Contact::e_filterFlag;
+			UpdateContact(m_contacts[i], nullptr, false);
 		}
+		return;
+	}
 
+	int32 count = m_contactCount;
+	if (count > m_updateCapacity)
+	{
+		b2Free(m_updates);
+		m_updateCapacity = b2Max(2 * m_updateCapacity, count);
+		m_updates = (b2ContactUpdate*)b2Alloc(m_updateCapacity * sizeof(b2ContactUpdate));
+	}
+
+	// Compute the manifolds of the active contacts in parallel. Computing a manifold
+	// does not change the contact, so the results can be thrown away.
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Contact* c = m_contacts[i];
+		b2ContactUpdate* update = m_updates + i;
+		update->contact = c;
+
+		b2Body* bodyA = c->GetFixtureA()->GetBody();
+		b2Body* bodyB = c->GetFixtureB()->GetBody();
 		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
 		bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+		bool reuse = m_reuseManifolds && c->CanReuseManifold();
+		update->computed = (activeA || activeB) && reuse == false;
+	}
+
+	b2ComputeManifoldsTask task;
+	task.m_contactManager = this;
+	b2ExecuteTask(m_taskScheduler, &task, count, b2_minTaskRange);
+
+	// Filter, destroy, and report in the same order as the serial path. Callbacks can
+	// wake bodies, so contacts that were skipped above are computed here if needed.
+	for (int32 i = count - 1; i >= 0; --i)
+	{
+		b2ContactUpdate* update = m_updates + i;
+		if (update->computed)
+		{
+			UpdateContact(update->contact, &update->manifold, update->touching);
+		}
+		else
+		{
+			UpdateContact(update->contact, nullptr, false);
+		}
+	}
+}
 
-		// At least one body must be awake and it must be dynamic or kinematic.
-		if (activeA == false && activeB == false)
+void b2ContactManager::ComputeManifolds(int32 begin, int32 end)
+{
+	for (int32 i = begin; i < end; ++i)
+	{
+		b2ContactUpdate* update = m_updates + i;
+		if (update->computed)
 		{
-			c = c->GetNext();
-			continue;
+			update->touching = update->contact->ComputeManifold(&update->manifold);
 		}
+	}
+}
+
+void b2ContactManager::UpdateContact(b2Contact* c, const b2Manifold* manifold, bool touching)
+{
+	b2Fixture* fixtureA = c->GetFixtureA();
+	b2Fixture* fixtureB = c->GetFixtureB();
+	int32 indexA = c->GetChildIndexA();
+	int32 indexB = c->GetChildIndexB();
+	b2Body* bodyA = fixtureA->GetBody();
+	b2Body* bodyB = fixtureB->GetBody();
 
-		int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
-		int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
-		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+	// Is this contact flagged for filtering?
+	if (c->m_flags & b2Contact::e_filterFlag)
+	{
+		// Should these bodies collide?
+		if (bodyB->ShouldCollide(bodyA) == false)
+		{
+			Destroy(c);
+			return;
+		}
 
-		// Here we destroy contacts that cease to overlap in the broad-phase.
-		if (overlap == false)
+		// Check user filtering.
+		if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
 		{
-			b2Contact* cNuke = c;
-			c = cNuke->GetNext();
-			Destroy(cNuke);
-			continue;
+			Destroy(c);
+			return;
 		}
 
-		// The contact persists.
+		// Clear the filtering flag.
+		c->m_flags &= ~b2Contact::e_filterFlag;
+	}
+
+	bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+	bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+
+	// At least one body must be awake and it must be dynamic or kinematic.
+	if (activeA == false && activeB == false)
+	{
+		return;
+	}
+
+	int32 proxyIdA = fixtureA->m_proxies[indexA].proxyId;
+	int32 proxyIdB = fixtureB->m_proxies[indexB].proxyId;
+	bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+
+	// Here we destroy contacts that cease to overlap in the broad-phase.
+	if (overlap == false)
+	{
+		Destroy(c);
+		return;
+	}
+
+	// The contact persists.
+	if (m_reuseManifolds && c->CanReuseManifold())
+	{
+		++m_reusedManifoldCount;
+		c->ReuseManifold(m_contactListener);
+	}
+	else if (manifold != nullptr)
+	{
+		c->FinishUpdate(*manifold, touching, m_contactListener);
+	}
+	else
+	{
 		c->Update(m_contactListener);
-		c = c->GetNext();
 	}
 }
 
 void b2ContactManager::FindNewContacts()
 {
-	m_broadPhase.UpdatePairs(this);
+	if (m_taskScheduler != nullptr && m_taskScheduler->GetWorkerCount() > 1)
+	{
+		m_broadPhase.UpdatePairs(this, m_taskScheduler);
+	}
+	else
+	{
+		m_broadPhase.UpdatePairs(this);
+	}
 }
 
 void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
@@ -198,33 +385,10 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 		return;
 	}
 
-	// TODO_ERIN use a hash table to remove a potential bottleneck when both
-	// bodies have a lot of contacts.
 	// Does a contact already exist?
-	b2ContactEdge* edge = bodyB->GetContactList();
-	while (edge)
+	if (FindContact(fixtureA, indexA, fixtureB, indexB) != nullptr)
 	{
-		if (edge->other == bodyA)
-		{
-			b2Fixture* fA = edge->contact->GetFixtureA();
-			b2Fixture* fB = edge->contact->GetFixtureB();
-			int32 iA = edge->contact->GetChildIndexA();
-			int32 iB = edge->contact->GetChildIndexB();
-
-			if (fA == fixtureA && fB == fixtureB && iA == indexA && iB == indexB)
-			{
-				// A contact already exists.
-				return;
-			}
-
-			if (fA == fixtureB && fB == fixtureA && iA == indexB && iB == indexA)
-			{
-				// A contact already exists.
-				return;
-			}
-		}
-
-		edge = edge->next;
+		return;
 	}
 
 	// Does a joint override collision? Is at least one body dynamic?
@@ -255,13 +419,33 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 	bodyB = fixtureB->GetBody();
 
 	// Insert into the world.
-	c->m_prev = nullptr;
-	c->m_next = m_contactList;
-	if (m_contactList != nullptr)
+	if (m_contactCount == m_contactCapacity)
 	{
-		m_contactList->m_prev = c;
+		b2Contact** oldContacts = m_contacts;
+		m_contactCapacity *= 2;
+		m_contacts = (b2Contact**)b2Alloc(m_contactCapacity * sizeof(b2Contact*));
+		memcpy(m_contacts, oldContacts, m_contactCount * sizeof(b2Contact*));
+		b2Free(oldContacts);
 	}
-	m_contactList = c;
+
+	c->m_manager = this;
+	c->m_managerIndex = m_contactCount;
+	m_contacts[m_contactCount] = c;
+
+	// Keep the table at most half full.
+	if (2 * (m_contactCount + 1) > m_contactTableCapacity)
+	{
+		b2Free(m_contactTable);
+		m_contactTableCapacity *= 2;
+		m_contactTable = (b2Contact**)b2Alloc(m_contactTableCapacity * sizeof(b2Contact*));
+		memset(m_contactTable, 0, m_contactTableCapacity * sizeof(b2Contact*));
+		for (int32 i = 0; i < m_contactCount; ++i)
+		{
+			InsertIntoTable(m_contacts[i]);
+		}
+	}
+
+	InsertIntoTable(c);
 
 	// Connect to island graph.
 
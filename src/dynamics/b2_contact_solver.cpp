@@ -33,21 +33,6 @@
 
 B2_API bool g_blockSolve = true;
 
-struct b2ContactPositionConstraint
-{
-	b2Vec2 localPoints[b2_maxManifoldPoints];
-	b2Vec2 localNormal;
-	b2Vec2 localPoint;
-	int32 indexA;
-	int32 indexB;
-	float invMassA, invMassB;
-	b2Vec2 localCenterA, localCenterB;
-	float invIA, invIB;
-	b2Manifold::Type type;
-	float radiusA, radiusB;
-	int32 pointCount;
-};
-
 b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -58,6 +43,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_wideBatches = nullptr;
+	m_wideSlots = nullptr;
+	m_wideBatchCount = 0;
+	m_softConstraints = nullptr;
+	m_softInvH = 0.0f;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -98,8 +88,8 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		pc->indexB = bodyB->m_islandIndex;
 		pc->invMassA = bodyA->m_invMass;
 		pc->invMassB = bodyB->m_invMass;
-		pc->localCenterA = bodyA->m_sweep.localCenter;
-		pc->localCenterB = bodyB->m_sweep.localCenter;
+		pc->localCenterA = bodyA->m_localCenter;
+		pc->localCenterB = bodyB->m_localCenter;
 		pc->invIA = bodyA->m_invI;
 		pc->invIB = bodyB->m_invI;
 		pc->localNormal = manifold->localNormal;
@@ -138,6 +128,17 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_softConstraints != nullptr)
+	{
+		m_allocator->Free(m_softConstraints);
+	}
+
+	if (m_wideBatches != nullptr)
+	{
+		m_allocator->Free(m_wideBatches);
+		m_allocator->Free(m_wideSlots);
+	}
+
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -145,7 +146,17 @@ b2ContactSolver::~b2ContactSolver()
 // Initialize position dependent portions of the velocity constraints.
 void b2ContactSolver::InitializeVelocityConstraints()
 {
-	for (int32 i = 0; i < m_count; ++i)
+	InitializeVelocityConstraints(0, m_count);
+
+	if (m_step.wideSolver && m_count > 0)
+	{
+		PrepareWideBatches();
+	}
+}
+
+void b2ContactSolver::InitializeVelocityConstraints(int32 begin, int32 end)
+{
+	for (int32 i = begin; i < end; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
 		b2ContactPositionConstraint* pc = m_positionConstraints + i;
@@ -254,73 +265,119 @@ void b2ContactSolver::InitializeVelocityConstraints()
 	}
 }
 
-void b2ContactSolver::WarmStart()
+// Store the velocity of a body after solving a contact. Colored solving skips bodies
+// without mass because the contacts of one color may share them and the solver
+// never changes their velocity.
+template <bool colored>
+inline void b2StoreVelocity(b2Velocity* velocity, const b2Vec2& v, float w, float invMass, float invI)
 {
-	// Warm start.
-	for (int32 i = 0; i < m_count; ++i)
+	if (colored == false || invMass != 0.0f || invI != 0.0f)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
-
-		int32 indexA = vc->indexA;
-		int32 indexB = vc->indexB;
-		float mA = vc->invMassA;
-		float iA = vc->invIA;
-		float mB = vc->invMassB;
-		float iB = vc->invIB;
-		int32 pointCount = vc->pointCount;
-
-		b2Vec2 vA = m_velocities[indexA].v;
-		float wA = m_velocities[indexA].w;
-		b2Vec2 vB = m_velocities[indexB].v;
-		float wB = m_velocities[indexB].w;
-
-		b2Vec2 normal = vc->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
+		velocity->v = v;
+		velocity->w = w;
+	}
+}
 
-		for (int32 j = 0; j < pointCount; ++j)
-		{
-			b2VelocityConstraintPoint* vcp = vc->points + j;
-			b2Vec2 P = vcp->normalImpulse * normal + vcp->tangentImpulse * tangent;
-			wA -= iA * b2Cross(vcp->rA, P);
-			vA -= mA * P;
-			wB += iB * b2Cross(vcp->rB, P);
-			vB += mB * P;
-		}
+// Position counterpart of b2StoreVelocity.
+template <bool colored>
+inline void b2StorePosition(b2Position* position, const b2Vec2& c, float a, float invMass, float invI)
+{
+	if (colored == false || invMass != 0.0f || invI != 0.0f)
+	{
+		position->c = c;
+		position->a = a;
+	}
+}
 
-		m_velocities[indexA].v = vA;
-		m_velocities[indexA].w = wA;
-		m_velocities[indexB].v = vB;
-		m_velocities[indexB].w = wB;
+// Apply the accumulated impulses of one contact.
+template <bool colored>
+static void b2WarmStartConstraint(b2ContactVelocityConstraint* vc, b2Velocity* velocities)
+{
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = velocities[indexA].v;
+	float wA = velocities[indexA].w;
+	b2Vec2 vB = velocities[indexB].v;
+	float wB = velocities[indexB].w;
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2VelocityConstraintPoint* vcp = vc->points + j;
+		b2Vec2 P = vcp->normalImpulse * normal + vcp->tangentImpulse * tangent;
+		wA -= iA * b2Cross(vcp->rA, P);
+		vA -= mA * P;
+		wB += iB * b2Cross(vcp->rB, P);
+		vB += mB * P;
 	}
+
+	b2StoreVelocity<colored>(velocities + indexA, vA, wA, mA, iA);
+	b2StoreVelocity<colored>(velocities + indexB, vB, wB, mB, iB);
 }
 
-void b2ContactSolver::SolveVelocityConstraints()
+// Solve the friction and normal constraints of one contact.
+template <bool colored>
+static void b2SolveVelocityConstraint(b2ContactVelocityConstraint* vc, b2Velocity* velocities)
 {
-	for (int32 i = 0; i < m_count; ++i)
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float mA = vc->invMassA;
+	float iA = vc->invIA;
+	float mB = vc->invMassB;
+	float iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = velocities[indexA].v;
+	float wA = velocities[indexA].w;
+	b2Vec2 vB = velocities[indexB].v;
+	float wB = velocities[indexB].w;
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float friction = vc->friction;
+
+	b2Assert(pointCount == 1 || pointCount == 2);
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2VelocityConstraintPoint* vcp = vc->points + j;
 
-		int32 indexA = vc->indexA;
-		int32 indexB = vc->indexB;
-		float mA = vc->invMassA;
-		float iA = vc->invIA;
-		float mB = vc->invMassB;
-		float iB = vc->invIB;
-		int32 pointCount = vc->pointCount;
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-		b2Vec2 vA = m_velocities[indexA].v;
-		float wA = m_velocities[indexA].w;
-		b2Vec2 vB = m_velocities[indexB].v;
-		float wB = m_velocities[indexB].w;
+		// Compute tangent force
+		float vt = b2Dot(dv, tangent) - vc->tangentSpeed;
+		float lambda = vcp->tangentMass * (-vt);
 
-		b2Vec2 normal = vc->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
-		float friction = vc->friction;
+		// b2Clamp the accumulated force
+		float maxFriction = friction * vcp->normalImpulse;
+		float newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
 
-		b2Assert(pointCount == 1 || pointCount == 2);
+		// Apply contact impulse
+		b2Vec2 P = lambda * tangent;
 
-		// Solve tangent constraints first because non-penetration is more important
-		// than friction.
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
+
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+
+	// Solve normal constraints
+	if (pointCount == 1 || g_blockSolve == false)
+	{
 		for (int32 j = 0; j < pointCount; ++j)
 		{
 			b2VelocityConstraintPoint* vcp = vc->points + j;
@@ -328,286 +385,303 @@ void b2ContactSolver::SolveVelocityConstraints()
 			// Relative velocity at contact
 			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-			// Compute tangent force
-			float vt = b2Dot(dv, tangent) - vc->tangentSpeed;
-			float lambda = vcp->tangentMass * (-vt);
+			// Compute normal impulse
+			float vn = b2Dot(dv, normal);
+			float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
 
-			// b2Clamp the accumulated force
-			float maxFriction = friction * vcp->normalImpulse;
-			float newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
-			lambda = newImpulse - vcp->tangentImpulse;
-			vcp->tangentImpulse = newImpulse;
+			// b2Clamp the accumulated impulse
+			float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
 
 			// Apply contact impulse
-			b2Vec2 P = lambda * tangent;
-
+			b2Vec2 P = lambda * normal;
 			vA -= mA * P;
 			wA -= iA * b2Cross(vcp->rA, P);
 
 			vB += mB * P;
 			wB += iB * b2Cross(vcp->rB, P);
 		}
-
-		// Solve normal constraints
-		if (pointCount == 1 || g_blockSolve == false)
+	}
+	else
+	{
+		// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
+		// Build the mini LCP for this contact patch
+		//
+		// vn = A * x + b, vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+		//
+		// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
+		// b = vn0 - velocityBias
+		//
+		// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
+		// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
+		// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
+		// solution that satisfies the problem is chosen.
+		// 
+		// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
+		// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+		//
+		// Substitute:
+		// 
+		// x = a + d
+		// 
+		// a := old total impulse
+		// x := new total impulse
+		// d := incremental impulse 
+		//
+		// For the current iteration we extend the formula for the incremental impulse
+		// to compute the new total impulse:
+		//
+		// vn = A * d + b
+		//    = A * (x - a) + b
+		//    = A * x + b - A * a
+		//    = A * x + b'
+		// b' = b - A * a;
+
+		b2VelocityConstraintPoint* cp1 = vc->points + 0;
+		b2VelocityConstraintPoint* cp2 = vc->points + 1;
+
+		b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
+		b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+
+		// Relative velocity at contact
+		b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+		b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+		// Compute normal velocity
+		float vn1 = b2Dot(dv1, normal);
+		float vn2 = b2Dot(dv2, normal);
+
+		b2Vec2 b;
+		b.x = vn1 - cp1->velocityBias;
+		b.y = vn2 - cp2->velocityBias;
+
+		// Compute b'
+		b -= b2Mul(vc->K, a);
+
+		const float k_errorTol = 1e-3f;
+		B2_NOT_USED(k_errorTol);
+
+		for (;;)
 		{
-			for (int32 j = 0; j < pointCount; ++j)
+			//
+			// Case 1: vn = 0
+			//
+			// 0 = A * x + b'
+			//
+			// Solve for x:
+			//
+			// x = - inv(A) * b'
+			//
+			b2Vec2 x = - b2Mul(vc->normalMass, b);
+
+			if (x.x >= 0.0f && x.y >= 0.0f)
 			{
-				b2VelocityConstraintPoint* vcp = vc->points + j;
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-				// Relative velocity at contact
-				b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-				// Compute normal impulse
-				float vn = b2Dot(dv, normal);
-				float lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-				// b2Clamp the accumulated impulse
-				float newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
-				lambda = newImpulse - vcp->normalImpulse;
-				vcp->normalImpulse = newImpulse;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-				// Apply contact impulse
-				b2Vec2 P = lambda * normal;
-				vA -= mA * P;
-				wA -= iA * b2Cross(vcp->rA, P);
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
+				vn2 = b2Dot(dv2, normal);
 
-				vB += mB * P;
-				wB += iB * b2Cross(vcp->rB, P);
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+#endif
+				break;
 			}
-		}
-		else
-		{
-			// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
-			// Build the mini LCP for this contact patch
-			//
-			// vn = A * x + b, vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
-			//
-			// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
-			// b = vn0 - velocityBias
-			//
-			// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
-			// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
-			// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
-			// solution that satisfies the problem is chosen.
-			// 
-			// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
-			// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+
 			//
-			// Substitute:
-			// 
-			// x = a + d
-			// 
-			// a := old total impulse
-			// x := new total impulse
-			// d := incremental impulse 
+			// Case 2: vn1 = 0 and x2 = 0
 			//
-			// For the current iteration we extend the formula for the incremental impulse
-			// to compute the new total impulse:
+			//   0 = a11 * x1 + a12 * 0 + b1' 
+			// vn2 = a21 * x1 + a22 * 0 + b2'
 			//
-			// vn = A * d + b
-			//    = A * (x - a) + b
-			//    = A * x + b - A * a
-			//    = A * x + b'
-			// b' = b - A * a;
+			x.x = - cp1->normalMass * b.x;
+			x.y = 0.0f;
+			vn1 = 0.0f;
+			vn2 = vc->K.ex.y * x.x + b.y;
+			if (x.x >= 0.0f && vn2 >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-			b2VelocityConstraintPoint* cp1 = vc->points + 0;
-			b2VelocityConstraintPoint* cp2 = vc->points + 1;
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-			b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
-			b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-			// Relative velocity at contact
-			b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-			b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
 
-			// Compute normal velocity
-			float vn1 = b2Dot(dv1, normal);
-			float vn2 = b2Dot(dv2, normal);
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
 
-			b2Vec2 b;
-			b.x = vn1 - cp1->velocityBias;
-			b.y = vn2 - cp2->velocityBias;
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+#endif
+				break;
+			}
 
-			// Compute b'
-			b -= b2Mul(vc->K, a);
 
-			const float k_errorTol = 1e-3f;
-			B2_NOT_USED(k_errorTol);
+			//
+			// Case 3: vn2 = 0 and x1 = 0
+			//
+			// vn1 = a11 * 0 + a12 * x2 + b1' 
+			//   0 = a21 * 0 + a22 * x2 + b2'
+			//
+			x.x = 0.0f;
+			x.y = - cp2->normalMass * b.y;
+			vn1 = vc->K.ey.x * x.y + b.x;
+			vn2 = 0.0f;
 
-			for (;;)
+			if (x.y >= 0.0f && vn1 >= 0.0f)
 			{
-				//
-				// Case 1: vn = 0
-				//
-				// 0 = A * x + b'
-				//
-				// Solve for x:
-				//
-				// x = - inv(A) * b'
-				//
-				b2Vec2 x = - b2Mul(vc->normalMass, b);
-
-				if (x.x >= 0.0f && x.y >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
-					vn2 = b2Dot(dv2, normal);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
-
-				//
-				// Case 2: vn1 = 0 and x2 = 0
-				//
-				//   0 = a11 * x1 + a12 * 0 + b1' 
-				// vn2 = a21 * x1 + a22 * 0 + b2'
-				//
-				x.x = - cp1->normalMass * b.x;
-				x.y = 0.0f;
-				vn1 = 0.0f;
-				vn2 = vc->K.ex.y * x.x + b.y;
-				if (x.x >= 0.0f && vn2 >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
 #if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				// Postconditions
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
+				// Compute normal velocity
+				vn2 = b2Dot(dv2, normal);
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
 #endif
-					break;
-				}
-
-
-				//
-				// Case 3: vn2 = 0 and x1 = 0
-				//
-				// vn1 = a11 * 0 + a12 * x2 + b1' 
-				//   0 = a21 * 0 + a22 * x2 + b2'
-				//
-				x.x = 0.0f;
-				x.y = - cp2->normalMass * b.y;
-				vn1 = vc->K.ey.x * x.y + b.x;
-				vn2 = 0.0f;
-
-				if (x.y >= 0.0f && vn1 >= 0.0f)
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				break;
+			}
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+			//
+			// Case 4: x1 = 0 and x2 = 0
+			// 
+			// vn1 = b1
+			// vn2 = b2;
+			x.x = 0.0f;
+			x.y = 0.0f;
+			vn1 = b.x;
+			vn2 = b.y;
+
+			if (vn1 >= 0.0f && vn2 >= 0.0f )
+			{
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-					// Compute normal velocity
-					vn2 = b2Dot(dv2, normal);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
-
-				//
-				// Case 4: x1 = 0 and x2 = 0
-				// 
-				// vn1 = b1
-				// vn2 = b2;
-				x.x = 0.0f;
-				x.y = 0.0f;
-				vn1 = b.x;
-				vn2 = b.y;
-
-				if (vn1 >= 0.0f && vn2 >= 0.0f )
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
-
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
-
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
-
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
-
-					break;
-				}
-
-				// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
 				break;
 			}
+
+			// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
+			break;
 		}
+	}
+
+	b2StoreVelocity<colored>(velocities + indexA, vA, wA, mA, iA);
+	b2StoreVelocity<colored>(velocities + indexB, vB, wB, mB, iB);
+}
+
+void b2ContactSolver::WarmStart()
+{
+	if (m_wideBatches != nullptr)
+	{
+		WarmStartWide();
+		return;
+	}
+
+	// Warm start.
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2WarmStartConstraint<false>(m_velocityConstraints + i, m_velocities);
+	}
+}
+
+void b2ContactSolver::SolveVelocityConstraints()
+{
+	if (m_wideBatches != nullptr)
+	{
+		SolveWideVelocityConstraints();
+		return;
+	}
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SolveVelocityConstraint<false>(m_velocityConstraints + i, m_velocities);
+	}
+}
 
-		m_velocities[indexA].v = vA;
-		m_velocities[indexA].w = wA;
-		m_velocities[indexB].v = vB;
-		m_velocities[indexB].w = wB;
+void b2ContactSolver::WarmStart(const int32* constraints, int32 count)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2WarmStartConstraint<true>(m_velocityConstraints + constraints[i], m_velocities);
+	}
+}
+
+void b2ContactSolver::SolveVelocityConstraints(const int32* constraints, int32 count)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2SolveVelocityConstraint<true>(m_velocityConstraints + constraints[i], m_velocities);
 	}
 }
 
 void b2ContactSolver::StoreImpulses()
 {
+	if (m_wideBatches != nullptr)
+	{
+		StoreWideImpulses();
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -672,78 +746,85 @@ struct b2PositionSolverManifold
 	float separation;
 };
 
-// Sequential solver.
-bool b2ContactSolver::SolvePositionConstraints()
+// Solve the position constraint of one contact and return the smallest separation (at most zero).
+template <bool colored>
+static float b2SolvePositionConstraint(b2ContactPositionConstraint* pc, b2Position* positions)
 {
 	float minSeparation = 0.0f;
 
-	for (int32 i = 0; i < m_count; ++i)
-	{
-		b2ContactPositionConstraint* pc = m_positionConstraints + i;
+	int32 indexA = pc->indexA;
+	int32 indexB = pc->indexB;
+	b2Vec2 localCenterA = pc->localCenterA;
+	float mA = pc->invMassA;
+	float iA = pc->invIA;
+	b2Vec2 localCenterB = pc->localCenterB;
+	float mB = pc->invMassB;
+	float iB = pc->invIB;
+	int32 pointCount = pc->pointCount;
 
-		int32 indexA = pc->indexA;
-		int32 indexB = pc->indexB;
-		b2Vec2 localCenterA = pc->localCenterA;
-		float mA = pc->invMassA;
-		float iA = pc->invIA;
-		b2Vec2 localCenterB = pc->localCenterB;
-		float mB = pc->invMassB;
-		float iB = pc->invIB;
-		int32 pointCount = pc->pointCount;
+	b2Vec2 cA = positions[indexA].c;
+	float aA = positions[indexA].a;
 
-		b2Vec2 cA = m_positions[indexA].c;
-		float aA = m_positions[indexA].a;
+	b2Vec2 cB = positions[indexB].c;
+	float aB = positions[indexB].a;
 
-		b2Vec2 cB = m_positions[indexB].c;
-		float aB = m_positions[indexB].a;
+	// Solve normal constraints
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2Transform xfA, xfB;
+		xfA.q.Set(aA);
+		xfB.q.Set(aB);
+		xfA.p = cA - b2Mul(xfA.q, localCenterA);
+		xfB.p = cB - b2Mul(xfB.q, localCenterB);
 
-		// Solve normal constraints
-		for (int32 j = 0; j < pointCount; ++j)
-		{
-			b2Transform xfA, xfB;
-			xfA.q.Set(aA);
-			xfB.q.Set(aB);
-			xfA.p = cA - b2Mul(xfA.q, localCenterA);
-			xfB.p = cB - b2Mul(xfB.q, localCenterB);
+		b2PositionSolverManifold psm;
+		psm.Initialize(pc, xfA, xfB, j);
+		b2Vec2 normal = psm.normal;
 
-			b2PositionSolverManifold psm;
-			psm.Initialize(pc, xfA, xfB, j);
-			b2Vec2 normal = psm.normal;
+		b2Vec2 point = psm.point;
+		float separation = psm.separation;
 
-			b2Vec2 point = psm.point;
-			float separation = psm.separation;
+		b2Vec2 rA = point - cA;
+		b2Vec2 rB = point - cB;
 
-			b2Vec2 rA = point - cA;
-			b2Vec2 rB = point - cB;
+		// Track max constraint error.
+		minSeparation = b2Min(minSeparation, separation);
 
-			// Track max constraint error.
-			minSeparation = b2Min(minSeparation, separation);
+		// Prevent large corrections and allow slop.
+		float C = b2Clamp(b2_baumgarte * (separation + b2_linearSlop), -b2_maxLinearCorrection, 0.0f);
 
-			// Prevent large corrections and allow slop.
-			float C = b2Clamp(b2_baumgarte * (separation + b2_linearSlop), -b2_maxLinearCorrection, 0.0f);
+		// Compute the effective mass.
+		float rnA = b2Cross(rA, normal);
+		float rnB = b2Cross(rB, normal);
+		float K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
 
-			// Compute the effective mass.
-			float rnA = b2Cross(rA, normal);
-			float rnB = b2Cross(rB, normal);
-			float K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+		// Compute normal impulse
+		float impulse = K > 0.0f ? - C / K : 0.0f;
 
-			// Compute normal impulse
-			float impulse = K > 0.0f ? - C / K : 0.0f;
+		b2Vec2 P = impulse * normal;
 
-			b2Vec2 P = impulse * normal;
+		cA -= mA * P;
+		aA -= iA * b2Cross(rA, P);
 
-			cA -= mA * P;
-			aA -= iA * b2Cross(rA, P);
+		cB += mB * P;
+		aB += iB * b2Cross(rB, P);
+	}
 
-			cB += mB * P;
-			aB += iB * b2Cross(rB, P);
-		}
+	b2StorePosition<colored>(positions + indexA, cA, aA, mA, iA);
+	b2StorePosition<colored>(positions + indexB, cB, aB, mB, iB);
 
-		m_positions[indexA].c = cA;
-		m_positions[indexA].a = aA;
+	return minSeparation;
+}
 
-		m_positions[indexB].c = cB;
-		m_positions[indexB].a = aB;
+// Sequential solver.
+bool b2ContactSolver::SolvePositionConstraints()
+{
+	float minSeparation = 0.0f;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		float separation = b2SolvePositionConstraint<false>(m_positionConstraints + i, m_positions);
+		minSeparation = b2Min(minSeparation, separation);
 	}
 
 	// We can't expect minSpeparation >= -b2_linearSlop because we don't
@@ -751,6 +832,19 @@ bool b2ContactSolver::SolvePositionConstraints()
 	return minSeparation >= -3.0f * b2_linearSlop;
 }
 
+bool b2ContactSolver::SolvePositionConstraints(const int32* constraints, int32 count)
+{
+	float minSeparation = 0.0f;
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		float separation = b2SolvePositionConstraint<true>(m_positionConstraints + constraints[i], m_positions);
+		minSeparation = b2Min(minSeparation, separation);
+	}
+
+	return minSeparation >= -3.0f * b2_linearSlop;
+}
+
 // Sequential position solver for position constraints.
 bool b2ContactSolver::SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB)
 {
@@ -30,7 +30,8 @@
 class b2Contact;
 class b2Body;
 class b2StackAllocator;
-struct b2ContactPositionConstraint;
+struct b2SoftContactConstraint;
+struct b2WideContactBatch;
 
 struct b2VelocityConstraintPoint
 {
@@ -61,6 +62,21 @@ struct b2ContactVelocityConstraint
 	int32 contactIndex;
 };
 
+struct b2ContactPositionConstraint
+{
+	b2Vec2 localPoints[b2_maxManifoldPoints];
+	b2Vec2 localNormal;
+	b2Vec2 localPoint;
+	int32 indexA;
+	int32 indexB;
+	float invMassA, invMassB;
+	b2Vec2 localCenterA, localCenterB;
+	float invIA, invIB;
+	b2Manifold::Type type;
+	float radiusA, radiusB;
+	int32 pointCount;
+};
+
 struct b2ContactSolverDef
 {
 	b2TimeStep step;
@@ -86,6 +102,29 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	// Colored solving, see b2ConstraintGraph. These visit the given constraints and
+	// never write bodies without mass, so constraints that do not share a body with
+	// mass can be solved at the same time.
+	void InitializeVelocityConstraints(int32 begin, int32 end);
+	void WarmStart(const int32* constraints, int32 count);
+	void SolveVelocityConstraints(const int32* constraints, int32 count);
+	bool SolvePositionConstraints(const int32* constraints, int32 count);
+
+	// Wide velocity solver, see b2_contact_solver_wide.cpp. The velocity constraints are
+	// packed into SIMD batches whose lanes never share a body that the contacts can move.
+	void PrepareWideBatches();
+	void WarmStartWide();
+	void SolveWideVelocityConstraints();
+	void StoreWideImpulses();
+
+	// Soft step solver, see b2_contact_solver_soft.cpp. The contacts are soft constraints
+	// that are solved once per sub-step with bias and once more without it to relax.
+	void PrepareSoftConstraints(float h);
+	void WarmStartSoft();
+	void SolveSoftVelocityConstraints(bool useBias);
+	void ApplySoftRestitution();
+	void StoreSoftImpulses();
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -94,6 +133,11 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+	b2WideContactBatch* m_wideBatches;
+	int32* m_wideSlots;
+	int32 m_wideBatchCount;
+	b2SoftContactConstraint* m_softConstraints;
+	float m_softInvH;
 };
 
 #endif
@@ -0,0 +1,514 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+#include "b2_contact_solver.h"
+
+#include "box2d/b2_contact.h"
+#include "box2d/b2_stack_allocator.h"
+
+extern B2_API bool g_blockSolve;
+
+// The soft step solver treats contacts as soft constraints, a damped spring with a given
+// stiffness that is solved with an implicit integrator. The time step is split into
+// sub-steps. Each sub-step integrates the velocities, solves the contacts with a bias that
+// pushes overlapping shapes apart, integrates the positions, and then solves the contacts
+// again without the bias. This relax pass removes the velocity added by the bias so that
+// the push out does not turn into bounce.
+//
+// The contact anchors are fixed at the start of the step. The separation of a point in a
+// later sub-step is estimated from how far the bodies moved and turned since then, so the
+// manifold does not need to be recomputed.
+
+// Coefficients of a soft constraint. See Erin Catto, "Solver2D", 2024.
+struct b2Softness
+{
+	float biasRate;
+	float massScale;
+	float impulseScale;
+};
+
+static b2Softness b2MakeSoftness(float hertz, float dampingRatio, float h)
+{
+	b2Softness softness;
+	if (hertz == 0.0f)
+	{
+		softness.biasRate = 0.0f;
+		softness.massScale = 1.0f;
+		softness.impulseScale = 0.0f;
+		return softness;
+	}
+
+	float omega = 2.0f * b2_pi * hertz;
+	float a1 = 2.0f * dampingRatio + h * omega;
+	float a2 = h * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+	softness.biasRate = omega / a1;
+	softness.massScale = a2 * a3;
+	softness.impulseScale = a3;
+	return softness;
+}
+
+struct b2SoftContactPoint
+{
+	b2Vec2 anchorA;
+	b2Vec2 anchorB;
+	float baseSeparation;
+	float relativeVelocity;
+	float normalImpulse;
+	float tangentImpulse;
+	float maxNormalImpulse;
+	float normalMass;
+	float tangentMass;
+};
+
+struct b2SoftContactConstraint
+{
+	b2SoftContactPoint points[b2_maxManifoldPoints];
+	b2Vec2 normal;
+	b2Mat22 normalMass;
+	b2Vec2 deltaCenter0;
+	float angleA0, angleB0;
+	int32 indexA;
+	int32 indexB;
+	float invMassA, invMassB;
+	float invIA, invIB;
+	float friction;
+	float restitution;
+	float threshold;
+	float tangentSpeed;
+	b2Softness softness;
+	int32 pointCount;
+	bool blockSolve;
+};
+
+void b2ContactSolver::PrepareSoftConstraints(float h)
+{
+	b2Assert(m_softConstraints == nullptr);
+	m_softConstraints = (b2SoftContactConstraint*)m_allocator->Allocate(m_count * sizeof(b2SoftContactConstraint));
+	m_softInvH = h > 0.0f ? 1.0f / h : 0.0f;
+
+	// Stiff contacts need a few sub-steps per period to stay stable.
+	float contactHertz = b2Min(b2_contactHertz, 0.25f * m_softInvH);
+	b2Softness softness = b2MakeSoftness(contactHertz, b2_contactDampingRatio, h);
+
+	// Contacts against bodies that cannot move only have one body to push, so they can be
+	// twice as stiff.
+	b2Softness staticSoftness = b2MakeSoftness(2.0f * contactHertz, b2_contactDampingRatio, h);
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		const b2ContactPositionConstraint* pc = m_positionConstraints + i;
+		b2SoftContactConstraint* sc = m_softConstraints + i;
+		const b2Manifold* manifold = m_contacts[vc->contactIndex]->GetManifold();
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float mB = vc->invMassB;
+		float iA = vc->invIA;
+		float iB = vc->invIB;
+
+		sc->indexA = indexA;
+		sc->indexB = indexB;
+		sc->invMassA = mA;
+		sc->invMassB = mB;
+		sc->invIA = iA;
+		sc->invIB = iB;
+		sc->friction = vc->friction;
+		sc->restitution = vc->restitution;
+		sc->threshold = vc->threshold;
+		sc->tangentSpeed = vc->tangentSpeed;
+		sc->pointCount = pc->pointCount;
+
+		bool staticA = mA == 0.0f && iA == 0.0f;
+		bool staticB = mB == 0.0f && iB == 0.0f;
+		sc->softness = (staticA || staticB) ? staticSoftness : softness;
+
+		b2Vec2 cA = m_positions[indexA].c;
+		float aA = m_positions[indexA].a;
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+
+		b2Vec2 cB = m_positions[indexB].c;
+		float aB = m_positions[indexB].a;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		sc->deltaCenter0 = cB - cA;
+		sc->angleA0 = aA;
+		sc->angleB0 = aB;
+
+		b2Transform xfA, xfB;
+		xfA.q.Set(aA);
+		xfB.q.Set(aB);
+		xfA.p = cA - b2Mul(xfA.q, pc->localCenterA);
+		xfB.p = cB - b2Mul(xfB.q, pc->localCenterB);
+
+		b2WorldManifold worldManifold;
+		worldManifold.Initialize(manifold, xfA, pc->radiusA, xfB, pc->radiusB);
+
+		b2Vec2 normal = worldManifold.normal;
+		b2Vec2 tangent = b2Cross(normal, 1.0f);
+		sc->normal = normal;
+
+		for (int32 j = 0; j < sc->pointCount; ++j)
+		{
+			b2SoftContactPoint* cp = sc->points + j;
+			const b2VelocityConstraintPoint* vcp = vc->points + j;
+
+			// The accumulated impulses were loaded by the constructor.
+			cp->normalImpulse = vcp->normalImpulse;
+			cp->tangentImpulse = vcp->tangentImpulse;
+			cp->maxNormalImpulse = 0.0f;
+
+			b2Vec2 rA = worldManifold.points[j] - cA;
+			b2Vec2 rB = worldManifold.points[j] - cB;
+			cp->anchorA = rA;
+			cp->anchorB = rB;
+
+			// The separation minus the part that changes when the anchors move.
+			cp->baseSeparation = worldManifold.separations[j] - b2Dot(rB - rA, normal);
+
+			float rnA = b2Cross(rA, normal);
+			float rnB = b2Cross(rB, normal);
+			float kNormal = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+			cp->normalMass = kNormal > 0.0f ? 1.0f / kNormal : 0.0f;
+
+			float rtA = b2Cross(rA, tangent);
+			float rtB = b2Cross(rB, tangent);
+			float kTangent = mA + mB + iA * rtA * rtA + iB * rtB * rtB;
+			cp->tangentMass = kTangent > 0.0f ? 1.0f / kTangent : 0.0f;
+
+			// Save the approach speed for restitution.
+			cp->relativeVelocity = b2Dot(normal, vB + b2Cross(wB, rB) - vA - b2Cross(wA, rA));
+		}
+
+		// Two points are solved together like the block solver of the default solver, so
+		// the push out of a resting box does not tip it toward the point solved first.
+		sc->blockSolve = false;
+		if (sc->pointCount == 2 && g_blockSolve)
+		{
+			b2Vec2 rn1(b2Cross(sc->points[0].anchorA, normal), b2Cross(sc->points[0].anchorB, normal));
+			b2Vec2 rn2(b2Cross(sc->points[1].anchorA, normal), b2Cross(sc->points[1].anchorB, normal));
+
+			float k11 = mA + mB + iA * rn1.x * rn1.x + iB * rn1.y * rn1.y;
+			float k22 = mA + mB + iA * rn2.x * rn2.x + iB * rn2.y * rn2.y;
+			float k12 = mA + mB + iA * rn1.x * rn2.x + iB * rn1.y * rn2.y;
+
+			// Ensure a reasonable condition number.
+			const float k_maxConditionNumber = 1000.0f;
+			if (k11 * k11 < k_maxConditionNumber * (k11 * k22 - k12 * k12))
+			{
+				b2Mat22 K;
+				K.ex.Set(k11, k12);
+				K.ey.Set(k12, k22);
+				sc->normalMass = K.GetInverse();
+				sc->blockSolve = true;
+			}
+		}
+	}
+}
+
+void b2ContactSolver::WarmStartSoft()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SoftContactConstraint* sc = m_softConstraints + i;
+
+		if (m_step.warmStarting == false)
+		{
+			// Each sub-step starts from zero.
+			for (int32 j = 0; j < sc->pointCount; ++j)
+			{
+				sc->points[j].normalImpulse = 0.0f;
+				sc->points[j].tangentImpulse = 0.0f;
+			}
+			continue;
+		}
+
+		int32 indexA = sc->indexA;
+		int32 indexB = sc->indexB;
+		float mA = sc->invMassA;
+		float iA = sc->invIA;
+		float mB = sc->invMassB;
+		float iB = sc->invIB;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		b2Vec2 normal = sc->normal;
+		b2Vec2 tangent = b2Cross(normal, 1.0f);
+
+		for (int32 j = 0; j < sc->pointCount; ++j)
+		{
+			const b2SoftContactPoint* cp = sc->points + j;
+			b2Vec2 P = cp->normalImpulse * normal + cp->tangentImpulse * tangent;
+			wA -= iA * b2Cross(cp->anchorA, P);
+			vA -= mA * P;
+			wB += iB * b2Cross(cp->anchorB, P);
+			vB += mB * P;
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
+void b2ContactSolver::SolveSoftVelocityConstraints(bool useBias)
+{
+	float inv_h = m_softInvH;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SoftContactConstraint* sc = m_softConstraints + i;
+
+		int32 indexA = sc->indexA;
+		int32 indexB = sc->indexB;
+		float mA = sc->invMassA;
+		float iA = sc->invIA;
+		float mB = sc->invMassB;
+		float iB = sc->invIB;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		// How far the bodies moved and turned since the anchors were computed.
+		b2Vec2 dc = m_positions[indexB].c - m_positions[indexA].c - sc->deltaCenter0;
+		float daA = m_positions[indexA].a - sc->angleA0;
+		float daB = m_positions[indexB].a - sc->angleB0;
+
+		b2Vec2 normal = sc->normal;
+		b2Vec2 tangent = b2Cross(normal, 1.0f);
+		float friction = sc->friction;
+		b2Softness softness = sc->softness;
+		int32 pointCount = sc->pointCount;
+
+		// Non-penetration is solved first so that friction uses the new normal impulse.
+		float velocityBias[b2_maxManifoldPoints];
+		float massScale[b2_maxManifoldPoints];
+		float impulseScale[b2_maxManifoldPoints];
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			const b2SoftContactPoint* cp = sc->points + j;
+
+			// Estimate the current separation. The rotation of the anchors is linearized,
+			// which is accurate for the small rotations of a single step.
+			b2Vec2 prA = cp->anchorA + b2Cross(daA, cp->anchorA);
+			b2Vec2 prB = cp->anchorB + b2Cross(daB, cp->anchorB);
+			float s = b2Dot(dc + prB - prA, normal) + cp->baseSeparation;
+
+			velocityBias[j] = 0.0f;
+			massScale[j] = 1.0f;
+			impulseScale[j] = 0.0f;
+			if (s > 0.0f)
+			{
+				// Speculative: allow the gap to close in this sub-step.
+				velocityBias[j] = s * inv_h;
+			}
+			else if (useBias)
+			{
+				velocityBias[j] = b2Max(softness.biasRate * s, -b2_contactPushVelocity);
+				massScale[j] = softness.massScale;
+				impulseScale[j] = softness.impulseScale;
+			}
+		}
+
+		bool solved = false;
+		if (sc->blockSolve)
+		{
+			b2SoftContactPoint* cp1 = sc->points + 0;
+			b2SoftContactPoint* cp2 = sc->points + 1;
+
+			// Relative velocity at contact
+			b2Vec2 dv1 = vB + b2Cross(wB, cp1->anchorB) - vA - b2Cross(wA, cp1->anchorA);
+			b2Vec2 dv2 = vB + b2Cross(wB, cp2->anchorB) - vA - b2Cross(wA, cp2->anchorA);
+
+			b2Vec2 b(b2Dot(dv1, normal) + velocityBias[0], b2Dot(dv2, normal) + velocityBias[1]);
+			b2Vec2 x = b2Mul(sc->normalMass, b);
+
+			// The incremental impulse of each point is softened on its own.
+			b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
+			b2Vec2 d(-massScale[0] * x.x - impulseScale[0] * a.x, -massScale[1] * x.y - impulseScale[1] * a.y);
+
+			// Both points must push. Otherwise solve them one at a time.
+			if (a.x + d.x >= 0.0f && a.y + d.y >= 0.0f)
+			{
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->anchorA, P1) + b2Cross(cp2->anchorA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->anchorB, P1) + b2Cross(cp2->anchorB, P2));
+
+				cp1->normalImpulse = a.x + d.x;
+				cp2->normalImpulse = a.y + d.y;
+				cp1->maxNormalImpulse = b2Max(cp1->maxNormalImpulse, d.x);
+				cp2->maxNormalImpulse = b2Max(cp2->maxNormalImpulse, d.y);
+				solved = true;
+			}
+		}
+
+		for (int32 j = 0; j < pointCount && solved == false; ++j)
+		{
+			b2SoftContactPoint* cp = sc->points + j;
+
+			// Relative velocity at contact
+			b2Vec2 dv = vB + b2Cross(wB, cp->anchorB) - vA - b2Cross(wA, cp->anchorA);
+			float vn = b2Dot(dv, normal);
+
+			float lambda = -cp->normalMass * massScale[j] * (vn + velocityBias[j]) - impulseScale[j] * cp->normalImpulse;
+
+			// b2Clamp the accumulated impulse
+			float newImpulse = b2Max(cp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - cp->normalImpulse;
+			cp->normalImpulse = newImpulse;
+			cp->maxNormalImpulse = b2Max(cp->maxNormalImpulse, lambda);
+
+			// Apply contact impulse
+			b2Vec2 P = lambda * normal;
+			vA -= mA * P;
+			wA -= iA * b2Cross(cp->anchorA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(cp->anchorB, P);
+		}
+
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2SoftContactPoint* cp = sc->points + j;
+
+			// Relative velocity at contact
+			b2Vec2 dv = vB + b2Cross(wB, cp->anchorB) - vA - b2Cross(wA, cp->anchorA);
+
+			// Compute tangent force
+			float vt = b2Dot(dv, tangent) - sc->tangentSpeed;
+			float lambda = cp->tangentMass * (-vt);
+
+			// b2Clamp the accumulated force
+			float maxFriction = friction * cp->normalImpulse;
+			float newImpulse = b2Clamp(cp->tangentImpulse + lambda, -maxFriction, maxFriction);
+			lambda = newImpulse - cp->tangentImpulse;
+			cp->tangentImpulse = newImpulse;
+
+			// Apply contact impulse
+			b2Vec2 P = lambda * tangent;
+
+			vA -= mA * P;
+			wA -= iA * b2Cross(cp->anchorA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(cp->anchorB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
+// Restitution is applied once after the sub-steps, using the approach speed from the start
+// of the step. Points that never pushed were not in contact.
+void b2ContactSolver::ApplySoftRestitution()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SoftContactConstraint* sc = m_softConstraints + i;
+		if (sc->restitution == 0.0f)
+		{
+			continue;
+		}
+
+		int32 indexA = sc->indexA;
+		int32 indexB = sc->indexB;
+		float mA = sc->invMassA;
+		float iA = sc->invIA;
+		float mB = sc->invMassB;
+		float iB = sc->invIB;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		b2Vec2 normal = sc->normal;
+
+		for (int32 j = 0; j < sc->pointCount; ++j)
+		{
+			b2SoftContactPoint* cp = sc->points + j;
+			if (cp->relativeVelocity > -sc->threshold || cp->maxNormalImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			b2Vec2 dv = vB + b2Cross(wB, cp->anchorB) - vA - b2Cross(wA, cp->anchorA);
+			float vn = b2Dot(dv, normal);
+
+			float lambda = -cp->normalMass * (vn + sc->restitution * cp->relativeVelocity);
+
+			float newImpulse = b2Max(cp->normalImpulse + lambda, 0.0f);
+			lambda = newImpulse - cp->normalImpulse;
+			cp->normalImpulse = newImpulse;
+			cp->maxNormalImpulse = b2Max(cp->maxNormalImpulse, lambda);
+
+			b2Vec2 P = lambda * normal;
+			vA -= mA * P;
+			wA -= iA * b2Cross(cp->anchorA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(cp->anchorB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
+// Store the impulses of the last sub-step for warm starting and for b2Island::Report.
+void b2ContactSolver::StoreSoftImpulses()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2SoftContactConstraint* sc = m_softConstraints + i;
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2Manifold* manifold = m_contacts[vc->contactIndex]->GetManifold();
+
+		for (int32 j = 0; j < sc->pointCount; ++j)
+		{
+			float normalImpulse = sc->points[j].normalImpulse;
+			float tangentImpulse = sc->points[j].tangentImpulse;
+			manifold->points[j].normalImpulse = normalImpulse;
+			manifold->points[j].tangentImpulse = tangentImpulse;
+			vc->points[j].normalImpulse = normalImpulse;
+			vc->points[j].tangentImpulse = tangentImpulse;
+		}
+	}
+}
@@ -0,0 +1,635 @@
+// MIT License
+
+// Copyright (c) 2019 Erin Catto
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "b2_contact_solver.h"
+
+#include "box2d/b2_stack_allocator.h"
+
+#include <string.h>
+
+extern B2_API bool g_blockSolve;
+
+// The wide solver packs velocity constraints into batches of b2_simdWidth lanes and runs the
+// same math as b2ContactSolver::SolveVelocityConstraints on all lanes at once. Two lanes of a
+// batch never share a body that a contact can move, so solving a batch is the same as solving
+// its constraints one after another. Bodies with zero mass and rotational inertia (static,
+// kinematic and massless dynamic bodies) may be shared because their velocity never changes.
+//
+// AVX builds use 8 lanes and SSE2 builds use 4 lanes. Other targets (or B2_NO_SIMD) use a
+// portable 4 lane fallback that gives the same results as SSE2.
+
+#if !defined(B2_NO_SIMD) && defined(__AVX__)
+
+#include <immintrin.h>
+
+#define b2_simdWidth 8
+
+typedef __m256 b2FloatW;
+typedef __m256 b2MaskW;
+
+inline b2FloatW b2LoadW(const float* p) { return _mm256_loadu_ps(p); }
+inline void b2StoreW(float* p, b2FloatW a) { _mm256_storeu_ps(p, a); }
+inline b2FloatW b2SplatW(float s) { return _mm256_set1_ps(s); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm256_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm256_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm256_mul_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm256_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm256_max_ps(a, b); }
+inline b2MaskW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline b2MaskW b2AndW(b2MaskW a, b2MaskW b) { return _mm256_and_ps(a, b); }
+inline b2MaskW b2OrW(b2MaskW a, b2MaskW b) { return _mm256_or_ps(a, b); }
+inline b2FloatW b2SelectW(b2MaskW mask, b2FloatW a, b2FloatW b) { return _mm256_blendv_ps(b, a, mask); }
+
+#elif !defined(B2_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+
+#include <emmintrin.h>
+
+#define b2_simdWidth 4
+
+typedef __m128 b2FloatW;
+typedef __m128 b2MaskW;
+
+inline b2FloatW b2LoadW(const float* p) { return _mm_loadu_ps(p); }
+inline void b2StoreW(float* p, b2FloatW a) { _mm_storeu_ps(p, a); }
+inline b2FloatW b2SplatW(float s) { return _mm_set1_ps(s); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm_mul_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm_max_ps(a, b); }
+inline b2MaskW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm_cmpge_ps(a, b); }
+inline b2MaskW b2AndW(b2MaskW a, b2MaskW b) { return _mm_and_ps(a, b); }
+inline b2MaskW b2OrW(b2MaskW a, b2MaskW b) { return _mm_or_ps(a, b); }
+inline b2FloatW b2SelectW(b2MaskW mask, b2FloatW a, b2FloatW b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+#else
+
+#define b2_simdWidth 4
+
+struct b2FloatW
+{
+	float v[b2_simdWidth];
+};
+
+struct b2MaskW
+{
+	bool v[b2_simdWidth];
+};
+
+inline b2FloatW b2LoadW(const float* p)
+{
+	b2FloatW r;
+	memcpy(r.v, p, sizeof(r.v));
+	return r;
+}
+
+inline void b2StoreW(float* p, b2FloatW a)
+{
+	memcpy(p, a.v, sizeof(a.v));
+}
+
+inline b2FloatW b2SplatW(float s)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = s;
+	}
+	return r;
+}
+
+#define B2_WIDE_BINARY(name, type, expr) \
+	inline type name(b2FloatW a, b2FloatW b) \
+	{ \
+		type r; \
+		for (int32 i = 0; i < b2_simdWidth; ++i) \
+		{ \
+			r.v[i] = expr; \
+		} \
+		return r; \
+	}
+
+B2_WIDE_BINARY(b2AddW, b2FloatW, a.v[i] + b.v[i])
+B2_WIDE_BINARY(b2SubW, b2FloatW, a.v[i] - b.v[i])
+B2_WIDE_BINARY(b2MulW, b2FloatW, a.v[i] * b.v[i])
+B2_WIDE_BINARY(b2MinW, b2FloatW, b2Min(a.v[i], b.v[i]))
+B2_WIDE_BINARY(b2MaxW, b2FloatW, b2Max(a.v[i], b.v[i]))
+B2_WIDE_BINARY(b2GreaterEqualW, b2MaskW, a.v[i] >= b.v[i])
+
+#undef B2_WIDE_BINARY
+
+inline b2MaskW b2AndW(b2MaskW a, b2MaskW b)
+{
+	b2MaskW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a.v[i] && b.v[i];
+	}
+	return r;
+}
+
+inline b2MaskW b2OrW(b2MaskW a, b2MaskW b)
+{
+	b2MaskW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = a.v[i] || b.v[i];
+	}
+	return r;
+}
+
+inline b2FloatW b2SelectW(b2MaskW mask, b2FloatW a, b2FloatW b)
+{
+	b2FloatW r;
+	for (int32 i = 0; i < b2_simdWidth; ++i)
+	{
+		r.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+	}
+	return r;
+}
+
+#endif
+
+// Number of partially filled batches that are searched for a free lane. Constraints that
+// conflict with all of them start a new batch and the oldest open batch is closed.
+#define b2_wideBatchWindow 8
+
+// Structure of arrays copy of b2VelocityConstraintPoint.
+struct b2WideContactPoint
+{
+	float rAx[b2_simdWidth], rAy[b2_simdWidth];
+	float rBx[b2_simdWidth], rBy[b2_simdWidth];
+	float normalImpulse[b2_simdWidth];
+	float tangentImpulse[b2_simdWidth];
+	float normalMass[b2_simdWidth];
+	float tangentMass[b2_simdWidth];
+	float velocityBias[b2_simdWidth];
+};
+
+// Structure of arrays copy of b2_simdWidth velocity constraints with the same point count.
+// Unused lanes are zero, so they produce zero impulses.
+struct b2WideContactBatch
+{
+	b2WideContactPoint points[b2_maxManifoldPoints];
+	float normalX[b2_simdWidth], normalY[b2_simdWidth];
+	float friction[b2_simdWidth];
+	float tangentSpeed[b2_simdWidth];
+	float invMassA[b2_simdWidth], invIA[b2_simdWidth];
+	float invMassB[b2_simdWidth], invIB[b2_simdWidth];
+	float k11[b2_simdWidth], k12[b2_simdWidth], k22[b2_simdWidth];
+	float normalMass11[b2_simdWidth], normalMass12[b2_simdWidth];
+	float normalMass21[b2_simdWidth], normalMass22[b2_simdWidth];
+	int32 indexA[b2_simdWidth];
+	int32 indexB[b2_simdWidth];
+	int32 constraints[b2_simdWidth];
+	int32 count;
+	int32 pointCount;
+};
+
+// A batch that still has free lanes during PrepareWideBatches.
+struct b2OpenWideBatch
+{
+	int32 batch;
+	int32 count;
+	int32 bodyCount;
+	int32 bodies[2 * b2_simdWidth];
+};
+
+struct b2WideBodies
+{
+	b2FloatW vx, vy, w;
+};
+
+static bool b2IsSharedBody(float invMass, float invI)
+{
+	return invMass == 0.0f && invI == 0.0f;
+}
+
+void b2ContactSolver::PrepareWideBatches()
+{
+	b2Assert(m_wideBatches == nullptr);
+
+	// Assign each constraint to a batch lane. Constraints with one and two points go to
+	// different batches because they use different normal solvers. The slot of a constraint
+	// is batch * b2_simdWidth + lane.
+	m_wideSlots = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+
+	b2OpenWideBatch open[b2_maxManifoldPoints][b2_wideBatchWindow];
+	int32 openCount[b2_maxManifoldPoints] = { 0 };
+	int32 batchCount = 0;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+
+		int32 bodies[2];
+		int32 bodyCount = 0;
+		if (b2IsSharedBody(vc->invMassA, vc->invIA) == false)
+		{
+			bodies[bodyCount++] = vc->indexA;
+		}
+		if (b2IsSharedBody(vc->invMassB, vc->invIB) == false)
+		{
+			bodies[bodyCount++] = vc->indexB;
+		}
+
+		b2OpenWideBatch* window = open[vc->pointCount - 1];
+		int32& windowCount = openCount[vc->pointCount - 1];
+
+		// Find the first open batch that does not touch the bodies of this constraint.
+		int32 k = 0;
+		for (; k < windowCount; ++k)
+		{
+			const b2OpenWideBatch* candidate = window + k;
+
+			bool conflict = false;
+			for (int32 m = 0; m < candidate->bodyCount && conflict == false; ++m)
+			{
+				for (int32 n = 0; n < bodyCount; ++n)
+				{
+					if (candidate->bodies[m] == bodies[n])
+					{
+						conflict = true;
+						break;
+					}
+				}
+			}
+
+			if (conflict == false)
+			{
+				break;
+			}
+		}
+
+		if (k == windowCount)
+		{
+			if (windowCount == b2_wideBatchWindow)
+			{
+				// Close the oldest batch.
+				memmove(window, window + 1, (b2_wideBatchWindow - 1) * sizeof(b2OpenWideBatch));
+				--windowCount;
+				--k;
+			}
+
+			b2OpenWideBatch* batch = window + windowCount;
+			batch->batch = batchCount++;
+			batch->count = 0;
+			batch->bodyCount = 0;
+			++windowCount;
+		}
+
+		b2OpenWideBatch* batch = window + k;
+		m_wideSlots[i] = batch->batch * b2_simdWidth + batch->count;
+		++batch->count;
+		for (int32 n = 0; n < bodyCount; ++n)
+		{
+			batch->bodies[batch->bodyCount++] = bodies[n];
+		}
+
+		if (batch->count == b2_simdWidth)
+		{
+			// Full batches leave the window.
+			memmove(batch, batch + 1, (windowCount - k - 1) * sizeof(b2OpenWideBatch));
+			--windowCount;
+		}
+	}
+
+	m_wideBatchCount = batchCount;
+	m_wideBatches = (b2WideContactBatch*)m_allocator->Allocate(batchCount * sizeof(b2WideContactBatch));
+	memset(m_wideBatches, 0, batchCount * sizeof(b2WideContactBatch));
+
+	// Copy the constraints into the lanes.
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2WideContactBatch* batch = m_wideBatches + m_wideSlots[i] / b2_simdWidth;
+		int32 lane = m_wideSlots[i] % b2_simdWidth;
+
+		batch->indexA[lane] = vc->indexA;
+		batch->indexB[lane] = vc->indexB;
+		batch->constraints[lane] = i;
+		batch->count = lane + 1;
+		batch->pointCount = vc->pointCount;
+
+		batch->normalX[lane] = vc->normal.x;
+		batch->normalY[lane] = vc->normal.y;
+		batch->friction[lane] = vc->friction;
+		batch->tangentSpeed[lane] = vc->tangentSpeed;
+		batch->invMassA[lane] = vc->invMassA;
+		batch->invIA[lane] = vc->invIA;
+		batch->invMassB[lane] = vc->invMassB;
+		batch->invIB[lane] = vc->invIB;
+		batch->k11[lane] = vc->K.ex.x;
+		batch->k12[lane] = vc->K.ex.y;
+		batch->k22[lane] = vc->K.ey.y;
+		batch->normalMass11[lane] = vc->normalMass.ex.x;
+		batch->normalMass12[lane] = vc->normalMass.ey.x;
+		batch->normalMass21[lane] = vc->normalMass.ex.y;
+		batch->normalMass22[lane] = vc->normalMass.ey.y;
+
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			const b2VelocityConstraintPoint* vcp = vc->points + j;
+			b2WideContactPoint* wcp = batch->points + j;
+			wcp->rAx[lane] = vcp->rA.x;
+			wcp->rAy[lane] = vcp->rA.y;
+			wcp->rBx[lane] = vcp->rB.x;
+			wcp->rBy[lane] = vcp->rB.y;
+			wcp->normalImpulse[lane] = vcp->normalImpulse;
+			wcp->tangentImpulse[lane] = vcp->tangentImpulse;
+			wcp->normalMass[lane] = vcp->normalMass;
+			wcp->tangentMass[lane] = vcp->tangentMass;
+			wcp->velocityBias[lane] = vcp->velocityBias;
+		}
+	}
+}
+
+static void b2GatherBodies(b2WideBodies* bodiesA, b2WideBodies* bodiesB, const b2WideContactBatch* batch, const b2Velocity* velocities)
+{
+	float vAx[b2_simdWidth] = { 0.0f }, vAy[b2_simdWidth] = { 0.0f }, wA[b2_simdWidth] = { 0.0f };
+	float vBx[b2_simdWidth] = { 0.0f }, vBy[b2_simdWidth] = { 0.0f }, wB[b2_simdWidth] = { 0.0f };
+
+	for (int32 lane = 0; lane < batch->count; ++lane)
+	{
+		const b2Velocity* a = velocities + batch->indexA[lane];
+		const b2Velocity* b = velocities + batch->indexB[lane];
+		vAx[lane] = a->v.x;
+		vAy[lane] = a->v.y;
+		wA[lane] = a->w;
+		vBx[lane] = b->v.x;
+		vBy[lane] = b->v.y;
+		wB[lane] = b->w;
+	}
+
+	bodiesA->vx = b2LoadW(vAx);
+	bodiesA->vy = b2LoadW(vAy);
+	bodiesA->w = b2LoadW(wA);
+	bodiesB->vx = b2LoadW(vBx);
+	bodiesB->vy = b2LoadW(vBy);
+	bodiesB->w = b2LoadW(wB);
+}
+
+static void b2ScatterBodies(const b2WideBodies* bodiesA, const b2WideBodies* bodiesB, const b2WideContactBatch* batch, b2Velocity* velocities)
+{
+	float vAx[b2_simdWidth], vAy[b2_simdWidth], wA[b2_simdWidth];
+	float vBx[b2_simdWidth], vBy[b2_simdWidth], wB[b2_simdWidth];
+	b2StoreW(vAx, bodiesA->vx);
+	b2StoreW(vAy, bodiesA->vy);
+	b2StoreW(wA, bodiesA->w);
+	b2StoreW(vBx, bodiesB->vx);
+	b2StoreW(vBy, bodiesB->vy);
+	b2StoreW(wB, bodiesB->w);
+
+	for (int32 lane = 0; lane < batch->count; ++lane)
+	{
+		b2Velocity* a = velocities + batch->indexA[lane];
+		b2Velocity* b = velocities + batch->indexB[lane];
+		a->v.Set(vAx[lane], vAy[lane]);
+		a->w = wA[lane];
+		b->v.Set(vBx[lane], vBy[lane]);
+		b->w = wB[lane];
+	}
+}
+
+// Apply the impulse P = (px, py) at the anchors rA and rB.
+static void b2ApplyImpulseW(b2WideBodies* A, b2WideBodies* B, b2FloatW mA, b2FloatW iA, b2FloatW mB, b2FloatW iB,
+	b2FloatW rAx, b2FloatW rAy, b2FloatW rBx, b2FloatW rBy, b2FloatW px, b2FloatW py)
+{
+	A->vx = b2SubW(A->vx, b2MulW(mA, px));
+	A->vy = b2SubW(A->vy, b2MulW(mA, py));
+	A->w = b2SubW(A->w, b2MulW(iA, b2SubW(b2MulW(rAx, py), b2MulW(rAy, px))));
+
+	B->vx = b2AddW(B->vx, b2MulW(mB, px));
+	B->vy = b2AddW(B->vy, b2MulW(mB, py));
+	B->w = b2AddW(B->w, b2MulW(iB, b2SubW(b2MulW(rBx, py), b2MulW(rBy, px))));
+}
+
+// Relative velocity at a contact point: vB + cross(wB, rB) - vA - cross(wA, rA).
+static void b2RelativeVelocityW(b2FloatW* dvx, b2FloatW* dvy, const b2WideBodies& A, const b2WideBodies& B,
+	b2FloatW rAx, b2FloatW rAy, b2FloatW rBx, b2FloatW rBy)
+{
+	*dvx = b2AddW(b2SubW(b2SubW(B.vx, b2MulW(B.w, rBy)), A.vx), b2MulW(A.w, rAy));
+	*dvy = b2SubW(b2SubW(b2AddW(B.vy, b2MulW(B.w, rBx)), A.vy), b2MulW(A.w, rAx));
+}
+
+void b2ContactSolver::WarmStartWide()
+{
+	for (int32 i = 0; i < m_wideBatchCount; ++i)
+	{
+		const b2WideContactBatch* batch = m_wideBatches + i;
+
+		b2WideBodies A, B;
+		b2GatherBodies(&A, &B, batch, m_velocities);
+
+		b2FloatW mA = b2LoadW(batch->invMassA);
+		b2FloatW iA = b2LoadW(batch->invIA);
+		b2FloatW mB = b2LoadW(batch->invMassB);
+		b2FloatW iB = b2LoadW(batch->invIB);
+		b2FloatW nx = b2LoadW(batch->normalX);
+		b2FloatW ny = b2LoadW(batch->normalY);
+
+		// tangent = cross(normal, 1) = (ny, -nx)
+		for (int32 j = 0; j < batch->pointCount; ++j)
+		{
+			const b2WideContactPoint* wcp = batch->points + j;
+			b2FloatW ni = b2LoadW(wcp->normalImpulse);
+			b2FloatW ti = b2LoadW(wcp->tangentImpulse);
+			b2FloatW px = b2AddW(b2MulW(ni, nx), b2MulW(ti, ny));
+			b2FloatW py = b2SubW(b2MulW(ni, ny), b2MulW(ti, nx));
+
+			b2ApplyImpulseW(&A, &B, mA, iA, mB, iB,
+				b2LoadW(wcp->rAx), b2LoadW(wcp->rAy), b2LoadW(wcp->rBx), b2LoadW(wcp->rBy), px, py);
+		}
+
+		b2ScatterBodies(&A, &B, batch, m_velocities);
+	}
+}
+
+void b2ContactSolver::SolveWideVelocityConstraints()
+{
+	const b2FloatW zero = b2SplatW(0.0f);
+	const b2FloatW minusOne = b2SplatW(-1.0f);
+
+	for (int32 i = 0; i < m_wideBatchCount; ++i)
+	{
+		b2WideContactBatch* batch = m_wideBatches + i;
+		int32 pointCount = batch->pointCount;
+
+		b2WideBodies A, B;
+		b2GatherBodies(&A, &B, batch, m_velocities);
+
+		b2FloatW mA = b2LoadW(batch->invMassA);
+		b2FloatW iA = b2LoadW(batch->invIA);
+		b2FloatW mB = b2LoadW(batch->invMassB);
+		b2FloatW iB = b2LoadW(batch->invIB);
+		b2FloatW nx = b2LoadW(batch->normalX);
+		b2FloatW ny = b2LoadW(batch->normalY);
+		b2FloatW friction = b2LoadW(batch->friction);
+		b2FloatW tangentSpeed = b2LoadW(batch->tangentSpeed);
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2WideContactPoint* wcp = batch->points + j;
+			b2FloatW rAx = b2LoadW(wcp->rAx), rAy = b2LoadW(wcp->rAy);
+			b2FloatW rBx = b2LoadW(wcp->rBx), rBy = b2LoadW(wcp->rBy);
+
+			b2FloatW dvx, dvy;
+			b2RelativeVelocityW(&dvx, &dvy, A, B, rAx, rAy, rBx, rBy);
+
+			// tangent = (ny, -nx)
+			b2FloatW vt = b2SubW(b2AddW(b2MulW(dvx, ny), b2MulW(dvy, b2MulW(minusOne, nx))), tangentSpeed);
+			b2FloatW lambda = b2MulW(b2LoadW(wcp->tangentMass), b2MulW(minusOne, vt));
+
+			b2FloatW oldImpulse = b2LoadW(wcp->tangentImpulse);
+			b2FloatW maxFriction = b2MulW(friction, b2LoadW(wcp->normalImpulse));
+			b2FloatW newImpulse = b2MaxW(b2MulW(minusOne, maxFriction), b2MinW(b2AddW(oldImpulse, lambda), maxFriction));
+			lambda = b2SubW(newImpulse, oldImpulse);
+			b2StoreW(wcp->tangentImpulse, newImpulse);
+
+			b2FloatW px = b2MulW(lambda, ny);
+			b2FloatW py = b2MulW(lambda, b2MulW(minusOne, nx));
+			b2ApplyImpulseW(&A, &B, mA, iA, mB, iB, rAx, rAy, rBx, rBy, px, py);
+		}
+
+		// Solve normal constraints
+		if (pointCount == 1 || g_blockSolve == false)
+		{
+			for (int32 j = 0; j < pointCount; ++j)
+			{
+				b2WideContactPoint* wcp = batch->points + j;
+				b2FloatW rAx = b2LoadW(wcp->rAx), rAy = b2LoadW(wcp->rAy);
+				b2FloatW rBx = b2LoadW(wcp->rBx), rBy = b2LoadW(wcp->rBy);
+
+				b2FloatW dvx, dvy;
+				b2RelativeVelocityW(&dvx, &dvy, A, B, rAx, rAy, rBx, rBy);
+
+				b2FloatW vn = b2AddW(b2MulW(dvx, nx), b2MulW(dvy, ny));
+				b2FloatW lambda = b2MulW(b2MulW(minusOne, b2LoadW(wcp->normalMass)), b2SubW(vn, b2LoadW(wcp->velocityBias)));
+
+				b2FloatW oldImpulse = b2LoadW(wcp->normalImpulse);
+				b2FloatW newImpulse = b2MaxW(b2AddW(oldImpulse, lambda), zero);
+				lambda = b2SubW(newImpulse, oldImpulse);
+				b2StoreW(wcp->normalImpulse, newImpulse);
+
+				b2FloatW px = b2MulW(lambda, nx);
+				b2FloatW py = b2MulW(lambda, ny);
+				b2ApplyImpulseW(&A, &B, mA, iA, mB, iB, rAx, rAy, rBx, rBy, px, py);
+			}
+		}
+		else
+		{
+			// Block solver, see b2ContactSolver::SolveVelocityConstraints. All four cases
+			// are evaluated and each lane picks the first valid one.
+			b2WideContactPoint* cp1 = batch->points + 0;
+			b2WideContactPoint* cp2 = batch->points + 1;
+
+			b2FloatW r1Ax = b2LoadW(cp1->rAx), r1Ay = b2LoadW(cp1->rAy);
+			b2FloatW r1Bx = b2LoadW(cp1->rBx), r1By = b2LoadW(cp1->rBy);
+			b2FloatW r2Ax = b2LoadW(cp2->rAx), r2Ay = b2LoadW(cp2->rAy);
+			b2FloatW r2Bx = b2LoadW(cp2->rBx), r2By = b2LoadW(cp2->rBy);
+
+			b2FloatW ax = b2LoadW(cp1->normalImpulse);
+			b2FloatW ay = b2LoadW(cp2->normalImpulse);
+
+			b2FloatW dv1x, dv1y, dv2x, dv2y;
+			b2RelativeVelocityW(&dv1x, &dv1y, A, B, r1Ax, r1Ay, r1Bx, r1By);
+			b2RelativeVelocityW(&dv2x, &dv2y, A, B, r2Ax, r2Ay, r2Bx, r2By);
+
+			b2FloatW vn1 = b2AddW(b2MulW(dv1x, nx), b2MulW(dv1y, ny));
+			b2FloatW vn2 = b2AddW(b2MulW(dv2x, nx), b2MulW(dv2y, ny));
+
+			b2FloatW k11 = b2LoadW(batch->k11);
+			b2FloatW k12 = b2LoadW(batch->k12);
+			b2FloatW k22 = b2LoadW(batch->k22);
+
+			// b' = b - K * a
+			b2FloatW bx = b2SubW(b2SubW(vn1, b2LoadW(cp1->velocityBias)), b2AddW(b2MulW(k11, ax), b2MulW(k12, ay)));
+			b2FloatW by = b2SubW(b2SubW(vn2, b2LoadW(cp2->velocityBias)), b2AddW(b2MulW(k12, ax), b2MulW(k22, ay)));
+
+			// Case 1: vn = 0, x = - inv(A) * b'
+			b2FloatW x1x = b2MulW(minusOne, b2AddW(b2MulW(b2LoadW(batch->normalMass11), bx), b2MulW(b2LoadW(batch->normalMass12), by)));
+			b2FloatW x1y = b2MulW(minusOne, b2AddW(b2MulW(b2LoadW(batch->normalMass21), bx), b2MulW(b2LoadW(batch->normalMass22), by)));
+			b2MaskW valid1 = b2AndW(b2GreaterEqualW(x1x, zero), b2GreaterEqualW(x1y, zero));
+
+			// Case 2: vn1 = 0 and x2 = 0
+			b2FloatW x2x = b2MulW(b2MulW(minusOne, b2LoadW(cp1->normalMass)), bx);
+			b2FloatW vn2Case2 = b2AddW(b2MulW(k12, x2x), by);
+			b2MaskW valid2 = b2AndW(b2GreaterEqualW(x2x, zero), b2GreaterEqualW(vn2Case2, zero));
+
+			// Case 3: vn2 = 0 and x1 = 0
+			b2FloatW x3y = b2MulW(b2MulW(minusOne, b2LoadW(cp2->normalMass)), by);
+			b2FloatW vn1Case3 = b2AddW(b2MulW(k12, x3y), bx);
+			b2MaskW valid3 = b2AndW(b2GreaterEqualW(x3y, zero), b2GreaterEqualW(vn1Case3, zero));
+
+			// Case 4: x1 = x2 = 0
+			b2MaskW valid4 = b2AndW(b2GreaterEqualW(bx, zero), b2GreaterEqualW(by, zero));
+
+			// Lanes without a valid case keep the old impulse.
+			b2FloatW xx = b2SelectW(valid4, zero, ax);
+			b2FloatW xy = b2SelectW(valid4, zero, ay);
+			xx = b2SelectW(valid3, zero, xx);
+			xy = b2SelectW(valid3, x3y, xy);
+			xx = b2SelectW(valid2, x2x, xx);
+			xy = b2SelectW(valid2, zero, xy);
+			xx = b2SelectW(valid1, x1x, xx);
+			xy = b2SelectW(valid1, x1y, xy);
+
+			b2FloatW dx = b2SubW(xx, ax);
+			b2FloatW dy = b2SubW(xy, ay);
+
+			b2FloatW p1x = b2MulW(dx, nx), p1y = b2MulW(dx, ny);
+			b2FloatW p2x = b2MulW(dy, nx), p2y = b2MulW(dy, ny);
+
+			A.vx = b2SubW(A.vx, b2MulW(mA, b2AddW(p1x, p2x)));
+			A.vy = b2SubW(A.vy, b2MulW(mA, b2AddW(p1y, p2y)));
+			A.w = b2SubW(A.w, b2MulW(iA, b2AddW(b2SubW(b2MulW(r1Ax, p1y), b2MulW(r1Ay, p1x)), b2SubW(b2MulW(r2Ax, p2y), b2MulW(r2Ay, p2x)))));
+
+			B.vx = b2AddW(B.vx, b2MulW(mB, b2AddW(p1x, p2x)));
+			B.vy = b2AddW(B.vy, b2MulW(mB, b2AddW(p1y, p2y)));
+			B.w = b2AddW(B.w, b2MulW(iB, b2AddW(b2SubW(b2MulW(r1Bx, p1y), b2MulW(r1By, p1x)), b2SubW(b2MulW(r2Bx, p2y), b2MulW(r2By, p2x)))));
+
+			b2StoreW(cp1->normalImpulse, xx);
+			b2StoreW(cp2->normalImpulse, xy);
+		}
+
+		b2ScatterBodies(&A, &B, batch, m_velocities);
+	}
+}
+
+void b2ContactSolver::StoreWideImpulses()
+{
+	for (int32 i = 0; i < m_wideBatchCount; ++i)
+	{
+		const b2WideContactBatch* batch = m_wideBatches + i;
+		for (int32 lane = 0; lane < batch->count; ++lane)
+		{
+			b2ContactVelocityConstraint* vc = m_velocityConstraints + batch->constraints[lane];
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = batch->points[j].normalImpulse[lane];
+				vc->points[j].tangentImpulse = batch->points[j].tangentImpulse[lane];
+			}
+		}
+	}
+}
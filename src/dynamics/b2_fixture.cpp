@@ -23,6 +23,7 @@
 #include "box2d/b2_fixture.h"
 #include "box2d/b2_block_allocator.h"
 #include "box2d/b2_broad_phase.h"
+#include "box2d/b2_capsule_shape.h"
 #include "box2d/b2_chain_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_collision.h"
@@ -115,6 +116,14 @@ void b2Fixture::Destroy(b2BlockAllocator* allocator)
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			b2CapsuleShape* s = (b2CapsuleShape*)m_shape;
+			s->~b2CapsuleShape();
+			allocator->Free(s, sizeof(b2CapsuleShape));
+		}
+		break;
+
 	default:
 		b2Assert(false);
 		break;
@@ -129,12 +138,14 @@ void b2Fixture::CreateProxies(b2BroadPhase* broadPhase, const b2Transform& xf)
 
 	// Create proxies in the broad-phase.
 	m_proxyCount = m_shape->GetChildCount();
+	bool isStatic = m_body->GetType() == b2_staticBody;
 
 	for (int32 i = 0; i < m_proxyCount; ++i)
 	{
 		b2FixtureProxy* proxy = m_proxies + i;
 		m_shape->ComputeAABB(&proxy->aabb, xf, i);
-		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy);
+		proxy->motion.SetZero();
+		proxy->proxyId = broadPhase->CreateProxy(proxy->aabb, proxy, isStatic);
 		proxy->fixture = this;
 		proxy->childIndex = i;
 	}
@@ -153,6 +164,25 @@ void b2Fixture::DestroyProxies(b2BroadPhase* broadPhase)
 	m_proxyCount = 0;
 }
 
+// Get the fat AABB margin of a proxy that moved by the displacement.
+static inline b2Vec2 b2GetMargin(b2BroadPhase* broadPhase, b2FixtureProxy* proxy, const b2Vec2& displacement)
+{
+	if (broadPhase->GetAdaptiveMargins() == false)
+	{
+		return b2Vec2(b2_aabbExtension, b2_aabbExtension);
+	}
+
+	// A margin that covers the recent movement on both sides keeps a proxy that changes
+	// direction inside its fat AABB. It shrinks as the motion decays, so resting proxies
+	// do not form pairs with everything within b2_aabbExtension.
+	proxy->motion = b2Max(b2Abs(displacement), b2_aabbMotionDecay * proxy->motion);
+
+	b2Vec2 margin = b2_aabbMotionMultiplier * proxy->motion;
+	margin.x = b2Clamp(margin.x + b2_aabbMinExtension, b2_aabbMinExtension, b2_aabbMaxExtension);
+	margin.y = b2Clamp(margin.y + b2_aabbMinExtension, b2_aabbMinExtension, b2_aabbMaxExtension);
+	return margin;
+}
+
 void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transform1, const b2Transform& transform2)
 {
 	if (m_proxyCount == 0)
@@ -173,7 +203,34 @@ void b2Fixture::Synchronize(b2BroadPhase* broadPhase, const b2Transform& transfo
 
 		b2Vec2 displacement = aabb2.GetCenter() - aabb1.GetCenter();
 
-		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement);
+		b2Vec2 margin = b2GetMargin(broadPhase, proxy, displacement);
+		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, displacement, margin);
+	}
+}
+
+void b2Fixture::SweepProxies(const b2Transform& transform1, const b2Transform& transform2)
+{
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		b2FixtureProxy* proxy = m_proxies + i;
+
+		// Compute an AABB that covers the swept shape (may miss some rotation effect).
+		b2AABB aabb1, aabb2;
+		m_shape->ComputeAABB(&aabb1, transform1, proxy->childIndex);
+		m_shape->ComputeAABB(&aabb2, transform2, proxy->childIndex);
+
+		proxy->aabb.Combine(aabb1, aabb2);
+		proxy->displacement = aabb2.GetCenter() - aabb1.GetCenter();
+	}
+}
+
+void b2Fixture::MoveProxies(b2BroadPhase* broadPhase)
+{
+	for (int32 i = 0; i < m_proxyCount; ++i)
+	{
+		b2FixtureProxy* proxy = m_proxies + i;
+		b2Vec2 margin = b2GetMargin(broadPhase, proxy, proxy->displacement);
+		broadPhase->MoveProxy(proxy->proxyId, proxy->aabb, proxy->displacement, margin);
 	}
 }
 
@@ -294,6 +351,16 @@ void b2Fixture::Dump(int32 bodyIndex)
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			b2CapsuleShape* s = (b2CapsuleShape*)m_shape;
+			b2Dump("    b2CapsuleShape shape;\n");
+			b2Dump("    shape.m_radius = %.9g;\n", s->m_radius);
+			b2Dump("    shape.m_vertex1.Set(%.9g, %.9g);\n", s->m_vertex1.x, s->m_vertex1.y);
+			b2Dump("    shape.m_vertex2.Set(%.9g, %.9g);\n", s->m_vertex2.x, s->m_vertex2.y);
+		}
+		break;
+
 	default:
 		return;
 	}
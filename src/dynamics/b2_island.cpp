@@ -29,9 +29,12 @@
 #include "box2d/b2_timer.h"
 #include "box2d/b2_world.h"
 
+#include "b2_constraint_graph.h"
 #include "b2_contact_solver.h"
 #include "b2_island.h"
 
+#include <new>
+
 /*
 Position Correction Notes
 =========================
@@ -122,9 +125,11 @@ to few cache misses.
 The bodies are not accessed during iteration. Instead read only data, such as
 the mass values are stored with the constraints. The mutable data are the constraint
 impulses and the bodies velocities/positions. The impulses are held inside the
-constraint structures. The body velocities/positions are held in compact, temporary
-arrays to increase the number of cache hits. Linear and angular velocity are
-stored in a single array since multiple arrays lead to multiple misses.
+constraint structures. The body velocities/positions are held in compact arrays
+owned by the world to increase the number of cache hits. The islands solve these
+arrays in place, so the state is not copied out of the bodies and back each step.
+Linear and angular velocity are stored in a single array since multiple arrays
+lead to multiple misses.
 */
 
 /*
@@ -166,20 +171,61 @@ b2Island::b2Island(
 
 	m_allocator = allocator;
 	m_listener = listener;
+	m_scheduler = nullptr;
+	m_impulses = nullptr;
+	m_ownsArrays = true;
 
 	m_bodies = (b2Body**)m_allocator->Allocate(bodyCapacity * sizeof(b2Body*));
 	m_contacts = (b2Contact**)m_allocator->Allocate(contactCapacity	 * sizeof(b2Contact*));
 	m_joints = (b2Joint**)m_allocator->Allocate(jointCapacity * sizeof(b2Joint*));
+	m_indices = (int32*)m_allocator->Allocate(bodyCapacity * sizeof(int32));
 
-	m_velocities = (b2Velocity*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Velocity));
-	m_positions = (b2Position*)m_allocator->Allocate(m_bodyCapacity * sizeof(b2Position));
+	m_velocities = nullptr;
+	m_positions = nullptr;
+}
+
+b2Island::b2Island(
+	b2Body** bodies,
+	int32* indices,
+	int32 bodyCapacity,
+	b2Contact** contacts,
+	int32 contactCapacity,
+	b2Joint** joints,
+	int32 jointCapacity,
+	b2StackAllocator* allocator,
+	b2ContactListener* listener)
+{
+	m_bodyCapacity = bodyCapacity;
+	m_contactCapacity = contactCapacity;
+	m_jointCapacity = jointCapacity;
+	m_bodyCount = 0;
+	m_contactCount = 0;
+	m_jointCount = 0;
+
+	m_allocator = allocator;
+	m_listener = listener;
+	m_scheduler = nullptr;
+	m_impulses = nullptr;
+	m_ownsArrays = false;
+
+	m_bodies = bodies;
+	m_contacts = contacts;
+	m_joints = joints;
+	m_indices = indices;
+
+	m_velocities = nullptr;
+	m_positions = nullptr;
 }
 
 b2Island::~b2Island()
 {
+	if (m_ownsArrays == false)
+	{
+		return;
+	}
+
 	// Warning: the order should reverse the constructor order.
-	m_allocator->Free(m_positions);
-	m_allocator->Free(m_velocities);
+	m_allocator->Free(m_indices);
 	m_allocator->Free(m_joints);
 	m_allocator->Free(m_contacts);
 	m_allocator->Free(m_bodies);
@@ -187,46 +233,92 @@ b2Island::~b2Island()
 
 void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep)
 {
-	b2Timer timer;
-
 	float h = step.dt;
 
-	// Integrate velocities and apply damping. Initialize the body state.
-	for (int32 i = 0; i < m_bodyCount; ++i)
+	// Store positions for continuous collision. The solver arrays are usually the body
+	// state itself, otherwise the state is copied in here.
+	b2SolverBodies* solverBodies = m_bodies[0]->m_solverBodies;
+	if (m_positions == solverBodies->positions)
 	{
-		b2Body* b = m_bodies[i];
+		for (int32 i = 0; i < m_bodyCount; ++i)
+		{
+			int32 index = m_indices[i];
+			solverBodies->positions0[index] = m_positions[index];
+		}
+	}
+	else
+	{
+		for (int32 i = 0; i < m_bodyCount; ++i)
+		{
+			int32 solverIndex = m_bodies[i]->m_solverIndex;
+			int32 index = m_indices[i];
+			solverBodies->positions0[solverIndex] = solverBodies->positions[solverIndex];
+			m_positions[index] = solverBodies->positions[solverIndex];
+			m_velocities[index] = solverBodies->velocities[solverIndex];
+		}
+	}
+
+	bool positionSolved;
+	if (step.softStep)
+	{
+		positionSolved = SolveSoftStep(profile, step, gravity);
+	}
+	else
+	{
+		positionSolved = SolveIterations(profile, step, gravity);
+	}
 
-		b2Vec2 c = b->m_sweep.c;
-		float a = b->m_sweep.a;
-		b2Vec2 v = b->m_linearVelocity;
-		float w = b->m_angularVelocity;
+	if (allowSleep)
+	{
+		float minSleepTime = b2_maxFloat;
 
-		// Store positions for continuous collision.
-		b->m_sweep.c0 = b->m_sweep.c;
-		b->m_sweep.a0 = b->m_sweep.a;
+		const float linTolSqr = b2_linearSleepTolerance * b2_linearSleepTolerance;
+		const float angTolSqr = b2_angularSleepTolerance * b2_angularSleepTolerance;
 
-		if (b->m_type == b2_dynamicBody)
+		for (int32 i = 0; i < m_bodyCount; ++i)
 		{
-			// Integrate velocities.
-			v += h * b->m_invMass * (b->m_gravityScale * b->m_mass * gravity + b->m_force);
-			w += h * b->m_invI * b->m_torque;
-
-			// Apply damping.
-			// ODE: dv/dt + c * v = 0
-			// Solution: v(t) = v0 * exp(-c * t)
-			// Time step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t) * exp(-c * dt) = v * exp(-c * dt)
-			// v2 = exp(-c * dt) * v1
-			// Pade approximation:
-			// v2 = v1 * 1 / (1 + c * dt)
-			v *= 1.0f / (1.0f + h * b->m_linearDamping);
-			w *= 1.0f / (1.0f + h * b->m_angularDamping);
+			b2Body* b = m_bodies[i];
+			if (b->GetType() == b2_staticBody)
+			{
+				continue;
+			}
+
+			const b2Velocity& v = m_velocities[m_indices[i]];
+			if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
+				v.w * v.w > angTolSqr ||
+				b2Dot(v.v, v.v) > linTolSqr)
+			{
+				b->m_sleepTime = 0.0f;
+				minSleepTime = 0.0f;
+			}
+			else
+			{
+				b->m_sleepTime += h;
+				minSleepTime = b2Min(minSleepTime, b->m_sleepTime);
+			}
 		}
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		if (minSleepTime >= b2_timeToSleep && positionSolved)
+		{
+			for (int32 i = 0; i < m_bodyCount; ++i)
+			{
+				b2Body* b = m_bodies[i];
+				b->SetAwake(false);
+			}
+		}
 	}
+}
+
+// Solve the velocity constraints with iterations and then fix the remaining overlap with
+// the position constraints.
+bool b2Island::SolveIterations(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity)
+{
+	b2Timer timer;
+
+	float h = step.dt;
+
+	// Integrate velocities and apply damping.
+	IntegrateVelocities(h, gravity);
 
 	timer.Reset();
 
@@ -246,16 +338,28 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	contactSolverDef.allocator = m_allocator;
 
 	b2ContactSolver contactSolver(&contactSolverDef);
-	contactSolver.InitializeVelocityConstraints();
 
-	if (step.warmStarting)
+	// Large islands may be split into graph colors that are solved in parallel.
+	b2ConstraintGraph* graph = nullptr;
+	if (b2IsColoredIsland(step, m_contactCount, m_jointCount))
 	{
-		contactSolver.WarmStart();
+		void* mem = m_allocator->Allocate(sizeof(b2ConstraintGraph));
+		graph = new (mem) b2ConstraintGraph(this, &contactSolver, &solverData, m_scheduler);
+		graph->InitializeVelocityConstraints();
 	}
-	
-	for (int32 i = 0; i < m_jointCount; ++i)
+	else
 	{
-		m_joints[i]->InitVelocityConstraints(solverData);
+		contactSolver.InitializeVelocityConstraints();
+
+		if (step.warmStarting)
+		{
+			contactSolver.WarmStart();
+		}
+
+		for (int32 i = 0; i < m_jointCount; ++i)
+		{
+			m_joints[i]->InitVelocityConstraints(solverData);
+		}
 	}
 
 	profile->solveInit = timer.GetMilliseconds();
@@ -264,6 +368,12 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	timer.Reset();
 	for (int32 i = 0; i < step.velocityIterations; ++i)
 	{
+		if (graph != nullptr)
+		{
+			graph->SolveVelocityConstraints();
+			continue;
+		}
+
 		for (int32 j = 0; j < m_jointCount; ++j)
 		{
 			m_joints[j]->SolveVelocityConstraints(solverData);
@@ -277,12 +387,97 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	profile->solveVelocity = timer.GetMilliseconds();
 
 	// Integrate positions
+	IntegratePositions(h);
+
+	// Solve position constraints
+	timer.Reset();
+	bool positionSolved = false;
+	for (int32 i = 0; i < step.positionIterations; ++i)
+	{
+		if (graph != nullptr)
+		{
+			if (graph->SolvePositionConstraints())
+			{
+				positionSolved = true;
+				break;
+			}
+			continue;
+		}
+
+		bool contactsOkay = contactSolver.SolvePositionConstraints();
+
+		bool jointsOkay = true;
+		for (int32 j = 0; j < m_jointCount; ++j)
+		{
+			bool jointOkay = m_joints[j]->SolvePositionConstraints(solverData);
+			jointsOkay = jointsOkay && jointOkay;
+		}
+
+		if (contactsOkay && jointsOkay)
+		{
+			// Exit early if the position errors are small.
+			positionSolved = true;
+			break;
+		}
+	}
+
+	if (graph != nullptr)
+	{
+		graph->~b2ConstraintGraph();
+		m_allocator->Free(graph);
+	}
+
+	SynchronizeBodies();
+
+	profile->solvePosition = timer.GetMilliseconds();
+
+	Report(contactSolver.m_velocityConstraints);
+
+	return positionSolved;
+}
+
+void b2Island::IntegrateVelocities(float h, const b2Vec2& gravity)
+{
+	for (int32 i = 0; i < m_bodyCount; ++i)
+	{
+		b2Body* b = m_bodies[i];
+		if (b->m_type != b2_dynamicBody)
+		{
+			continue;
+		}
+
+		int32 index = m_indices[i];
+		b2Vec2 v = m_velocities[index].v;
+		float w = m_velocities[index].w;
+
+		// Integrate velocities.
+		v += h * b->m_invMass * (b->m_gravityScale * b->m_mass * gravity + b->m_force);
+		w += h * b->m_invI * b->m_torque;
+
+		// Apply damping.
+		// ODE: dv/dt + c * v = 0
+		// Solution: v(t) = v0 * exp(-c * t)
+		// Time step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t) * exp(-c * dt) = v * exp(-c * dt)
+		// v2 = exp(-c * dt) * v1
+		// Pade approximation:
+		// v2 = v1 * 1 / (1 + c * dt)
+		v *= 1.0f / (1.0f + h * b->m_linearDamping);
+		w *= 1.0f / (1.0f + h * b->m_angularDamping);
+
+		m_velocities[index].v = v;
+		m_velocities[index].w = w;
+	}
+}
+
+void b2Island::IntegratePositions(float h)
+{
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Vec2 c = m_positions[i].c;
-		float a = m_positions[i].a;
-		b2Vec2 v = m_velocities[i].v;
-		float w = m_velocities[i].w;
+		int32 index = m_indices[i];
+		b2Vec2 c = m_positions[index].c;
+		float a = m_positions[index].a;
+		b2Vec2 v = m_velocities[index].v;
+		float w = m_velocities[index].w;
 
 		// Check for large velocities
 		b2Vec2 translation = h * v;
@@ -303,103 +498,131 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		c += h * v;
 		a += h * w;
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		m_positions[index].c = c;
+		m_positions[index].a = a;
+		m_velocities[index].v = v;
+		m_velocities[index].w = w;
 	}
+}
 
-	// Solve position constraints
-	timer.Reset();
-	bool positionSolved = false;
-	for (int32 i = 0; i < step.positionIterations; ++i)
+// Synchronize the transforms. Copy the state back if the solver arrays are not the body
+// state.
+void b2Island::SynchronizeBodies()
+{
+	b2SolverBodies* solverBodies = m_bodies[0]->m_solverBodies;
+	if (m_positions != solverBodies->positions)
 	{
-		bool contactsOkay = contactSolver.SolvePositionConstraints();
-
-		bool jointsOkay = true;
-		for (int32 j = 0; j < m_jointCount; ++j)
-		{
-			bool jointOkay = m_joints[j]->SolvePositionConstraints(solverData);
-			jointsOkay = jointsOkay && jointOkay;
-		}
-
-		if (contactsOkay && jointsOkay)
+		for (int32 i = 0; i < m_bodyCount; ++i)
 		{
-			// Exit early if the position errors are small.
-			positionSolved = true;
-			break;
+			int32 solverIndex = m_bodies[i]->m_solverIndex;
+			int32 index = m_indices[i];
+			solverBodies->positions[solverIndex] = m_positions[index];
+			solverBodies->velocities[solverIndex] = m_velocities[index];
 		}
 	}
 
-	// Copy state buffers back to the bodies
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Body* body = m_bodies[i];
-		body->m_sweep.c = m_positions[i].c;
-		body->m_sweep.a = m_positions[i].a;
-		body->m_linearVelocity = m_velocities[i].v;
-		body->m_angularVelocity = m_velocities[i].w;
-		body->SynchronizeTransform();
+		m_bodies[i]->SynchronizeTransform();
 	}
+}
 
-	profile->solvePosition = timer.GetMilliseconds();
+// Split the step into sub-steps and solve the contacts as soft constraints, see
+// b2_contact_solver_soft.cpp. The velocity iterations of the step are the number of
+// sub-steps. Joints are solved with their velocity solver in each sub-step and their
+// remaining error is fixed by the position iterations at the end of the step.
+bool b2Island::SolveSoftStep(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity)
+{
+	b2Timer timer;
 
-	Report(contactSolver.m_velocityConstraints);
+	int32 subStepCount = b2Max(step.velocityIterations, 1);
+	float h = step.dt / subStepCount;
 
-	if (allowSleep)
+	// The joints see each sub-step as a time step.
+	b2SolverData solverData;
+	solverData.step = step;
+	solverData.step.dt = h;
+	solverData.step.inv_dt = subStepCount * step.inv_dt;
+	solverData.positions = m_positions;
+	solverData.velocities = m_velocities;
+
+	b2ContactSolverDef contactSolverDef;
+	contactSolverDef.step = step;
+	contactSolverDef.contacts = m_contacts;
+	contactSolverDef.count = m_contactCount;
+	contactSolverDef.positions = m_positions;
+	contactSolverDef.velocities = m_velocities;
+	contactSolverDef.allocator = m_allocator;
+
+	b2ContactSolver contactSolver(&contactSolverDef);
+	contactSolver.PrepareSoftConstraints(h);
+
+	profile->solveInit = timer.GetMilliseconds();
+
+	timer.Reset();
+	for (int32 i = 0; i < subStepCount; ++i)
 	{
-		float minSleepTime = b2_maxFloat;
+		IntegrateVelocities(h, gravity);
 
-		const float linTolSqr = b2_linearSleepTolerance * b2_linearSleepTolerance;
-		const float angTolSqr = b2_angularSleepTolerance * b2_angularSleepTolerance;
+		// The impulses of the previous sub-step carry over unchanged.
+		solverData.step.dtRatio = i == 0 ? step.dtRatio : 1.0f;
+		for (int32 j = 0; j < m_jointCount; ++j)
+		{
+			m_joints[j]->InitVelocityConstraints(solverData);
+		}
 
-		for (int32 i = 0; i < m_bodyCount; ++i)
+		contactSolver.WarmStartSoft();
+
+		for (int32 j = 0; j < m_jointCount; ++j)
 		{
-			b2Body* b = m_bodies[i];
-			if (b->GetType() == b2_staticBody)
-			{
-				continue;
-			}
+			m_joints[j]->SolveVelocityConstraints(solverData);
+		}
 
-			if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
-				b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
-				b2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
-			{
-				b->m_sleepTime = 0.0f;
-				minSleepTime = 0.0f;
-			}
-			else
-			{
-				b->m_sleepTime += h;
-				minSleepTime = b2Min(minSleepTime, b->m_sleepTime);
-			}
+		contactSolver.SolveSoftVelocityConstraints(true);
+
+		IntegratePositions(h);
+
+		// Relax
+		for (int32 j = 0; j < m_jointCount; ++j)
+		{
+			m_joints[j]->SolveVelocityConstraints(solverData);
 		}
 
-		if (minSleepTime >= b2_timeToSleep && positionSolved)
+		contactSolver.SolveSoftVelocityConstraints(false);
+	}
+
+	contactSolver.ApplySoftRestitution();
+	contactSolver.StoreSoftImpulses();
+	profile->solveVelocity = timer.GetMilliseconds();
+
+	// Contacts do not need position correction. Islands without joints are always solved.
+	timer.Reset();
+	bool positionSolved = m_jointCount == 0;
+	for (int32 i = 0; i < step.positionIterations && positionSolved == false; ++i)
+	{
+		bool jointsOkay = true;
+		for (int32 j = 0; j < m_jointCount; ++j)
 		{
-			for (int32 i = 0; i < m_bodyCount; ++i)
-			{
-				b2Body* b = m_bodies[i];
-				b->SetAwake(false);
-			}
+			bool jointOkay = m_joints[j]->SolvePositionConstraints(solverData);
+			jointsOkay = jointsOkay && jointOkay;
 		}
+
+		positionSolved = jointsOkay;
 	}
+
+	SynchronizeBodies();
+
+	profile->solvePosition = timer.GetMilliseconds();
+
+	Report(contactSolver.m_velocityConstraints);
+
+	return positionSolved;
 }
 
 void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB)
 {
-	b2Assert(toiIndexA < m_bodyCount);
-	b2Assert(toiIndexB < m_bodyCount);
-
-	// Initialize the body state.
-	for (int32 i = 0; i < m_bodyCount; ++i)
-	{
-		b2Body* b = m_bodies[i];
-		m_positions[i].c = b->m_sweep.c;
-		m_positions[i].a = b->m_sweep.a;
-		m_velocities[i].v = b->m_linearVelocity;
-		m_velocities[i].w = b->m_angularVelocity;
-	}
+	// The TOI solver always works on the body state in place.
+	b2Assert(m_positions == m_bodies[0]->m_solverBodies->positions);
 
 	b2ContactSolverDef contactSolverDef;
 	contactSolverDef.contacts = m_contacts;
@@ -454,10 +677,9 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 #endif
 
 	// Leap of faith to new safe state.
-	m_bodies[toiIndexA]->m_sweep.c0 = m_positions[toiIndexA].c;
-	m_bodies[toiIndexA]->m_sweep.a0 = m_positions[toiIndexA].a;
-	m_bodies[toiIndexB]->m_sweep.c0 = m_positions[toiIndexB].c;
-	m_bodies[toiIndexB]->m_sweep.a0 = m_positions[toiIndexB].a;
+	b2Position* positions0 = m_bodies[0]->m_solverBodies->positions0;
+	positions0[toiIndexA] = m_positions[toiIndexA];
+	positions0[toiIndexB] = m_positions[toiIndexB];
 
 	// No warm starting is needed for TOI events because warm
 	// starting impulses were applied in the discrete solver.
@@ -477,10 +699,11 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 	// Integrate positions
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
-		b2Vec2 c = m_positions[i].c;
-		float a = m_positions[i].a;
-		b2Vec2 v = m_velocities[i].v;
-		float w = m_velocities[i].w;
+		int32 index = m_indices[i];
+		b2Vec2 c = m_positions[index].c;
+		float a = m_positions[index].a;
+		b2Vec2 v = m_velocities[index].v;
+		float w = m_velocities[index].w;
 
 		// Check for large velocities
 		b2Vec2 translation = h * v;
@@ -501,18 +724,13 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 		c += h * v;
 		a += h * w;
 
-		m_positions[i].c = c;
-		m_positions[i].a = a;
-		m_velocities[i].v = v;
-		m_velocities[i].w = w;
+		m_positions[index].c = c;
+		m_positions[index].a = a;
+		m_velocities[index].v = v;
+		m_velocities[index].w = w;
 
 		// Sync bodies
-		b2Body* body = m_bodies[i];
-		body->m_sweep.c = c;
-		body->m_sweep.a = a;
-		body->m_linearVelocity = v;
-		body->m_angularVelocity = w;
-		body->SynchronizeTransform();
+		m_bodies[i]->SynchronizeTransform();
 	}
 
 	Report(contactSolver.m_velocityConstraints);
@@ -520,7 +738,7 @@ void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiInd
 
 void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 {
-	if (m_listener == nullptr)
+	if (m_listener == nullptr && m_impulses == nullptr)
 	{
 		return;
 	}
@@ -539,6 +757,13 @@ void b2Island::Report(const b2ContactVelocityConstraint* constraints)
 			impulse.tangentImpulses[j] = vc->points[j].tangentImpulse;
 		}
 
-		m_listener->PostSolve(c, &impulse);
+		if (m_impulses != nullptr)
+		{
+			m_impulses[i] = impulse;
+		}
+		else
+		{
+			m_listener->PostSolve(c, &impulse);
+		}
 	}
 }
@@ -25,21 +25,31 @@
 
 #include "box2d/b2_body.h"
 #include "box2d/b2_math.h"
+#include "box2d/b2_stack_allocator.h"
 #include "box2d/b2_time_step.h"
 
 class b2Contact;
 class b2Joint;
-class b2StackAllocator;
 class b2ContactListener;
+class b2TaskScheduler;
+struct b2ContactImpulse;
 struct b2ContactVelocityConstraint;
 struct b2Profile;
 
-/// This is an internal class.
+/// This is an internal class. The island solves the body state in the solver arrays
+/// of the world in place. The solver arrays must be set before calling Solve.
 class b2Island
 {
 public:
 	b2Island(int32 bodyCapacity, int32 contactCapacity, int32 jointCapacity,
 			b2StackAllocator* allocator, b2ContactListener* listener);
+
+	/// Construct an island over arrays owned by the caller. The island does not
+	/// allocate or free these. The bodies may be solved in private solver arrays using
+	/// their island index, then the state is copied back to the world.
+	b2Island(b2Body** bodies, int32* indices, int32 bodyCapacity, b2Contact** contacts, int32 contactCapacity,
+			b2Joint** joints, int32 jointCapacity, b2StackAllocator* allocator, b2ContactListener* listener);
+
 	~b2Island();
 
 	void Clear()
@@ -56,8 +66,9 @@ public:
 	void Add(b2Body* body)
 	{
 		b2Assert(m_bodyCount < m_bodyCapacity);
-		body->m_islandIndex = m_bodyCount;
+		body->m_islandIndex = body->m_solverIndex;
 		m_bodies[m_bodyCount] = body;
+		m_indices[m_bodyCount] = body->m_solverIndex;
 		++m_bodyCount;
 	}
 
@@ -75,13 +86,37 @@ public:
 
 	void Report(const b2ContactVelocityConstraint* constraints);
 
+	// The solvers used by Solve. These return true if the position error is small.
+	bool SolveIterations(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity);
+	bool SolveSoftStep(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity);
+
+	// Integrate the velocities of the bodies over h and apply damping.
+	void IntegrateVelocities(float h, const b2Vec2& gravity);
+
+	// Integrate the positions of the bodies over h, clamping large velocities.
+	void IntegratePositions(float h);
+
+	// Copy the solver state back to the bodies if needed and update their transforms.
+	void SynchronizeBodies();
+
 	b2StackAllocator* m_allocator;
 	b2ContactListener* m_listener;
 
+	// Used to solve the colors of a large island in parallel. See b2ConstraintGraph.
+	b2TaskScheduler* m_scheduler;
+
+	// If this is not null the contact impulses are stored here instead of
+	// being reported to the listener.
+	b2ContactImpulse* m_impulses;
+
 	b2Body** m_bodies;
 	b2Contact** m_contacts;
 	b2Joint** m_joints;
 
+	// The island index of each body, so the solver can walk the solver arrays without
+	// visiting the bodies.
+	int32* m_indices;
+
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
 
@@ -92,6 +127,23 @@ public:
 	int32 m_bodyCapacity;
 	int32 m_contactCapacity;
 	int32 m_jointCapacity;
+
+	bool m_ownsArrays;
+};
+
+/// Storage for a worker that solves islands in parallel. This is an internal structure.
+struct b2IslandWorker
+{
+	b2StackAllocator allocator;
+
+	// Solver arrays sized for the largest island followed by the static bodies.
+	b2Position* positions;
+	b2Velocity* velocities;
+
+	// The island indices of the bodies in the solver arrays, 0 to the largest island size.
+	int32* indices;
+
+	b2Profile profile;
 };
 
 #endif
@@ -90,8 +90,8 @@ void b2WheelJoint::InitVelocityConstraints(const b2SolverData& data)
 {
 	m_indexA = m_bodyA->m_islandIndex;
 	m_indexB = m_bodyB->m_islandIndex;
-	m_localCenterA = m_bodyA->m_sweep.localCenter;
-	m_localCenterB = m_bodyB->m_sweep.localCenter;
+	m_localCenterA = m_bodyA->m_localCenter;
+	m_localCenterB = m_bodyB->m_localCenter;
 	m_invMassA = m_bodyA->m_invMass;
 	m_invMassB = m_bodyB->m_invMass;
 	m_invIA = m_bodyA->m_invI;
@@ -482,17 +482,17 @@ float b2WheelJoint::GetJointLinearSpeed() const
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
 
-	b2Vec2 rA = b2Mul(bA->m_xf.q, m_localAnchorA - bA->m_sweep.localCenter);
-	b2Vec2 rB = b2Mul(bB->m_xf.q, m_localAnchorB - bB->m_sweep.localCenter);
-	b2Vec2 p1 = bA->m_sweep.c + rA;
-	b2Vec2 p2 = bB->m_sweep.c + rB;
+	b2Vec2 rA = b2Mul(bA->m_xf.q, m_localAnchorA - bA->m_localCenter);
+	b2Vec2 rB = b2Mul(bB->m_xf.q, m_localAnchorB - bB->m_localCenter);
+	b2Vec2 p1 = bA->GetWorldCenter() + rA;
+	b2Vec2 p2 = bB->GetWorldCenter() + rB;
 	b2Vec2 d = p2 - p1;
 	b2Vec2 axis = b2Mul(bA->m_xf.q, m_localXAxisA);
 
-	b2Vec2 vA = bA->m_linearVelocity;
-	b2Vec2 vB = bB->m_linearVelocity;
-	float wA = bA->m_angularVelocity;
-	float wB = bB->m_angularVelocity;
+	b2Vec2 vA = bA->GetLinearVelocity();
+	b2Vec2 vB = bB->GetLinearVelocity();
+	float wA = bA->GetAngularVelocity();
+	float wB = bB->GetAngularVelocity();
 
 	float speed = b2Dot(d, b2Cross(wA, axis)) + b2Dot(axis, vB + b2Cross(wB, rB) - vA - b2Cross(wA, rA));
 	return speed;
@@ -502,13 +502,13 @@ float b2WheelJoint::GetJointAngle() const
 {
 	b2Body* bA = m_bodyA;
 	b2Body* bB = m_bodyB;
-	return bB->m_sweep.a - bA->m_sweep.a;
+	return bB->GetAngle() - bA->GetAngle();
 }
 
 float b2WheelJoint::GetJointAngularSpeed() const
 {
-	float wA = m_bodyA->m_angularVelocity;
-	float wB = m_bodyB->m_angularVelocity;
+	float wA = m_bodyA->GetAngularVelocity();
+	float wB = m_bodyB->GetAngularVelocity();
 	return wB - wA;
 }
 
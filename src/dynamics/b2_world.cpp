@@ -20,11 +20,13 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "b2_constraint_graph.h"
 #include "b2_contact_solver.h"
 #include "b2_island.h"
 
 #include "box2d/b2_body.h"
 #include "box2d/b2_broad_phase.h"
+#include "box2d/b2_capsule_shape.h"
 #include "box2d/b2_chain_shape.h"
 #include "box2d/b2_circle_shape.h"
 #include "box2d/b2_collision.h"
@@ -34,26 +36,81 @@
 #include "box2d/b2_fixture.h"
 #include "box2d/b2_polygon_shape.h"
 #include "box2d/b2_pulley_joint.h"
+#include "box2d/b2_task_scheduler.h"
 #include "box2d/b2_time_of_impact.h"
 #include "box2d/b2_timer.h"
 #include "box2d/b2_world.h"
 
 #include <new>
+#include <string.h>
+
+// Runs a member function of the world over the ranges of a task.
+class b2WorldTask : public b2RangeTask
+{
+public:
+	typedef void (b2World::*Function)(void* context, int32 begin, int32 end, int32 workerIndex);
+
+	b2WorldTask(b2World* world, Function function, void* context)
+	{
+		m_world = world;
+		m_function = function;
+		m_context = context;
+	}
+
+	void Execute(int32 begin, int32 end, int32 workerIndex) override
+	{
+		(m_world->*m_function)(m_context, begin, end, workerIndex);
+	}
+
+	b2World* m_world;
+	Function m_function;
+	void* m_context;
+};
+
+static bool b2IsParallel(b2TaskScheduler* scheduler)
+{
+	return scheduler != nullptr && scheduler->GetWorkerCount() > 1;
+}
 
 b2World::b2World(const b2Vec2& gravity)
+	: b2World(gravity, nullptr)
+{
+}
+
+b2World::b2World(const b2Vec2& gravity, b2TaskScheduler* scheduler)
+	: b2World(gravity, scheduler, b2BroadPhaseDef())
+{
+}
+
+b2World::b2World(const b2Vec2& gravity, b2TaskScheduler* scheduler, const b2BroadPhaseDef& broadPhaseDef)
 {
 	m_destructionListener = nullptr;
 	m_debugDraw = nullptr;
 
+	m_taskScheduler = scheduler;
+	m_islandWorkers = nullptr;
+	m_islandWorkerCount = 0;
+
 	m_bodyList = nullptr;
 	m_jointList = nullptr;
 
+	m_solverBodies.positions = nullptr;
+	m_solverBodies.positions0 = nullptr;
+	m_solverBodies.velocities = nullptr;
+	m_solverBodies.bodies = nullptr;
+	m_solverBodies.count = 0;
+	m_solverBodies.capacity = 0;
+
 	m_bodyCount = 0;
 	m_jointCount = 0;
 
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_wideSolver = false;
+	m_graphColoring = false;
+	m_softStep = false;
+	m_bulkLoad = false;
 
 	m_stepComplete = true;
 
@@ -67,6 +124,8 @@ b2World::b2World(const b2Vec2& gravity)
 	m_inv_dt0 = 0.0f;
 
 	m_contactManager.m_allocator = &m_blockAllocator;
+	m_contactManager.m_taskScheduler = scheduler;
+	m_contactManager.m_broadPhase.SetType(broadPhaseDef);
 
 	memset(&m_profile, 0, sizeof(b2Profile));
 }
@@ -90,6 +149,17 @@ b2World::~b2World()
 
 		b = bNext;
 	}
+
+	for (int32 i = 0; i < m_islandWorkerCount; ++i)
+	{
+		m_islandWorkers[i].~b2IslandWorker();
+	}
+	b2Free(m_islandWorkers);
+
+	b2Free(m_solverBodies.positions);
+	b2Free(m_solverBodies.positions0);
+	b2Free(m_solverBodies.velocities);
+	b2Free(m_solverBodies.bodies);
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -112,6 +182,21 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	m_debugDraw = debugDraw;
 }
 
+void b2World::SetTaskScheduler(b2TaskScheduler* scheduler)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	// A tree rebuild may still be running on the old scheduler.
+	m_contactManager.m_broadPhase.WaitForRebuild();
+
+	m_taskScheduler = scheduler;
+	m_contactManager.m_taskScheduler = scheduler;
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -213,10 +298,64 @@ void b2World::DestroyBody(b2Body* b)
 	}
 
 	--m_bodyCount;
+	RemoveSolverBody(b);
 	b->~b2Body();
 	m_blockAllocator.Free(b, sizeof(b2Body));
 }
 
+int32 b2World::AddSolverBody(b2Body* body)
+{
+	b2SolverBodies* solver = &m_solverBodies;
+	if (solver->count == solver->capacity)
+	{
+		// Grow the solver arrays. The bodies refer to their state by index.
+		b2Position* oldPositions = solver->positions;
+		b2Position* oldPositions0 = solver->positions0;
+		b2Velocity* oldVelocities = solver->velocities;
+		b2Body** oldBodies = solver->bodies;
+
+		solver->capacity = b2Max(2 * solver->capacity, 16);
+		solver->positions = (b2Position*)b2Alloc(solver->capacity * sizeof(b2Position));
+		solver->positions0 = (b2Position*)b2Alloc(solver->capacity * sizeof(b2Position));
+		solver->velocities = (b2Velocity*)b2Alloc(solver->capacity * sizeof(b2Velocity));
+		solver->bodies = (b2Body**)b2Alloc(solver->capacity * sizeof(b2Body*));
+
+		if (solver->count > 0)
+		{
+			memcpy(solver->positions, oldPositions, solver->count * sizeof(b2Position));
+			memcpy(solver->positions0, oldPositions0, solver->count * sizeof(b2Position));
+			memcpy(solver->velocities, oldVelocities, solver->count * sizeof(b2Velocity));
+			memcpy(solver->bodies, oldBodies, solver->count * sizeof(b2Body*));
+		}
+
+		b2Free(oldPositions);
+		b2Free(oldPositions0);
+		b2Free(oldVelocities);
+		b2Free(oldBodies);
+	}
+
+	int32 index = solver->count++;
+	solver->bodies[index] = body;
+	return index;
+}
+
+void b2World::RemoveSolverBody(b2Body* body)
+{
+	// Move the last body into the free slot to keep the arrays dense.
+	b2SolverBodies* solver = &m_solverBodies;
+	int32 index = body->m_solverIndex;
+	int32 last = --solver->count;
+	if (index != last)
+	{
+		b2Body* moved = solver->bodies[last];
+		solver->positions[index] = solver->positions[last];
+		solver->positions0[index] = solver->positions0[last];
+		solver->velocities[index] = solver->velocities[last];
+		solver->bodies[index] = moved;
+		moved->m_solverIndex = index;
+	}
+}
+
 b2Joint* b2World::CreateJoint(const b2JointDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -372,6 +511,106 @@ void b2World::DestroyJoint(b2Joint* j)
 	}
 }
 
+void b2World::BeginBulkLoad()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_bulkLoad = true;
+}
+
+void b2World::EndBulkLoad()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked() || m_bulkLoad == false)
+	{
+		return;
+	}
+
+	m_bulkLoad = false;
+
+	// Fixtures of enabled bodies without proxies were created during the bulk load.
+	int32 count = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->IsEnabled() == false)
+		{
+			continue;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			if (f->m_proxyCount == 0)
+			{
+				count += f->m_shape->GetChildCount();
+			}
+		}
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2AABB* aabbs = (b2AABB*)m_stackAllocator.Allocate(count * sizeof(b2AABB));
+	void** userData = (void**)m_stackAllocator.Allocate(count * sizeof(void*));
+	int32* proxyIds = (int32*)m_stackAllocator.Allocate(count * sizeof(int32));
+
+	// Static proxies go to the front and the others to the back, because the broad-phase
+	// keeps them in different trees.
+	int32 staticCount = 0;
+	int32 index = count;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		if (b->IsEnabled() == false)
+		{
+			continue;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			if (f->m_proxyCount != 0)
+			{
+				continue;
+			}
+
+			f->m_proxyCount = f->m_shape->GetChildCount();
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2FixtureProxy* proxy = f->m_proxies + i;
+				f->m_shape->ComputeAABB(&proxy->aabb, b->m_xf, i);
+				proxy->motion.SetZero();
+				proxy->fixture = f;
+				proxy->childIndex = i;
+
+				int32 slot = b->m_type == b2_staticBody ? staticCount++ : --index;
+				aabbs[slot] = proxy->aabb;
+				userData[slot] = proxy;
+			}
+		}
+	}
+
+	b2Assert(staticCount == index);
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	broadPhase->CreateProxies(staticCount, aabbs, userData, proxyIds, true);
+	broadPhase->CreateProxies(count - staticCount, aabbs + staticCount, userData + staticCount, proxyIds + staticCount, false);
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)userData[i];
+		proxy->proxyId = proxyIds[i];
+	}
+
+	m_stackAllocator.Free(proxyIds);
+	m_stackAllocator.Free(userData);
+	m_stackAllocator.Free(aabbs);
+
+	m_newContacts = true;
+}
+
 //
 void b2World::SetAllowSleeping(bool flag)
 {
@@ -391,34 +630,384 @@ void b2World::SetAllowSleeping(bool flag)
 }
 
 // Find islands, integrate and solve constraints, solve position constraints
+// Add the seed and everything connected to it by touching contacts and joints to the island
+// using a depth first search (DFS) on the constraint graph. If statics is not null then static
+// bodies are appended there instead of being added to the island.
+void b2World::BuildIsland(b2Island* island, b2Body* seed, b2Body** stack, int32 stackSize, b2Body** statics, int32* staticCount)
+{
+	int32 stackCount = 0;
+	stack[stackCount++] = seed;
+	seed->m_flags |= b2Body::e_islandFlag;
+
+	while (stackCount > 0)
+	{
+		// Grab the next body off the stack and add it to the island.
+		b2Body* b = stack[--stackCount];
+		b2Assert(b->IsEnabled() == true);
+
+		// To keep islands as small as possible, we don't
+		// propagate islands across static bodies.
+		if (b->GetType() == b2_staticBody)
+		{
+			if (statics != nullptr)
+			{
+				statics[(*staticCount)++] = b;
+			}
+			else
+			{
+				island->Add(b);
+			}
+			continue;
+		}
+
+		island->Add(b);
+
+		// Make sure the body is awake (without resetting sleep timer).
+		b->m_flags |= b2Body::e_awakeFlag;
+
+		// Search all contacts connected to this body.
+		for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+		{
+			b2Contact* contact = ce->contact;
+
+			// Has this contact already been added to an island?
+			if (contact->m_flags & b2Contact::e_islandFlag)
+			{
+				continue;
+			}
+
+			// Is this contact solid and touching?
+			if (contact->IsEnabled() == false ||
+				contact->IsTouching() == false)
+			{
+				continue;
+			}
+
+			// Skip sensors.
+			bool sensorA = contact->m_fixtureA->m_isSensor;
+			bool sensorB = contact->m_fixtureB->m_isSensor;
+			if (sensorA || sensorB)
+			{
+				continue;
+			}
+
+			island->Add(contact);
+			contact->m_flags |= b2Contact::e_islandFlag;
+
+			b2Body* other = ce->other;
+
+			// Was the other body already added to this island?
+			if (other->m_flags & b2Body::e_islandFlag)
+			{
+				continue;
+			}
+
+			b2Assert(stackCount < stackSize);
+			stack[stackCount++] = other;
+			other->m_flags |= b2Body::e_islandFlag;
+		}
+
+		// Search all joints connect to this body.
+		for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+		{
+			if (je->joint->m_islandFlag == true)
+			{
+				continue;
+			}
+
+			b2Body* other = je->other;
+
+			// Don't simulate joints connected to disabled bodies.
+			if (other->IsEnabled() == false)
+			{
+				continue;
+			}
+
+			island->Add(je->joint);
+			je->joint->m_islandFlag = true;
+
+			if (other->m_flags & b2Body::e_islandFlag)
+			{
+				continue;
+			}
+
+			b2Assert(stackCount < stackSize);
+			stack[stackCount++] = other;
+			other->m_flags |= b2Body::e_islandFlag;
+		}
+	}
+}
+
 void b2World::Solve(const b2TimeStep& step)
 {
 	m_profile.solveInit = 0.0f;
 	m_profile.solveVelocity = 0.0f;
 	m_profile.solvePosition = 0.0f;
 
-	// Size the island for the worst case.
-	b2Island island(m_bodyCount,
-					m_contactManager.m_contactCount,
-					m_jointCount,
-					&m_stackAllocator,
-					m_contactManager.m_contactListener);
-
 	// Clear all the island flags.
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
 		b->m_flags &= ~b2Body::e_islandFlag;
 	}
-	for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	for (int32 i = 0; i < m_contactManager.m_contactCount; ++i)
 	{
-		c->m_flags &= ~b2Contact::e_islandFlag;
+		m_contactManager.m_contacts[i]->m_flags &= ~b2Contact::e_islandFlag;
 	}
 	for (b2Joint* j = m_jointList; j; j = j->m_next)
 	{
 		j->m_islandFlag = false;
 	}
 
-	// Build and simulate all awake islands.
+	if (b2IsParallel(m_taskScheduler))
+	{
+		SolveParallel(step);
+	}
+	else
+	{
+		// Size the island for the worst case. The island solves the body state in place.
+		b2Island island(m_bodyCount,
+						m_contactManager.m_contactCount,
+						m_jointCount,
+						&m_stackAllocator,
+						m_contactManager.m_contactListener);
+		island.m_positions = m_solverBodies.positions;
+		island.m_velocities = m_solverBodies.velocities;
+		island.m_scheduler = m_taskScheduler;
+
+		// Build and simulate all awake islands.
+		int32 stackSize = m_bodyCount;
+		b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
+		for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
+		{
+			if (seed->m_flags & b2Body::e_islandFlag)
+			{
+				continue;
+			}
+
+			if (seed->IsAwake() == false || seed->IsEnabled() == false)
+			{
+				continue;
+			}
+
+			// The seed can be dynamic or kinematic.
+			if (seed->GetType() == b2_staticBody)
+			{
+				continue;
+			}
+
+			island.Clear();
+			BuildIsland(&island, seed, stack, stackSize, nullptr, nullptr);
+
+			b2Profile profile;
+			island.Solve(&profile, step, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+
+			// Post solve cleanup.
+			for (int32 i = 0; i < island.m_bodyCount; ++i)
+			{
+				// Allow static bodies to participate in other islands.
+				b2Body* b = island.m_bodies[i];
+				if (b->GetType() == b2_staticBody)
+				{
+					b->m_flags &= ~b2Body::e_islandFlag;
+				}
+			}
+		}
+
+		m_stackAllocator.Free(stack);
+	}
+
+	{
+		b2Timer timer;
+		if (b2IsParallel(m_taskScheduler))
+		{
+			// Sweep the fixtures in parallel, then move the proxies in body order.
+			b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2Body*));
+			int32 count = 0;
+			for (b2Body* b = m_bodyList; b; b = b->GetNext())
+			{
+				if ((b->m_flags & b2Body::e_islandFlag) && b->GetType() != b2_staticBody)
+				{
+					bodies[count++] = b;
+				}
+			}
+
+			b2WorldTask task(this, &b2World::SweepFixtures, bodies);
+			b2ExecuteTask(m_taskScheduler, &task, count, b2_minTaskRange);
+
+			for (int32 i = 0; i < count; ++i)
+			{
+				bodies[i]->MoveFixtureProxies();
+			}
+
+			m_stackAllocator.Free(bodies);
+		}
+		else
+		{
+			// Synchronize fixtures, check for out of range bodies.
+			for (b2Body* b = m_bodyList; b; b = b->GetNext())
+			{
+				// If a body was not in an island then it did not move.
+				if ((b->m_flags & b2Body::e_islandFlag) == 0)
+				{
+					continue;
+				}
+
+				if (b->GetType() == b2_staticBody)
+				{
+					continue;
+				}
+
+				// Update fixtures (for broad-phase).
+				b->SynchronizeFixtures();
+			}
+		}
+
+		// Look for new contacts.
+		m_contactManager.FindNewContacts();
+		m_profile.broadphase = timer.GetMilliseconds();
+	}
+}
+
+// The first body, contact, and joint of an island built for parallel solving.
+struct b2IslandStart
+{
+	int32 body;
+	int32 contact;
+	int32 joint;
+
+	// Keeps the pointer arrays allocated after the starts aligned.
+	int32 padding;
+};
+
+// The islands are stored back to back in the arrays of a single island and the
+// range of island i is [starts[i], starts[i + 1]). Static bodies may be shared by
+// islands on different workers, so they are not part of any island. The solver
+// arrays of the world cannot be solved in place because the constraints would write
+// the shared static bodies concurrently. Instead each worker copies an island into
+// private arrays followed by a copy of the static bodies.
+struct b2SolveIslandsContext
+{
+	const b2TimeStep* step;
+
+	const b2Island* islands;
+	const b2IslandStart* starts;
+	b2ContactImpulse* impulses;
+
+	const b2Position* staticPositions;
+	const b2Velocity* staticVelocities;
+	int32 staticCount;
+	int32 maxBodyCount;
+};
+
+void b2World::SolveIslands(void* context, int32 begin, int32 end, int32 workerIndex)
+{
+	const b2SolveIslandsContext* task = (b2SolveIslandsContext*)context;
+	b2IslandWorker* worker = m_islandWorkers + workerIndex;
+	b2StackAllocator* allocator = &worker->allocator;
+	int32 maxBodyCount = task->maxBodyCount;
+
+	if (worker->positions == nullptr)
+	{
+		int32 capacity = maxBodyCount + task->staticCount;
+		worker->velocities = (b2Velocity*)allocator->Allocate(capacity * sizeof(b2Velocity));
+		worker->positions = (b2Position*)allocator->Allocate(capacity * sizeof(b2Position));
+		worker->indices = (int32*)allocator->Allocate(maxBodyCount * sizeof(int32));
+		memcpy(worker->velocities + maxBodyCount, task->staticVelocities, task->staticCount * sizeof(b2Velocity));
+		memcpy(worker->positions + maxBodyCount, task->staticPositions, task->staticCount * sizeof(b2Position));
+		for (int32 i = 0; i < maxBodyCount; ++i)
+		{
+			worker->indices[i] = i;
+		}
+	}
+
+	const b2Island* islands = task->islands;
+	for (int32 i = begin; i < end; ++i)
+	{
+		const b2IslandStart* start = task->starts + i;
+		const b2IslandStart* next = task->starts + i + 1;
+
+		// Colored islands are solved after this task by b2World::SolveParallel.
+		if (b2IsColoredIsland(*task->step, next->contact - start->contact, next->joint - start->joint))
+		{
+			continue;
+		}
+
+		b2Island island(islands->m_bodies + start->body, worker->indices, next->body - start->body,
+						islands->m_contacts + start->contact, next->contact - start->contact,
+						islands->m_joints + start->joint, next->joint - start->joint,
+						allocator, nullptr);
+		island.m_bodyCount = island.m_bodyCapacity;
+		island.m_contactCount = island.m_contactCapacity;
+		island.m_jointCount = island.m_jointCapacity;
+		island.m_positions = worker->positions;
+		island.m_velocities = worker->velocities;
+		if (task->impulses != nullptr)
+		{
+			island.m_impulses = task->impulses + start->contact;
+		}
+
+		for (int32 j = 0; j < island.m_bodyCount; ++j)
+		{
+			island.m_bodies[j]->m_islandIndex = j;
+		}
+
+		b2Profile profile;
+		island.Solve(&profile, *task->step, m_gravity, m_allowSleep);
+		worker->profile.solveInit += profile.solveInit;
+		worker->profile.solveVelocity += profile.solveVelocity;
+		worker->profile.solvePosition += profile.solvePosition;
+	}
+}
+
+void b2World::SweepFixtures(void* context, int32 begin, int32 end, int32 workerIndex)
+{
+	B2_NOT_USED(workerIndex);
+
+	b2Body** bodies = (b2Body**)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		bodies[i]->SweepFixtures();
+	}
+}
+
+void b2World::SolveParallel(const b2TimeStep& step)
+{
+	int32 workerCount = m_taskScheduler->GetWorkerCount();
+	if (workerCount != m_islandWorkerCount)
+	{
+		for (int32 i = 0; i < m_islandWorkerCount; ++i)
+		{
+			m_islandWorkers[i].~b2IslandWorker();
+		}
+		b2Free(m_islandWorkers);
+
+		m_islandWorkers = (b2IslandWorker*)b2Alloc(workerCount * sizeof(b2IslandWorker));
+		for (int32 i = 0; i < workerCount; ++i)
+		{
+			new (m_islandWorkers + i) b2IslandWorker();
+		}
+		m_islandWorkerCount = workerCount;
+	}
+
+	int32 contactCount = m_contactManager.m_contactCount;
+	b2ContactListener* listener = m_contactManager.m_contactListener;
+
+	// All islands are built up front and stored back to back.
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2Body*));
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(contactCount * sizeof(b2Contact*));
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+	int32* indices = (int32*)m_stackAllocator.Allocate(m_bodyCount * sizeof(int32));
+	b2Island islands(bodies, indices, m_bodyCount, contacts, contactCount, joints, m_jointCount, &m_stackAllocator, nullptr);
+
+	b2Body** statics = (b2Body**)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2Body*));
+	b2IslandStart* starts = (b2IslandStart*)m_stackAllocator.Allocate((m_bodyCount + 1) * sizeof(b2IslandStart));
+	int32 staticCount = 0;
+	int32 islandCount = 0;
+	int32 maxBodyCount = 0;
+
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
 	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
@@ -439,145 +1028,253 @@ void b2World::Solve(const b2TimeStep& step)
 			continue;
 		}
 
-		// Reset island and stack.
-		island.Clear();
-		int32 stackCount = 0;
-		stack[stackCount++] = seed;
-		seed->m_flags |= b2Body::e_islandFlag;
+		b2IslandStart* start = starts + islandCount;
+		start->body = islands.m_bodyCount;
+		start->contact = islands.m_contactCount;
+		start->joint = islands.m_jointCount;
+
+		// Static bodies keep their island flag until all islands are built,
+		// so each one is only collected once.
+		BuildIsland(&islands, seed, stack, stackSize, statics, &staticCount);
+
+		maxBodyCount = b2Max(maxBodyCount, islands.m_bodyCount - start->body);
+		++islandCount;
+	}
+	m_stackAllocator.Free(stack);
+
+	b2IslandStart* end = starts + islandCount;
+	end->body = islands.m_bodyCount;
+	end->contact = islands.m_contactCount;
+	end->joint = islands.m_jointCount;
+
+	b2Velocity* staticVelocities = (b2Velocity*)m_stackAllocator.Allocate(staticCount * sizeof(b2Velocity));
+	b2Position* staticPositions = (b2Position*)m_stackAllocator.Allocate(staticCount * sizeof(b2Position));
+	for (int32 i = 0; i < staticCount; ++i)
+	{
+		b2Body* b = statics[i];
+		b->m_islandIndex = maxBodyCount + i;
+		staticPositions[i] = b->GetSolverPosition();
+		staticVelocities[i] = b->GetSolverVelocity();
+	}
+
+	b2ContactImpulse* impulses = nullptr;
+	if (listener != nullptr)
+	{
+		impulses = (b2ContactImpulse*)m_stackAllocator.Allocate(islands.m_contactCount * sizeof(b2ContactImpulse));
+	}
+
+	for (int32 i = 0; i < workerCount; ++i)
+	{
+		b2IslandWorker* worker = m_islandWorkers + i;
+		worker->positions = nullptr;
+		worker->velocities = nullptr;
+		worker->indices = nullptr;
+		memset(&worker->profile, 0, sizeof(b2Profile));
+	}
+
+	b2SolveIslandsContext context;
+	context.step = &step;
+	context.islands = &islands;
+	context.starts = starts;
+	context.impulses = impulses;
+	context.staticPositions = staticPositions;
+	context.staticVelocities = staticVelocities;
+	context.staticCount = staticCount;
+	context.maxBodyCount = maxBodyCount;
+
+	b2WorldTask task(this, &b2World::SolveIslands, &context);
+	b2ExecuteTask(m_taskScheduler, &task, islandCount, 1);
+
+	for (int32 i = 0; i < workerCount; ++i)
+	{
+		b2IslandWorker* worker = m_islandWorkers + i;
+		if (worker->positions != nullptr)
+		{
+			worker->allocator.Free(worker->indices);
+			worker->allocator.Free(worker->positions);
+			worker->allocator.Free(worker->velocities);
+		}
+
+		m_profile.solveInit += worker->profile.solveInit;
+		m_profile.solveVelocity += worker->profile.solveVelocity;
+		m_profile.solvePosition += worker->profile.solvePosition;
+	}
+
+	// Large islands are split into graph colors and solved one at a time with every
+	// worker. The other islands are finished, so these are solved in place in the solver
+	// arrays of the world like the serial path does.
+	if (step.graphColoring)
+	{
+		for (int32 i = 0; i < staticCount; ++i)
+		{
+			statics[i]->m_islandIndex = statics[i]->m_solverIndex;
+		}
 
-		// Perform a depth first search (DFS) on the constraint graph.
-		while (stackCount > 0)
+		for (int32 i = 0; i < islandCount; ++i)
 		{
-			// Grab the next body off the stack and add it to the island.
-			b2Body* b = stack[--stackCount];
-			b2Assert(b->IsEnabled() == true);
-			island.Add(b);
-
-			// To keep islands as small as possible, we don't
-			// propagate islands across static bodies.
-			if (b->GetType() == b2_staticBody)
+			const b2IslandStart* start = starts + i;
+			const b2IslandStart* next = starts + i + 1;
+			if (b2IsColoredIsland(step, next->contact - start->contact, next->joint - start->joint) == false)
 			{
 				continue;
 			}
 
-			// Make sure the body is awake (without resetting sleep timer).
-			b->m_flags |= b2Body::e_awakeFlag;
+			b2Island island(islands.m_bodies + start->body, islands.m_indices + start->body, next->body - start->body,
+							islands.m_contacts + start->contact, next->contact - start->contact,
+							islands.m_joints + start->joint, next->joint - start->joint,
+							&m_stackAllocator, nullptr);
+			island.m_bodyCount = island.m_bodyCapacity;
+			island.m_contactCount = island.m_contactCapacity;
+			island.m_jointCount = island.m_jointCapacity;
+			island.m_positions = m_solverBodies.positions;
+			island.m_velocities = m_solverBodies.velocities;
+			island.m_scheduler = m_taskScheduler;
+			if (impulses != nullptr)
+			{
+				island.m_impulses = impulses + start->contact;
+			}
 
-			// Search all contacts connected to this body.
-			for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			for (int32 j = 0; j < island.m_bodyCount; ++j)
 			{
-				b2Contact* contact = ce->contact;
+				island.m_bodies[j]->m_islandIndex = island.m_bodies[j]->m_solverIndex;
+			}
 
-				// Has this contact already been added to an island?
-				if (contact->m_flags & b2Contact::e_islandFlag)
-				{
-					continue;
-				}
+			b2Profile profile;
+			island.Solve(&profile, step, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+		}
+	}
 
-				// Is this contact solid and touching?
-				if (contact->IsEnabled() == false ||
-					contact->IsTouching() == false)
-				{
-					continue;
-				}
+	// Report the impulses in the same order as the serial solver.
+	if (impulses != nullptr)
+	{
+		for (int32 i = 0; i < islands.m_contactCount; ++i)
+		{
+			listener->PostSolve(islands.m_contacts[i], impulses + i);
+		}
+		m_stackAllocator.Free(impulses);
+	}
 
-				// Skip sensors.
-				bool sensorA = contact->m_fixtureA->m_isSensor;
-				bool sensorB = contact->m_fixtureB->m_isSensor;
-				if (sensorA || sensorB)
-				{
-					continue;
-				}
+	m_stackAllocator.Free(staticPositions);
+	m_stackAllocator.Free(staticVelocities);
 
-				island.Add(contact);
-				contact->m_flags |= b2Contact::e_islandFlag;
+	// Allow static bodies to participate in islands next time.
+	for (int32 i = 0; i < staticCount; ++i)
+	{
+		statics[i]->m_flags &= ~b2Body::e_islandFlag;
+	}
 
-				b2Body* other = ce->other;
+	m_stackAllocator.Free(starts);
+	m_stackAllocator.Free(statics);
+	m_stackAllocator.Free(indices);
+	m_stackAllocator.Free(joints);
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(bodies);
+}
 
-				// Was the other body already added to this island?
-				if (other->m_flags & b2Body::e_islandFlag)
-				{
-					continue;
-				}
+// Compute the TOI of a contact and cache it. Returns false if the contact
+// does not need continuous collision.
+bool b2World::ComputeTOI(b2Contact* c)
+{
+	b2Fixture* fA = c->GetFixtureA();
+	b2Fixture* fB = c->GetFixtureB();
 
-				b2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b2Body::e_islandFlag;
-			}
+	// Is there a sensor?
+	if (fA->IsSensor() || fB->IsSensor())
+	{
+		return false;
+	}
 
-			// Search all joints connect to this body.
-			for (b2JointEdge* je = b->m_jointList; je; je = je->next)
-			{
-				if (je->joint->m_islandFlag == true)
-				{
-					continue;
-				}
+	b2Body* bA = fA->GetBody();
+	b2Body* bB = fB->GetBody();
+
+	b2BodyType typeA = bA->m_type;
+	b2BodyType typeB = bB->m_type;
+	b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
+
+	bool activeA = bA->IsAwake() && typeA != b2_staticBody;
+	bool activeB = bB->IsAwake() && typeB != b2_staticBody;
+
+	// Is at least one body active (awake and dynamic or kinematic)?
+	if (activeA == false && activeB == false)
+	{
+		return false;
+	}
+
+	bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
+	bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
+
+	// Are these two non-bullet dynamic bodies?
+	if (collideA == false && collideB == false)
+	{
+		return false;
+	}
 
-				b2Body* other = je->other;
+	// Compute the TOI for this contact.
+	// Put the sweeps onto the same time interval.
+	b2Sweep sweepA = bA->GetSweep();
+	b2Sweep sweepB = bB->GetSweep();
+	float alpha0 = sweepA.alpha0;
 
-				// Don't simulate joints connected to disabled bodies.
-				if (other->IsEnabled() == false)
-				{
-					continue;
-				}
+	if (sweepA.alpha0 < sweepB.alpha0)
+	{
+		alpha0 = sweepB.alpha0;
+		sweepA.Advance(alpha0);
+		bA->SetSweep(sweepA);
+	}
+	else if (sweepB.alpha0 < sweepA.alpha0)
+	{
+		alpha0 = sweepA.alpha0;
+		sweepB.Advance(alpha0);
+		bB->SetSweep(sweepB);
+	}
 
-				island.Add(je->joint);
-				je->joint->m_islandFlag = true;
+	b2Assert(alpha0 < 1.0f);
 
-				if (other->m_flags & b2Body::e_islandFlag)
-				{
-					continue;
-				}
+	int32 indexA = c->GetChildIndexA();
+	int32 indexB = c->GetChildIndexB();
 
-				b2Assert(stackCount < stackSize);
-				stack[stackCount++] = other;
-				other->m_flags |= b2Body::e_islandFlag;
-			}
-		}
+	// Compute the time of impact in interval [0, minTOI]
+	b2TOIInput input;
+	input.proxyA.Set(fA->GetShape(), indexA);
+	input.proxyB.Set(fB->GetShape(), indexB);
+	input.sweepA = sweepA;
+	input.sweepB = sweepB;
+	input.tMax = 1.0f;
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+	b2TOIOutput output;
+	b2TimeOfImpact(&output, &input);
 
-		// Post solve cleanup.
-		for (int32 i = 0; i < island.m_bodyCount; ++i)
-		{
-			// Allow static bodies to participate in other islands.
-			b2Body* b = island.m_bodies[i];
-			if (b->GetType() == b2_staticBody)
-			{
-				b->m_flags &= ~b2Body::e_islandFlag;
-			}
-		}
+	// Beta is the fraction of the remaining portion of the .
+	float beta = output.t;
+	float alpha;
+	if (output.state == b2TOIOutput::e_touching)
+	{
+		alpha = b2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
+	}
+	else
+	{
+		alpha = 1.0f;
 	}
 
-	m_stackAllocator.Free(stack);
+	c->m_toi = alpha;
+	c->m_flags |= b2Contact::e_toiFlag;
+	return true;
+}
+
+void b2World::ComputeTOIs(void* context, int32 begin, int32 end, int32 workerIndex)
+{
+	B2_NOT_USED(workerIndex);
 
+	b2Contact** contacts = (b2Contact**)context;
+	for (int32 i = begin; i < end; ++i)
 	{
-		b2Timer timer;
-		// Synchronize fixtures, check for out of range bodies.
-		for (b2Body* b = m_bodyList; b; b = b->GetNext())
+		if (contacts[i]->IsEnabled())
 		{
-			// If a body was not in an island then it did not move.
-			if ((b->m_flags & b2Body::e_islandFlag) == 0)
-			{
-				continue;
-			}
-
-			if (b->GetType() == b2_staticBody)
-			{
-				continue;
-			}
-
-			// Update fixtures (for broad-phase).
-			b->SynchronizeFixtures();
+			ComputeTOI(contacts[i]);
 		}
-
-		// Look for new contacts.
-		m_contactManager.FindNewContacts();
-		m_profile.broadphase = timer.GetMilliseconds();
 	}
 }
 
@@ -585,22 +1282,34 @@ void b2World::Solve(const b2TimeStep& step)
 void b2World::SolveTOI(const b2TimeStep& step)
 {
 	b2Island island(2 * b2_maxTOIContacts, b2_maxTOIContacts, 0, &m_stackAllocator, m_contactManager.m_contactListener);
+	island.m_positions = m_solverBodies.positions;
+	island.m_velocities = m_solverBodies.velocities;
 
 	if (m_stepComplete)
 	{
 		for (b2Body* b = m_bodyList; b; b = b->m_next)
 		{
 			b->m_flags &= ~b2Body::e_islandFlag;
-			b->m_sweep.alpha0 = 0.0f;
+			b->m_alpha0 = 0.0f;
 		}
 
-		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		for (int32 i = 0; i < m_contactManager.m_contactCount; ++i)
 		{
 			// Invalidate TOI
+			b2Contact* c = m_contactManager.m_contacts[i];
 			c->m_flags &= ~(b2Contact::e_toiFlag | b2Contact::e_islandFlag);
 			c->m_toiCount = 0;
 			c->m_toi = 1.0f;
 		}
+
+		if (b2IsParallel(m_taskScheduler))
+		{
+			// All sweeps start at alpha0 = 0, so the first TOI of each contact can be
+			// computed in parallel without advancing any body. The loop below uses these
+			// cached values and only computes TOIs invalidated by sub-steps.
+			b2WorldTask task(this, &b2World::ComputeTOIs, m_contactManager.m_contacts);
+			b2ExecuteTask(m_taskScheduler, &task, m_contactManager.m_contactCount, b2_minTaskRange);
+		}
 	}
 
 	// Find TOI events and solve them.
@@ -610,8 +1319,10 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		b2Contact* minContact = nullptr;
 		float minAlpha = 1.0f;
 
-		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+		for (int32 i = m_contactManager.m_contactCount - 1; i >= 0; --i)
 		{
+			b2Contact* c = m_contactManager.m_contacts[i];
+
 			// Is this contact disabled?
 			if (c->IsEnabled() == false)
 			{
@@ -624,94 +1335,13 @@ void b2World::SolveTOI(const b2TimeStep& step)
 				continue;
 			}
 
-			float alpha = 1.0f;
-			if (c->m_flags & b2Contact::e_toiFlag)
-			{
-				// This contact has a valid cached TOI.
-				alpha = c->m_toi;
-			}
-			else
+			// Use the cached TOI if it is still valid.
+			if ((c->m_flags & b2Contact::e_toiFlag) == 0 && ComputeTOI(c) == false)
 			{
-				b2Fixture* fA = c->GetFixtureA();
-				b2Fixture* fB = c->GetFixtureB();
-
-				// Is there a sensor?
-				if (fA->IsSensor() || fB->IsSensor())
-				{
-					continue;
-				}
-
-				b2Body* bA = fA->GetBody();
-				b2Body* bB = fB->GetBody();
-
-				b2BodyType typeA = bA->m_type;
-				b2BodyType typeB = bB->m_type;
-				b2Assert(typeA == b2_dynamicBody || typeB == b2_dynamicBody);
-
-				bool activeA = bA->IsAwake() && typeA != b2_staticBody;
-				bool activeB = bB->IsAwake() && typeB != b2_staticBody;
-
-				// Is at least one body active (awake and dynamic or kinematic)?
-				if (activeA == false && activeB == false)
-				{
-					continue;
-				}
-
-				bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
-				bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
-
-				// Are these two non-bullet dynamic bodies?
-				if (collideA == false && collideB == false)
-				{
-					continue;
-				}
-
-				// Compute the TOI for this contact.
-				// Put the sweeps onto the same time interval.
-				float alpha0 = bA->m_sweep.alpha0;
-
-				if (bA->m_sweep.alpha0 < bB->m_sweep.alpha0)
-				{
-					alpha0 = bB->m_sweep.alpha0;
-					bA->m_sweep.Advance(alpha0);
-				}
-				else if (bB->m_sweep.alpha0 < bA->m_sweep.alpha0)
-				{
-					alpha0 = bA->m_sweep.alpha0;
-					bB->m_sweep.Advance(alpha0);
-				}
-
-				b2Assert(alpha0 < 1.0f);
-
-				int32 indexA = c->GetChildIndexA();
-				int32 indexB = c->GetChildIndexB();
-
-				// Compute the time of impact in interval [0, minTOI]
-				b2TOIInput input;
-				input.proxyA.Set(fA->GetShape(), indexA);
-				input.proxyB.Set(fB->GetShape(), indexB);
-				input.sweepA = bA->m_sweep;
-				input.sweepB = bB->m_sweep;
-				input.tMax = 1.0f;
-
-				b2TOIOutput output;
-				b2TimeOfImpact(&output, &input);
-
-				// Beta is the fraction of the remaining portion of the .
-				float beta = output.t;
-				if (output.state == b2TOIOutput::e_touching)
-				{
-					alpha = b2Min(alpha0 + (1.0f - alpha0) * beta, 1.0f);
-				}
-				else
-				{
-					alpha = 1.0f;
-				}
-
-				c->m_toi = alpha;
-				c->m_flags |= b2Contact::e_toiFlag;
+				continue;
 			}
 
+			float alpha = c->m_toi;
 			if (alpha < minAlpha)
 			{
 				// This is the minimum TOI found so far.
@@ -733,8 +1363,8 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		b2Body* bA = fA->GetBody();
 		b2Body* bB = fB->GetBody();
 
-		b2Sweep backup1 = bA->m_sweep;
-		b2Sweep backup2 = bB->m_sweep;
+		b2Sweep backup1 = bA->GetSweep();
+		b2Sweep backup2 = bB->GetSweep();
 
 		bA->Advance(minAlpha);
 		bB->Advance(minAlpha);
@@ -749,8 +1379,8 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		{
 			// Restore the sweeps.
 			minContact->SetEnabled(false);
-			bA->m_sweep = backup1;
-			bB->m_sweep = backup2;
+			bA->SetSweep(backup1);
+			bB->SetSweep(backup2);
 			bA->SynchronizeTransform();
 			bB->SynchronizeTransform();
 			continue;
@@ -813,7 +1443,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 					}
 
 					// Tentatively advance the body to the TOI.
-					b2Sweep backup = other->m_sweep;
+					b2Sweep backup = other->GetSweep();
 					if ((other->m_flags & b2Body::e_islandFlag) == 0)
 					{
 						other->Advance(minAlpha);
@@ -825,7 +1455,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 					// Was the contact disabled by the user?
 					if (contact->IsEnabled() == false)
 					{
-						other->m_sweep = backup;
+						other->SetSweep(backup);
 						other->SynchronizeTransform();
 						continue;
 					}
@@ -833,7 +1463,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 					// Are there contact points?
 					if (contact->IsTouching() == false)
 					{
-						other->m_sweep = backup;
+						other->SetSweep(backup);
 						other->SynchronizeTransform();
 						continue;
 					}
@@ -868,6 +1498,9 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		subStep.wideSolver = false;
+		subStep.graphColoring = false;
+		subStep.softStep = false;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -906,6 +1539,17 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 {
 	b2Timer stepTimer;
 
+	// The proxies of a bulk load must be added before the step.
+	b2Assert(m_bulkLoad == false);
+
+	// Swap in the broad-phase tree rebuilt since the last step.
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	broadPhase->FinishRebuild();
+
+	int32 proxyMoveCount = broadPhase->GetProxyMoveCount();
+	int32 pairQueryCount = broadPhase->GetPairQueryCount();
+	int32 foundPairCount = broadPhase->GetFoundPairCount();
+
 	// If new fixtures were added, we need to find the new contacts.
 	if (m_newContacts)
 	{
@@ -931,11 +1575,16 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.wideSolver = m_wideSolver;
+	step.graphColoring = m_graphColoring;
+	step.softStep = m_softStep;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
 		b2Timer timer;
+		int32 reusedCount = m_contactManager.m_reusedManifoldCount;
 		m_contactManager.Collide();
+		m_profile.reusedManifolds = m_contactManager.m_reusedManifoldCount - reusedCount;
 		m_profile.collide = timer.GetMilliseconds();
 	}
 
@@ -965,6 +1614,14 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 		ClearForces();
 	}
 
+	m_profile.proxyMoves = broadPhase->GetProxyMoveCount() - proxyMoveCount;
+	m_profile.pairQueries = broadPhase->GetPairQueryCount() - pairQueryCount;
+	m_profile.pairs = broadPhase->GetFoundPairCount() - foundPairCount;
+
+	// Rebuild the broad-phase tree in the background if the proxies have drifted
+	// far from where they were when it was built.
+	broadPhase->StartRebuild(m_taskScheduler);
+
 	m_locked = false;
 
 	m_profile.step = stepTimer.GetMilliseconds();
@@ -1036,6 +1693,266 @@ void b2World::RayCast(b2RayCastCallback* callback, const b2Vec2& point1, const b
 	m_contactManager.m_broadPhase.RayCast(&wrapper, input);
 }
 
+// Keeps the closest hit of each ray in a packet.
+struct b2WorldRayCastBatchWrapper
+{
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId, int32 rayIndex)
+	{
+		void* userData = broadPhase->GetUserData(proxyId);
+		b2FixtureProxy* proxy = (b2FixtureProxy*)userData;
+		b2Fixture* fixture = proxy->fixture;
+		const b2BatchRay* ray = rays + rayIndex;
+		if (fixture->IsSensor() || (fixture->GetFilterData().categoryBits & ray->maskBits) == 0)
+		{
+			return input.maxFraction;
+		}
+
+		int32 index = proxy->childIndex;
+		b2RayCastOutput output;
+		bool hit = fixture->RayCast(&output, input, index);
+
+		if (hit)
+		{
+			b2BatchRayHit* result = hits + rayIndex;
+			result->fixture = fixture;
+			result->point = (1.0f - output.fraction) * input.p1 + output.fraction * input.p2;
+			result->normal = output.normal;
+			result->fraction = output.fraction;
+			return output.fraction;
+		}
+
+		return input.maxFraction;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2BatchRay* rays;
+	b2BatchRayHit* hits;
+};
+
+// Casts the rays of one packet.
+static void b2RayCastPacket(const b2BroadPhase* broadPhase, const b2BatchRay* rays, int32 count, b2BatchRayHit* hits)
+{
+	b2RayCastInput inputs[b2_maxRayPacket];
+	for (int32 i = 0; i < count; ++i)
+	{
+		inputs[i].p1 = rays[i].p1;
+		inputs[i].p2 = rays[i].p2;
+
+		// A zero length ray hits nothing.
+		inputs[i].maxFraction = b2DistanceSquared(rays[i].p1, rays[i].p2) > 0.0f ? 1.0f : 0.0f;
+
+		hits[i].fixture = nullptr;
+		hits[i].point = rays[i].p2;
+		hits[i].normal.SetZero();
+		hits[i].fraction = 1.0f;
+	}
+
+	b2WorldRayCastBatchWrapper wrapper;
+	wrapper.broadPhase = broadPhase;
+	wrapper.rays = rays;
+	wrapper.hits = hits;
+	broadPhase->RayCastPacket(&wrapper, inputs, count);
+}
+
+// Runs the independent items of a batch query over the ranges of a task.
+template <typename T>
+class b2BatchQueryTask : public b2RangeTask
+{
+public:
+	void Execute(int32 begin, int32 end, int32 workerIndex) override
+	{
+		B2_NOT_USED(workerIndex);
+		for (int32 i = begin; i < end; ++i)
+		{
+			m_batch->Run(i);
+		}
+	}
+
+	const T* m_batch;
+};
+
+template <typename T>
+static void b2RunBatchQuery(b2TaskScheduler* scheduler, const T* batch, int32 itemCount, int32 minRange)
+{
+	b2BatchQueryTask<T> task;
+	task.m_batch = batch;
+	b2ExecuteTask(scheduler, &task, itemCount, minRange);
+}
+
+// The packets of b2World::RayCastBatch.
+struct b2RayCastBatch
+{
+	void Run(int32 packetIndex) const
+	{
+		int32 first = packetIndex * b2_maxRayPacket;
+		int32 packetCount = b2Min(count - first, b2_maxRayPacket);
+		b2RayCastPacket(broadPhase, rays + first, packetCount, hits + first);
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2BatchRay* rays;
+	b2BatchRayHit* hits;
+	int32 count;
+};
+
+void b2World::RayCastBatch(const b2BatchRay* rays, int32 count, b2BatchRayHit* hits, bool parallel) const
+{
+	b2RayCastBatch batch;
+	batch.broadPhase = &m_contactManager.m_broadPhase;
+	batch.rays = rays;
+	batch.hits = hits;
+	batch.count = count;
+
+	int32 packetCount = (count + b2_maxRayPacket - 1) / b2_maxRayPacket;
+	b2RunBatchQuery(parallel ? m_taskScheduler : nullptr, &batch, packetCount, b2_minTaskRange / b2_maxRayPacket);
+}
+
+// Stores the fixtures found by one query of a batch, up to the capacity.
+struct b2BatchQueryResults
+{
+	void Add(b2Fixture* fixture)
+	{
+		if (count < capacity)
+		{
+			fixtures[count] = fixture;
+		}
+		++count;
+	}
+
+	b2Fixture** fixtures;
+	int32 capacity;
+	int32 count;
+};
+
+struct b2BatchAABBWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		results->Add(proxy->fixture);
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	b2BatchQueryResults* results;
+};
+
+// The queries of b2World::QueryAABBBatch.
+struct b2QueryAABBBatch
+{
+	void Run(int32 index) const
+	{
+		b2BatchQueryResults results;
+		results.fixtures = fixtures + index * capacity;
+		results.capacity = capacity;
+		results.count = 0;
+
+		b2BatchAABBWrapper wrapper;
+		wrapper.broadPhase = broadPhase;
+		wrapper.results = &results;
+		broadPhase->Query(&wrapper, aabbs[index]);
+
+		counts[index] = results.count;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2AABB* aabbs;
+	b2Fixture** fixtures;
+	int32 capacity;
+	int32* counts;
+};
+
+void b2World::QueryAABBBatch(const b2AABB* aabbs, int32 count, b2Fixture** fixtures, int32 capacity, int32* counts, bool parallel) const
+{
+	b2QueryAABBBatch batch;
+	batch.broadPhase = &m_contactManager.m_broadPhase;
+	batch.aabbs = aabbs;
+	batch.fixtures = fixtures;
+	batch.capacity = capacity;
+	batch.counts = counts;
+	b2RunBatchQuery(parallel ? m_taskScheduler : nullptr, &batch, count, b2_minTaskRange);
+}
+
+struct b2BatchOverlapWrapper
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)broadPhase->GetUserData(proxyId);
+		b2Fixture* fixture = proxy->fixture;
+		if ((fixture->GetFilterData().categoryBits & query->maskBits) == 0)
+		{
+			return true;
+		}
+
+		const b2Shape* shape = fixture->GetShape();
+		const b2Transform& xf = fixture->GetBody()->GetTransform();
+		int32 childCount = query->shape->GetChildCount();
+		for (int32 i = 0; i < childCount; ++i)
+		{
+			if (b2TestOverlap(query->shape, i, shape, proxy->childIndex, query->transform, xf))
+			{
+				results->Add(fixture);
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2BatchShapeQuery* query;
+	b2BatchQueryResults* results;
+};
+
+// The queries of b2World::OverlapShapeBatch.
+struct b2OverlapShapeBatch
+{
+	void Run(int32 index) const
+	{
+		const b2BatchShapeQuery* query = queries + index;
+
+		b2AABB aabb;
+		query->shape->ComputeAABB(&aabb, query->transform, 0);
+		int32 childCount = query->shape->GetChildCount();
+		for (int32 i = 1; i < childCount; ++i)
+		{
+			b2AABB childAABB;
+			query->shape->ComputeAABB(&childAABB, query->transform, i);
+			aabb.Combine(childAABB);
+		}
+
+		b2BatchQueryResults results;
+		results.fixtures = fixtures + index * capacity;
+		results.capacity = capacity;
+		results.count = 0;
+
+		b2BatchOverlapWrapper wrapper;
+		wrapper.broadPhase = broadPhase;
+		wrapper.query = query;
+		wrapper.results = &results;
+		broadPhase->Query(&wrapper, aabb);
+
+		counts[index] = results.count;
+	}
+
+	const b2BroadPhase* broadPhase;
+	const b2BatchShapeQuery* queries;
+	b2Fixture** fixtures;
+	int32 capacity;
+	int32* counts;
+};
+
+void b2World::OverlapShapeBatch(const b2BatchShapeQuery* queries, int32 count, b2Fixture** fixtures, int32 capacity, int32* counts, bool parallel) const
+{
+	b2OverlapShapeBatch batch;
+	batch.broadPhase = &m_contactManager.m_broadPhase;
+	batch.queries = queries;
+	batch.fixtures = fixtures;
+	batch.capacity = capacity;
+	batch.counts = counts;
+	b2RunBatchQuery(parallel ? m_taskScheduler : nullptr, &batch, count, b2_minTaskRange);
+}
+
 void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color& color)
 {
 	switch (fixture->GetType())
@@ -1099,6 +2016,31 @@ void b2World::DrawShape(b2Fixture* fixture, const b2Transform& xf, const b2Color
 		}
 		break;
 
+	case b2Shape::e_capsule:
+		{
+			b2CapsuleShape* capsule = (b2CapsuleShape*)fixture->GetShape();
+			b2Vec2 v1 = b2Mul(xf, capsule->m_vertex1);
+			b2Vec2 v2 = b2Mul(xf, capsule->m_vertex2);
+			float radius = capsule->m_radius;
+
+			// Outline the caps with half circles.
+			const int32 k_segments = 8;
+			b2Vec2 vertices[2 * k_segments + 2];
+			b2Vec2 axis = v2 - v1;
+			axis.Normalize();
+			b2Vec2 normal(axis.y, -axis.x);
+			for (int32 i = 0; i <= k_segments; ++i)
+			{
+				float angle = b2_pi * float(i) / float(k_segments);
+				b2Vec2 r = cosf(angle) * normal + sinf(angle) * axis;
+				vertices[i] = v2 + radius * r;
+				vertices[k_segments + 1 + i] = v1 - radius * r;
+			}
+
+			m_debugDraw->DrawSolidPolygon(vertices, 2 * k_segments + 2, color);
+		}
+		break;
+
 	default:
 	break;
 	}
@@ -1160,8 +2102,9 @@ void b2World::DebugDraw()
 	if (flags & b2Draw::e_pairBit)
 	{
 		b2Color color(0.3f, 0.9f, 0.9f);
-		for (b2Contact* c = m_contactManager.m_contactList; c; c = c->GetNext())
+		for (int32 i = 0; i < m_contactManager.m_contactCount; ++i)
 		{
+			b2Contact* c = m_contactManager.m_contacts[i];
 			b2Fixture* fixtureA = c->GetFixtureA();
 			b2Fixture* fixtureB = c->GetFixtureB();
 			int32 indexA = c->GetChildIndexA();
@@ -1219,6 +2162,11 @@ int32 b2World::GetProxyCount() const
 	return m_contactManager.m_broadPhase.GetProxyCount();
 }
 
+int32 b2World::GetProxyMoveCount() const
+{
+	return m_contactManager.m_broadPhase.GetProxyMoveCount();
+}
+
 int32 b2World::GetTreeHeight() const
 {
 	return m_contactManager.m_broadPhase.GetTreeHeight();
@@ -1234,6 +2182,46 @@ float b2World::GetTreeQuality() const
 	return m_contactManager.m_broadPhase.GetTreeQuality();
 }
 
+void b2World::SetTreeRebuildThreshold(float threshold)
+{
+	m_contactManager.m_broadPhase.SetRebuildThreshold(threshold);
+}
+
+void b2World::SetTreeRefit(bool flag)
+{
+	m_contactManager.m_broadPhase.SetRefitMode(flag);
+}
+
+void b2World::SetAdaptiveMargins(bool flag)
+{
+	m_contactManager.m_broadPhase.SetAdaptiveMargins(flag);
+}
+
+bool b2World::GetAdaptiveMargins() const
+{
+	return m_contactManager.m_broadPhase.GetAdaptiveMargins();
+}
+
+void b2World::SetManifoldReuse(bool flag)
+{
+	m_contactManager.m_reuseManifolds = flag;
+}
+
+bool b2World::GetManifoldReuse() const
+{
+	return m_contactManager.m_reuseManifolds;
+}
+
+void b2World::SetWideTree(bool flag)
+{
+	m_contactManager.m_broadPhase.SetWideTree(flag);
+}
+
+void b2World::SetCompactTree(bool flag)
+{
+	m_contactManager.m_broadPhase.SetCompactTree(flag);
+}
+
 void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	b2Assert(m_locked == false);
@@ -1245,8 +2233,8 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
 		b->m_xf.p -= newOrigin;
-		b->m_sweep.c0 -= newOrigin;
-		b->m_sweep.c -= newOrigin;
+		b->GetSolverPosition0().c -= newOrigin;
+		b->GetSolverPosition().c -= newOrigin;
 	}
 
 	for (b2Joint* j = m_jointList; j; j = j->m_next)
@@ -1257,6 +2245,50 @@ void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 	m_contactManager.m_broadPhase.ShiftOrigin(newOrigin);
 }
 
+// FNV-1a over the bits of the values. Floats are hashed bit for bit, so -0 and +0 differ.
+static uint64 b2HashFloats(uint64 hash, const float* values, int32 count)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		uint32 bits;
+		memcpy(&bits, values + i, sizeof(uint32));
+		for (int32 j = 0; j < 4; ++j)
+		{
+			hash ^= (bits >> (8 * j)) & 0xFF;
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+uint64 b2World::ComputeStateHash() const
+{
+	uint64 hash = 14695981039346656037ULL;
+
+	for (const b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		const b2Transform& xf = b->GetTransform();
+		b2Vec2 v = b->GetLinearVelocity();
+		float state[7] = { xf.p.x, xf.p.y, xf.q.s, xf.q.c, v.x, v.y, b->GetAngularVelocity() };
+		hash = b2HashFloats(hash, state, 7);
+	}
+
+	// The contact order is fixed by the order of creation and destruction.
+	for (int32 i = 0; i < m_contactManager.m_contactCount; ++i)
+	{
+		const b2Manifold* manifold = m_contactManager.m_contacts[i]->GetManifold();
+		for (int32 j = 0; j < manifold->pointCount; ++j)
+		{
+			const b2ManifoldPoint* mp = manifold->points + j;
+			float impulses[2] = { mp->normalImpulse, mp->tangentImpulse };
+			hash = b2HashFloats(hash, impulses, 2);
+		}
+	}
+
+	return hash;
+}
+
 void b2World::Dump()
 {
 	if (m_locked)
@@ -305,6 +305,7 @@ void Test::Step(Settings& settings)
 	m_world->SetWarmStarting(settings.m_enableWarmStarting);
 	m_world->SetContinuousPhysics(settings.m_enableContinuous);
 	m_world->SetSubStepping(settings.m_enableSubStepping);
+	m_world->SetManifoldReuse(settings.m_enableManifoldReuse);
 
 	m_pointCount = 0;
 
@@ -391,6 +392,10 @@ void Test::Step(Settings& settings)
 		m_textLine += m_textIncrement;
 		g_debugDraw.DrawString(5, m_textLine, "broad-phase [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.broadphase, aveProfile.broadphase, m_maxProfile.broadphase);
 		m_textLine += m_textIncrement;
+		g_debugDraw.DrawString(5, m_textLine, "proxy moves/pair queries/pairs = %d/%d/%d", p.proxyMoves, p.pairQueries, p.pairs);
+		m_textLine += m_textIncrement;
+		g_debugDraw.DrawString(5, m_textLine, "reused manifolds = %d", p.reusedManifolds);
+		m_textLine += m_textIncrement;
 	}
 
 	if (m_bombSpawning)
@@ -72,8 +72,7 @@ public:
 		g_debugDraw.DrawString(5, m_textLine, "toi = %g", output.t);
 		m_textLine += m_textIncrement;
 
-		extern B2_API int32 b2_toiMaxIters, b2_toiMaxRootIters;
-		g_debugDraw.DrawString(5, m_textLine, "max toi iters = %d, max root iters = %d", b2_toiMaxIters, b2_toiMaxRootIters);
+		g_debugDraw.DrawString(5, m_textLine, "max toi iters = %d, max root iters = %d", b2_toiMaxIters.load(), b2_toiMaxRootIters.load());
 		m_textLine += m_textIncrement;
 
 		b2Vec2 vertices[b2_maxPolygonVertices];
@@ -21,6 +21,7 @@
 // SOFTWARE.
 
 #include "box2d/box2d.h"
+#include "box2d/b2_distance.h"
 #include "doctest.h"
 #include <stdio.h>
 
@@ -79,3 +80,851 @@ DOCTEST_TEST_CASE("collision test")
 		CHECK(b2Abs(massData2.I - inertia) < 40.0f * (absTol + relTol * inertia));
 	}
 }
+
+class TreeQueryCallback
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		B2_NOT_USED(proxyId);
+		++m_count;
+		return true;
+	}
+
+	int32 m_count = 0;
+};
+
+DOCTEST_TEST_CASE("dynamic tree bulk build")
+{
+	const int32 count = 1000;
+	b2AABB aabbs[count];
+	void* userData[count];
+	int32 proxyIds[count];
+
+	// Walls of a maze on a 40 by 25 grid.
+	for (int32 i = 0; i < count; ++i)
+	{
+		float x = float(i % 40);
+		float y = float(i / 40);
+		b2Vec2 extents = (i % 3) == 0 ? b2Vec2(0.5f, 0.05f) : b2Vec2(0.05f, 0.5f);
+		aabbs[i].lowerBound = b2Vec2(x, y) - extents;
+		aabbs[i].upperBound = b2Vec2(x, y) + extents;
+		userData[i] = aabbs + i;
+	}
+
+	b2DynamicTree incremental;
+	for (int32 i = 0; i < count; ++i)
+	{
+		incremental.CreateProxy(aabbs[i], userData[i]);
+	}
+
+	b2DynamicTree bulk;
+	bulk.CreateProxies(count, aabbs, userData, proxyIds);
+	bulk.Validate();
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		CHECK(bulk.GetUserData(proxyIds[i]) == userData[i]);
+	}
+
+	CHECK(bulk.GetAreaRatio() < incremental.GetAreaRatio());
+
+	// Both trees find the same proxies.
+	b2AABB box;
+	box.lowerBound.Set(10.0f, 5.0f);
+	box.upperBound.Set(14.5f, 9.5f);
+
+	TreeQueryCallback incrementalCallback;
+	incremental.Query(&incrementalCallback, box);
+
+	TreeQueryCallback bulkCallback;
+	bulk.Query(&bulkCallback, box);
+
+	CHECK(bulkCallback.m_count > 0);
+	CHECK(bulkCallback.m_count == incrementalCallback.m_count);
+
+	// Proxies added later go through the usual insertion.
+	b2AABB extra;
+	extra.lowerBound.Set(-5.0f, -5.0f);
+	extra.upperBound.Set(-4.0f, -4.0f);
+	int32 extraId = bulk.CreateProxy(extra, nullptr);
+	bulk.DestroyProxy(proxyIds[0]);
+	bulk.DestroyProxy(extraId);
+	bulk.Rebuild();
+	bulk.Validate();
+	CHECK(bulk.GetAreaRatio() < incremental.GetAreaRatio());
+}
+
+class FindProxyCallback
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		m_found = m_found || proxyId == m_proxyId;
+		return true;
+	}
+
+	int32 m_proxyId = b2_nullNode;
+	bool m_found = false;
+};
+
+DOCTEST_TEST_CASE("dynamic tree rebuild from snapshot")
+{
+	const int32 count = 500;
+	b2DynamicTree tree;
+	int32 proxyIds[count];
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2AABB aabb;
+		aabb.lowerBound.Set(float(i % 25), float(i / 25));
+		aabb.upperBound = aabb.lowerBound + b2Vec2(0.5f, 0.5f);
+		proxyIds[i] = tree.CreateProxy(aabb, nullptr);
+	}
+
+	b2TreeRebuild rebuild;
+	rebuild.Snapshot(&tree);
+
+	// Change the tree while the new structure is built from the snapshot. Some of the
+	// destroyed nodes are reused by the new proxies.
+	for (int32 i = 0; i < count; i += 5)
+	{
+		tree.DestroyProxy(proxyIds[i]);
+		proxyIds[i] = b2_nullNode;
+	}
+
+	for (int32 i = 0; i < count; i += 10)
+	{
+		b2AABB aabb;
+		aabb.lowerBound.Set(-10.0f + 0.1f * i, -10.0f);
+		aabb.upperBound = aabb.lowerBound + b2Vec2(0.5f, 0.5f);
+		proxyIds[i] = tree.CreateProxy(aabb, nullptr);
+	}
+
+	for (int32 i = 1; i < count; i += 7)
+	{
+		if (proxyIds[i] == b2_nullNode)
+		{
+			continue;
+		}
+
+		b2AABB aabb = tree.GetFatAABB(proxyIds[i]);
+		aabb.lowerBound += b2Vec2(3.0f, 0.0f);
+		aabb.upperBound += b2Vec2(3.0f, 0.0f);
+		tree.MoveProxy(proxyIds[i], aabb, b2Vec2(3.0f, 0.0f));
+	}
+
+	rebuild.Build();
+	rebuild.Apply(&tree);
+	tree.Validate();
+
+	// A query of everything finds each live proxy once.
+	b2AABB box;
+	box.lowerBound.Set(-20.0f, -20.0f);
+	box.upperBound.Set(40.0f, 40.0f);
+	TreeQueryCallback callback;
+	tree.Query(&callback, box);
+
+	int32 liveCount = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		liveCount += proxyIds[i] != b2_nullNode ? 1 : 0;
+	}
+	CHECK(callback.m_count == liveCount);
+
+	// Each live proxy is found by a query of its own AABB.
+	bool found = true;
+	for (int32 i = 0; i < count; ++i)
+	{
+		if (proxyIds[i] == b2_nullNode)
+		{
+			continue;
+		}
+
+		FindProxyCallback proxyCallback;
+		proxyCallback.m_proxyId = proxyIds[i];
+		tree.Query(&proxyCallback, tree.GetFatAABB(proxyIds[i]));
+		found = found && proxyCallback.m_found;
+	}
+	CHECK(found);
+}
+
+DOCTEST_TEST_CASE("dynamic tree refit")
+{
+	const int32 count = 400;
+	b2AABB aabbs[count];
+	int32 proxyIds[count];
+
+	b2DynamicTree tree;
+	tree.SetRefitMode(true);
+	for (int32 i = 0; i < count; ++i)
+	{
+		aabbs[i].lowerBound.Set(float(i % 20), float(i / 20));
+		aabbs[i].upperBound = aabbs[i].lowerBound + b2Vec2(0.5f, 0.5f);
+		proxyIds[i] = tree.CreateProxy(aabbs[i], nullptr);
+	}
+
+	// Move every proxy along a spiral. Some drift far from where they were inserted.
+	for (int32 step = 0; step < 20; ++step)
+	{
+		for (int32 i = 0; i < count; ++i)
+		{
+			float angle = 0.1f * (i + step);
+			b2Vec2 d(0.05f * i * cosf(angle), 0.05f * i * sinf(angle));
+			aabbs[i].lowerBound += d;
+			aabbs[i].upperBound += d;
+			tree.MoveProxy(proxyIds[i], aabbs[i], d);
+		}
+
+		tree.Refit();
+		tree.Validate();
+	}
+
+	CHECK(tree.GetMoveCount() > 0);
+
+	// Every proxy is found by a query of its own AABB.
+	bool found = true;
+	for (int32 i = 0; i < count; ++i)
+	{
+		FindProxyCallback callback;
+		callback.m_proxyId = proxyIds[i];
+		tree.Query(&callback, aabbs[i]);
+		found = found && callback.m_found;
+	}
+	CHECK(found);
+
+	// A region query finds the same proxies as brute force.
+	b2AABB box;
+	box.lowerBound.Set(0.0f, 0.0f);
+	box.upperBound.Set(10.0f, 10.0f);
+
+	int32 bruteCount = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		bruteCount += b2TestOverlap(tree.GetFatAABB(proxyIds[i]), box) ? 1 : 0;
+	}
+
+	TreeQueryCallback callback;
+	tree.Query(&callback, box);
+	CHECK(callback.m_count > 0);
+	CHECK(callback.m_count == bruteCount);
+}
+
+// Sums the proxy ids found by a query so two trees can be compared.
+class SumQueryCallback
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		m_sum += proxyId + 1;
+		++m_count;
+		return true;
+	}
+
+	int32 m_sum = 0;
+	int32 m_count = 0;
+};
+
+// Keeps the closest hit of a ray cast against the proxy AABBs.
+class ClosestTreeRayCastCallback
+{
+public:
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		b2RayCastOutput output;
+		if (m_tree->GetFatAABB(proxyId).RayCast(&output, input) == false)
+		{
+			return input.maxFraction;
+		}
+
+		m_proxyId = proxyId;
+		m_fraction = output.fraction;
+		return output.fraction;
+	}
+
+	const b2DynamicTree* m_tree;
+	int32 m_proxyId = b2_nullNode;
+	float m_fraction = 1.0f;
+};
+
+DOCTEST_TEST_CASE("wide tree")
+{
+	b2DynamicTree tree;
+	uint32 seed = 1;
+	for (int32 i = 0; i < 1000; ++i)
+	{
+		seed = 1664525 * seed + 1013904223;
+		float x = float(seed >> 16) * (100.0f / 65536.0f);
+		seed = 1664525 * seed + 1013904223;
+		float y = float(seed >> 16) * (100.0f / 65536.0f);
+
+		b2AABB aabb;
+		aabb.lowerBound.Set(x, y);
+		aabb.upperBound.Set(x + 0.5f + 0.001f * i, y + 0.5f);
+		tree.CreateProxy(aabb, nullptr);
+	}
+
+	b2WideTree wideTree;
+	wideTree.Build(&tree);
+	CHECK(wideTree.GetNodeCount() > 0);
+	// Each wide node replaces at least one of the 999 internal nodes.
+	CHECK(wideTree.GetNodeCount() < 999);
+
+	bool sameQuery = true;
+	bool sameRayCast = true;
+	for (int32 i = 0; i < 100; ++i)
+	{
+		b2AABB box;
+		box.lowerBound.Set(float(i), float((7 * i) % 100));
+		box.upperBound = box.lowerBound + b2Vec2(5.0f, 3.0f);
+
+		SumQueryCallback treeQuery;
+		tree.Query(&treeQuery, box);
+		SumQueryCallback wideQuery;
+		wideTree.Query(&wideQuery, box);
+		sameQuery = sameQuery && treeQuery.m_count == wideQuery.m_count && treeQuery.m_sum == wideQuery.m_sum;
+
+		b2RayCastInput input;
+		input.p1.Set(float(i), 0.0f);
+		input.p2.Set(100.0f - float(i), 100.0f);
+		input.maxFraction = 1.0f;
+
+		ClosestTreeRayCastCallback treeRay;
+		treeRay.m_tree = &tree;
+		tree.RayCast(&treeRay, input);
+		ClosestTreeRayCastCallback wideRay;
+		wideRay.m_tree = &tree;
+		wideTree.RayCast(&wideRay, input);
+		sameRayCast = sameRayCast && treeRay.m_proxyId == wideRay.m_proxyId && treeRay.m_fraction == wideRay.m_fraction;
+	}
+
+	CHECK(sameQuery);
+	CHECK(sameRayCast);
+
+	// An empty tree and a single proxy.
+	b2DynamicTree single;
+	wideTree.Build(&single);
+	CHECK(wideTree.GetNodeCount() == 0);
+
+	b2AABB aabb;
+	aabb.lowerBound.Set(0.0f, 0.0f);
+	aabb.upperBound.Set(1.0f, 1.0f);
+	int32 proxyId = single.CreateProxy(aabb, nullptr);
+	wideTree.Build(&single);
+
+	FindProxyCallback callback;
+	callback.m_proxyId = proxyId;
+	wideTree.Query(&callback, aabb);
+	CHECK(callback.m_found);
+}
+
+DOCTEST_TEST_CASE("compact tree")
+{
+	// Small boxes far from the origin stress the rounding of the quantized bounds.
+	const b2Vec2 offsets[2] = { b2Vec2(0.0f, 0.0f), b2Vec2(30000.0f, -20000.0f) };
+	for (int32 k = 0; k < 2; ++k)
+	{
+		b2DynamicTree tree;
+		uint32 seed = 1;
+		for (int32 i = 0; i < 1000; ++i)
+		{
+			seed = 1664525 * seed + 1013904223;
+			float x = float(seed >> 16) * (100.0f / 65536.0f);
+			seed = 1664525 * seed + 1013904223;
+			float y = float(seed >> 16) * (100.0f / 65536.0f);
+
+			b2AABB aabb;
+			aabb.lowerBound = offsets[k] + b2Vec2(x, y);
+			aabb.upperBound = aabb.lowerBound + b2Vec2(0.01f + 0.0005f * i, 0.01f);
+			tree.CreateProxy(aabb, nullptr);
+		}
+
+		b2CompactTree compactTree;
+		compactTree.Build(&tree);
+		CHECK(compactTree.GetNodeCount() > 0);
+		CHECK(compactTree.GetNodeCount() < 999);
+
+		// Smaller than a wide tree of the same proxies.
+		b2WideTree wideTree;
+		wideTree.Build(&tree);
+		CHECK(compactTree.GetByteCount() < wideTree.GetNodeCount() * int32(sizeof(b2WideNode)));
+
+		bool sameQuery = true;
+		bool sameRayCast = true;
+		for (int32 i = 0; i < 100; ++i)
+		{
+			b2AABB box;
+			box.lowerBound = offsets[k] + b2Vec2(float(i), float((7 * i) % 100));
+			box.upperBound = box.lowerBound + b2Vec2(5.0f, 3.0f);
+
+			SumQueryCallback treeQuery;
+			tree.Query(&treeQuery, box);
+			SumQueryCallback compactQuery;
+			compactTree.Query(&compactQuery, box);
+			sameQuery = sameQuery && treeQuery.m_count == compactQuery.m_count && treeQuery.m_sum == compactQuery.m_sum;
+
+			b2RayCastInput input;
+			input.p1 = offsets[k] + b2Vec2(float(i), 0.0f);
+			input.p2 = offsets[k] + b2Vec2(100.0f - float(i), 100.0f);
+			input.maxFraction = 1.0f;
+
+			ClosestTreeRayCastCallback treeRay;
+			treeRay.m_tree = &tree;
+			tree.RayCast(&treeRay, input);
+			ClosestTreeRayCastCallback compactRay;
+			compactRay.m_tree = &tree;
+			compactTree.RayCast(&compactRay, input);
+			sameRayCast = sameRayCast && treeRay.m_proxyId == compactRay.m_proxyId && treeRay.m_fraction == compactRay.m_fraction;
+		}
+
+		CHECK(sameQuery);
+		CHECK(sameRayCast);
+	}
+
+	// An empty tree and a single proxy.
+	b2CompactTree compactTree;
+	b2DynamicTree single;
+	compactTree.Build(&single);
+	CHECK(compactTree.GetNodeCount() == 0);
+
+	b2AABB aabb;
+	aabb.lowerBound.Set(0.0f, 0.0f);
+	aabb.upperBound.Set(1.0f, 1.0f);
+	int32 proxyId = single.CreateProxy(aabb, nullptr);
+	compactTree.Build(&single);
+
+	FindProxyCallback callback;
+	callback.m_proxyId = proxyId;
+	compactTree.Query(&callback, aabb);
+	CHECK(callback.m_found);
+}
+
+// Sums the indices stored in the user data of the proxies found by a query and keeps
+// the closest ray hit, so different broad-phase structures can be compared.
+template <typename T>
+class IndexCallback
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		m_sum += int32(intptr_t(m_structure->GetUserData(proxyId)));
+		++m_count;
+		return true;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		b2RayCastOutput output;
+		if (m_structure->GetFatAABB(proxyId).RayCast(&output, input) == false)
+		{
+			return input.maxFraction;
+		}
+
+		m_index = int32(intptr_t(m_structure->GetUserData(proxyId)));
+		m_fraction = output.fraction;
+		return output.fraction;
+	}
+
+	const T* m_structure;
+	int32 m_sum = 0;
+	int32 m_count = 0;
+	int32 m_index = -1;
+	float m_fraction = 1.0f;
+};
+
+template <typename T>
+static void RunIndexQueries(const T* structure, int32* sums, int32* indices)
+{
+	for (int32 i = 0; i < 100; ++i)
+	{
+		b2AABB box;
+		box.lowerBound.Set(float(i) - 10.0f, float((7 * i) % 100) - 10.0f);
+		box.upperBound = box.lowerBound + b2Vec2(0.1f * i, 3.0f);
+		if (i == 99)
+		{
+			// Larger than the grid is worth walking.
+			box.lowerBound.Set(-1000.0f, -1000.0f);
+			box.upperBound.Set(1000.0f, 1000.0f);
+		}
+
+		IndexCallback<T> query;
+		query.m_structure = structure;
+		structure->Query(&query, box);
+		sums[i] = query.m_sum + 1000000 * query.m_count;
+
+		b2RayCastInput input;
+		input.p1.Set(float(i) - 10.0f, -10.0f);
+		input.p2.Set(90.0f - float(i), 100.0f - 0.9f * i);
+		input.maxFraction = 1.0f;
+
+		IndexCallback<T> ray;
+		ray.m_structure = structure;
+		structure->RayCast(&ray, input);
+		indices[i] = ray.m_index;
+	}
+}
+
+// Applies the same changes to each structure.
+template <typename T>
+static void BuildIndexScene(T* structure)
+{
+	const int32 count = 1000;
+	int32 proxyIds[count];
+	uint32 seed = 7;
+	for (int32 i = 0; i < count; ++i)
+	{
+		seed = 1664525 * seed + 1013904223;
+		float x = float(seed >> 16) * (100.0f / 65536.0f) - 10.0f;
+		seed = 1664525 * seed + 1013904223;
+		float y = float(seed >> 16) * (100.0f / 65536.0f) - 10.0f;
+
+		// Every 50th proxy is large.
+		float size = i % 50 == 0 ? 20.0f : 0.5f;
+		b2AABB aabb;
+		aabb.lowerBound.Set(x, y);
+		aabb.upperBound.Set(x + size, y + 0.5f);
+		proxyIds[i] = structure->CreateProxy(aabb, (void*)intptr_t(i));
+	}
+
+	for (int32 i = 0; i < count; i += 3)
+	{
+		b2Vec2 d(0.3f * float(i % 7) - 1.0f, 0.2f * float(i % 5) - 0.5f);
+		b2AABB aabb = structure->GetFatAABB(proxyIds[i]);
+		aabb.lowerBound += d;
+		aabb.upperBound += d;
+		structure->MoveProxy(proxyIds[i], aabb, d);
+	}
+
+	for (int32 i = 0; i < count; i += 11)
+	{
+		structure->DestroyProxy(proxyIds[i]);
+	}
+}
+
+DOCTEST_TEST_CASE("broad-phase structures")
+{
+	b2DynamicTree tree;
+	b2SpatialHash grid;
+	b2SweepAndPrune sweep;
+	BuildIndexScene(&tree);
+	BuildIndexScene(&grid);
+	BuildIndexScene(&sweep);
+
+	int32 treeSums[100], gridSums[100], sweepSums[100];
+	int32 treeHits[100], gridHits[100], sweepHits[100];
+	RunIndexQueries(&tree, treeSums, treeHits);
+	RunIndexQueries(&grid, gridSums, gridHits);
+	RunIndexQueries(&sweep, sweepSums, sweepHits);
+
+	bool sameQuery = true;
+	bool sameRayCast = true;
+	int32 hitCount = 0;
+	for (int32 i = 0; i < 100; ++i)
+	{
+		sameQuery = sameQuery && gridSums[i] == treeSums[i] && sweepSums[i] == treeSums[i];
+		sameRayCast = sameRayCast && gridHits[i] == treeHits[i] && sweepHits[i] == treeHits[i];
+		hitCount += treeHits[i] >= 0 ? 1 : 0;
+	}
+
+	CHECK(hitCount > 0);
+	CHECK(sameQuery);
+	CHECK(sameRayCast);
+
+	// Shifting the origin keeps the same proxies under the shifted queries.
+	b2Vec2 origin(5.0f, -3.0f);
+	b2AABB box;
+	box.lowerBound.Set(10.0f, 10.0f);
+	box.upperBound.Set(30.0f, 20.0f);
+
+	IndexCallback<b2SpatialHash> before;
+	before.m_structure = &grid;
+	grid.Query(&before, box);
+
+	grid.ShiftOrigin(origin);
+	box.lowerBound -= origin;
+	box.upperBound -= origin;
+
+	IndexCallback<b2SpatialHash> after;
+	after.m_structure = &grid;
+	grid.Query(&after, box);
+	CHECK(after.m_count == before.m_count);
+	CHECK(after.m_sum == before.m_sum);
+}
+
+// The max separation of poly2 from poly1 along the edge normals of poly1, one normal at a time.
+static float ReferenceSeparation(int32* edgeIndex, const b2PolygonShape& poly1, const b2Transform& xf1,
+								 const b2PolygonShape& poly2, const b2Transform& xf2)
+{
+	b2Transform xf = b2MulT(xf2, xf1);
+	*edgeIndex = 0;
+	float maxSeparation = -b2_maxFloat;
+	for (int32 i = 0; i < poly1.m_count; ++i)
+	{
+		b2Vec2 n = b2Mul(xf.q, poly1.m_normals[i]);
+		b2Vec2 v1 = b2Mul(xf, poly1.m_vertices[i]);
+
+		float si = b2_maxFloat;
+		for (int32 j = 0; j < poly2.m_count; ++j)
+		{
+			si = b2Min(si, b2Dot(n, poly2.m_vertices[j] - v1));
+		}
+
+		if (si > maxSeparation)
+		{
+			maxSeparation = si;
+			*edgeIndex = i;
+		}
+	}
+
+	return maxSeparation;
+}
+
+DOCTEST_TEST_CASE("polygon collision")
+{
+	// Triangles, boxes, and octagons cover partial and full blocks of edges.
+	b2PolygonShape polygons[3];
+	b2Vec2 triangle[3] = { b2Vec2(-0.5f, 0.0f), b2Vec2(0.5f, 0.0f), b2Vec2(0.0f, 0.8f) };
+	polygons[0].Set(triangle, 3);
+	polygons[1].SetAsBox(0.5f, 0.25f);
+	b2Vec2 octagon[8];
+	for (int32 i = 0; i < 8; ++i)
+	{
+		float angle = 0.25f * b2_pi * float(i);
+		octagon[i].Set(0.6f * cosf(angle), 0.6f * sinf(angle));
+	}
+	polygons[2].Set(octagon, 8);
+	polygons[2].m_radius = 0.05f;
+
+	bool sameFeatures = true;
+	int32 touchingCount = 0;
+	uint32 seed = 1;
+	for (int32 i = 0; i < 3000; ++i)
+	{
+		const b2PolygonShape& polyA = polygons[i % 3];
+		const b2PolygonShape& polyB = polygons[(i / 3) % 3];
+
+		seed = 1664525 * seed + 1013904223;
+		float x = float(seed >> 16) * (2.0f / 65536.0f) - 1.0f;
+		seed = 1664525 * seed + 1013904223;
+		float y = float(seed >> 16) * (2.0f / 65536.0f) - 1.0f;
+		seed = 1664525 * seed + 1013904223;
+		float angle = float(seed >> 16) * (2.0f * b2_pi / 65536.0f);
+
+		b2Transform xfA(b2Vec2(0.1f, -0.2f), b2Rot(0.3f));
+		b2Transform xfB(b2Vec2(x, y), b2Rot(angle));
+
+		b2Manifold manifold;
+		b2CollidePolygons(&manifold, &polyA, xfA, &polyB, xfB);
+
+		float totalRadius = polyA.m_radius + polyB.m_radius;
+		int32 edgeA, edgeB;
+		float separationA = ReferenceSeparation(&edgeA, polyA, xfA, polyB, xfB);
+		float separationB = ReferenceSeparation(&edgeB, polyB, xfB, polyA, xfA);
+		if (separationA > totalRadius || separationB > totalRadius)
+		{
+			sameFeatures = sameFeatures && manifold.pointCount == 0;
+			continue;
+		}
+
+		if (manifold.pointCount == 0)
+		{
+			continue;
+		}
+
+		++touchingCount;
+
+		// The reference face and the feature ids used for warm starting.
+		bool flip = separationB > separationA + 0.1f * b2_linearSlop;
+		const b2PolygonShape& poly1 = flip ? polyB : polyA;
+		int32 edge1 = flip ? edgeB : edgeA;
+		int32 edge2 = edge1 + 1 < poly1.m_count ? edge1 + 1 : 0;
+		b2Vec2 planePoint = 0.5f * (poly1.m_vertices[edge1] + poly1.m_vertices[edge2]);
+		sameFeatures = sameFeatures && manifold.type == (flip ? b2Manifold::e_faceB : b2Manifold::e_faceA);
+		sameFeatures = sameFeatures && manifold.localPoint.x == planePoint.x && manifold.localPoint.y == planePoint.y;
+		for (int32 j = 0; j < manifold.pointCount; ++j)
+		{
+			// Clipped points use a vertex of the reference edge.
+			const b2ContactFeature& cf = manifold.points[j].id.cf;
+			int32 index1 = flip ? cf.indexB : cf.indexA;
+			sameFeatures = sameFeatures && (index1 == edge1 || index1 == edge2);
+		}
+	}
+
+	CHECK(touchingCount > 100);
+	CHECK(sameFeatures);
+}
+
+DOCTEST_TEST_CASE("capsule shape")
+{
+	b2CapsuleShape capsule;
+	capsule.Set(b2Vec2(-0.5f, 0.25f), b2Vec2(1.0f, 0.25f), 0.25f);
+
+	SUBCASE("mass data")
+	{
+		b2MassData massData;
+		capsule.ComputeMass(&massData, 2.0f);
+
+		// Integrate over a grid using the point test.
+		const int32 n = 400;
+		b2Vec2 lower(-0.75f, 0.0f), upper(1.25f, 0.5f);
+		b2Vec2 cell = (1.0f / n) * (upper - lower);
+		float area = 0.0f, inertia = 0.0f;
+		b2Vec2 moment = b2Vec2_zero;
+		for (int32 i = 0; i < n; ++i)
+		{
+			for (int32 j = 0; j < n; ++j)
+			{
+				b2Vec2 p(lower.x + (i + 0.5f) * cell.x, lower.y + (j + 0.5f) * cell.y);
+				if (capsule.TestPoint(b2Transform(b2Vec2_zero, b2Rot(0.0f)), p))
+				{
+					float da = cell.x * cell.y;
+					area += da;
+					moment += da * p;
+					inertia += da * b2Dot(p, p);
+				}
+			}
+		}
+
+		CHECK(massData.mass == doctest::Approx(2.0f * area).epsilon(0.005));
+		CHECK(massData.center.x == doctest::Approx(moment.x / area).epsilon(0.005));
+		CHECK(massData.center.y == doctest::Approx(moment.y / area).epsilon(0.005));
+		CHECK(massData.I == doctest::Approx(2.0f * inertia).epsilon(0.005));
+	}
+
+	SUBCASE("aabb")
+	{
+		b2Transform xf(b2Vec2(1.0f, 2.0f), b2Rot(0.5f * b2_pi));
+		b2AABB aabb;
+		capsule.ComputeAABB(&aabb, xf, 0);
+		CHECK(aabb.lowerBound.x == doctest::Approx(0.5f));
+		CHECK(aabb.lowerBound.y == doctest::Approx(1.25f));
+		CHECK(aabb.upperBound.x == doctest::Approx(1.0f));
+		CHECK(aabb.upperBound.y == doctest::Approx(3.25f));
+	}
+
+	SUBCASE("ray cast")
+	{
+		b2Transform xf;
+		xf.SetIdentity();
+		b2RayCastOutput output;
+		b2RayCastInput input;
+		input.maxFraction = 1.0f;
+
+		// Side
+		input.p1.Set(0.5f, 2.0f);
+		input.p2.Set(0.5f, -2.0f);
+		CHECK(capsule.RayCast(&output, input, xf, 0));
+		CHECK(output.fraction == doctest::Approx(1.5f / 4.0f));
+		CHECK(output.normal.y == doctest::Approx(1.0f));
+
+		// Cap
+		input.p1.Set(-2.0f, 0.25f);
+		input.p2.Set(2.0f, 0.25f);
+		CHECK(capsule.RayCast(&output, input, xf, 0));
+		CHECK(output.fraction == doctest::Approx(1.25f / 4.0f));
+		CHECK(output.normal.x == doctest::Approx(-1.0f));
+
+		// Miss
+		input.p1.Set(-2.0f, 1.0f);
+		input.p2.Set(2.0f, 1.0f);
+		CHECK_FALSE(capsule.RayCast(&output, input, xf, 0));
+
+		// Inside
+		input.p1.Set(0.0f, 0.25f);
+		input.p2.Set(0.0f, 2.0f);
+		CHECK_FALSE(capsule.RayCast(&output, input, xf, 0));
+	}
+}
+
+DOCTEST_TEST_CASE("capsule collision")
+{
+	b2CapsuleShape capsuleA;
+	capsuleA.Set(b2Vec2(0.0f, -0.35f), b2Vec2(0.0f, 0.35f), 0.25f);
+	b2CapsuleShape capsuleB;
+	capsuleB.Set(b2Vec2(-0.3f, -0.3f), b2Vec2(0.2f, 0.4f), 0.15f);
+	b2PolygonShape polygon;
+	polygon.SetAsBox(0.4f, 0.3f);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-1.0f, 0.0f), b2Vec2(1.0f, 0.0f));
+	b2CircleShape circle;
+	circle.m_radius = 0.2f;
+
+	// Compare the deepest manifold point against the distance between the cores.
+	int32 badCount = 0;
+	int32 touchingCount = 0;
+	uint32 seed = 3;
+	for (int32 i = 0; i < 4000; ++i)
+	{
+		seed = 1664525 * seed + 1013904223;
+		float x = float(seed >> 16) * (2.4f / 65536.0f) - 1.2f;
+		seed = 1664525 * seed + 1013904223;
+		float y = float(seed >> 16) * (2.4f / 65536.0f) - 1.2f;
+		seed = 1664525 * seed + 1013904223;
+		float angle = float(seed >> 16) * (2.0f * b2_pi / 65536.0f);
+
+		b2Transform xfA(b2Vec2_zero, b2Rot(0.3f));
+		b2Transform xfB(b2Vec2(x, y), b2Rot(angle));
+
+		int32 which = i % 4;
+		const b2Shape* shapeA = &capsuleA;
+		const b2Shape* shapeB = &capsuleB;
+		b2Manifold manifold;
+		if (which == 0)
+		{
+			b2CollideCapsules(&manifold, &capsuleA, xfA, &capsuleB, xfB);
+		}
+		else if (which == 1)
+		{
+			shapeA = &polygon;
+			b2CollidePolygonAndCapsule(&manifold, &polygon, xfA, &capsuleB, xfB);
+		}
+		else if (which == 2)
+		{
+			shapeA = &edge;
+			b2CollideEdgeAndCapsule(&manifold, &edge, xfA, &capsuleB, xfB);
+		}
+		else
+		{
+			shapeB = &circle;
+			b2CollideCapsuleAndCircle(&manifold, &capsuleA, xfA, &circle, xfB);
+		}
+
+		b2DistanceInput input;
+		input.proxyA.Set(shapeA, 0);
+		input.proxyB.Set(shapeB, 0);
+		input.transformA = xfA;
+		input.transformB = xfB;
+		input.useRadii = false;
+		b2SimplexCache cache;
+		cache.count = 0;
+		b2DistanceOutput output;
+		b2Distance(&output, &cache, &input);
+
+		// Skip overlapping cores, the distance is not defined.
+		if (output.distance < 0.01f)
+		{
+			continue;
+		}
+
+		float separation = output.distance - shapeA->m_radius - shapeB->m_radius;
+		if (manifold.pointCount == 0)
+		{
+			badCount += separation < 0.0f ? 1 : 0;
+			continue;
+		}
+
+		++touchingCount;
+
+		b2WorldManifold worldManifold;
+		worldManifold.Initialize(&manifold, xfA, shapeA->m_radius, xfB, shapeB->m_radius);
+		float minSeparation = b2_maxFloat;
+		for (int32 j = 0; j < manifold.pointCount; ++j)
+		{
+			minSeparation = b2Min(minSeparation, worldManifold.separations[j]);
+		}
+
+		badCount += b2Abs(minSeparation - separation) > 0.005f ? 1 : 0;
+	}
+
+	CHECK(touchingCount > 500);
+	CHECK(badCount == 0);
+}
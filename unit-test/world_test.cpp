@@ -23,6 +23,7 @@
 #include "box2d/box2d.h"
 #include "doctest.h"
 #include <stdio.h>
+#include <thread>
 
 static bool begin_contact = false;
 
@@ -71,3 +72,1591 @@ DOCTEST_TEST_CASE("begin contact")
 	CHECK(world.GetContactList() != nullptr);
 	CHECK(begin_contact == true);
 }
+
+// Runs the ranges in reverse order on a rotating set of workers.
+class ReverseTaskScheduler : public b2TaskScheduler
+{
+public:
+	int32 GetWorkerCount() const override
+	{
+		return 3;
+	}
+
+	void* Enqueue(b2RangeTask* task, int32 itemCount, int32 minRange) override
+	{
+		int32 rangeCount = (itemCount + minRange - 1) / minRange;
+		for (int32 i = rangeCount - 1; i >= 0; --i)
+		{
+			int32 begin = i * minRange;
+			int32 end = b2Min(begin + minRange, itemCount);
+			task->Execute(begin, end, i % 3);
+		}
+		++taskCount;
+		return nullptr;
+	}
+
+	void Wait(void* handle) override
+	{
+		(void)handle;
+	}
+
+	int32 taskCount = 0;
+};
+
+class ImpulseListener : public b2ContactListener
+{
+public:
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override
+	{
+		(void)contact;
+		if (count < 4096)
+		{
+			impulses[count] = impulse->normalImpulses[0];
+		}
+		++count;
+	}
+
+	float impulses[4096];
+	int32 count = 0;
+};
+
+static void BuildPiles(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-100.0f, 0.0f), b2Vec2(100.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	for (int32 i = 0; i < 6; ++i)
+	{
+		float x = -50.0f + 20.0f * i;
+		b2Body* prev = ground;
+		for (int32 j = 0; j < 5; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(x + 0.1f * j, 0.5f + 1.05f * j);
+			b2Body* body = world->CreateBody(&bd);
+			body->CreateFixture(&box, 1.0f);
+
+			if (j == 0)
+			{
+				b2RevoluteJointDef jd;
+				jd.Initialize(prev, body, b2Vec2(x, 0.0f));
+				world->CreateJoint(&jd);
+			}
+			prev = body;
+		}
+	}
+}
+
+DOCTEST_TEST_CASE("parallel islands")
+{
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	ImpulseListener serialListener;
+	serialWorld.SetContactListener(&serialListener);
+	BuildPiles(&serialWorld);
+
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f));
+	ImpulseListener parallelListener;
+	ReverseTaskScheduler scheduler;
+	parallelWorld.SetContactListener(&parallelListener);
+	parallelWorld.SetTaskScheduler(&scheduler);
+	BuildPiles(&parallelWorld);
+
+	for (int32 i = 0; i < 60; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(scheduler.taskCount > 0);
+
+	// Solving islands in parallel must not change the results or the callback order.
+	const b2Body* serialBody = serialWorld.GetBodyList();
+	const b2Body* parallelBody = parallelWorld.GetBodyList();
+	while (serialBody != nullptr && parallelBody != nullptr)
+	{
+		CHECK(serialBody->GetPosition() == parallelBody->GetPosition());
+		CHECK(serialBody->GetAngle() == parallelBody->GetAngle());
+		serialBody = serialBody->GetNext();
+		parallelBody = parallelBody->GetNext();
+	}
+	CHECK(serialBody == parallelBody);
+
+	REQUIRE(serialListener.count == parallelListener.count);
+	REQUIRE(serialListener.count <= 4096);
+	bool sameImpulses = true;
+	for (int32 i = 0; i < serialListener.count; ++i)
+	{
+		sameImpulses = sameImpulses && serialListener.impulses[i] == parallelListener.impulses[i];
+	}
+	CHECK(sameImpulses);
+}
+
+DOCTEST_TEST_CASE("thread pool")
+{
+	b2ThreadPool pool(4);
+	CHECK(pool.GetWorkerCount() == 4);
+
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	b2World pooledWorld(b2Vec2(0.0f, -10.0f), &pool);
+	CHECK(pooledWorld.GetTaskScheduler() == &pool);
+
+	b2World* worlds[2] = { &serialWorld, &pooledWorld };
+	for (int32 i = 0; i < 2; ++i)
+	{
+		BuildPiles(worlds[i]);
+
+		// A fast bullet exercises continuous collision.
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.bullet = true;
+		bd.position.Set(0.0f, 20.0f);
+		bd.linearVelocity.Set(0.0f, -200.0f);
+		b2Body* bullet = worlds[i]->CreateBody(&bd);
+		b2CircleShape circle;
+		circle.m_radius = 0.25f;
+		bullet->CreateFixture(&circle, 1.0f);
+	}
+
+	for (int32 i = 0; i < 60; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		pooledWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	const b2Body* serialBody = serialWorld.GetBodyList();
+	const b2Body* pooledBody = pooledWorld.GetBodyList();
+	while (serialBody != nullptr && pooledBody != nullptr)
+	{
+		CHECK(serialBody->GetPosition() == pooledBody->GetPosition());
+		CHECK(serialBody->GetAngle() == pooledBody->GetAngle());
+		serialBody = serialBody->GetNext();
+		pooledBody = pooledBody->GetNext();
+	}
+	CHECK(serialBody == pooledBody);
+
+	// The bullet must not tunnel through the ground.
+	CHECK(pooledWorld.GetBodyList()->GetPosition().y > 0.0f);
+}
+
+// Records contact events as (event, body, body) using the body user data.
+class EventListener : public b2ContactListener
+{
+public:
+	void BeginContact(b2Contact* contact) override
+	{
+		Record(1, contact);
+	}
+
+	void EndContact(b2Contact* contact) override
+	{
+		Record(2, contact);
+	}
+
+	void PreSolve(b2Contact* contact, const b2Manifold* oldManifold) override
+	{
+		(void)oldManifold;
+		Record(3, contact);
+	}
+
+	void Record(int32 event, b2Contact* contact)
+	{
+		uintptr_t a = contact->GetFixtureA()->GetBody()->GetUserData().pointer;
+		uintptr_t b = contact->GetFixtureB()->GetBody()->GetUserData().pointer;
+		hash = 31 * hash + uint32(event);
+		hash = 31 * hash + uint32(a);
+		hash = 31 * hash + uint32(b);
+		++count;
+	}
+
+	uint32 hash = 0;
+	int32 count = 0;
+};
+
+DOCTEST_TEST_CASE("parallel collide")
+{
+	ReverseTaskScheduler scheduler;
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f), &scheduler);
+	EventListener serialListener;
+	EventListener parallelListener;
+	serialWorld.SetContactListener(&serialListener);
+	parallelWorld.SetContactListener(&parallelListener);
+
+	b2World* worlds[2] = { &serialWorld, &parallelWorld };
+	for (int32 w = 0; w < 2; ++w)
+	{
+		b2World* world = worlds[w];
+
+		b2BodyDef groundDef;
+		b2Body* ground = world->CreateBody(&groundDef);
+		b2PolygonShape wall;
+		wall.SetAsBox(10.0f, 0.5f);
+		ground->CreateFixture(&wall, 0.0f);
+		wall.SetAsBox(0.5f, 10.0f, b2Vec2(-10.0f, 10.0f), 0.0f);
+		ground->CreateFixture(&wall, 0.0f);
+		wall.SetAsBox(0.5f, 10.0f, b2Vec2(10.0f, 10.0f), 0.0f);
+		ground->CreateFixture(&wall, 0.0f);
+
+		b2CircleShape circle;
+		circle.m_radius = 0.4f;
+		b2PolygonShape box;
+		box.SetAsBox(0.35f, 0.35f);
+
+		// A sensor that the bodies fall through.
+		b2FixtureDef sensorDef;
+		b2PolygonShape sensorShape;
+		sensorShape.SetAsBox(9.0f, 1.0f, b2Vec2(0.0f, 6.0f), 0.0f);
+		sensorDef.shape = &sensorShape;
+		sensorDef.isSensor = true;
+		ground->CreateFixture(&sensorDef);
+
+		for (int32 i = 0; i < 200; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-8.0f + 0.9f * (i % 18), 2.0f + 0.9f * (i / 18));
+			bd.userData.pointer = uintptr_t(i + 1);
+			b2Body* body = world->CreateBody(&bd);
+			if (i % 2 == 0)
+			{
+				body->CreateFixture(&circle, 1.0f);
+			}
+			else
+			{
+				body->CreateFixture(&box, 1.0f);
+			}
+		}
+	}
+
+	for (int32 i = 0; i < 90; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(serialWorld.GetContactCount() > b2_minTaskRange);
+	CHECK(serialWorld.GetContactCount() == parallelWorld.GetContactCount());
+	CHECK(serialListener.count > 0);
+	CHECK(serialListener.count == parallelListener.count);
+	CHECK(serialListener.hash == parallelListener.hash);
+
+	const b2Body* serialBody = serialWorld.GetBodyList();
+	const b2Body* parallelBody = parallelWorld.GetBodyList();
+	bool samePositions = true;
+	while (serialBody != nullptr && parallelBody != nullptr)
+	{
+		samePositions = samePositions && serialBody->GetPosition() == parallelBody->GetPosition();
+		serialBody = serialBody->GetNext();
+		parallelBody = parallelBody->GetNext();
+	}
+	CHECK(samePositions);
+}
+
+// Hashes the contact list, which is in the order the broad-phase created the pairs.
+static uint32 HashContactList(const b2World& world)
+{
+	uint32 hash = 0;
+	for (const b2Contact* c = world.GetContactList(); c != nullptr; c = c->GetNext())
+	{
+		hash = 31 * hash + uint32(c->GetFixtureA()->GetBody()->GetUserData().pointer);
+		hash = 31 * hash + uint32(c->GetFixtureB()->GetBody()->GetUserData().pointer);
+	}
+	return hash;
+}
+
+DOCTEST_TEST_CASE("parallel pairs")
+{
+	ReverseTaskScheduler scheduler;
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f), &scheduler);
+
+	b2World* worlds[2] = { &serialWorld, &parallelWorld };
+	for (int32 w = 0; w < 2; ++w)
+	{
+		b2World* world = worlds[w];
+
+		b2BodyDef groundDef;
+		b2Body* ground = world->CreateBody(&groundDef);
+		b2EdgeShape edge;
+		edge.SetTwoSided(b2Vec2(-12.0f, 0.0f), b2Vec2(12.0f, 0.0f));
+		ground->CreateFixture(&edge, 0.0f);
+
+		// Enough moving proxies for the pair queries to span several task ranges.
+		b2CircleShape circle;
+		circle.m_radius = 0.3f;
+		for (int32 i = 0; i < 5 * b2_minTaskRange; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-10.0f + 0.7f * (i % 30), 1.0f + 0.7f * (i / 30));
+			bd.userData.pointer = uintptr_t(i + 1);
+			b2Body* body = world->CreateBody(&bd);
+			body->CreateFixture(&circle, 1.0f);
+		}
+	}
+
+	// The pairs are created in the same order on every step.
+	bool sameOrder = true;
+	for (int32 i = 0; i < 90; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+		sameOrder = sameOrder && serialWorld.GetContactCount() == parallelWorld.GetContactCount();
+		sameOrder = sameOrder && HashContactList(serialWorld) == HashContactList(parallelWorld);
+	}
+
+	CHECK(serialWorld.GetContactCount() > b2_minTaskRange);
+	CHECK(sameOrder);
+	CHECK(serialWorld.ComputeStateHash() == parallelWorld.ComputeStateHash());
+}
+
+struct PairCounter
+{
+	void AddPair(void* userDataA, void* userDataB)
+	{
+		B2_NOT_USED(userDataA);
+		B2_NOT_USED(userDataB);
+		++count;
+	}
+
+	int32 count = 0;
+};
+
+DOCTEST_TEST_CASE("pair query count")
+{
+	ReverseTaskScheduler scheduler;
+	b2TaskScheduler* schedulers[2] = { nullptr, &scheduler };
+	for (int32 s = 0; s < 2; ++s)
+	{
+		// Proxies destroyed before UpdatePairs leave null entries in the move buffer,
+		// which are not queried.
+		b2BroadPhase broadPhase;
+		const int32 count = 4 * b2_minTaskRange;
+		int32 proxies[count];
+		for (int32 i = 0; i < count; ++i)
+		{
+			b2AABB aabb;
+			aabb.lowerBound.Set(2.0f * float(i), 0.0f);
+			aabb.upperBound.Set(2.0f * float(i) + 1.0f, 1.0f);
+			proxies[i] = broadPhase.CreateProxy(aabb, nullptr);
+		}
+
+		for (int32 i = 0; i < count; i += 2)
+		{
+			broadPhase.DestroyProxy(proxies[i]);
+		}
+
+		PairCounter counter;
+		broadPhase.UpdatePairs(&counter, schedulers[s]);
+		CHECK(counter.count == 0);
+		CHECK(broadPhase.GetPairQueryCount() == count / 2);
+	}
+}
+
+DOCTEST_TEST_CASE("destroy body keeps state")
+{
+	b2World world(b2Vec2(0.0f, 0.0f));
+
+	b2Body* bodies[20];
+	for (int32 i = 0; i < 20; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(float(i), 2.0f * i);
+		bd.angle = 0.1f * i;
+		bd.linearVelocity.Set(-float(i), 1.0f);
+		bd.angularVelocity = 0.5f * i;
+		bodies[i] = world.CreateBody(&bd);
+	}
+
+	// Destroying bodies moves the state of other bodies in the solver arrays.
+	for (int32 i = 0; i < 20; i += 3)
+	{
+		world.DestroyBody(bodies[i]);
+		bodies[i] = nullptr;
+	}
+
+	for (int32 i = 0; i < 20; ++i)
+	{
+		if (bodies[i] == nullptr)
+		{
+			continue;
+		}
+
+		CHECK(bodies[i]->GetPosition() == b2Vec2(float(i), 2.0f * i));
+		CHECK(bodies[i]->GetAngle() == 0.1f * i);
+		CHECK(bodies[i]->GetLinearVelocity() == b2Vec2(-float(i), 1.0f));
+		CHECK(bodies[i]->GetAngularVelocity() == 0.5f * i);
+	}
+
+	float h = 0.1f;
+	world.Step(h, 1, 1);
+
+	for (int32 i = 0; i < 20; ++i)
+	{
+		if (bodies[i] == nullptr)
+		{
+			continue;
+		}
+
+		CHECK(bodies[i]->GetWorldCenter() == b2Vec2(float(i) + h * -float(i), 2.0f * i + h * 1.0f));
+		CHECK(bodies[i]->GetAngle() == 0.1f * i + h * (0.5f * i));
+	}
+}
+
+static b2Body* BuildPyramid(b2World* world, int32 rows)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+
+	b2Body* top = nullptr;
+	b2Vec2 x(-7.0f, 0.75f);
+	for (int32 i = 0; i < rows; ++i)
+	{
+		b2Vec2 y = x;
+		for (int32 j = i; j < rows; ++j)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position = y;
+			top = world->CreateBody(&bd);
+			top->CreateFixture(&box, 5.0f);
+			y += b2Vec2(1.125f, 0.0f);
+		}
+		x += b2Vec2(0.5625f, 1.25f);
+	}
+
+	return top;
+}
+
+DOCTEST_TEST_CASE("wide contact solver")
+{
+	b2World scalarWorld(b2Vec2(0.0f, -10.0f));
+	b2Body* scalarTop = BuildPyramid(&scalarWorld, 12);
+
+	b2World wideWorld(b2Vec2(0.0f, -10.0f));
+	wideWorld.SetWideSolver(true);
+	ImpulseListener wideListener;
+	wideWorld.SetContactListener(&wideListener);
+	b2Body* wideTop = BuildPyramid(&wideWorld, 12);
+
+	for (int32 i = 0; i < 300; ++i)
+	{
+		scalarWorld.Step(1.0f / 60.0f, 8, 3);
+		wideWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	// The wide solver visits the constraints in a different order, so the results are
+	// close to the default solver but not identical. The pyramid must still come to rest.
+	CHECK(b2Distance(scalarTop->GetPosition(), wideTop->GetPosition()) < 0.05f);
+
+	bool asleep = true;
+	for (const b2Body* body = wideWorld.GetBodyList(); body != nullptr; body = body->GetNext())
+	{
+		asleep = asleep && body->IsAwake() == false;
+	}
+	CHECK(asleep);
+
+	// Impulses are copied back to the constraints before they are reported.
+	REQUIRE(wideListener.count > 0);
+	bool positiveImpulse = false;
+	for (int32 i = 0; i < b2Min(wideListener.count, 4096); ++i)
+	{
+		positiveImpulse = positiveImpulse || wideListener.impulses[i] > 0.0f;
+	}
+	CHECK(positiveImpulse);
+}
+
+// A large pyramid with a chain hanging from the top box, so the island has joints.
+static void BuildColoredScene(b2World* world)
+{
+	b2Body* prev = BuildPyramid(world, 20);
+	b2Vec2 anchor = prev->GetPosition();
+
+	b2PolygonShape link;
+	link.SetAsBox(0.25f, 0.05f);
+
+	for (int32 i = 0; i < 10; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position = anchor + b2Vec2(0.5f * i + 0.75f, 0.0f);
+		b2Body* body = world->CreateBody(&bd);
+		body->CreateFixture(&link, 1.0f);
+
+		b2RevoluteJointDef jd;
+		jd.Initialize(prev, body, bd.position - b2Vec2(0.25f, 0.0f));
+		world->CreateJoint(&jd);
+		prev = body;
+	}
+}
+
+DOCTEST_TEST_CASE("graph coloring")
+{
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	serialWorld.SetGraphColoring(true);
+	BuildColoredScene(&serialWorld);
+
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f));
+	ReverseTaskScheduler scheduler;
+	parallelWorld.SetTaskScheduler(&scheduler);
+	parallelWorld.SetGraphColoring(true);
+	ImpulseListener parallelListener;
+	parallelWorld.SetContactListener(&parallelListener);
+	BuildColoredScene(&parallelWorld);
+
+	for (int32 i = 0; i < 120; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(scheduler.taskCount > 0);
+	CHECK(parallelListener.count > 0);
+
+	// The colors are solved in the same order for any number of workers.
+	bool sameState = true;
+	bool standing = true;
+	const b2Body* serialBody = serialWorld.GetBodyList();
+	const b2Body* parallelBody = parallelWorld.GetBodyList();
+	while (serialBody != nullptr && parallelBody != nullptr)
+	{
+		sameState = sameState && serialBody->GetPosition() == parallelBody->GetPosition();
+		sameState = sameState && serialBody->GetAngle() == parallelBody->GetAngle();
+		sameState = sameState && serialBody->GetLinearVelocity() == parallelBody->GetLinearVelocity();
+
+		// The boxes of the pyramid stay above the ground.
+		standing = standing && serialBody->GetPosition().y >= 0.0f;
+		serialBody = serialBody->GetNext();
+		parallelBody = parallelBody->GetNext();
+	}
+	CHECK(serialBody == parallelBody);
+	CHECK(sameState);
+	CHECK(standing);
+}
+
+DOCTEST_TEST_CASE("contact list after destroy")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	b2Body* top = BuildPyramid(&world, 10);
+
+	for (int32 i = 0; i < 30; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	// Destroying a body removes its contacts from the middle of the contact array.
+	world.DestroyBody(top);
+	b2Body* body = world.GetBodyList();
+	for (int32 i = 0; body != nullptr; ++i)
+	{
+		b2Body* next = body->GetNext();
+		if (i % 4 == 1 && body->GetType() == b2_dynamicBody)
+		{
+			world.DestroyBody(body);
+		}
+		body = next;
+	}
+
+	world.Step(1.0f / 60.0f, 8, 3);
+
+	int32 count = 0;
+	for (b2Contact* c = world.GetContactList(); c; c = c->GetNext())
+	{
+		b2Body* bodyA = c->GetFixtureA()->GetBody();
+		b2Body* bodyB = c->GetFixtureB()->GetBody();
+
+		bool found = false;
+		for (b2ContactEdge* ce = bodyA->GetContactList(); ce; ce = ce->next)
+		{
+			if (ce->contact == c)
+			{
+				found = true;
+				CHECK(ce->other == bodyB);
+			}
+		}
+		CHECK(found);
+
+		++count;
+	}
+
+	CHECK(count > 0);
+	CHECK(count == world.GetContactCount());
+}
+
+DOCTEST_TEST_CASE("state hash")
+{
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	serialWorld.SetWideSolver(true);
+	BuildPiles(&serialWorld);
+
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f));
+	ReverseTaskScheduler scheduler;
+	parallelWorld.SetTaskScheduler(&scheduler);
+	parallelWorld.SetWideSolver(true);
+	BuildPiles(&parallelWorld);
+
+	CHECK(serialWorld.ComputeStateHash() == parallelWorld.ComputeStateHash());
+
+	bool sameHash = true;
+	uint64 hash = serialWorld.ComputeStateHash();
+	for (int32 i = 0; i < 60; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+		sameHash = sameHash && serialWorld.ComputeStateHash() == parallelWorld.ComputeStateHash();
+	}
+	CHECK(sameHash);
+	CHECK(serialWorld.ComputeStateHash() != hash);
+
+	// The wide solver visits the contacts in a different order than the default solver.
+	b2World defaultWorld(b2Vec2(0.0f, -10.0f));
+	BuildPiles(&defaultWorld);
+	for (int32 i = 0; i < 60; ++i)
+	{
+		defaultWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+	CHECK(defaultWorld.ComputeStateHash() != serialWorld.ComputeStateHash());
+
+	// Any change to the state changes the hash.
+	b2Body* body = parallelWorld.GetBodyList();
+	body->SetAngularVelocity(body->GetAngularVelocity() + 1.0f);
+	CHECK(parallelWorld.ComputeStateHash() != serialWorld.ComputeStateHash());
+}
+
+DOCTEST_TEST_CASE("soft step")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetSoftStep(true);
+
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	// A tall stack held with four sub-steps.
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	b2Body* top = nullptr;
+	for (int32 i = 0; i < 25; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(0.0f, 0.5f + 1.0f * i);
+		top = world.CreateBody(&bd);
+		top->CreateFixture(&box, 1.0f)->SetFriction(0.6f);
+	}
+
+	// A pendulum away from the stack exercises the joints.
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position.Set(20.0f, 10.0f);
+	b2Body* bob = world.CreateBody(&bd);
+	bob->CreateFixture(&box, 1.0f);
+
+	b2RevoluteJointDef jd;
+	jd.Initialize(ground, bob, b2Vec2(15.0f, 10.0f));
+	b2Joint* joint = world.CreateJoint(&jd);
+
+	for (int32 i = 0; i < 1800; ++i)
+	{
+		world.Step(1.0f / 60.0f, 4, 3);
+	}
+
+	CHECK(b2Abs(top->GetPosition().x) < 0.05f);
+	CHECK(top->GetPosition().y > 24.0f);
+	CHECK(top->IsAwake() == false);
+	CHECK(b2Distance(joint->GetAnchorA(), joint->GetAnchorB()) < 0.01f);
+}
+
+class CountQueryCallback : public b2QueryCallback
+{
+public:
+	bool ReportFixture(b2Fixture* fixture)
+	{
+		B2_NOT_USED(fixture);
+		++m_count;
+		return true;
+	}
+
+	int32 m_count = 0;
+};
+
+static void CreateBulkScene(b2World* world, bool bulkLoad)
+{
+	if (bulkLoad)
+	{
+		world->BeginBulkLoad();
+	}
+
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	// A field of posts with a box resting on each.
+	b2PolygonShape post;
+	b2PolygonShape box;
+	box.SetAsBox(0.25f, 0.25f);
+	for (int32 i = 0; i < 20; ++i)
+	{
+		for (int32 j = 0; j < 20; ++j)
+		{
+			b2Vec2 center(2.0f * i, 2.0f * j);
+			post.SetAsBox(0.5f, 0.1f, center, 0.0f);
+			ground->CreateFixture(&post, 0.0f);
+
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position = center + b2Vec2(0.0f, 0.35f);
+			world->CreateBody(&bd)->CreateFixture(&box, 1.0f);
+		}
+	}
+
+	if (bulkLoad)
+	{
+		world->EndBulkLoad();
+	}
+}
+
+DOCTEST_TEST_CASE("bulk load")
+{
+	b2World world(b2Vec2(0.0f, 0.0f));
+	CreateBulkScene(&world, false);
+
+	b2World bulkWorld(b2Vec2(0.0f, 0.0f));
+	CreateBulkScene(&bulkWorld, true);
+
+	CHECK(bulkWorld.GetProxyCount() == world.GetProxyCount());
+	CHECK(bulkWorld.GetTreeQuality() < world.GetTreeQuality());
+
+	b2AABB aabb;
+	aabb.lowerBound.Set(3.0f, 3.0f);
+	aabb.upperBound.Set(9.0f, 9.0f);
+
+	CountQueryCallback callback;
+	world.QueryAABB(&callback, aabb);
+
+	CountQueryCallback bulkCallback;
+	bulkWorld.QueryAABB(&bulkCallback, aabb);
+
+	CHECK(bulkCallback.m_count > 0);
+	CHECK(bulkCallback.m_count == callback.m_count);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+	bulkWorld.Step(1.0f / 60.0f, 8, 3);
+	CHECK(bulkWorld.GetContactCount() == world.GetContactCount());
+	CHECK(bulkWorld.GetContactCount() == 400);
+}
+
+class ClosestRayCastCallback : public b2RayCastCallback
+{
+public:
+	float ReportFixture(b2Fixture* fixture, const b2Vec2& point, const b2Vec2& normal, float fraction) override
+	{
+		B2_NOT_USED(point);
+		B2_NOT_USED(normal);
+		m_fixture = fixture;
+		m_fraction = fraction;
+		return fraction;
+	}
+
+	b2Fixture* m_fixture = nullptr;
+	float m_fraction = 1.0f;
+};
+
+// Finds the tree of the proxy of a fixture.
+class ProxyQueryCallback
+{
+public:
+	bool QueryCallback(int32 proxyId)
+	{
+		b2FixtureProxy* proxy = (b2FixtureProxy*)m_broadPhase->GetUserData(proxyId);
+		if (proxy->fixture == m_fixture)
+		{
+			m_isStatic = m_broadPhase->IsStaticProxy(proxyId);
+		}
+		return true;
+	}
+
+	const b2BroadPhase* m_broadPhase;
+	b2Fixture* m_fixture;
+	bool m_isStatic;
+};
+
+static bool IsStaticProxy(const b2BroadPhase& broadPhase, b2Fixture* fixture)
+{
+	ProxyQueryCallback callback;
+	callback.m_broadPhase = &broadPhase;
+	callback.m_fixture = fixture;
+	callback.m_isStatic = false;
+	broadPhase.Query(&callback, fixture->GetAABB(0));
+	return callback.m_isStatic;
+}
+
+DOCTEST_TEST_CASE("static tree")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	const b2BroadPhase& broadPhase = world.GetContactManager().m_broadPhase;
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position.Set(0.0f, 2.0f);
+	b2Body* body = world.CreateBody(&bd);
+	b2PolygonShape box;
+	box.SetAsBox(0.5f, 0.5f);
+	b2Fixture* boxFixture = body->CreateFixture(&box, 1.0f);
+
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-10.0f, 0.0f), b2Vec2(10.0f, 0.0f));
+	b2Fixture* groundFixture = ground->CreateFixture(&edge, 0.0f);
+
+	CHECK(IsStaticProxy(broadPhase, groundFixture));
+	CHECK(IsStaticProxy(broadPhase, boxFixture) == false);
+
+	// Queries and ray casts see both trees. The ray is clipped by the closest hit.
+	ClosestRayCastCallback callback;
+	world.RayCast(&callback, b2Vec2(0.0f, 5.0f), b2Vec2(0.0f, -5.0f));
+	CHECK(callback.m_fixture == boxFixture);
+
+	CountQueryCallback queryCallback;
+	b2AABB aabb;
+	aabb.lowerBound.Set(-1.0f, -1.0f);
+	aabb.upperBound.Set(1.0f, 3.0f);
+	world.QueryAABB(&queryCallback, aabb);
+	CHECK(queryCallback.m_count == 2);
+
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	CHECK(world.GetContactCount() == 1);
+	CHECK(b2Abs(body->GetPosition().y - 0.5f) < 0.02f);
+
+	// A body that becomes static moves to the static tree and keeps no contact with the
+	// ground.
+	body->SetType(b2_staticBody);
+	CHECK(IsStaticProxy(broadPhase, boxFixture));
+	world.Step(1.0f / 60.0f, 8, 3);
+	CHECK(world.GetContactCount() == 0);
+
+	body->SetType(b2_dynamicBody);
+	CHECK(IsStaticProxy(broadPhase, boxFixture) == false);
+	world.Step(1.0f / 60.0f, 8, 3);
+	CHECK(world.GetContactCount() == 1);
+
+	// A moved static proxy is updated in place and found at once, before and after the
+	// next step.
+	ground->SetTransform(b2Vec2(30.0f, 0.0f), 0.0f);
+	aabb.lowerBound.Set(29.0f, -1.0f);
+	aabb.upperBound.Set(31.0f, 1.0f);
+	queryCallback.m_count = 0;
+	world.QueryAABB(&queryCallback, aabb);
+	CHECK(queryCallback.m_count == 1);
+
+	world.Step(1.0f / 60.0f, 8, 3);
+	queryCallback.m_count = 0;
+	world.QueryAABB(&queryCallback, aabb);
+	CHECK(queryCallback.m_count == 1);
+}
+
+// Boxes bouncing around a closed room without gravity, so the tree keeps changing.
+static void CreateRoom(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+	// Clockwise, so the one-sided walls face into the room.
+	b2Vec2 corners[4] = { b2Vec2(-10.0f, -10.0f), b2Vec2(-10.0f, 10.0f), b2Vec2(10.0f, 10.0f), b2Vec2(10.0f, -10.0f) };
+	b2ChainShape chain;
+	chain.CreateLoop(corners, 4);
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2PolygonShape box;
+	box.SetAsBox(0.2f, 0.2f);
+	b2FixtureDef fd;
+	fd.shape = &box;
+	fd.density = 1.0f;
+	fd.friction = 0.0f;
+	fd.restitution = 1.0f;
+
+	uint32 seed = 12345;
+	for (int32 i = 0; i < 400; ++i)
+	{
+		seed = 1664525 * seed + 1013904223;
+		float angle = (seed >> 8) * (2.0f * b2_pi / 16777216.0f);
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-9.0f + 0.9f * (i % 20), -9.0f + 0.9f * (i / 20));
+		bd.linearVelocity.Set(8.0f * cosf(angle), 8.0f * sinf(angle));
+		world->CreateBody(&bd)->CreateFixture(&fd);
+	}
+}
+
+DOCTEST_TEST_CASE("tree rebuild")
+{
+	b2ThreadPool pool(4);
+	b2World serialWorld(b2Vec2(0.0f, 0.0f));
+	b2World pooledWorld(b2Vec2(0.0f, 0.0f), &pool);
+	b2World fixedWorld(b2Vec2(0.0f, 0.0f));
+	fixedWorld.SetTreeRebuildThreshold(0.0f);
+
+	b2World* worlds[3] = { &serialWorld, &pooledWorld, &fixedWorld };
+	for (int32 i = 0; i < 3; ++i)
+	{
+		CreateRoom(worlds[i]);
+	}
+
+	// The tree is rebuilt in the background on the pool, so it may still be building
+	// when bodies are destroyed. The results must not depend on that.
+	bool sameHash = true;
+	for (int32 i = 0; i < 180; ++i)
+	{
+		for (int32 j = 0; j < 3; ++j)
+		{
+			if (i % 30 == 15)
+			{
+				worlds[j]->DestroyBody(worlds[j]->GetBodyList());
+			}
+
+			worlds[j]->Step(1.0f / 60.0f, 8, 3);
+		}
+
+		sameHash = sameHash && serialWorld.ComputeStateHash() == pooledWorld.ComputeStateHash();
+	}
+
+	CHECK(sameHash);
+
+	// A rebuild changes the order of the pairs and so the results.
+	CHECK(serialWorld.ComputeStateHash() != fixedWorld.ComputeStateHash());
+}
+
+DOCTEST_TEST_CASE("ray cast batch")
+{
+	b2ThreadPool pool(4);
+	b2World world(b2Vec2(0.0f, 0.0f), &pool);
+	CreateRoom(&world);
+	for (int32 i = 0; i < 30; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	// Only the walls are in category two.
+	b2Body* ground = world.GetBodyList();
+	while (ground->GetType() != b2_staticBody)
+	{
+		ground = ground->GetNext();
+	}
+	b2Fixture* wall = ground->GetFixtureList();
+	b2Filter filter = wall->GetFilterData();
+	filter.categoryBits = 0x0002;
+	wall->SetFilterData(filter);
+
+	// Fans of rays from a few points, with one zero length ray.
+	const int32 rayCount = 301;
+	b2BatchRay rays[rayCount];
+	for (int32 i = 0; i < rayCount; ++i)
+	{
+		b2Vec2 origin(-6.0f + 4.0f * (i / 60), 1.5f * ((i / 60) % 2));
+		float angle = i * (2.0f * b2_pi / 60.0f);
+		rays[i].p1 = origin;
+		rays[i].p2 = origin + b2Vec2(25.0f * cosf(angle), 25.0f * sinf(angle));
+		rays[i].maskBits = i % 3 == 0 ? 0x0002 : 0xFFFF;
+	}
+	rays[rayCount - 1].p2 = rays[rayCount - 1].p1;
+
+	b2BatchRayHit serialHits[rayCount];
+	b2BatchRayHit parallelHits[rayCount];
+	world.RayCastBatch(rays, rayCount, serialHits, false);
+	world.RayCastBatch(rays, rayCount, parallelHits, true);
+
+	bool sameHits = true;
+	bool sameParallelHits = true;
+	for (int32 i = 0; i < rayCount - 1; ++i)
+	{
+		const b2BatchRayHit& hit = serialHits[i];
+		sameParallelHits = sameParallelHits && parallelHits[i].fixture == hit.fixture && parallelHits[i].fraction == hit.fraction;
+
+		if (rays[i].maskBits == 0x0002)
+		{
+			// The walls enclose every ray.
+			sameHits = sameHits && hit.fixture == wall;
+			continue;
+		}
+
+		ClosestRayCastCallback callback;
+		world.RayCast(&callback, rays[i].p1, rays[i].p2);
+		sameHits = sameHits && hit.fixture == callback.m_fixture && hit.fraction == doctest::Approx(callback.m_fraction);
+	}
+
+	CHECK(sameHits);
+	CHECK(sameParallelHits);
+	CHECK(serialHits[rayCount - 1].fixture == nullptr);
+}
+
+DOCTEST_TEST_CASE("concurrent queries")
+{
+	b2ThreadPool pool(4);
+	b2World world(b2Vec2(0.0f, -10.0f), &pool);
+	CreateBulkScene(&world, true);
+	world.Step(1.0f / 60.0f, 8, 3);
+
+	const int32 queryCount = 200;
+	const int32 capacity = 8;
+	b2AABB aabbs[queryCount];
+	b2BatchShapeQuery shapeQueries[queryCount];
+	b2CircleShape circle;
+	circle.m_radius = 0.5f;
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		b2Vec2 center(0.19f * i, 0.37f * (i % 100));
+		aabbs[i].lowerBound = center - b2Vec2(0.5f, 0.5f);
+		aabbs[i].upperBound = center + b2Vec2(0.5f, 0.5f);
+
+		shapeQueries[i].shape = &circle;
+		shapeQueries[i].transform.Set(center, 0.0f);
+		shapeQueries[i].maskBits = 0xFFFF;
+	}
+
+	// Gameplay threads querying the world at the same time each get the results of a
+	// lone query.
+	int32 expected[queryCount];
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		CountQueryCallback callback;
+		world.QueryAABB(&callback, aabbs[i]);
+		expected[i] = callback.m_count;
+	}
+
+	const int32 threadCount = 4;
+	bool sameCounts[threadCount];
+	std::thread threads[threadCount];
+	for (int32 t = 0; t < threadCount; ++t)
+	{
+		bool* same = sameCounts + t;
+		threads[t] = std::thread([&world, &aabbs, &expected, same]()
+		{
+			*same = true;
+			for (int32 i = 0; i < queryCount; ++i)
+			{
+				CountQueryCallback callback;
+				world.QueryAABB(&callback, aabbs[i]);
+				*same = *same && callback.m_count == expected[i];
+
+				ClosestRayCastCallback rayCallback;
+				world.RayCast(&rayCallback, aabbs[i].lowerBound, aabbs[i].upperBound);
+			}
+		});
+	}
+
+	for (int32 t = 0; t < threadCount; ++t)
+	{
+		threads[t].join();
+		CHECK(sameCounts[t]);
+	}
+
+	// The batches store the same fixtures serially and in parallel.
+	b2Fixture* serialFixtures[queryCount * capacity];
+	b2Fixture* parallelFixtures[queryCount * capacity];
+	int32 serialCounts[queryCount];
+	int32 parallelCounts[queryCount];
+	world.QueryAABBBatch(aabbs, queryCount, serialFixtures, capacity, serialCounts, false);
+	world.QueryAABBBatch(aabbs, queryCount, parallelFixtures, capacity, parallelCounts, true);
+
+	bool sameBatch = true;
+	int32 found = 0;
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		sameBatch = sameBatch && serialCounts[i] == expected[i] && parallelCounts[i] == expected[i];
+		for (int32 j = 0; j < b2Min(expected[i], capacity); ++j)
+		{
+			sameBatch = sameBatch && serialFixtures[i * capacity + j] == parallelFixtures[i * capacity + j];
+		}
+		found += expected[i];
+	}
+
+	CHECK(found > 0);
+	CHECK(sameBatch);
+
+	// The circles fit in the query boxes, so the exact overlap finds fewer fixtures.
+	world.OverlapShapeBatch(shapeQueries, queryCount, serialFixtures, capacity, serialCounts, false);
+	world.OverlapShapeBatch(shapeQueries, queryCount, parallelFixtures, capacity, parallelCounts, true);
+
+	bool overlaps = true;
+	bool sameOverlaps = true;
+	int32 overlapCount = 0;
+	for (int32 i = 0; i < queryCount; ++i)
+	{
+		sameOverlaps = sameOverlaps && serialCounts[i] == parallelCounts[i];
+		for (int32 j = 0; j < b2Min(serialCounts[i], capacity); ++j)
+		{
+			b2Fixture* fixture = serialFixtures[i * capacity + j];
+			overlaps = overlaps && b2TestOverlap(&circle, 0, fixture->GetShape(), 0, shapeQueries[i].transform, fixture->GetBody()->GetTransform());
+		}
+		overlapCount += serialCounts[i];
+	}
+
+	CHECK(overlaps);
+	CHECK(sameOverlaps);
+	CHECK(0 < overlapCount);
+	CHECK(overlapCount < found);
+
+	// The mask filters the fixtures.
+	shapeQueries[0].maskBits = 0;
+	world.OverlapShapeBatch(shapeQueries, 1, serialFixtures, capacity, serialCounts, false);
+	CHECK(serialCounts[0] == 0);
+}
+
+DOCTEST_TEST_CASE("broad-phase types")
+{
+	b2ThreadPool pool(4);
+	b2BroadPhaseDef defs[3];
+	defs[0].type = b2_treeBroadPhase;
+	defs[1].type = b2_gridBroadPhase;
+	defs[1].cellSize = 0.5f;
+	defs[2].type = b2_sweepBroadPhase;
+
+	int32 queryCounts[3];
+	float fractions[3];
+	int32 contactCounts[3];
+	bool sameHash[3];
+	for (int32 i = 0; i < 3; ++i)
+	{
+		b2World world(b2Vec2(0.0f, 0.0f), nullptr, defs[i]);
+		b2World pooledWorld(b2Vec2(0.0f, 0.0f), &pool, defs[i]);
+		CreateRoom(&world);
+		CreateRoom(&pooledWorld);
+
+		b2AABB aabb;
+		aabb.lowerBound.Set(-5.0f, -5.0f);
+		aabb.upperBound.Set(3.0f, 2.0f);
+		CountQueryCallback queryCallback;
+		world.QueryAABB(&queryCallback, aabb);
+		queryCounts[i] = queryCallback.m_count;
+
+		ClosestRayCastCallback rayCallback;
+		world.RayCast(&rayCallback, b2Vec2(-9.5f, -9.9f), b2Vec2(9.0f, 9.7f));
+		fractions[i] = rayCallback.m_fraction;
+
+		world.Step(1.0f / 60.0f, 8, 3);
+		contactCounts[i] = world.GetContactCount();
+
+		// The pair order depends on the structure, but not on the scheduler.
+		sameHash[i] = true;
+		pooledWorld.Step(1.0f / 60.0f, 8, 3);
+		for (int32 j = 0; j < 120; ++j)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+			pooledWorld.Step(1.0f / 60.0f, 8, 3);
+			sameHash[i] = sameHash[i] && world.ComputeStateHash() == pooledWorld.ComputeStateHash();
+		}
+
+		// No box escaped the room.
+		bool inside = true;
+		for (b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+		{
+			b2Vec2 p = body->GetPosition();
+			inside = inside && b2Abs(p.x) < 10.0f && b2Abs(p.y) < 10.0f;
+		}
+		CHECK(inside);
+	}
+
+	CHECK(queryCounts[0] > 0);
+	CHECK(queryCounts[1] == queryCounts[0]);
+	CHECK(queryCounts[2] == queryCounts[0]);
+	CHECK(fractions[0] < 1.0f);
+	CHECK(fractions[1] == fractions[0]);
+	CHECK(fractions[2] == fractions[0]);
+	CHECK(contactCounts[1] == contactCounts[0]);
+	CHECK(contactCounts[2] == contactCounts[0]);
+	CHECK(sameHash[0]);
+	CHECK(sameHash[1]);
+	CHECK(sameHash[2]);
+}
+
+DOCTEST_TEST_CASE("static tree copies")
+{
+	// The static tree itself, the wide copy, and the compact copy.
+	int32 queryCounts[3];
+	float fractions[3];
+	int32 contactCounts[3];
+	for (int32 i = 0; i < 3; ++i)
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		world.SetWideTree(i == 1);
+		world.SetCompactTree(i == 2);
+
+		// A floor of static tiles with circles dropped on it.
+		b2BodyDef groundDef;
+		b2Body* ground = world.CreateBody(&groundDef);
+		for (int32 j = 0; j < 400; ++j)
+		{
+			b2PolygonShape tile;
+			tile.SetAsBox(0.5f, 0.5f, b2Vec2(-100.0f + float(j % 200), -1.0f - float(j / 200)), 0.0f);
+			ground->CreateFixture(&tile, 0.0f);
+		}
+
+		for (int32 j = 0; j < 100; ++j)
+		{
+			b2BodyDef bodyDef;
+			bodyDef.type = b2_dynamicBody;
+			bodyDef.position.Set(-90.0f + 1.8f * float(j), 1.0f + 0.1f * float(j % 7));
+			b2Body* body = world.CreateBody(&bodyDef);
+			b2CircleShape circle;
+			circle.m_radius = 0.4f;
+			body->CreateFixture(&circle, 1.0f);
+		}
+
+		for (int32 j = 0; j < 60; ++j)
+		{
+			world.Step(1.0f / 60.0f, 8, 3);
+		}
+		contactCounts[i] = world.GetContactCount();
+
+		b2AABB aabb;
+		aabb.lowerBound.Set(-20.0f, -3.0f);
+		aabb.upperBound.Set(15.0f, 2.0f);
+		CountQueryCallback queryCallback;
+		world.QueryAABB(&queryCallback, aabb);
+		queryCounts[i] = queryCallback.m_count;
+
+		ClosestRayCastCallback rayCallback;
+		world.RayCast(&rayCallback, b2Vec2(-50.3f, 10.0f), b2Vec2(-40.1f, -5.0f));
+		fractions[i] = rayCallback.m_fraction;
+	}
+
+	CHECK(contactCounts[0] > 0);
+	CHECK(contactCounts[1] == contactCounts[0]);
+	CHECK(contactCounts[2] == contactCounts[0]);
+	CHECK(queryCounts[0] > 0);
+	CHECK(queryCounts[1] == queryCounts[0]);
+	CHECK(queryCounts[2] == queryCounts[0]);
+	CHECK(fractions[0] < 1.0f);
+	CHECK(fractions[1] == fractions[0]);
+	CHECK(fractions[2] == fractions[0]);
+}
+
+DOCTEST_TEST_CASE("contacts of a busy body")
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+
+	// One ground body touches every circle.
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+	for (int32 i = 0; i < 100; ++i)
+	{
+		b2PolygonShape tile;
+		tile.SetAsBox(0.5f, 0.5f, b2Vec2(-50.0f + float(i), 0.0f), 0.0f);
+		ground->CreateFixture(&tile, 0.0f);
+	}
+
+	b2Body* bodies[300];
+	for (int32 i = 0; i < 300; ++i)
+	{
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(-49.5f + 0.33f * float(i), 1.0f + 0.8f * float(i % 3));
+		bodies[i] = world.CreateBody(&bodyDef);
+		b2CircleShape circle;
+		circle.m_radius = 0.3f;
+		bodies[i]->CreateFixture(&circle, 1.0f);
+	}
+
+	// Contacts come and go as bodies are destroyed while the pile settles.
+	for (int32 i = 0; i < 120; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+		if (i % 10 == 5)
+		{
+			int32 index = (37 * i) % 300;
+			if (bodies[index] != nullptr)
+			{
+				world.DestroyBody(bodies[index]);
+				bodies[index] = nullptr;
+			}
+		}
+	}
+
+	int32 groundCount = 0;
+	for (b2ContactEdge* ce = ground->GetContactList(); ce; ce = ce->next)
+	{
+		++groundCount;
+	}
+	CHECK(groundCount > 100);
+
+	// Each pair of fixture children has at most one contact.
+	bool unique = true;
+	int32 count = 0;
+	for (b2Contact* c = world.GetContactList(); c; c = c->GetNext())
+	{
+		for (b2Contact* d = c->GetNext(); d; d = d->GetNext())
+		{
+			bool same = c->GetFixtureA() == d->GetFixtureA() && c->GetFixtureB() == d->GetFixtureB() &&
+				c->GetChildIndexA() == d->GetChildIndexA() && c->GetChildIndexB() == d->GetChildIndexB();
+			bool swapped = c->GetFixtureA() == d->GetFixtureB() && c->GetFixtureB() == d->GetFixtureA() &&
+				c->GetChildIndexA() == d->GetChildIndexB() && c->GetChildIndexB() == d->GetChildIndexA();
+			unique = unique && same == false && swapped == false;
+		}
+		++count;
+	}
+
+	CHECK(unique);
+	CHECK(count == world.GetContactCount());
+}
+
+static int32 RunPile(bool adaptive, int32* touchingCount)
+{
+	b2World world(b2Vec2(0.0f, -10.0f));
+	world.SetAdaptiveMargins(adaptive);
+	CHECK(world.GetAdaptiveMargins() == adaptive);
+
+	b2BodyDef groundDef;
+	b2Body* ground = world.CreateBody(&groundDef);
+	b2Vec2 vertices[4] = {b2Vec2(10.0f, 40.0f), b2Vec2(10.0f, 0.0f), b2Vec2(-10.0f, 0.0f), b2Vec2(-10.0f, 40.0f)};
+	b2ChainShape chain;
+	chain.CreateChain(vertices, 4, vertices[0], vertices[3]);
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.35f;
+	for (int32 i = 0; i < 1000; ++i)
+	{
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(-9.5f + 0.76f * float(i % 25), 1.0f + 0.8f * float(i / 25));
+		world.CreateBody(&bodyDef)->CreateFixture(&circle, 1.0f);
+	}
+
+	int32 moves = 0, pairs = 0;
+	for (int32 i = 0; i < 240; ++i)
+	{
+		world.Step(1.0f / 60.0f, 8, 3);
+
+		// New proxies are queried without being moved.
+		const b2Profile& profile = world.GetProfile();
+		CHECK(profile.pairQueries >= profile.proxyMoves);
+		moves += profile.proxyMoves;
+		pairs += profile.pairs;
+	}
+
+	CHECK(moves > 0);
+	CHECK(pairs > 0);
+
+	*touchingCount = 0;
+	for (b2Contact* c = world.GetContactList(); c; c = c->GetNext())
+	{
+		if (c->IsTouching())
+		{
+			++(*touchingCount);
+		}
+	}
+
+	return world.GetContactCount();
+}
+
+DOCTEST_TEST_CASE("adaptive margins")
+{
+	int32 fixedTouching, adaptiveTouching;
+	int32 fixedCount = RunPile(false, &fixedTouching);
+	int32 adaptiveCount = RunPile(true, &adaptiveTouching);
+
+	// Resting bodies keep tight margins, so far fewer contacts are not touching.
+	CHECK(adaptiveCount < fixedCount);
+
+	// The pile is packed either way.
+	CHECK(fixedTouching > 900);
+	CHECK(adaptiveTouching > 900);
+}
+
+DOCTEST_TEST_CASE("manifold reuse")
+{
+	for (int32 k = 0; k < 2; ++k)
+	{
+		b2World world(b2Vec2(0.0f, -10.0f));
+		world.SetManifoldReuse(k == 0);
+		CHECK(world.GetManifoldReuse() == (k == 0));
+		EventListener listener;
+		world.SetContactListener(&listener);
+
+		// A stack riding a platform does not move relative to it.
+		b2BodyDef platformDef;
+		platformDef.type = b2_kinematicBody;
+		platformDef.linearVelocity.Set(3.0f, 0.0f);
+		b2Body* platform = world.CreateBody(&platformDef);
+		b2PolygonShape platformBox;
+		platformBox.SetAsBox(5.0f, 0.5f);
+		platform->CreateFixture(&platformBox, 0.0f);
+
+		b2PolygonShape box;
+		box.SetAsBox(0.5f, 0.5f);
+		b2Body* bodies[3];
+		for (int32 i = 0; i < 3; ++i)
+		{
+			b2BodyDef bodyDef;
+			bodyDef.type = b2_dynamicBody;
+			bodyDef.position.Set(0.0f, 1.0f + 1.0f * float(i));
+			bodyDef.linearVelocity = platformDef.linearVelocity;
+			bodies[i] = world.CreateBody(&bodyDef);
+			bodies[i]->CreateFixture(&box, 1.0f);
+		}
+
+		int32 reusedCount = 0;
+		bool preSolved = true;
+		for (int32 i = 0; i < 120; ++i)
+		{
+			int32 eventCount = listener.count;
+			world.Step(1.0f / 60.0f, 8, 3);
+			reusedCount += world.GetProfile().reusedManifolds;
+
+			// Reused contacts are still reported every step.
+			preSolved = preSolved && listener.count > eventCount;
+		}
+
+		CHECK(preSolved);
+		if (k == 0)
+		{
+			CHECK(reusedCount > 100);
+		}
+		else
+		{
+			CHECK(reusedCount == 0);
+		}
+
+		// The stack stays on the platform, held apart by the polygon skins.
+		for (int32 i = 0; i < 3; ++i)
+		{
+			b2Vec2 p = bodies[i]->GetPosition() - platform->GetPosition();
+			CHECK(b2Abs(p.x) < 0.01f);
+			CHECK(p.y > 1.0f + 1.0f * float(i));
+			CHECK(p.y < 1.0f + 1.0f * float(i) + 2.0f * b2_polygonRadius * float(i + 1));
+		}
+	}
+}
+
+static void BuildMixedScene(b2World* world)
+{
+	b2BodyDef groundDef;
+	b2Body* ground = world->CreateBody(&groundDef);
+
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-20.0f, 0.0f), b2Vec2(0.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	b2Vec2 vertices[4] = { b2Vec2(20.0f, 10.0f), b2Vec2(20.0f, 0.0f), b2Vec2(0.0f, 0.0f), b2Vec2(0.0f, -1.0f) };
+	b2ChainShape chain;
+	chain.CreateChain(vertices, 4, b2Vec2(20.0f, 11.0f), b2Vec2(0.0f, -2.0f));
+	ground->CreateFixture(&chain, 0.0f);
+
+	b2CircleShape circle;
+	circle.m_radius = 0.4f;
+	b2PolygonShape box;
+	box.SetAsBox(0.35f, 0.35f);
+	b2Vec2 triangle[3] = { b2Vec2(-0.4f, -0.3f), b2Vec2(0.4f, -0.3f), b2Vec2(0.0f, 0.4f) };
+	b2PolygonShape wedge;
+	wedge.Set(triangle, 3);
+	b2CapsuleShape capsule;
+	capsule.Set(b2Vec2(-0.2f, 0.0f), b2Vec2(0.2f, 0.0f), 0.2f);
+
+	for (int32 i = 0; i < 240; ++i)
+	{
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(-18.0f + 0.95f * (i % 38), 1.0f + 0.95f * (i / 38));
+		bd.userData.pointer = uintptr_t(i + 1);
+		b2Body* body = world->CreateBody(&bd);
+
+		// Columns of one shape type, so like shapes stack as well.
+		int32 column = i % 38;
+		if (column % 4 == 0)
+		{
+			body->CreateFixture(&circle, 1.0f);
+		}
+		else if (column % 4 == 1)
+		{
+			body->CreateFixture(&box, 1.0f);
+		}
+		else if (column % 4 == 2)
+		{
+			body->CreateFixture(&wedge, 1.0f);
+		}
+		else
+		{
+			body->CreateFixture(&capsule, 1.0f);
+		}
+	}
+}
+
+DOCTEST_TEST_CASE("mixed shape types")
+{
+	ReverseTaskScheduler scheduler;
+	b2World serialWorld(b2Vec2(0.0f, -10.0f));
+	b2World parallelWorld(b2Vec2(0.0f, -10.0f), &scheduler);
+	EventListener serialListener;
+	EventListener parallelListener;
+	serialWorld.SetContactListener(&serialListener);
+	parallelWorld.SetContactListener(&parallelListener);
+	BuildMixedScene(&serialWorld);
+	BuildMixedScene(&parallelWorld);
+
+	for (int32 i = 0; i < 120; ++i)
+	{
+		serialWorld.Step(1.0f / 60.0f, 8, 3);
+		parallelWorld.Step(1.0f / 60.0f, 8, 3);
+	}
+
+	// The contacts cover every pair of shape types in the scene.
+	bool touched[b2Shape::e_typeCount][b2Shape::e_typeCount] = {};
+	for (b2Contact* c = serialWorld.GetContactList(); c != nullptr; c = c->GetNext())
+	{
+		if (c->IsTouching())
+		{
+			touched[c->GetFixtureA()->GetType()][c->GetFixtureB()->GetType()] = true;
+		}
+	}
+	CHECK(touched[b2Shape::e_circle][b2Shape::e_circle]);
+	CHECK(touched[b2Shape::e_polygon][b2Shape::e_circle]);
+	CHECK(touched[b2Shape::e_polygon][b2Shape::e_polygon]);
+	CHECK(touched[b2Shape::e_edge][b2Shape::e_circle]);
+	CHECK(touched[b2Shape::e_edge][b2Shape::e_polygon]);
+	CHECK(touched[b2Shape::e_chain][b2Shape::e_circle]);
+	CHECK(touched[b2Shape::e_chain][b2Shape::e_polygon]);
+	CHECK(touched[b2Shape::e_capsule][b2Shape::e_circle]);
+	CHECK(touched[b2Shape::e_capsule][b2Shape::e_capsule]);
+	CHECK(touched[b2Shape::e_polygon][b2Shape::e_capsule]);
+	CHECK(touched[b2Shape::e_edge][b2Shape::e_capsule]);
+	CHECK(touched[b2Shape::e_chain][b2Shape::e_capsule]);
+
+	// Manifolds computed across task ranges give the same results and events.
+	CHECK(serialWorld.GetContactCount() == parallelWorld.GetContactCount());
+	CHECK(serialListener.count == parallelListener.count);
+	CHECK(serialListener.hash == parallelListener.hash);
+
+	const b2Body* serialBody = serialWorld.GetBodyList();
+	const b2Body* parallelBody = parallelWorld.GetBodyList();
+	bool samePositions = true;
+	bool aboveGround = true;
+	while (serialBody != nullptr && parallelBody != nullptr)
+	{
+		samePositions = samePositions && serialBody->GetPosition() == parallelBody->GetPosition();
+		aboveGround = aboveGround && serialBody->GetPosition().y > -0.1f;
+		serialBody = serialBody->GetNext();
+		parallelBody = parallelBody->GetNext();
+	}
+	CHECK(samePositions);
+	CHECK(aboveGround);
+}
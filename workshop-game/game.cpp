@@ -70,6 +70,9 @@ void Game::createTrack() {
     |                    |
     ----------------------
     */
+    // Add the walls to the broad-phase in one go.
+    m_world->BeginBulkLoad();
+
     createWall(0, 0, 40, Orientation::Horizontal);
     createWall(0, 40, 40, Orientation::Horizontal);
     createWall(-20, 20, 40, Orientation::Vertical);
@@ -82,6 +85,8 @@ void Game::createTrack() {
     createWall(0, 17.5, 25, Orientation::Vertical);
     createWall(2.5, 30, 25, Orientation::Horizontal);
     createWall(-15, 17.5, 10, Orientation::Horizontal);
+
+    m_world->EndBulkLoad();
 }
 
 void Game::createTriangle() {